@@ -4,17 +4,23 @@
 #include <termios.h>
 #include <unistd.h>
 #endif
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <thread>
 #include <chrono>
 #include <functional>
 #include <boost/program_options.hpp>
 #include <cpprest/filestream.h>
 #include <cpprest/json.h>
+#include <openssl/sha.h>
 #include "ArgumentParser.h"
+#include "../common/DeltaSync.h"
+#include "../common/UnixHttpConnection.h"
 #include "../common/Utility.h"
 #include "../common/os/linux.hpp"
 #include "../common/os/chown.hpp"
+#include "../common/os/filemap.hpp"
 
 #define OPTION_HOST_NAME	("host,b", po::value<std::string>()->default_value("localhost"), "host name or ip address") \
 							("port,B", po::value<int>(), "port number")
@@ -39,8 +45,8 @@
 const static std::string m_tokenFilePrefix = std::string(getenv("HOME") ? getenv("HOME") : ".") + "/._appmgr_";
 static std::string m_jwtToken;
 
-ArgumentParser::ArgumentParser(int argc, const char* argv[], int listenPort, bool sslEnabled)
-	:m_listenPort(listenPort), m_sslEnabled(sslEnabled), m_tokenTimeoutSeconds(0)
+ArgumentParser::ArgumentParser(int argc, const char* argv[], int listenPort, bool sslEnabled, const std::string& localSocket)
+	:m_listenPort(listenPort), m_sslEnabled(sslEnabled), m_localSocket(localSocket), m_tokenTimeoutSeconds(0)
 {
 	po::options_description global("Global options");
 	global.add_options()
@@ -159,6 +165,11 @@ void ArgumentParser::parse()
 	{
 		processWatch();
 	}
+	else if (cmd == "batch")
+	{
+		// POST /appmgr/apps/batch
+		processBatch();
+	}
 	else
 	{
 		printMainHelp();
@@ -179,6 +190,7 @@ void ArgumentParser::printMainHelp()
 	std::cout << "  restart     Restart a application" << std::endl;
 	std::cout << "  reg         Add a new application" << std::endl;
 	std::cout << "  unreg       Remove an application" << std::endl;
+	std::cout << "  batch       Register, enable, disable or remove applications in one request" << std::endl;
 	std::cout << "  run         Run application and get output" << std::endl;
 	std::cout << "  get         Download remote file to local" << std::endl;
 	std::cout << "  put         Upload file to server" << std::endl;
@@ -300,12 +312,18 @@ void ArgumentParser::processReg()
 		("pid,p", po::value<int>(), "process id used to attach")
 		("virtual_memory,v", po::value<int>(), "virtual memory limit in MByte")
 		("cpu_shares,r", po::value<int>(), "CPU shares (relative weight)")
+		("cpu_quota", po::value<double>(), "CPU hard limit in number of CPUs (e.g., 1.5)")
+		("cpu_set", po::value<std::string>(), "pin to CPU list (e.g., '0-3,8')")
+		("cpu_cores", po::value<int>(), "pin to number of CPUs placed on one NUMA node automatically")
+		("mem_nodes", po::value<std::string>(), "bind memory to NUMA node list (default follow pinned CPUs)")
 		("env,e", po::value<std::vector<std::string>>(), "environment variables (e.g., -e env1=value1 -e env2=value2, APP_DOCKER_OPTS is used to input docker parameters)")
 		("interval,i", po::value<int>(), "start interval seconds for short running app")
 		("extra_time,q", po::value<int>(), "extra timeout for short running app,the value must less than interval  (default 0)")
 		("timezone,z", po::value<std::string>(), "posix timezone for the application, reflect [start_time|daily_start|daily_end] (e.g., 'WST+08:00' is Australia Standard Time)")
 		("keep_running,k", po::value<bool>()->default_value(false), "monitor and keep running for short running app in start interval")
 		("cache_lines,o", po::value<int>()->default_value(0), "number of output lines will be cached in server side (used for none-container app)")
+		("priority", po::value<int>(), "application start priority, higher starts first and is not delayed by host pressure when reach Pressure.CriticalPriority")
+		("metrics_interval", po::value<int>(), "sampling interval seconds for process io/fd/thread/context switch metrics (default 0, disabled)")
 		("force,f", "force without confirm")
 		("help,h", "Prints command usage to stdout and exits");
 
@@ -364,12 +382,17 @@ void ArgumentParser::processReg()
 	}
 
 	if (m_commandLineVariables.count("memory") || m_commandLineVariables.count("virtual_memory") ||
-		m_commandLineVariables.count("cpu_shares"))
+		m_commandLineVariables.count("cpu_shares") || m_commandLineVariables.count("cpu_quota") || m_commandLineVariables.count("cpu_set") ||
+		m_commandLineVariables.count("cpu_cores") || m_commandLineVariables.count("mem_nodes"))
 	{
 		web::json::value objResourceLimitation = web::json::value::object();
 		if (m_commandLineVariables.count("memory")) objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_memory_mb] = web::json::value::number(m_commandLineVariables["memory"].as<int>());
 		if (m_commandLineVariables.count("virtual_memory")) objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb] = web::json::value::number(m_commandLineVariables["virtual_memory"].as<int>());
 		if (m_commandLineVariables.count("cpu_shares")) objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_shares] = web::json::value::number(m_commandLineVariables["cpu_shares"].as<int>());
+		if (m_commandLineVariables.count("cpu_quota")) objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_quota] = web::json::value::number(m_commandLineVariables["cpu_quota"].as<double>());
+		if (m_commandLineVariables.count("cpu_set")) objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_set] = web::json::value::string(m_commandLineVariables["cpu_set"].as<std::string>());
+		if (m_commandLineVariables.count("cpu_cores")) objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_cpu_cores] = web::json::value::number(m_commandLineVariables["cpu_cores"].as<int>());
+		if (m_commandLineVariables.count("mem_nodes")) objResourceLimitation[JSON_KEY_RESOURCE_LIMITATION_mem_nodes] = web::json::value::string(m_commandLineVariables["mem_nodes"].as<std::string>());
 		jsobObj[JSON_KEY_APP_resource_limit] = objResourceLimitation;
 	}
 
@@ -394,6 +417,8 @@ void ArgumentParser::processReg()
 		}
 	}
 	if (m_commandLineVariables.count("cache_lines")) jsobObj[JSON_KEY_APP_cache_lines] = web::json::value::number(m_commandLineVariables["cache_lines"].as<int>());
+	if (m_commandLineVariables.count("priority")) jsobObj[JSON_KEY_APP_priority] = web::json::value::number(m_commandLineVariables["priority"].as<int>());
+	if (m_commandLineVariables.count("metrics_interval")) jsobObj[JSON_KEY_APP_metrics_interval] = web::json::value::number(m_commandLineVariables["metrics_interval"].as<int>());
 	if (m_commandLineVariables.count("pid")) jsobObj[JSON_KEY_APP_pid] = web::json::value::number(m_commandLineVariables["pid"].as<int>());
 	std::string restPath = std::string("/appmgr/app/") + m_commandLineVariables["name"].as<std::string>();
 	auto response = requestHttp(methods::PUT, restPath, jsobObj);
@@ -432,15 +457,29 @@ void ArgumentParser::processUnReg()
 					return;
 				}
 			}
-			std::string restPath = std::string("/appmgr/app/") + appName;
-			auto response = requestHttp(methods::DEL, restPath);
-			std::cout << GET_STD_STRING(response.extract_utf8string(true).get()) << std::endl;
 		}
 		else
 		{
 			throw std::invalid_argument(std::string("no such application : ") + appName);
 		}
 	}
+	if (appNames.size() > 1)
+	{
+		auto operations = web::json::value::array(appNames.size());
+		for (size_t i = 0; i < appNames.size(); i++)
+		{
+			operations[i][JSON_KEY_BATCH_action] = web::json::value::string(JSON_KEY_BATCH_action_delete);
+			operations[i][JSON_KEY_APP_name] = web::json::value::string(appNames[i]);
+		}
+		requestBatch(operations, false);
+		return;
+	}
+	for (auto appName : appNames)
+	{
+		std::string restPath = std::string("/appmgr/app/") + appName;
+		auto response = requestHttp(methods::DEL, restPath);
+		std::cout << GET_STD_STRING(response.extract_utf8string(true).get()) << std::endl;
+	}
 }
 
 void ArgumentParser::processView()
@@ -541,6 +580,18 @@ void ArgumentParser::processEnableDisable(bool start)
 			appList.push_back(appName);
 		}
 	}
+	if (appList.size() > 1)
+	{
+		// one request and one configuration write for all
+		auto operations = web::json::value::array(appList.size());
+		for (size_t i = 0; i < appList.size(); i++)
+		{
+			operations[i][JSON_KEY_BATCH_action] = web::json::value::string(start ? JSON_KEY_BATCH_action_enable : JSON_KEY_BATCH_action_disable);
+			operations[i][JSON_KEY_APP_name] = web::json::value::string(appList[i]);
+		}
+		requestBatch(operations, false);
+		return;
+	}
 	for (auto app : appList)
 	{
 		std::string restPath = std::string("/appmgr/app/") + app + +"/" + (start ? HTTP_QUERY_KEY_action_start : HTTP_QUERY_KEY_action_stop);
@@ -565,6 +616,7 @@ void ArgumentParser::processRun()
 		("env,e", po::value<std::vector<std::string>>(), "environment variables (e.g., -e env1=value1 -e env2=value2)")
 		("timeout,t", po::value<int>()->default_value(DEFAULT_RUN_APP_TIMEOUT_SECONDS), "timeout seconds for the shell command run. More than 0 means output will be fetch and print immediately, less than 0 means output will be print when process exited.")
 		("retention,r", po::value<int>()->default_value(DEFAULT_RUN_APP_RETENTION_DURATION), "retention duration after run finished (default 10s)")
+		("pool,p", "run by pre-forked shell worker of the user, fall back to normal run when not applicable")
 		;
 	shiftCommandLineArgs(desc);
 	HELP_ARG_CHECK_WITH_RETURN;
@@ -578,6 +630,7 @@ void ArgumentParser::processRun()
 	std::map<std::string, std::string> query;
 	int timeout = m_commandLineVariables["timeout"].as<int>();
 	if (m_commandLineVariables.count("timeout")) query[HTTP_QUERY_KEY_timeout] = std::to_string(timeout);
+	if (m_commandLineVariables.count("pool")) query[HTTP_QUERY_KEY_pool] = "1";
 
 	web::json::value jsobObj;
 	jsobObj[JSON_KEY_APP_command] = web::json::value::string(m_commandLineVariables["cmd"].as<std::string>());
@@ -643,6 +696,7 @@ void ArgumentParser::processDownload()
 		COMMON_OPTIONS
 		("remote,r", po::value<std::string>(), "remote file path")
 		("local,l", po::value<std::string>(), "save to local file path")
+		("continue,c", "resume download of a partial local file")
 		("help,h", "Prints command usage to stdout and exits")
 		;
 	shiftCommandLineArgs(desc);
@@ -659,9 +713,16 @@ void ArgumentParser::processDownload()
 	auto local = m_commandLineVariables["local"].as<std::string>();
 	std::map<std::string, std::string> query, headers;
 	headers[HTTP_HEADER_KEY_file_path] = file;
+	if (m_commandLineVariables.count("continue") && Utility::isFileExist(local))
+	{
+		struct stat st;
+		if (::stat(local.c_str(), &st) == 0 && st.st_size > 0) headers[HTTP_HEADER_KEY_Range] = std::string("bytes=") + std::to_string(st.st_size) + "-";
+	}
 	auto response = requestHttp(methods::GET, restPath, query, nullptr, &headers);
 
-	auto stream = concurrency::streams::file_stream<uint8_t>::open_ostream(local, std::ios_base::trunc | std::ios_base::binary).get();
+	// server reply the whole file if range is not applied
+	auto mode = (response.status_code() == status_codes::PartialContent ? std::ios_base::app : std::ios_base::trunc) | std::ios_base::binary;
+	auto stream = concurrency::streams::file_stream<uint8_t>::open_ostream(local, mode).get();
 	response.body().read_to_end(stream.streambuf()).wait();
 
 	std::cout << "Download file <" << local << "> size <" << Utility::humanReadableSize(stream.streambuf().size()) << ">" << std::endl;
@@ -679,6 +740,7 @@ void ArgumentParser::processUpload()
 		COMMON_OPTIONS
 		("remote,r", po::value<std::string>(), "save to remote file path")
 		("local,l", po::value<std::string>(), "local file path")
+		("parallel,P", po::value<int>()->default_value(DEFAULT_UPLOAD_PARALLEL), "number of parallel chunk streams")
 		("help,h", "Prints command usage to stdout and exits")
 		;
 	shiftCommandLineArgs(desc);
@@ -692,40 +754,165 @@ void ArgumentParser::processUpload()
 
 	auto file = m_commandLineVariables["remote"].as<std::string>();
 	auto local = m_commandLineVariables["local"].as<std::string>();
+	auto parallel = std::max(1, m_commandLineVariables["parallel"].as<int>());
 
 	if (!Utility::isFileExist(local))
 	{
 		std::cout << "local file not exist" << std::endl;
 		return;
 	}
-	// https://msdn.microsoft.com/en-us/magazine/dn342869.aspx
-
-	auto fileStream = concurrency::streams::file_stream<uint8_t>::open_istream(local, std::ios_base::binary).get();
-	// Get the content length, which is used to set the
-	// Content-Length property
-	fileStream.seek(0, std::ios::end);
-	auto length = static_cast<size_t>(fileStream.tell());
-	fileStream.seek(0, std::ios::beg);
-
+	os::FileMapping mapping(local);
+	if (!mapping.valid())
+	{
+		std::cout << "local file can not be read" << std::endl;
+		return;
+	}
 
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256(mapping.data(), mapping.size(), hash);
+	auto protocol = m_sslEnabled ? U("https://") : U("http://");
+	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
 	std::map<std::string, std::string> query, header;
 	header[HTTP_HEADER_KEY_file_path] = file;
+	header[HTTP_HEADER_KEY_file_mode] = std::to_string(os::fileStat(local));
+	header[HTTP_HEADER_KEY_file_user] = os::fileUser(local);
+
+	// 1. same content already in server artifact store, no transfer needed
+	{
+		web::http::client::http_client_config config;
+		config.set_timeout(std::chrono::seconds(65));
+		config.set_validate_certificates(false);
+		web::http::client::http_client client(restURL, config);
+		auto request = createRequest(methods::POST, std::string("/appmgr/file/artifact/") + Utility::hexEncode(hash, sizeof(hash)) + "/deploy", query, &header);
+		auto response = client.request(request).get();
+		if (response.status_code() == status_codes::OK)
+		{
+			auto result = response.extract_json(true).get();
+			std::cout << "File <" << file << "> deployed from artifact store by " << GET_JSON_STR_VALUE(result, JSON_KEY_ARTIFACT_method) << std::endl;
+			return;
+		}
+		if (response.status_code() != status_codes::NotFound)
+		{
+			throw std::invalid_argument(response.extract_utf8string(true).get());
+		}
+	}
 
-	auto protocol = m_sslEnabled ? U("https://") : U("http://");
-	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
-	// Create http_client to send the request.
-	http_client_config config;
-	config.set_timeout(std::chrono::seconds(200));
-	config.set_validate_certificates(false);
-	http_client client(restURL, config);
-	std::string restPath = "/appmgr/file/upload";
-	http_request request = createRequest(methods::POST, restPath, query, &header);
-
-	request.set_body(fileStream, length);
-	request.headers().add(HTTP_HEADER_KEY_file_mode, os::fileStat(local));
-	request.headers().add(HTTP_HEADER_KEY_file_user, os::fileUser(local));
-	http_response response = client.request(request).get();
-	fileStream.close();
+	// 2. send block delta against the current server copy
+	if (mapping.size() >= DeltaSync::MIN_BLOCK_SIZE * 2)
+	{
+		web::http::client::http_client_config config;
+		config.set_timeout(std::chrono::seconds(200));
+		config.set_validate_certificates(false);
+		web::http::client::http_client client(restURL, config);
+		auto response = client.request(createRequest(methods::GET, "/appmgr/file/delta/signature", query, &header)).get();
+		if (response.status_code() == status_codes::OK)
+		{
+			auto signature = response.extract_json(true).get();
+			const auto blockSize = static_cast<size_t>(GET_JSON_NUMBER_VALUE(signature, JSON_KEY_DELTA_block_size));
+			std::vector<DeltaSync::BlockSignature> blocks;
+			for (const auto& block : signature.at(JSON_KEY_DELTA_blocks).as_array())
+			{
+				blocks.push_back(DeltaSync::BlockSignature{ block.at(0).as_number().to_uint32(), std::stoull(GET_STD_STRING(block.at(1).as_string()), nullptr, 16) });
+			}
+			size_t literal = 0;
+			auto delta = blocks.size() ? DeltaSync::diff(mapping.data(), mapping.size(), blockSize, blocks, GET_JSON_NUMBER_VALUE(signature, JSON_KEY_DELTA_file_size), literal) : std::string();
+			// little in common, resumable chunked upload is better
+			if (blockSize && delta.size() && delta.size() < mapping.size() / 2 && delta.size() <= MAX_FILE_DELTA_SIZE)
+			{
+				auto deltaHeader = header;
+				deltaHeader[HTTP_HEADER_KEY_block_size] = std::to_string(blockSize);
+				deltaHeader[HTTP_HEADER_KEY_Digest] = std::string("sha-256=") + Utility::encode64(std::string(reinterpret_cast<const char*>(hash), sizeof(hash)));
+				auto request = createRequest(methods::POST, "/appmgr/file/delta", query, &deltaHeader);
+				request.set_body(std::vector<unsigned char>(delta.begin(), delta.end()));
+				response = client.request(request).get();
+				if (response.status_code() == status_codes::OK)
+				{
+					std::cout << "File <" << file << "> synchronized by delta, sent <" << delta.size() << "/" << mapping.size() << "> bytes" << std::endl;
+					return;
+				}
+				std::cout << "Delta failed, upload full content: " << response.extract_utf8string(true).get() << std::endl;
+			}
+		}
+	}
+
+	// 3. open or resume upload session
+	header[HTTP_HEADER_KEY_file_size] = std::to_string(mapping.size());
+	auto session = requestHttp(methods::POST, "/appmgr/file/upload/session", query, nullptr, &header).extract_json(true).get();
+	const auto sessionPath = std::string("/appmgr/file/upload/session/") + GET_JSON_STR_VALUE(session, JSON_KEY_UPLOAD_session_id);
+	const uint64_t chunkSize = std::max<int64_t>(GET_JSON_NUMBER_VALUE(session, JSON_KEY_UPLOAD_chunk_size), 1);
+
+	// 4. chunks not received by server yet
+	std::map<uint64_t, uint64_t> received;
+	if (HAS_JSON_FIELD(session, JSON_KEY_UPLOAD_received))
+	{
+		for (const auto& range : session.at(JSON_KEY_UPLOAD_received).as_array())
+		{
+			received[range.at(0).as_number().to_uint64()] = range.at(1).as_number().to_uint64();
+		}
+	}
+	std::vector<uint64_t> chunks;
+	for (uint64_t offset = 0; offset < mapping.size(); offset += chunkSize)
+	{
+		auto end = std::min<uint64_t>(offset + chunkSize, mapping.size());
+		auto iter = received.upper_bound(offset);
+		if (iter != received.begin() && (--iter)->first <= offset && iter->second >= end) continue;
+		chunks.push_back(offset);
+	}
+
+	// 5. send chunks with parallel streams
+	const auto authorization = std::string(HTTP_HEADER_JWT_BearerSpace) + getAuthenToken();
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::string error;
+	std::mutex errorMutex;
+	auto worker = [&]()
+	{
+		web::http::client::http_client_config config;
+		config.set_timeout(std::chrono::seconds(200));
+		config.set_validate_certificates(false);
+		web::http::client::http_client client(restURL, config);
+		for (auto index = next++; index < chunks.size() && !failed; index = next++)
+		{
+			const auto offset = chunks[index];
+			const auto length = std::min<uint64_t>(chunkSize, mapping.size() - offset);
+			for (int retry = 1; ; retry++)
+			{
+				try
+				{
+					uri_builder builder(GET_STRING_T(sessionPath));
+					builder.append_query(U(HTTP_QUERY_KEY_offset), GET_STRING_T(std::to_string(offset)));
+					http_request request(methods::PUT);
+					request.set_request_uri(builder.to_uri());
+					request.headers().add(HTTP_HEADER_JWT_Authorization, authorization);
+					request.set_body(std::vector<unsigned char>(mapping.data() + offset, mapping.data() + offset + length));
+					auto response = client.request(request).get();
+					if (response.status_code() != status_codes::OK) throw std::invalid_argument(response.extract_utf8string(true).get());
+					break;
+				}
+				catch (const std::exception& e)
+				{
+					if (retry < 3) continue;
+					std::lock_guard<std::mutex> guard(errorMutex);
+					error = std::string("upload chunk at <") + std::to_string(offset) + "> failed :" + e.what();
+					failed = true;
+					break;
+				}
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for (int i = 0; i < std::min<int>(parallel, chunks.size()); i++) threads.push_back(std::thread(worker));
+	for (auto& thread : threads) thread.join();
+	if (failed)
+	{
+		// session is kept in server, run the same command again to resume
+		throw std::invalid_argument(error);
+	}
+
+	// 6. verify checksum and move into place, server keep the content in artifact store
+	std::map<std::string, std::string> commitHeader;
+	commitHeader[HTTP_HEADER_KEY_Digest] = std::string("sha-256=") + Utility::encode64(std::string(reinterpret_cast<const char*>(hash), sizeof(hash)));
+	auto response = requestHttp(methods::POST, sessionPath + "/commit", query, nullptr, &commitHeader);
 	std::cout << GET_STD_STRING(response.extract_utf8string(true).get()) << std::endl;
 }
 
@@ -926,6 +1113,86 @@ void ArgumentParser::processEncryptUserPwd()
 	}
 }
 
+void ArgumentParser::processBatch()
+{
+	po::options_description desc("Manage applications in one request:");
+	desc.add_options()
+		COMMON_OPTIONS
+		("file,f", po::value<std::string>(), "json file of operations (e.g., [{\"action\":\"reg\",\"app\":{...}},{\"action\":\"disable\",\"name\":\"ping\"}]), action is reg/enable/disable/delete, application definitions without action are registered")
+		("rollback,r", "roll back all applied operations if any one failed")
+		("help,h", "Prints command usage to stdout and exits")
+		;
+	shiftCommandLineArgs(desc);
+	HELP_ARG_CHECK_WITH_RETURN;
+
+	if (!m_commandLineVariables.count("file"))
+	{
+		std::cout << desc << std::endl;
+		return;
+	}
+
+	auto content = Utility::readFileCpp(m_commandLineVariables["file"].as<std::string>());
+	auto json = web::json::value::parse(GET_STRING_T(content));
+	bool rollback = m_commandLineVariables.count("rollback") > 0;
+	if (json.is_object() && HAS_JSON_FIELD(json, JSON_KEY_BATCH_operations))
+	{
+		rollback = rollback || GET_JSON_BOOL_VALUE(json, JSON_KEY_BATCH_rollback);
+		json = json.at(JSON_KEY_BATCH_operations);
+	}
+	if (!json.is_array())
+	{
+		throw std::invalid_argument("batch file should be a json array of operations");
+	}
+	auto operations = web::json::value::array(json.size());
+	for (size_t i = 0; i < json.size(); i++)
+	{
+		if (HAS_JSON_FIELD(json[i], JSON_KEY_BATCH_action))
+		{
+			operations[i] = json[i];
+		}
+		else
+		{
+			operations[i][JSON_KEY_BATCH_action] = web::json::value::string(JSON_KEY_BATCH_action_reg);
+			operations[i][JSON_KEY_BATCH_app] = json[i];
+		}
+	}
+	requestBatch(operations, rollback);
+}
+
+void ArgumentParser::requestBatch(const web::json::value& operations, bool rollback)
+{
+	auto body = web::json::value::object();
+	body[JSON_KEY_BATCH_operations] = operations;
+	body[JSON_KEY_BATCH_rollback] = web::json::value::boolean(rollback);
+
+	web::json::value result;
+	try
+	{
+		auto response = requestHttp(methods::POST, "/appmgr/apps/batch", body);
+		result = response.extract_json(true).get();
+	}
+	catch (const std::invalid_argument& e)
+	{
+		// failed batch still reply the result of each operation
+		std::error_code ec;
+		result = web::json::value::parse(GET_STRING_T(std::string(e.what())), ec);
+		if (ec || !HAS_JSON_FIELD(result, JSON_KEY_BATCH_results)) throw;
+	}
+
+	for (const auto& item : result.at(JSON_KEY_BATCH_results).as_array())
+	{
+		std::cout << std::left
+			<< std::setw(8) << GET_JSON_STR_VALUE(item, JSON_KEY_BATCH_action)
+			<< std::setw(24) << GET_JSON_STR_VALUE(item, JSON_KEY_APP_name)
+			<< std::setw(5) << GET_JSON_INT_VALUE(item, JSON_KEY_BATCH_status)
+			<< GET_JSON_STR_VALUE(item, JSON_KEY_BATCH_message) << std::endl;
+	}
+	if (GET_JSON_BOOL_VALUE(result, JSON_KEY_BATCH_rolled_back))
+	{
+		std::cout << "Operation failed, all applied operations are rolled back." << std::endl;
+	}
+}
+
 void ArgumentParser::processWatch()
 {
 	po::options_description desc("Post consul watch:");
@@ -972,27 +1239,51 @@ http_response ArgumentParser::requestHttp(const method& mtd, const std::string&
 
 http_response ArgumentParser::requestHttp(const method& mtd, const std::string& path, std::map<std::string, std::string>& query, web::json::value* body, std::map<std::string, std::string>* header)
 {
-	auto protocol = m_sslEnabled ? U("https://") : U("http://");
-	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
-	// Create http_client to send the request.
-	web::http::client::http_client_config config;
-	config.set_timeout(std::chrono::seconds(65));
-	config.set_validate_certificates(false);
-	web::http::client::http_client client(restURL, config);
-	http_request request = createRequest(mtd, path, query, header);
+	// local socket peer credential is used when no user or token is given
+	const bool peerAuth = useLocalSocket() && m_username.empty() && readAuthenToken().empty();
+	http_request request = createRequest(mtd, path, query, header, !peerAuth);
 	if (body != nullptr)
 	{
 		request.set_body(*body);
 	}
-	http_response response = client.request(request).get();
-	if (response.status_code() != status_codes::OK)
+	http_response response = sendRequest(request, 65);
+	if (peerAuth && response.status_code() == status_codes::Unauthorized)
+	{
+		// peer not mapped to a user by daemon
+		request = createRequest(mtd, path, query, header);
+		if (body != nullptr) request.set_body(*body);
+		response = sendRequest(request, 65);
+	}
+	if (response.status_code() != status_codes::OK && response.status_code() != status_codes::PartialContent)
 	{
 		throw std::invalid_argument(response.extract_utf8string(true).get());
 	}
 	return std::move(response);
 }
 
-http_request ArgumentParser::createRequest(const method& mtd, const std::string& path, std::map<std::string, std::string>& query, std::map<std::string, std::string>* header)
+http_response ArgumentParser::sendRequest(const http_request& request, int timeoutSeconds)
+{
+	if (useLocalSocket())
+	{
+		return UnixHttpConnection::connect(m_localSocket, timeoutSeconds)->request(request);
+	}
+	auto protocol = m_sslEnabled ? U("https://") : U("http://");
+	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
+	// Create http_client to send the request.
+	web::http::client::http_client_config config;
+	config.set_timeout(std::chrono::seconds(timeoutSeconds));
+	config.set_validate_certificates(false);
+	web::http::client::http_client client(restURL, config);
+	return client.request(request).get();
+}
+
+bool ArgumentParser::useLocalSocket() const
+{
+	const bool localHost = (m_hostname == "localhost" || m_hostname == "127.0.0.1" || m_hostname == "::1");
+	return localHost && m_localSocket.length() && Utility::isFileExist(m_localSocket);
+}
+
+http_request ArgumentParser::createRequest(const method& mtd, const std::string& path, std::map<std::string, std::string>& query, std::map<std::string, std::string>* header, bool withToken)
 {
 	// Build request URI and start the request.
 	uri_builder builder(GET_STRING_T(path));
@@ -1009,8 +1300,11 @@ http_request ArgumentParser::createRequest(const method& mtd, const std::string&
 			request.headers().add(h.first, h.second);
 		}
 	}
-	auto jwtToken = getAuthenToken();
-	request.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + jwtToken);
+	if (withToken)
+	{
+		auto jwtToken = getAuthenToken();
+		request.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + jwtToken);
+	}
 	request.set_request_uri(builder.to_uri());
 	return std::move(request);
 }
@@ -1080,18 +1374,13 @@ std::string ArgumentParser::readAuthenToken()
 
 std::string ArgumentParser::requestToken(const std::string& user, const std::string& passwd)
 {
-	auto protocol = m_sslEnabled ? U("https://") : U("http://");
-	auto restURL = (protocol + GET_STRING_T(m_hostname) + ":" + GET_STRING_T(std::to_string(m_listenPort)));
-	http_client_config config;
-	config.set_validate_certificates(false);
-	http_client client(restURL, config);
 	http_request requestLogin(web::http::methods::POST);
 	uri_builder builder(GET_STRING_T("/appmgr/login"));
 	requestLogin.set_request_uri(builder.to_uri());
 	requestLogin.headers().add(HTTP_HEADER_JWT_username, Utility::encode64(user));
 	requestLogin.headers().add(HTTP_HEADER_JWT_password, Utility::encode64(passwd));
 	if (m_tokenTimeoutSeconds) requestLogin.headers().add(HTTP_HEADER_JWT_expire_seconds, std::to_string(m_tokenTimeoutSeconds));
-	http_response response = client.request(requestLogin).get();
+	http_response response = sendRequest(requestLogin, 30);
 	if (response.status_code() != status_codes::OK)
 	{
 		throw std::invalid_argument(std::string("Login failed ") + response.extract_utf8string(true).get());
@@ -19,7 +19,7 @@ namespace po = boost::program_options;
 class ArgumentParser
 {
 public:
-	ArgumentParser(int argc, const char* argv[], int listenPort, bool sslEnabled);
+	ArgumentParser(int argc, const char* argv[], int listenPort, bool sslEnabled, const std::string& localSocket);
 	virtual ~ArgumentParser();
 
 	void parse();
@@ -43,12 +43,16 @@ private:
 	void processLockUser();
 	void processEncryptUserPwd();
 	void processWatch();
+	void processBatch();
 
 	bool confirmInput(const char* msg);
 	http_response requestHttp(const method& mtd, const std::string& path);
 	http_response requestHttp(const method& mtd, const std::string& path, web::json::value& body);
 	http_response requestHttp(const method& mtd, const std::string& path, std::map<std::string, std::string>& query, web::json::value* body = nullptr, std::map<std::string, std::string>* header = nullptr);
-	http_request createRequest(const method& mtd, const std::string& path, std::map<std::string, std::string>& query, std::map<std::string, std::string>* header);
+	http_request createRequest(const method& mtd, const std::string& path, std::map<std::string, std::string>& query, std::map<std::string, std::string>* header, bool withToken = true);
+	// local socket when target localhost and daemon listen on it, otherwise TCP
+	http_response sendRequest(const http_request& request, int timeoutSeconds);
+	bool useLocalSocket() const;
 
 	std::string getAuthenToken();
 	std::string readAuthenToken();
@@ -57,6 +61,7 @@ private:
 private:
 	bool isAppExist(const std::string& appName);
 	std::map<std::string, bool> getAppList();
+	void requestBatch(const web::json::value& operations, bool rollback);
 	void printApps(web::json::value json, bool reduce);
 	void shiftCommandLineArgs(po::options_description& desc);
 	std::string reduceStr(std::string source, int limit);
@@ -67,6 +72,7 @@ private:
 	std::vector<po::option> m_pasrsedOptions;
 	int m_listenPort;
 	bool m_sslEnabled;
+	std::string m_localSocket;
 	int m_tokenTimeoutSeconds;
 	std::string m_hostname;
 	std::string m_username;
@@ -8,7 +8,7 @@ _appc()
 
     case $prev in
         appc)
-            COMPREPLY=( $(compgen -W "logon logoff view resource label enable disable restart reg unreg run get put config passwd lock log" -- $cur) )
+            COMPREPLY=( $(compgen -W "logon logoff view resource label enable disable restart reg unreg batch run get put config passwd lock log" -- $cur) )
             return
             ;;
         -n|--name)
@@ -11,7 +11,7 @@
 #include "../common/Utility.h"
 
 namespace po = boost::program_options;
-void getListenPort(int& port, bool& sslEnabled);
+void getListenPort(int& port, bool& sslEnabled, std::string& localSocket);
 
 int main(int argc, const char* argv[])
 {
@@ -20,9 +20,10 @@ int main(int argc, const char* argv[])
 	{
 		int port = DEFAULT_REST_LISTEN_PORT;
 		bool ssl = false;
+		std::string localSocket;
 		crossplat::threadpool::initialize_with_threads(1);
-		getListenPort(port, ssl);
-		ArgumentParser parser(argc, argv, port, ssl);
+		getListenPort(port, ssl, localSocket);
+		ArgumentParser parser(argc, argv, port, ssl, localSocket);
 		parser.parse();
 	}
 	catch (const std::exception & e)
@@ -33,7 +34,7 @@ int main(int argc, const char* argv[])
 	return 0;
 }
 
-void getListenPort(int& port, bool& sslEnabled)
+void getListenPort(int& port, bool& sslEnabled, std::string& localSocket)
 {
 	// Get listen port
 	web::json::value jsonValue;
@@ -63,6 +64,11 @@ void getListenPort(int& port, bool& sslEnabled)
 			{
 				sslEnabled = GET_JSON_BOOL_VALUE(rest.at(JSON_KEY_SSL), JSON_KEY_SSLEnabled);
 			}
+			// Local socket
+			if (HAS_JSON_FIELD(rest, JSON_KEY_LocalSocket))
+			{
+				localSocket = GET_JSON_STR_VALUE(rest.at(JSON_KEY_LocalSocket), JSON_KEY_LocalSocketPath);
+			}
 		}
 	}
 }
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <openssl/sha.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "DeltaSync.h"
+
+namespace
+{
+	void putUint32(std::string& out, uint32_t value)
+	{
+		for (int i = 0; i < 4; i++) out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+
+	void putUint64(std::string& out, uint64_t value)
+	{
+		for (int i = 0; i < 8; i++) out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+
+	uint64_t getUint(const unsigned char* data, int bytes)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < bytes; i++) value |= static_cast<uint64_t>(data[i]) << (8 * i);
+		return value;
+	}
+
+	void readFull(const DeltaSync::Reader& reader, uint64_t offset, unsigned char* buffer, size_t length)
+	{
+		size_t done = 0;
+		while (done < length)
+		{
+			const auto size = reader(offset + done, buffer + done, length - done);
+			// base is truncated while read
+			if (size == 0) throw std::invalid_argument("base content changed while reading");
+			done += size;
+		}
+	}
+}
+
+const size_t DeltaSync::MIN_BLOCK_SIZE;
+const size_t DeltaSync::MAX_BLOCK_SIZE;
+
+size_t DeltaSync::blockSize(uint64_t fileSize)
+{
+	// multiple of 1K
+	size_t size = static_cast<size_t>(std::sqrt(static_cast<double>(fileSize))) & ~static_cast<size_t>(1023);
+	if (size < MIN_BLOCK_SIZE) return MIN_BLOCK_SIZE;
+	if (size > MAX_BLOCK_SIZE) return MAX_BLOCK_SIZE;
+	return size;
+}
+
+uint32_t DeltaSync::weakChecksumScalar(const unsigned char* data, size_t length)
+{
+	uint32_t s1 = 0, s2 = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		s1 += data[i];
+		s2 += s1;
+	}
+	return (s1 & 0xFFFF) | (s2 << 16);
+}
+
+uint32_t DeltaSync::weakChecksum(const unsigned char* data, size_t length)
+{
+#if defined(__SSE2__)
+	// 16 bytes per step: s2 += 16 * s1 + sum((16 - k) * x[k]), s1 += sum(x[k])
+	// s1 of previous steps is accumulated in a vector and multiplied once at the end
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i weightLow = _mm_set_epi16(9, 10, 11, 12, 13, 14, 15, 16);
+	const __m128i weightHigh = _mm_set_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+	__m128i vs1 = zero, vs1Prefix = zero, vs2 = zero;
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		vs1Prefix = _mm_add_epi32(vs1Prefix, vs1);
+		vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(v, zero));
+		vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpacklo_epi8(v, zero), weightLow));
+		vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpackhi_epi8(v, zero), weightHigh));
+	}
+	// horizontal sum, sad result is in 32 bit lane 0 and 2
+	vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(1, 0, 3, 2)));
+	vs2 = _mm_add_epi32(vs2, _mm_shuffle_epi32(vs2, _MM_SHUFFLE(2, 3, 0, 1)));
+	vs1 = _mm_add_epi32(vs1, _mm_shuffle_epi32(vs1, _MM_SHUFFLE(1, 0, 3, 2)));
+	vs1Prefix = _mm_add_epi32(vs1Prefix, _mm_shuffle_epi32(vs1Prefix, _MM_SHUFFLE(1, 0, 3, 2)));
+	uint32_t s1 = static_cast<uint32_t>(_mm_cvtsi128_si32(vs1));
+	uint32_t s2 = 16 * static_cast<uint32_t>(_mm_cvtsi128_si32(vs1Prefix)) + static_cast<uint32_t>(_mm_cvtsi128_si32(vs2));
+	for (; i < length; i++)
+	{
+		s1 += data[i];
+		s2 += s1;
+	}
+	return (s1 & 0xFFFF) | (s2 << 16);
+#else
+	return weakChecksumScalar(data, length);
+#endif
+}
+
+uint64_t DeltaSync::strongChecksum(const unsigned char* data, size_t length)
+{
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256(data, length, hash);
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++) value = (value << 8) | hash[i];
+	return value;
+}
+
+std::vector<DeltaSync::BlockSignature> DeltaSync::signatures(const unsigned char* data, size_t size, size_t blockSize)
+{
+	std::vector<BlockSignature> result;
+	result.reserve((size + blockSize - 1) / blockSize);
+	for (size_t offset = 0; offset < size; offset += blockSize)
+	{
+		auto length = std::min(blockSize, size - offset);
+		result.push_back(BlockSignature{ weakChecksum(data + offset, length), strongChecksum(data + offset, length) });
+	}
+	return result;
+}
+
+std::vector<DeltaSync::BlockSignature> DeltaSync::signatures(const Reader& reader, uint64_t size, size_t blockSize)
+{
+	std::vector<BlockSignature> result;
+	result.reserve(static_cast<size_t>((size + blockSize - 1) / blockSize));
+	std::vector<unsigned char> block(blockSize);
+	for (uint64_t offset = 0; offset < size; offset += blockSize)
+	{
+		const auto length = static_cast<size_t>(std::min<uint64_t>(blockSize, size - offset));
+		readFull(reader, offset, block.data(), length);
+		result.push_back(BlockSignature{ weakChecksum(block.data(), length), strongChecksum(block.data(), length) });
+	}
+	return result;
+}
+
+std::string DeltaSync::diff(const unsigned char* data, size_t size, size_t blockSize, const std::vector<BlockSignature>& base, uint64_t baseSize, size_t& literal)
+{
+	std::unordered_map<uint32_t, std::vector<size_t>> index;
+	index.reserve(base.size());
+	for (size_t i = 0; i < base.size(); i++)
+	{
+		// the short last block only match the end of data
+		if (i + 1 < base.size() || baseSize % blockSize == 0) index[base[i].m_weak].push_back(i);
+	}
+
+	std::string delta;
+	literal = 0;
+	size_t literalStart = 0;
+	uint64_t copyIndex = 0;
+	uint32_t copyCount = 0;
+	auto flushCopy = [&]()
+	{
+		if (copyCount == 0) return;
+		delta.push_back('C');
+		putUint64(delta, copyIndex);
+		putUint32(delta, copyCount);
+		copyCount = 0;
+	};
+	auto flushLiteral = [&](size_t end)
+	{
+		if (end <= literalStart) return;
+		flushCopy();
+		while (literalStart < end)
+		{
+			const auto length = std::min<size_t>(end - literalStart, UINT32_MAX);
+			delta.push_back('L');
+			putUint32(delta, static_cast<uint32_t>(length));
+			delta.append(reinterpret_cast<const char*>(data + literalStart), length);
+			literal += length;
+			literalStart += length;
+		}
+	};
+	auto addCopy = [&](size_t block)
+	{
+		if (copyCount && copyIndex + copyCount == block) copyCount++;
+		else
+		{
+			flushCopy();
+			copyIndex = block;
+			copyCount = 1;
+		}
+	};
+
+	size_t pos = 0;
+	uint32_t weak = 0;
+	bool weakValid = false;
+	while (pos + blockSize <= size)
+	{
+		if (!weakValid) weak = weakChecksum(data + pos, blockSize);
+		weakValid = true;
+		auto iter = index.find(weak);
+		if (iter != index.end())
+		{
+			const auto strong = strongChecksum(data + pos, blockSize);
+			const size_t expected = copyCount ? copyIndex + copyCount : 0;
+			size_t matched = base.size();
+			for (auto block : iter->second)
+			{
+				if (base[block].m_strong != strong) continue;
+				matched = block;
+				// prefer the next block of current copy to get a longer run
+				if (block == expected) break;
+			}
+			if (matched < base.size())
+			{
+				flushLiteral(pos);
+				addCopy(matched);
+				pos += blockSize;
+				literalStart = pos;
+				weakValid = false;
+				continue;
+			}
+		}
+		if (pos + blockSize < size) weak = rollChecksum(weak, data[pos], data[pos + blockSize], blockSize);
+		else weakValid = false;
+		pos++;
+	}
+	// tail shorter than one block
+	const size_t lastLength = baseSize % blockSize;
+	if (base.size() && lastLength && size - pos == lastLength &&
+		base.back().m_weak == weakChecksum(data + pos, lastLength) && base.back().m_strong == strongChecksum(data + pos, lastLength))
+	{
+		flushLiteral(pos);
+		addCopy(base.size() - 1);
+		literalStart = size;
+	}
+	flushLiteral(size);
+	flushCopy();
+	return delta;
+}
+
+void DeltaSync::apply(const unsigned char* base, size_t baseSize, size_t blockSize, const unsigned char* delta, size_t deltaSize, const Writer& writer)
+{
+	size_t pos = 0;
+	while (pos < deltaSize)
+	{
+		const auto op = delta[pos++];
+		if (op == 'C' && pos + 12 <= deltaSize)
+		{
+			const auto block = getUint(delta + pos, 8);
+			const auto count = getUint(delta + pos + 8, 4);
+			pos += 12;
+			if (count == 0 || block >= (baseSize + blockSize - 1) / blockSize) throw std::invalid_argument("delta copy out of range");
+			const uint64_t offset = block * blockSize;
+			const uint64_t end = std::min<uint64_t>(offset + count * blockSize, baseSize);
+			writer(base + offset, end - offset);
+		}
+		else if (op == 'L' && pos + 4 <= deltaSize)
+		{
+			const auto length = getUint(delta + pos, 4);
+			pos += 4;
+			if (length > deltaSize - pos) throw std::invalid_argument("delta literal out of range");
+			writer(delta + pos, length);
+			pos += length;
+		}
+		else
+		{
+			throw std::invalid_argument("malformed delta");
+		}
+	}
+}
+
+void DeltaSync::apply(const Reader& base, uint64_t baseSize, size_t blockSize, const unsigned char* delta, size_t deltaSize, const Writer& writer)
+{
+	std::vector<unsigned char> block(blockSize);
+	size_t pos = 0;
+	while (pos < deltaSize)
+	{
+		const auto op = delta[pos++];
+		if (op == 'C' && pos + 12 <= deltaSize)
+		{
+			const auto first = getUint(delta + pos, 8);
+			const auto count = getUint(delta + pos + 8, 4);
+			pos += 12;
+			if (count == 0 || first >= (baseSize + blockSize - 1) / blockSize) throw std::invalid_argument("delta copy out of range");
+			const uint64_t end = std::min<uint64_t>((first + count) * blockSize, baseSize);
+			for (uint64_t offset = first * blockSize; offset < end; offset += blockSize)
+			{
+				const auto length = static_cast<size_t>(std::min<uint64_t>(blockSize, end - offset));
+				readFull(base, offset, block.data(), length);
+				writer(block.data(), length);
+			}
+		}
+		else if (op == 'L' && pos + 4 <= deltaSize)
+		{
+			const auto length = getUint(delta + pos, 4);
+			pos += 4;
+			if (length > deltaSize - pos) throw std::invalid_argument("delta literal out of range");
+			writer(delta + pos, length);
+			pos += length;
+		}
+		else
+		{
+			throw std::invalid_argument("malformed delta");
+		}
+	}
+}
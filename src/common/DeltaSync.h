@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+/// rsync style block delta
+/// The receiver publish a weak (rolling) and a strong checksum for each
+/// block of its current copy, the sender slide a rolling window over the new
+/// content and encode matched blocks as block references, the rest as
+/// literal bytes. The receiver rebuild the new content from its copy.
+///
+/// Delta stream: sequence of
+///   'C' u64 block index, u32 block count   copy blocks of the base
+///   'L' u32 length, bytes                  literal data
+/// integers are little endian.
+//////////////////////////////////////////////////////////////////////////
+class DeltaSync
+{
+public:
+	struct BlockSignature
+	{
+		uint32_t m_weak;
+		uint64_t m_strong;
+	};
+
+	// Sink for rebuilt content
+	typedef std::function<void(const unsigned char* data, size_t length)> Writer;
+	// Read base content at offset, return bytes read (short at end of file)
+	typedef std::function<size_t(uint64_t offset, unsigned char* buffer, size_t length)> Reader;
+
+	static const size_t MIN_BLOCK_SIZE = 2 * 1024;
+	static const size_t MAX_BLOCK_SIZE = 128 * 1024;
+
+	// block size grow with sqrt of file size, same as rsync
+	static size_t blockSize(uint64_t fileSize);
+
+	// rsync weak checksum: low 16 bits sum of bytes, high 16 bits sum of prefix sums
+	static uint32_t weakChecksum(const unsigned char* data, size_t length);
+	static uint32_t weakChecksumScalar(const unsigned char* data, size_t length);
+	// remove out byte and append in byte for a window of length
+	static inline uint32_t rollChecksum(uint32_t checksum, unsigned char out, unsigned char in, size_t length)
+	{
+		uint32_t a = (checksum & 0xFFFF) - out + in;
+		uint32_t b = (checksum >> 16) - static_cast<uint32_t>(length) * out + a;
+		return (a & 0xFFFF) | (b << 16);
+	}
+	// first 8 bytes of SHA-256
+	static uint64_t strongChecksum(const unsigned char* data, size_t length);
+
+	static std::vector<BlockSignature> signatures(const unsigned char* data, size_t size, size_t blockSize);
+	// Same as above, base is read block by block, throw std::invalid_argument when it is shorter than size
+	static std::vector<BlockSignature> signatures(const Reader& reader, uint64_t size, size_t blockSize);
+	// Encode data against the signatures of base, literal reports the literal bytes in delta
+	static std::string diff(const unsigned char* data, size_t size, size_t blockSize, const std::vector<BlockSignature>& base, uint64_t baseSize, size_t& literal);
+	// Rebuild content from base and delta, throw std::invalid_argument for a malformed delta
+	static void apply(const unsigned char* base, size_t baseSize, size_t blockSize, const unsigned char* delta, size_t deltaSize, const Writer& writer);
+	// Same as above, copied blocks are read from base, throw std::invalid_argument when it is shorter than baseSize
+	static void apply(const Reader& base, uint64_t baseSize, size_t blockSize, const unsigned char* delta, size_t deltaSize, const Writer& writer);
+};
@@ -1,5 +1,5 @@
 #include "HttpRequest.h"
-#include "../daemon/Application.h"
+#include <stdexcept>
 
 HttpRequest::HttpRequest(const web::http::http_request& message)
 	:http_request(message)
@@ -66,6 +66,16 @@ pplx::task<void> HttpRequest::reply(status_code status, const concurrency::strea
 	return reply(response);
 }
 
+const std::string& HttpRequest::getPathParam(const std::string& name) const
+{
+	auto iter = m_pathParams.find(name);
+	if (iter == m_pathParams.end())
+	{
+		throw std::invalid_argument(std::string("failed to get ") + name + " from path");
+	}
+	return iter->second;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // HttpRequestWithCallback
 ////////////////////////////////////////////////////////////////////////////////
@@ -81,15 +91,3 @@ HttpRequestWithCallback::~HttpRequestWithCallback()
 		m_callBackHandler(m_appName);
 	}
 }
-////////////////////////////////////////////////////////////////////////////////
-// HttpRequest with remove app from global map
-////////////////////////////////////////////////////////////////////////////////
-HttpRequestWithAppRef::HttpRequestWithAppRef(const web::http::http_request& message, const std::shared_ptr<Application>& appObj)
-	:HttpRequest(message), m_app(appObj)
-{
-}
-
-HttpRequestWithAppRef::~HttpRequestWithAppRef()
-{
-	if (m_app) m_app->onSuicideEvent();
-}
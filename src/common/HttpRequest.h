@@ -1,7 +1,9 @@
 #pragma once
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <string>
 #include <cpprest/http_client.h>
 
 using namespace web;
@@ -108,6 +110,16 @@ public:
 		const concurrency::streams::istream& body,
 		utility::size64_t content_length,
 		const utility::string_t& content_type = _XPLATSTR("application/octet-stream")) const;
+
+	/// <summary>
+	/// Get the decoded path parameter extracted by the route.
+	/// </summary>
+	/// <param name="name">Parameter name in route, e.g. name of /appmgr/app/{name}.</param>
+	/// <returns>Parameter value, throw std::invalid_argument if not exist.</returns>
+	const std::string& getPathParam(const std::string& name) const;
+
+	// path parameters set by RestRouter match
+	std::map<std::string, std::string> m_pathParams;
 };
 
 class HttpRequestWithCallback : public HttpRequest
@@ -120,14 +132,3 @@ private:
 	std::string m_appName;
 	std::function<void(std::string)> m_callBackHandler;
 };
-
-class Application;
-class HttpRequestWithAppRef : public HttpRequest
-{
-public:
-	HttpRequestWithAppRef(const web::http::http_request& message, const std::shared_ptr<Application>& appObj);
-	virtual ~HttpRequestWithAppRef();
-
-private:
-	const std::shared_ptr<Application> m_app;
-};
@@ -0,0 +1,212 @@
+#include <cstdio>
+#include <stdexcept>
+#include "JsonWriter.h"
+#include "Utility.h"
+
+JsonWriter::JsonWriter(bool pretty, size_t flushSize, const Sink& sink)
+	:m_pretty(pretty), m_flushSize(flushSize), m_sink(sink), m_afterKey(false)
+{
+	if (m_sink && m_flushSize) m_buffer.reserve(m_flushSize + 256);
+}
+
+JsonWriter::~JsonWriter()
+{
+}
+
+void JsonWriter::newLine()
+{
+	m_buffer.push_back('\n');
+	m_buffer.append(m_levels.size(), '\t');
+}
+
+void JsonWriter::beforeValue()
+{
+	if (m_afterKey)
+	{
+		m_afterKey = false;
+		return;
+	}
+	if (m_levels.size())
+	{
+		if (m_levels.back()++) m_buffer.push_back(',');
+		if (m_pretty) newLine();
+	}
+}
+
+void JsonWriter::checkFlush()
+{
+	// only flush between elements
+	if (m_sink && m_flushSize && !m_afterKey && m_buffer.length() >= m_flushSize) m_sink(m_buffer);
+}
+
+JsonWriter& JsonWriter::startObject()
+{
+	beforeValue();
+	m_buffer.push_back('{');
+	m_levels.push_back(0);
+	return *this;
+}
+
+JsonWriter& JsonWriter::endObject()
+{
+	if (m_levels.empty()) throw std::logic_error("JsonWriter: no open object");
+	auto count = m_levels.back();
+	m_levels.pop_back();
+	if (m_pretty && count) newLine();
+	m_buffer.push_back('}');
+	checkFlush();
+	return *this;
+}
+
+JsonWriter& JsonWriter::startArray()
+{
+	beforeValue();
+	m_buffer.push_back('[');
+	m_levels.push_back(0);
+	return *this;
+}
+
+JsonWriter& JsonWriter::endArray()
+{
+	if (m_levels.empty()) throw std::logic_error("JsonWriter: no open array");
+	auto count = m_levels.back();
+	m_levels.pop_back();
+	if (m_pretty && count) newLine();
+	m_buffer.push_back(']');
+	checkFlush();
+	return *this;
+}
+
+JsonWriter& JsonWriter::key(const std::string& name)
+{
+	beforeValue();
+	m_buffer.push_back('"');
+	escape(name, m_buffer);
+	m_buffer.append(m_pretty ? "\": " : "\":");
+	m_afterKey = true;
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(const std::string& str)
+{
+	beforeValue();
+	m_buffer.push_back('"');
+	escape(str, m_buffer);
+	m_buffer.push_back('"');
+	checkFlush();
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* str)
+{
+	return value(std::string(str));
+}
+
+JsonWriter& JsonWriter::value(long long number)
+{
+	beforeValue();
+	m_buffer.append(std::to_string(number));
+	checkFlush();
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(double number)
+{
+	beforeValue();
+	char buf[32] = { 0 };
+	std::snprintf(buf, sizeof(buf), "%.17g", number);
+	m_buffer.append(buf);
+	checkFlush();
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(bool boolean)
+{
+	beforeValue();
+	m_buffer.append(boolean ? "true" : "false");
+	checkFlush();
+	return *this;
+}
+
+JsonWriter& JsonWriter::null()
+{
+	beforeValue();
+	m_buffer.append("null");
+	checkFlush();
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(const web::json::value& json)
+{
+	switch (json.type())
+	{
+	case web::json::value::Object:
+		startObject();
+		for (const auto& field : json.as_object())
+		{
+			key(GET_STD_STRING(field.first));
+			value(field.second);
+		}
+		return endObject();
+	case web::json::value::Array:
+		startArray();
+		for (const auto& element : json.as_array())
+		{
+			value(element);
+		}
+		return endArray();
+	case web::json::value::String:
+		return value(GET_STD_STRING(json.as_string()));
+	case web::json::value::Boolean:
+		return value(json.as_bool());
+	case web::json::value::Number:
+		if (json.is_integer())
+		{
+			const auto& number = json.as_number();
+			if (number.is_uint64() && !number.is_int64())
+			{
+				beforeValue();
+				m_buffer.append(std::to_string(number.to_uint64()));
+				checkFlush();
+				return *this;
+			}
+			return value(static_cast<long long>(number.to_int64()));
+		}
+		return value(json.as_double());
+	default:
+		return null();
+	}
+}
+
+void JsonWriter::flush()
+{
+	if (m_sink && m_buffer.length()) m_sink(m_buffer);
+}
+
+void JsonWriter::escape(const std::string& str, std::string& out)
+{
+	for (auto c : str)
+	{
+		switch (c)
+		{
+		case '"': out.append("\\\""); break;
+		case '\\': out.append("\\\\"); break;
+		case '\b': out.append("\\b"); break;
+		case '\f': out.append("\\f"); break;
+		case '\n': out.append("\\n"); break;
+		case '\r': out.append("\\r"); break;
+		case '\t': out.append("\\t"); break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char buf[8] = { 0 };
+				std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+				out.append(buf);
+			}
+			else
+			{
+				out.push_back(c);
+			}
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <cpprest/json.h>
+
+//////////////////////////////////////////////////////////////////////////
+/// Streaming JSON writer, output is appended to a buffer and handed to the
+/// sink when the buffer reach flush size, so a large document never exist
+/// as one json::value tree or one string.
+/// Pretty format is the same as Utility::prettyJson.
+//////////////////////////////////////////////////////////////////////////
+class JsonWriter
+{
+public:
+	// sink receive the filled buffer and should consume (clear or swap) it
+	typedef std::function<void(std::string& buffer)> Sink;
+
+	explicit JsonWriter(bool pretty, size_t flushSize = 0, const Sink& sink = nullptr);
+	virtual ~JsonWriter();
+
+	JsonWriter& startObject();
+	JsonWriter& endObject();
+	JsonWriter& startArray();
+	JsonWriter& endArray();
+	JsonWriter& key(const std::string& name);
+
+	JsonWriter& value(const std::string& str);
+	JsonWriter& value(const char* str);
+	JsonWriter& value(long long number);
+	JsonWriter& value(int number) { return value(static_cast<long long>(number)); }
+	JsonWriter& value(double number);
+	JsonWriter& value(bool boolean);
+	JsonWriter& null();
+	// write a json value, used for the sub objects already have AsJson()
+	JsonWriter& value(const web::json::value& json);
+
+	// hand the remaining buffer to sink
+	void flush();
+	// written content when no sink is set
+	std::string& str() { return m_buffer; }
+
+	static void escape(const std::string& str, std::string& out);
+
+private:
+	void beforeValue();
+	void newLine();
+	void checkFlush();
+
+	const bool m_pretty;
+	const size_t m_flushSize;
+	const Sink m_sink;
+	std::string m_buffer;
+	// element count of each open container
+	std::vector<size_t> m_levels;
+	bool m_afterKey;
+};
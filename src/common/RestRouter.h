@@ -0,0 +1,146 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////
+/// REST route table, compiled once when routes are bound
+/// Static path:        /appmgr/applications        (hash lookup)
+/// Parametrized path:  /appmgr/app/{name}/output   (segment trie)
+/// A parameter matches one non-empty segment without '*', literal segment
+/// take priority over parameter on the same level.
+//////////////////////////////////////////////////////////////////////////
+template <typename Handler>
+class RestRouter
+{
+public:
+	typedef std::map<std::string, std::string> PathParams;
+
+	RestRouter() :m_root(new Node()) {}
+
+	void addRoute(const std::string& pattern, const Handler& handler)
+	{
+		if (pattern.empty() || pattern[0] != '/')
+		{
+			throw std::invalid_argument(std::string("route should start with '/' : ") + pattern);
+		}
+		if (pattern.find('{') == std::string::npos)
+		{
+			m_staticRoutes[pattern] = handler;
+			return;
+		}
+		auto node = m_root.get();
+		for (const auto& segment : split(pattern))
+		{
+			if (segment.length() > 2 && segment.front() == '{' && segment.back() == '}')
+			{
+				auto name = segment.substr(1, segment.length() - 2);
+				if (node->paramChild == nullptr)
+				{
+					node->paramChild.reset(new Node());
+					node->paramName = name;
+				}
+				else if (node->paramName != name)
+				{
+					throw std::invalid_argument(std::string("route parameter name conflict : ") + pattern);
+				}
+				node = node->paramChild.get();
+			}
+			else
+			{
+				auto& child = node->children[segment];
+				if (child == nullptr) child.reset(new Node());
+				node = child.get();
+			}
+		}
+		node->handler = handler;
+		node->hasHandler = true;
+	}
+
+	// Return the handler of the path, nullptr if no route match
+	const Handler* match(const std::string& path, PathParams& params) const
+	{
+		params.clear();
+		auto iter = m_staticRoutes.find(path);
+		if (iter != m_staticRoutes.end()) return &(iter->second);
+
+		const auto segments = split(path);
+		std::vector<std::pair<const std::string*, const std::string*>> values;
+		auto node = matchNode(m_root.get(), segments, 0, values);
+		if (node == nullptr) return nullptr;
+		for (const auto& value : values) params[*value.first] = *value.second;
+		return &(node->handler);
+	}
+
+	size_t size() const
+	{
+		return m_staticRoutes.size() + count(m_root.get());
+	}
+
+private:
+	struct Node
+	{
+		Node() :hasHandler(false) {}
+		std::unordered_map<std::string, std::unique_ptr<Node>> children;
+		std::unique_ptr<Node> paramChild;
+		std::string paramName;
+		Handler handler;
+		bool hasHandler;
+	};
+
+	static std::vector<std::string> split(const std::string& path)
+	{
+		std::vector<std::string> segments;
+		size_t start = 0;
+		while (start < path.length())
+		{
+			auto end = path.find('/', start);
+			if (end == std::string::npos) end = path.length();
+			if (end > start) segments.push_back(path.substr(start, end - start));
+			start = end + 1;
+		}
+		return segments;
+	}
+
+	static bool isParamValue(const std::string& segment)
+	{
+		return !segment.empty() && segment.find('*') == std::string::npos;
+	}
+
+	// depth first, literal child before parameter child
+	static const Node* matchNode(const Node* node, const std::vector<std::string>& segments, size_t index,
+		std::vector<std::pair<const std::string*, const std::string*>>& values)
+	{
+		if (index == segments.size()) return node->hasHandler ? node : nullptr;
+
+		auto child = node->children.find(segments[index]);
+		if (child != node->children.end())
+		{
+			auto found = matchNode(child->second.get(), segments, index + 1, values);
+			if (found) return found;
+		}
+		if (node->paramChild && isParamValue(segments[index]))
+		{
+			values.push_back(std::make_pair(&node->paramName, &segments[index]));
+			auto found = matchNode(node->paramChild.get(), segments, index + 1, values);
+			if (found) return found;
+			values.pop_back();
+		}
+		return nullptr;
+	}
+
+	static size_t count(const Node* node)
+	{
+		size_t total = node->hasHandler ? 1 : 0;
+		for (const auto& child : node->children) total += count(child.second.get());
+		if (node->paramChild) total += count(node->paramChild.get());
+		return total;
+	}
+
+	std::unordered_map<std::string, Handler> m_staticRoutes;
+	std::unique_ptr<Node> m_root;
+};
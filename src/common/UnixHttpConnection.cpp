@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "UnixHttpConnection.h"
+#include "Utility.h"
+
+namespace
+{
+	const size_t READ_SIZE = 64 * 1024;
+	const size_t MAX_LINE_SIZE = 64 * 1024;
+}
+
+UnixHttpConnection::UnixHttpConnection(int fd)
+	:m_fd(fd), m_offset(0), m_maxHeaderSize(std::numeric_limits<size_t>::max()), m_maxBodySize(std::numeric_limits<size_t>::max())
+{
+}
+
+UnixHttpConnection::~UnixHttpConnection()
+{
+	if (m_fd >= 0) ::close(m_fd);
+}
+
+std::shared_ptr<UnixHttpConnection> UnixHttpConnection::connect(const std::string& socketPath, int timeoutSeconds)
+{
+	struct sockaddr_un addr;
+	if (socketPath.empty() || socketPath.length() >= sizeof(addr.sun_path))
+	{
+		throw std::invalid_argument(std::string("invalid local socket path : ") + socketPath);
+	}
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) throw std::invalid_argument(std::string("create local socket failed : ") + std::strerror(errno));
+	auto connection = std::make_shared<UnixHttpConnection>(fd);
+	if (timeoutSeconds > 0)
+	{
+		struct timeval timeout = { timeoutSeconds, 0 };
+		::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	}
+	if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+	{
+		throw std::invalid_argument(std::string("connect local socket <") + socketPath + "> failed : " + std::strerror(errno));
+	}
+	return connection;
+}
+
+void UnixHttpConnection::setLimits(size_t maxHeaderSize, size_t maxBodySize)
+{
+	m_maxHeaderSize = maxHeaderSize;
+	m_maxBodySize = maxBodySize;
+}
+
+bool UnixHttpConnection::fill()
+{
+	// drop consumed data
+	if (m_offset)
+	{
+		m_buffer.erase(0, m_offset);
+		m_offset = 0;
+	}
+	char data[READ_SIZE];
+	while (true)
+	{
+		auto size = ::recv(m_fd, data, sizeof(data), 0);
+		if (size > 0)
+		{
+			m_buffer.append(data, size);
+			return true;
+		}
+		if (size == 0) return false;
+		if (errno != EINTR) throw std::invalid_argument(std::string("local socket read failed : ") + std::strerror(errno));
+	}
+}
+
+bool UnixHttpConnection::readLine(std::string& line)
+{
+	while (true)
+	{
+		auto end = m_buffer.find("\r\n", m_offset);
+		if (end != std::string::npos)
+		{
+			line = m_buffer.substr(m_offset, end - m_offset);
+			m_offset = end + 2;
+			return true;
+		}
+		if (m_buffer.length() - m_offset > MAX_LINE_SIZE) throw std::invalid_argument("http line too long");
+		if (!fill())
+		{
+			if (m_buffer.length() > m_offset) throw std::invalid_argument("local socket closed in message");
+			return false;
+		}
+	}
+}
+
+void UnixHttpConnection::readBytes(std::vector<unsigned char>& body, size_t length)
+{
+	while (length)
+	{
+		if (m_offset == m_buffer.length() && !fill()) throw std::invalid_argument("local socket closed in message body");
+		const auto size = std::min(length, m_buffer.length() - m_offset);
+		body.insert(body.end(), m_buffer.begin() + m_offset, m_buffer.begin() + m_offset + size);
+		m_offset += size;
+		length -= size;
+	}
+}
+
+bool UnixHttpConnection::readMessage(std::string& startLine, web::http::http_headers& headers, std::vector<unsigned char>& body, bool isResponse, bool expectBody)
+{
+	headers.clear();
+	body.clear();
+	// tolerate empty lines between messages
+	do
+	{
+		if (!readLine(startLine)) return false;
+	} while (startLine.empty());
+
+	std::string line;
+	size_t headerSize = startLine.length();
+	while (true)
+	{
+		if (!readLine(line)) throw std::invalid_argument("local socket closed in http header");
+		if (line.empty()) break;
+		headerSize += line.length();
+		if (headerSize > m_maxHeaderSize) throw TooLarge("http header too large");
+		auto colon = line.find(':');
+		if (colon == std::string::npos) throw std::invalid_argument(std::string("invalid http header : ") + line);
+		headers.add(Utility::stdStringTrim(line.substr(0, colon)), Utility::stdStringTrim(line.substr(colon + 1)));
+	}
+	if (!expectBody) return true;
+
+	if (headers.has(web::http::header_names::transfer_encoding) &&
+		GET_STD_STRING(headers.find(web::http::header_names::transfer_encoding)->second).find("chunked") != std::string::npos)
+	{
+		while (true)
+		{
+			if (!readLine(line)) throw std::invalid_argument("local socket closed in chunk");
+			const auto chunkSize = std::stoull(line.substr(0, line.find(';')), nullptr, 16);
+			if (chunkSize == 0) break;
+			if (chunkSize > m_maxBodySize - body.size()) throw TooLarge("http body too large");
+			readBytes(body, chunkSize);
+			if (!readLine(line) || !line.empty()) throw std::invalid_argument("invalid http chunk");
+		}
+		// trailers
+		while (readLine(line) && !line.empty())
+		{
+			headerSize += line.length();
+			if (headerSize > m_maxHeaderSize) throw TooLarge("http header too large");
+		}
+	}
+	else if (headers.has(web::http::header_names::content_length))
+	{
+		// refused before read, the body is never buffered
+		if (headers.content_length() > m_maxBodySize) throw TooLarge("http body too large");
+		readBytes(body, headers.content_length());
+	}
+	else if (isResponse)
+	{
+		// no framing, body end with connection
+		body.insert(body.end(), m_buffer.begin() + m_offset, m_buffer.end());
+		m_offset = m_buffer.length();
+		while (fill())
+		{
+			body.insert(body.end(), m_buffer.begin() + m_offset, m_buffer.end());
+			m_offset = m_buffer.length();
+		}
+	}
+	return true;
+}
+
+void UnixHttpConnection::writeAll(const char* data, size_t length)
+{
+	while (length)
+	{
+		auto size = ::send(m_fd, data, length, MSG_NOSIGNAL);
+		if (size < 0)
+		{
+			if (errno == EINTR) continue;
+			throw std::invalid_argument(std::string("local socket write failed : ") + std::strerror(errno));
+		}
+		data += size;
+		length -= size;
+	}
+}
+
+void UnixHttpConnection::writeMessage(const std::string& startLine, const web::http::http_headers& headers, concurrency::streams::istream body, bool expectBody)
+{
+	const bool hasBody = expectBody && body.is_valid();
+	const bool hasLength = headers.has(web::http::header_names::content_length);
+	const bool chunked = hasBody && !hasLength;
+
+	std::string head = startLine + "\r\n";
+	for (const auto& header : headers)
+	{
+		if (header.first == web::http::header_names::transfer_encoding) continue;
+		head.append(GET_STD_STRING(header.first)).append(": ").append(GET_STD_STRING(header.second)).append("\r\n");
+	}
+	if (chunked) head.append("Transfer-Encoding: chunked\r\n");
+	else if (expectBody && !hasLength) head.append("Content-Length: 0\r\n");
+	head.append("\r\n");
+	writeAll(head);
+	if (!hasBody) return;
+
+	auto remain = hasLength ? headers.content_length() : std::numeric_limits<utility::size64_t>::max();
+	std::vector<unsigned char> data(READ_SIZE);
+	auto streamBuffer = body.streambuf();
+	while (remain)
+	{
+		const auto size = streamBuffer.getn(data.data(), static_cast<size_t>(std::min<utility::size64_t>(data.size(), remain))).get();
+		if (size == 0) break;
+		if (chunked)
+		{
+			char chunkHead[32];
+			snprintf(chunkHead, sizeof(chunkHead), "%zx\r\n", size);
+			writeAll(chunkHead, std::strlen(chunkHead));
+			writeAll(reinterpret_cast<const char*>(data.data()), size);
+			writeAll("\r\n", 2);
+		}
+		else
+		{
+			writeAll(reinterpret_cast<const char*>(data.data()), size);
+			remain -= size;
+		}
+	}
+	if (chunked) writeAll("0\r\n\r\n", 5);
+	else if (remain) throw std::invalid_argument("http body shorter than Content-Length");
+}
+
+web::http::http_response UnixHttpConnection::request(const web::http::http_request& request)
+{
+	auto headers = request.headers();
+	if (!headers.has(web::http::header_names::host)) headers.add(web::http::header_names::host, "localhost");
+	const auto method = GET_STD_STRING(request.method());
+	writeMessage(method + " " + GET_STD_STRING(request.request_uri().resource().to_string()) + " HTTP/1.1", headers, request.body());
+
+	std::string statusLine;
+	std::vector<unsigned char> body;
+	web::http::http_headers responseHeaders;
+	// HTTP/1.1 200 OK, a HEAD response have no body
+	if (!readMessage(statusLine, responseHeaders, body, true, method != "HEAD"))
+	{
+		throw std::invalid_argument("local socket closed before response");
+	}
+	auto first = statusLine.find(' ');
+	if (first == std::string::npos) throw std::invalid_argument(std::string("invalid http status line : ") + statusLine);
+	auto second = statusLine.find(' ', first + 1);
+	web::http::http_response response(static_cast<web::http::status_code>(std::stoi(statusLine.substr(first + 1, second - first - 1))));
+	if (second != std::string::npos) response.set_reason_phrase(statusLine.substr(second + 1));
+	const auto bodySize = body.size();
+	response.set_body(std::move(body));
+	// headers from the wire replace the ones set with body
+	for (const auto& header : responseHeaders) response.headers()[header.first] = header.second;
+	// make extract_xxx() available as a received message
+	response._get_impl()->_complete(bodySize);
+	return response;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cpprest/http_msg.h>
+
+//////////////////////////////////////////////////////////////////////////
+/// HTTP/1.1 over a Unix domain stream socket
+/// Used by the daemon local listener and by appc for local requests, where
+/// cpprest only support TCP. Body is framed by Content-Length or chunked
+/// transfer encoding, a response without both end when the peer close.
+/// IO and protocol errors throw std::invalid_argument.
+//////////////////////////////////////////////////////////////////////////
+class UnixHttpConnection
+{
+public:
+	// Message exceed the limits set by setLimits(), reply 413 and close
+	class TooLarge : public std::invalid_argument
+	{
+	public:
+		explicit TooLarge(const std::string& what) : std::invalid_argument(what) {}
+	};
+
+	// Take the ownership of a connected socket
+	explicit UnixHttpConnection(int fd);
+	virtual ~UnixHttpConnection();
+	static std::shared_ptr<UnixHttpConnection> connect(const std::string& socketPath, int timeoutSeconds);
+
+	int fd() const { return m_fd; }
+	// Limit headers and body of a read message, unlimited by default
+	void setLimits(size_t maxHeaderSize, size_t maxBodySize);
+
+	// Read start line, headers and body of one message, false if peer closed before a new message
+	bool readMessage(std::string& startLine, web::http::http_headers& headers, std::vector<unsigned char>& body, bool isResponse, bool expectBody = true);
+	// Write start line, headers and body stream, chunked when no Content-Length
+	void writeMessage(const std::string& startLine, const web::http::http_headers& headers, concurrency::streams::istream body, bool expectBody = true);
+
+	// Client: send a cpprest request and read the response
+	web::http::http_response request(const web::http::http_request& request);
+
+private:
+	bool fill();
+	bool readLine(std::string& line);
+	void readBytes(std::vector<unsigned char>& body, size_t length);
+	void writeAll(const char* data, size_t length);
+	void writeAll(const std::string& data) { writeAll(data.data(), data.length()); }
+
+	int m_fd;
+	std::string m_buffer;
+	size_t m_offset;
+	size_t m_maxHeaderSize;
+	size_t m_maxBodySize;
+};
@@ -410,6 +410,19 @@ std::string Utility::decode64(const std::string& val)
 		});
 }
 
+std::string Utility::hexEncode(const unsigned char* data, size_t length)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string result;
+	result.reserve(length * 2);
+	for (size_t i = 0; i < length; i++)
+	{
+		result.push_back(digits[data[i] >> 4]);
+		result.push_back(digits[data[i] & 0x0F]);
+	}
+	return result;
+}
+
 std::string Utility::readFile(const std::string& path)
 {
 	const static char fname[] = "Utility::readFile() ";
@@ -77,7 +77,22 @@ namespace std
 #define APPMGR_PASSWD_MIN_LENGTH 3
 #define DEFAULT_RUN_APP_RETENTION_DURATION 10
 #define DEFAULT_HEALTH_CHECK_INTERVAL 10
+#define DEFAULT_RESOURCE_FAST_INTERVAL 2		// memory & load refresh seconds
+#define DEFAULT_RESOURCE_PROCESS_INTERVAL 10	// process tree (application memory) refresh seconds
+#define DEFAULT_RESOURCE_SLOW_INTERVAL 60		// network & file system refresh seconds
+#define DEFAULT_PRESSURE_CRITICAL_PRIORITY 100	// app priority not delayed by host pressure
+#define DEFAULT_RATE_LIMIT_RESERVED_THREADS 1	// REST threads reserved for health and metrics
+#define MAX_RATE_LIMIT_TRACKED_USERS 10000	// idle user limiter state is dropped above this
+#define DEFAULT_PRESSURE_SPAWN_BUDGET 1			// none-critical starts allowed per fast refresh under pressure
 #define MAX_COMMAND_LINE_LENGH 2048
+#define DEFAULT_JSON_STREAM_CHUNK_SIZE (64 * 1024)	// chunked transfer size for streamed json
+#define DEFAULT_JSON_STREAM_PENDING_CHUNKS 4		// chunks buffered before wait for the client
+#define DEFAULT_JSON_STREAM_TIMEOUT 30				// seconds allowance of a stream before the minimum rate apply
+#define DEFAULT_JSON_STREAM_MIN_RATE (16 * 1024)	// bytes per second a streamed json client must keep
+#define DEFAULT_FILE_STREAM_CHUNK_SIZE (64 * 1024)	// pread size for file download
+#define DEFAULT_FILE_STREAM_PENDING_CHUNKS 16		// download chunks buffered before wait for the client
+#define DEFAULT_FILE_STREAM_TIMEOUT 30				// seconds allowance of a download before the minimum rate apply
+#define DEFAULT_FILE_STREAM_MIN_RATE (64 * 1024)	// bytes per second a download client must keep
 
 #define DEFAULT_LABLE_HOST_NAME "HOST_NAME"
 #define SNAPSHOT_FILE_NAME ".snapshot"
@@ -137,6 +152,8 @@ public:
 	// Base64
 	static std::string encode64(const std::string& val);
 	static std::string decode64(const std::string& val);
+	// lower case hex string of binary data
+	static std::string hexEncode(const unsigned char* data, size_t length);
 
 	// Read file to string
 	static std::string readFile(const std::string& path);
@@ -153,6 +170,34 @@ public:
 #define DATE_TIME_FORMAT "%Y-%m-%d %H:%M:%S"
 #define DEFAULT_TOKEN_EXPIRE_SECONDS 3 * 3 *(60 * 60 * 8)	// default 3 days
 #define MAX_TOKEN_EXPIRE_SECONDS (60 * 60 * 24) // max 24 hour
+#define MAX_TOKEN_CACHE_SIZE 1024				// verified JWT token cache entries
+#define MAX_DIGEST_CACHE_SIZE 256				// download file digest cache entries
+#define DEFAULT_UPLOAD_CHUNK_SIZE (8 * 1024 * 1024)	// upload session chunk size
+#define MAX_UPLOAD_CHUNK_SIZE (64 * 1024 * 1024)
+#define MAX_FILE_DELTA_SIZE (64 * 1024 * 1024)		// larger delta is uploaded by session instead
+#define DEFAULT_UPLOAD_SESSION_TIMEOUT (24 * 60 * 60)	// idle upload session removed after seconds
+#define DEFAULT_UPLOAD_PARALLEL 4				// appc parallel chunk streams
+#define DEFAULT_ARTIFACT_STORE_DIR "artifacts"	// content addressed store under appmgr dir
+#define DEFAULT_ARTIFACT_STORE_MAX_SIZE (20ULL * 1024 * 1024 * 1024)	// unreferenced artifacts evicted above this size
+#define DEFAULT_LOCAL_SOCKET_TOKEN_SECONDS (60 * 60)	// token minted for a local socket peer
+#define DEFAULT_LOCAL_SOCKET_IDLE_TIMEOUT 60		// idle local keep-alive connection closed after seconds
+#define MAX_LOCAL_SOCKET_CONNECTIONS 64
+#define MAX_LOCAL_SOCKET_HEADER_SIZE (64 * 1024)	// request line and headers of one local socket request
+#define MAX_LOCAL_SOCKET_BODY_SIZE MAX_UPLOAD_CHUNK_SIZE	// same as the largest body REST readBody accept
+#define DEFAULT_EVENT_LOG_SIZE 4096				// events kept for subscriber resume
+#define DEFAULT_EVENT_HEARTBEAT_SECONDS 15		// idle event stream heartbeat
+#define DEFAULT_EVENT_STREAM_TIMEOUT (10 * 60)	// event stream closed after seconds, client resume with sequence
+#define MAX_EVENT_STREAM_TIMEOUT (24 * 60 * 60)
+#define MAX_EVENT_STREAM_PENDING_BYTES (1024 * 1024)	// stream not read by client is closed above this
+#define MAX_EVENT_SUBSCRIBERS 256
+#define DEFAULT_RUN_POOL_SHELL "/bin/bash"			// worker loop need bash read -d
+#define DEFAULT_RUN_POOL_MAX_WORKERS 4			// shell workers per OS user
+#define DEFAULT_RUN_POOL_MIN_IDLE_WORKERS 1		// idle workers kept for prefork users
+#define DEFAULT_RUN_POOL_IDLE_TIMEOUT 300		// idle worker exit after seconds
+#define DEFAULT_RUN_POOL_CLOSE_TIMEOUT 2		// closing worker socket is shut down after seconds
+#define MAX_RUN_POOL_PENDING 256				// queued runs per OS user
+#define MAX_RUN_POOL_OUTPUT_SIZE (1024 * 1024)	// newest output kept for a pool run
+#define MAX_RUN_RECORDS 4096					// ad-hoc runs kept for output at the same time
 #define DEFAULT_RUN_APP_TIMEOUT_SECONDS 10		// run app default timeout
 #define MAX_APP_CACHED_LINES 1024
 #define SECURIRE_USER_KEY "******"
@@ -174,6 +219,10 @@ public:
 #define JSON_KEY_SSLCertificateFile "SSLCertificateFile"
 #define JSON_KEY_SSLCertificateKeyFile "SSLCertificateKeyFile"
 
+#define JSON_KEY_LocalSocket "LocalSocket"
+#define JSON_KEY_LocalSocketPath "LocalSocketPath"
+#define JSON_KEY_LocalSocketPeers "LocalSocketPeers"
+
 #define JSON_KEY_Security "Security"
 
 #define JSON_KEY_JWTEnabled "JWTEnabled"
@@ -193,6 +242,24 @@ public:
 #define JSON_KEY_CONSULE_SESSION_TTL "session_TTL"
 #define JSON_KEY_CONSUL_SECURITY "enable_consul_security"
 #define JSON_KEY_JWT_Users "Users"
+#define JSON_KEY_Pressure "Pressure"
+#define JSON_KEY_PressureCpuThreshold "CpuThreshold"
+#define JSON_KEY_PressureMemoryThreshold "MemoryThreshold"
+#define JSON_KEY_PressureIoThreshold "IoThreshold"
+#define JSON_KEY_PressureCriticalPriority "CriticalPriority"
+#define JSON_KEY_RateLimit "RateLimit"
+#define JSON_KEY_RateLimitReservedThreads "ReservedThreads"
+#define JSON_KEY_RateLimitUser "User"
+#define JSON_KEY_RateLimitRoutes "Routes"
+#define JSON_KEY_RateLimitRequestsPerSecond "RequestsPerSecond"
+#define JSON_KEY_RateLimitBurst "Burst"
+#define JSON_KEY_RateLimitConcurrency "Concurrency"
+#define JSON_KEY_RunPool "RunPool"
+#define JSON_KEY_RunPoolShell "Shell"
+#define JSON_KEY_RunPoolMaxWorkersPerUser "MaxWorkersPerUser"
+#define JSON_KEY_RunPoolMinIdleWorkers "MinIdleWorkers"
+#define JSON_KEY_RunPoolIdleTimeoutSeconds "IdleTimeoutSeconds"
+#define JSON_KEY_RunPoolPreforkUsers "PreforkUsers"
 #define JSON_KEY_APP_name "name"
 #define JSON_KEY_APP_user "user"
 #define JSON_KEY_APP_metadata "metadata"
@@ -212,12 +279,21 @@ public:
 #define JSON_KEY_APP_posix_timezone "posix_timezone"
 #define JSON_KEY_APP_cache_lines "cache_lines"
 #define JSON_KEY_APP_docker_image "docker_image"
+#define JSON_KEY_APP_metrics_interval "metrics_interval"
+#define JSON_KEY_APP_priority "priority"
 // runtime attr
 #define JSON_KEY_APP_pid "pid"
 #define JSON_KEY_APP_return "return"
 #define JSON_KEY_APP_id "id"
 #define JSON_KEY_APP_memory "memory"
+#define JSON_KEY_APP_io_read_bytes "io_read_bytes"
+#define JSON_KEY_APP_io_write_bytes "io_write_bytes"
+#define JSON_KEY_APP_fd_count "fd_count"
+#define JSON_KEY_APP_threads "threads"
+#define JSON_KEY_APP_ctx_switches_voluntary "ctx_switches_voluntary"
+#define JSON_KEY_APP_ctx_switches_involuntary "ctx_switches_involuntary"
 #define JSON_KEY_APP_last_start "last_start_time"
+#define JSON_KEY_APP_last_exit_reason "last_exit_reason"
 #define JSON_KEY_APP_container_id "container_id"
 #define JSON_KEY_APP_health "health"
 #define JSON_KEY_APP_version "version"
@@ -226,6 +302,37 @@ public:
 
 #define JSON_KEY_PERIOD_APP_keep_running "keep_running"
 
+#define JSON_KEY_UPLOAD_session_id "session_id"
+#define JSON_KEY_UPLOAD_file_path "file_path"
+#define JSON_KEY_UPLOAD_file_size "file_size"
+#define JSON_KEY_UPLOAD_file_mode "file_mode"
+#define JSON_KEY_UPLOAD_file_user "file_user"
+#define JSON_KEY_UPLOAD_chunk_size "chunk_size"
+#define JSON_KEY_UPLOAD_received "received"
+#define JSON_KEY_UPLOAD_received_bytes "received_bytes"
+
+#define JSON_KEY_ARTIFACT_hash "hash"
+#define JSON_KEY_ARTIFACT_size "size"
+#define JSON_KEY_ARTIFACT_file_path "file_path"
+#define JSON_KEY_ARTIFACT_method "method"
+
+#define JSON_KEY_DELTA_file_size "file_size"
+#define JSON_KEY_DELTA_block_size "block_size"
+#define JSON_KEY_DELTA_blocks "blocks"
+
+#define JSON_KEY_BATCH_operations "operations"
+#define JSON_KEY_BATCH_rollback "rollback"
+#define JSON_KEY_BATCH_action "action"
+#define JSON_KEY_BATCH_app "app"
+#define JSON_KEY_BATCH_results "results"
+#define JSON_KEY_BATCH_status "status"
+#define JSON_KEY_BATCH_message "message"
+#define JSON_KEY_BATCH_rolled_back "rolled_back"
+#define JSON_KEY_BATCH_action_reg "reg"
+#define JSON_KEY_BATCH_action_enable "enable"
+#define JSON_KEY_BATCH_action_disable "disable"
+#define JSON_KEY_BATCH_action_delete "delete"
+
 #define JSON_KEY_SHORT_APP_start_interval_seconds "start_interval_seconds"
 #define JSON_KEY_SHORT_APP_start_time "start_time"
 #define JSON_KEY_SHORT_APP_end_time "end_time"
@@ -238,12 +345,44 @@ public:
 #define JSON_KEY_RESOURCE_LIMITATION_memory_mb "memory_mb"
 #define JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb "memory_virt_mb"
 #define JSON_KEY_RESOURCE_LIMITATION_cpu_shares "cpu_shares"
+#define JSON_KEY_RESOURCE_LIMITATION_cpu_set "cpu_set"
+#define JSON_KEY_RESOURCE_LIMITATION_cpu_cores "cpu_cores"
+#define JSON_KEY_RESOURCE_LIMITATION_mem_nodes "mem_nodes"
+#define JSON_KEY_RESOURCE_LIMITATION_memory_high_mb "memory_high_mb"
+#define JSON_KEY_RESOURCE_LIMITATION_memory_high_action "memory_high_action"
+#define JSON_KEY_RESOURCE_LIMITATION_cpu_quota "cpu_quota"
+#define JSON_KEY_RESOURCE_LIMITATION_io_limit "io_limit"
+#define JSON_KEY_RESOURCE_LIMITATION_io_device "device"
+#define JSON_KEY_RESOURCE_LIMITATION_io_read_bps "read_bps"
+#define JSON_KEY_RESOURCE_LIMITATION_io_write_bps "write_bps"
+#define JSON_KEY_RESOURCE_LIMITATION_io_read_iops "read_iops"
+#define JSON_KEY_RESOURCE_LIMITATION_io_write_iops "write_iops"
+#define JSON_KEY_RESOURCE_LIMITATION_placement "placement"
+#define JSON_KEY_RESOURCE_LIMITATION_placement_cpus "cpus"
+#define JSON_KEY_RESOURCE_LIMITATION_placement_mems "mems"
+#define JSON_KEY_RESOURCE_LIMITATION_placement_conflict "conflict"
 
 
 #define JSON_KEY_USER_key "key"
 #define JSON_KEY_USER_roles "roles"
 #define JSON_KEY_USER_locked "locked"
 
+#define JSON_KEY_EVENT_id "id"
+#define JSON_KEY_EVENT_type "type"
+#define JSON_KEY_EVENT_app "app"
+#define JSON_KEY_EVENT_time "time"
+#define JSON_KEY_EVENT_data "data"
+#define JSON_KEY_EVENT_resume_from "resume_from"
+#define JSON_KEY_EVENT_pid "pid"
+#define JSON_KEY_EVENT_exit_code "exit_code"
+#define JSON_KEY_EVENT_exit_reason "exit_reason"
+#define JSON_KEY_EVENT_healthy "healthy"
+#define JSON_KEY_EVENT_sections "sections"
+#define JSON_KEY_EVENT_leader "leader"
+#define JSON_KEY_EVENT_added "added"
+#define JSON_KEY_EVENT_removed "removed"
+#define JSON_KEY_EVENT_updated "updated"
+
 #define HTTP_HEADER_JWT "JWT"
 #define HTTP_HEADER_JWT_ISSUER "appmgr-auth0"
 #define HTTP_HEADER_JWT_name "name"
@@ -260,6 +399,19 @@ public:
 #define HTTP_HEADER_KEY_file_path "file_path"
 #define HTTP_HEADER_KEY_file_mode "file_mode"
 #define HTTP_HEADER_KEY_file_user "file_user"
+#define HTTP_HEADER_KEY_file_size "file_size"
+#define HTTP_HEADER_KEY_block_size "block_size"
+#define HTTP_HEADER_KEY_ETag "ETag"
+#define HTTP_HEADER_KEY_If_None_Match "If-None-Match"
+#define HTTP_HEADER_KEY_Range "Range"
+#define HTTP_HEADER_KEY_If_Range "If-Range"
+#define HTTP_HEADER_KEY_Content_Range "Content-Range"
+#define HTTP_HEADER_KEY_Accept_Ranges "Accept-Ranges"
+#define HTTP_HEADER_KEY_Want_Digest "Want-Digest"	// RFC 3230, e.g. "sha-256"
+#define HTTP_HEADER_KEY_Digest "Digest"				// RFC 3230, e.g. "sha-256=base64"
+#define HTTP_HEADER_KEY_Retry_After "Retry-After"
+#define HTTP_HEADER_KEY_Last_Event_ID "Last-Event-ID"
+#define HTTP_STATUS_TOO_MANY_REQUESTS 429		// not defined by cpprest status_codes
 
 #define HTTP_QUERY_KEY_keep_history "keep_history"
 #define HTTP_QUERY_KEY_process_uuid "process_uuid"
@@ -269,6 +421,20 @@ public:
 #define HTTP_QUERY_KEY_loglevel "level"
 #define HTTP_QUERY_KEY_label_value "value"
 #define HTTP_QUERY_KEY_retention "retention" // for async run, the output hold timeout in sever side
+#define HTTP_QUERY_KEY_pool "pool"	// run by pre-forked shell worker
+#define HTTP_QUERY_KEY_name_prefix "name_prefix"
+#define HTTP_QUERY_KEY_status "status"
+#define HTTP_QUERY_KEY_user "user"
+#define HTTP_QUERY_KEY_docker "docker"
+#define HTTP_QUERY_KEY_health "health"
+#define HTTP_QUERY_KEY_limit "limit"
+#define HTTP_QUERY_KEY_offset "offset"
+#define HTTP_QUERY_KEY_fields "fields"
+#define HTTP_QUERY_KEY_since "since"
+#define HTTP_QUERY_KEY_app "app"
+#define HTTP_QUERY_KEY_type "type"
+#define HTTP_QUERY_KEY_format "format"
+#define HTTP_HEADER_KEY_total_count "X-Total-Count"
 
 #define PERMISSION_KEY_view_app 				"app-view"
 #define PERMISSION_KEY_view_app_output			"app-output-view"
@@ -0,0 +1,96 @@
+// Micro benchmark: block delta upload vs full upload
+// Build: cd src/common; make benchmark
+// Usage: ./delta_benchmark [file_mb] [changes] (default 64 MB, 16 changes)
+// A random file is changed at random places (overwrite, insert and delete a
+// few bytes), report bytes on the wire and CPU time of each side, plus the
+// throughput of the SSE2 and scalar weak checksum.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <openssl/sha.h>
+#include "DeltaSync.h"
+
+template <typename Func>
+static long long measureUs(Func func)
+{
+	auto start = std::chrono::steady_clock::now();
+	func();
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t fileSize = ((argc > 1) ? std::stoul(argv[1]) : 64) * 1024 * 1024;
+	const size_t changes = (argc > 2) ? std::stoul(argv[2]) : 16;
+
+	std::mt19937_64 random(20200308);
+	std::vector<unsigned char> base(fileSize);
+	for (auto& c : base) c = static_cast<unsigned char>(random());
+	std::vector<unsigned char> target(base);
+	for (size_t i = 0; i < changes; i++)
+	{
+		auto pos = random() % target.size();
+		auto length = 1 + random() % 512;
+		switch (i % 3)
+		{
+		case 0:
+			for (size_t k = pos; k < std::min(pos + length, target.size()); k++) target[k] = static_cast<unsigned char>(random());
+			break;
+		case 1:
+			target.insert(target.begin() + pos, length, static_cast<unsigned char>(random()));
+			break;
+		default:
+			target.erase(target.begin() + pos, target.begin() + std::min(pos + length, target.size()));
+		}
+	}
+
+	// weak checksum throughput
+	const auto blockSize = DeltaSync::blockSize(base.size());
+	uint64_t scalarSum = 0, vectorSum = 0;
+	auto scalarUs = measureUs([&]() { for (size_t off = 0; off + blockSize <= base.size(); off += blockSize) scalarSum += DeltaSync::weakChecksumScalar(base.data() + off, blockSize); });
+	auto vectorUs = measureUs([&]() { for (size_t off = 0; off + blockSize <= base.size(); off += blockSize) vectorSum += DeltaSync::weakChecksum(base.data() + off, blockSize); });
+	if (scalarSum != vectorSum)
+	{
+		std::cout << "weak checksum mismatch between scalar and vector" << std::endl;
+		return 1;
+	}
+
+	// full upload: client hash, whole file on the wire
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	auto fullUs = measureUs([&]() { SHA256(target.data(), target.size(), hash); });
+
+	// delta upload: server signatures, client diff, server rebuild
+	std::vector<DeltaSync::BlockSignature> signatures;
+	std::string delta;
+	size_t literal = 0;
+	std::vector<unsigned char> rebuilt;
+	rebuilt.reserve(target.size());
+	auto signatureUs = measureUs([&]() { signatures = DeltaSync::signatures(base.data(), base.size(), blockSize); });
+	auto diffUs = measureUs([&]() { delta = DeltaSync::diff(target.data(), target.size(), blockSize, signatures, base.size(), literal); });
+	auto applyUs = measureUs([&]()
+		{
+			DeltaSync::apply(base.data(), base.size(), blockSize, reinterpret_cast<const unsigned char*>(delta.data()), delta.size(),
+				[&rebuilt](const unsigned char* data, size_t length) { rebuilt.insert(rebuilt.end(), data, data + length); });
+		});
+	if (rebuilt != target)
+	{
+		std::cout << "rebuilt content mismatch" << std::endl;
+		return 1;
+	}
+	// signature on wire: weak + 16 hex digits as JSON, about 32 bytes per block
+	const size_t signatureBytes = signatures.size() * 32;
+
+	std::cout << "file size        : " << target.size() << " bytes, " << changes << " changes, block size " << blockSize << std::endl;
+	std::cout << "weak checksum    : scalar " << scalarUs << " us, sse2 " << vectorUs << " us ("
+		<< (vectorUs ? (double)scalarUs / vectorUs : 0) << "x)" << std::endl;
+	std::cout << "full upload      : " << target.size() << " bytes on wire, client cpu " << fullUs << " us" << std::endl;
+	std::cout << "delta upload     : " << (delta.size() + signatureBytes) << " bytes on wire (delta " << delta.size() << ", literal " << literal
+		<< ", signatures " << signatureBytes << "), client cpu " << (diffUs + fullUs) << " us, server cpu " << (signatureUs + applyUs) << " us" << std::endl;
+	std::cout << "bandwidth saved  : " << (100.0 - 100.0 * (delta.size() + signatureBytes) / target.size()) << "%" << std::endl;
+	return 0;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "../../common/Utility.h"
+
+namespace os {
+
+	// Read only memory mapping of a regular file, file content is paged in by
+	// kernel on access without read() into an user space buffer.
+	// Access after the file is truncated raise SIGBUS, only map a file that is
+	// not written concurrently, use FileReader for others.
+	class FileMapping
+	{
+	public:
+		explicit FileMapping(const std::string& path)
+			:m_data(nullptr), m_size(0), m_valid(false)
+		{
+			const static char fname[] = "FileMapping::FileMapping() ";
+
+			int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)
+			{
+				LOG_WAR << fname << "Failed to open file <" << path << ">, error :" << std::strerror(errno);
+				return;
+			}
+			struct stat st;
+			if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+			{
+				m_size = st.st_size;
+				m_valid = true;
+				if (m_size > 0)
+				{
+					void* addr = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+					if (addr == MAP_FAILED)
+					{
+						LOG_WAR << fname << "Failed to map file <" << path << ">, error :" << std::strerror(errno);
+						m_valid = false;
+						m_size = 0;
+					}
+					else
+					{
+						m_data = static_cast<const unsigned char*>(addr);
+						// sequential read for download and checksum
+						::madvise(addr, m_size, MADV_SEQUENTIAL);
+					}
+				}
+			}
+			::close(fd);
+		}
+
+		~FileMapping()
+		{
+			if (m_data) ::munmap(const_cast<unsigned char*>(m_data), m_size);
+		}
+
+		FileMapping(const FileMapping&) = delete;
+		FileMapping& operator=(const FileMapping&) = delete;
+
+		bool valid() const { return m_valid; }
+		const unsigned char* data() const { return m_data; }
+		size_t size() const { return m_size; }
+
+	private:
+		const unsigned char* m_data;
+		size_t m_size;
+		bool m_valid;
+	};
+
+	// Opened regular file read with pread(), the descriptor keep the inode
+	// alive when the path is replaced, a truncated file give a short read.
+	class FileReader
+	{
+	public:
+		explicit FileReader(const std::string& path)
+			:m_fd(-1), m_size(0), m_device(0), m_inode(0), m_mtimeNs(0)
+		{
+			const static char fname[] = "FileReader::FileReader() ";
+
+			m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (m_fd < 0)
+			{
+				LOG_WAR << fname << "Failed to open file <" << path << ">, error :" << std::strerror(errno);
+				return;
+			}
+			struct stat st;
+			if (::fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode))
+			{
+				::close(m_fd);
+				m_fd = -1;
+				return;
+			}
+			m_size = st.st_size;
+			m_device = st.st_dev;
+			m_inode = st.st_ino;
+			m_mtimeNs = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+			// sequential read for download and checksum
+			::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+
+		~FileReader()
+		{
+			if (m_fd >= 0) ::close(m_fd);
+		}
+
+		FileReader(const FileReader&) = delete;
+		FileReader& operator=(const FileReader&) = delete;
+
+		bool valid() const { return m_fd >= 0; }
+		// size when opened
+		size_t size() const { return m_size; }
+		// read up to length bytes at offset, return bytes read, 0 for end of file, -1 for error
+		ssize_t read(size_t offset, void* buffer, size_t length) const
+		{
+			ssize_t bytes = 0;
+			do
+			{
+				bytes = ::pread(m_fd, buffer, length, offset);
+			} while (bytes < 0 && errno == EINTR);
+			return bytes;
+		}
+		// identify file content version: device, inode, size and modify time
+		std::string version() const
+		{
+			return std::to_string(m_device) + "-" + std::to_string(m_inode) + "-" + std::to_string(m_size) + "-" + std::to_string(m_mtimeNs);
+		}
+
+	private:
+		int m_fd;
+		size_t m_size;
+		dev_t m_device;
+		ino_t m_inode;
+		long long m_mtimeNs;
+	};
+
+}
@@ -580,6 +580,67 @@ namespace os {
 
 		return results;
 	}
+
+	// Parse kernel cpu list format (e.g. "0-3,8,10-11") used by
+	// cpuset.cpus / cpuset.mems / node cpulist.
+	// Returns false for invalid format.
+	inline bool parseCpuList(const std::string& str, std::set<int>& result)
+	{
+		result.clear();
+		for (auto token : Utility::splitString(str, ","))
+		{
+			token = Utility::stdStringTrim(token);
+			if (token.empty()) continue;
+			auto range = Utility::splitString(token, "-");
+			if (range.size() != (token.find('-') == std::string::npos ? 1U : 2U)) return false;
+			for (const auto& num : range)
+			{
+				if (num.empty() || !Utility::isNumber(num)) return false;
+			}
+			int first = std::stoi(range.front());
+			int last = std::stoi(range.back());
+			if (first > last) return false;
+			for (int i = first; i <= last; i++) result.insert(i);
+		}
+		return true;
+	}
+
+	// Format cpu set to kernel cpu list format, continuous ids are merged to range.
+	inline std::string formatCpuList(const std::set<int>& cpus)
+	{
+		std::string result;
+		auto iter = cpus.begin();
+		while (iter != cpus.end())
+		{
+			int first = *iter;
+			int last = first;
+			while (++iter != cpus.end() && *iter == last + 1) last = *iter;
+			if (result.length()) result.append(",");
+			result.append(std::to_string(first));
+			if (last != first) result.append("-").append(std::to_string(last));
+		}
+		return result;
+	}
+
+	// Reads NUMA node topology from /sys/devices/system/node/node*/cpulist,
+	// returns map of node id to cpu ids, empty if NUMA is not exposed.
+	inline std::map<int, std::set<int>> numaNodes()
+	{
+		std::map<int, std::set<int>> results;
+		const std::string nodeDir = "/sys/devices/system/node";
+		for (const auto& entry : ls(nodeDir))
+		{
+			if (entry.find("node") != 0 || !Utility::isNumber(entry.substr(4))) continue;
+			std::ifstream file(nodeDir + "/" + entry + "/cpulist");
+			std::string line;
+			std::set<int> cpus;
+			if (file.is_open() && std::getline(file, line) && parseCpuList(line, cpus) && cpus.size())
+			{
+				results[std::stoi(entry.substr(4))] = cpus;
+			}
+		}
+		return results;
+	}
 	//************************CPU****************************************
 
 	// Structure returned by loadavg(). Encodes system load average
@@ -610,6 +671,51 @@ namespace os {
 		return load;
 	}
 
+	// Pressure stall information (Linux 4.20+), percentage of time
+	// some (or all) tasks stalled on the resource, see:
+	// https://www.kernel.org/doc/html/latest/accounting/psi.html
+	struct Pressure {
+		Pressure() :someAvg10(0), someAvg60(0), someAvg300(0), fullAvg10(0), fullAvg60(0), fullAvg300(0) {}
+		double someAvg10;
+		double someAvg60;
+		double someAvg300;
+		double fullAvg10;
+		double fullAvg60;
+		double fullAvg300;
+	};
+
+	// Read /proc/pressure/[cpu|memory|io], return nullptr when PSI is not available.
+	inline std::shared_ptr<Pressure> pressure(const std::string& resource)
+	{
+		const std::string path = "/proc/pressure/" + resource;
+		FILE* fp = ::fopen(path.c_str(), "r");
+		if (fp == nullptr) return nullptr;
+
+		auto result = std::make_shared<Pressure>();
+		char kind[8] = { 0 };
+		double avg10 = 0, avg60 = 0, avg300 = 0;
+		unsigned long long total = 0;
+		bool parsed = false;
+		while (::fscanf(fp, "%7s avg10=%lf avg60=%lf avg300=%lf total=%llu", kind, &avg10, &avg60, &avg300, &total) == 5)
+		{
+			parsed = true;
+			if (strcmp(kind, "some") == 0)
+			{
+				result->someAvg10 = avg10;
+				result->someAvg60 = avg60;
+				result->someAvg300 = avg300;
+			}
+			else if (strcmp(kind, "full") == 0)
+			{
+				result->fullAvg10 = avg10;
+				result->fullAvg60 = avg60;
+				result->fullAvg300 = avg300;
+			}
+		}
+		::fclose(fp);
+		return parsed ? result : nullptr;
+	}
+
 	struct FSusage {
 		unsigned long size;
 		unsigned long used;
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <sys/types.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace os {
+
+	// Fields of /proc/[pid]/stat which can be requested from ProcStatReader,
+	// combine them as a bit mask. Parsing stops after the last requested field.
+	enum ProcStatField : unsigned int
+	{
+		STAT_COMM = 1U << 0,		// field 2
+		STAT_STATE = 1U << 1,		// field 3
+		STAT_PPID = 1U << 2,		// field 4
+		STAT_PGRP = 1U << 3,		// field 5
+		STAT_SESSION = 1U << 4,		// field 6
+		STAT_UTIME = 1U << 5,		// field 14
+		STAT_STIME = 1U << 6,		// field 15
+		STAT_NUM_THREADS = 1U << 7,	// field 20
+		STAT_STARTTIME = 1U << 8,	// field 22
+		STAT_VSIZE = 1U << 9,		// field 23
+		STAT_RSS = 1U << 10,		// field 24
+	};
+
+	// Plain (allocation free) subset of /proc/[pid]/stat,
+	// only the requested fields are filled.
+	struct ProcStat
+	{
+		pid_t pid;
+		char comm[64];
+		char state;
+		pid_t ppid;
+		pid_t pgrp;
+		pid_t session;
+		unsigned long utime;
+		unsigned long stime;
+		long num_threads;
+		unsigned long long starttime;
+		unsigned long vsize;
+		long rss;	// pages
+	};
+
+	// Aggregated usage of a process tree, see ProcStatReader::treeUsage().
+	struct ProcTreeUsage
+	{
+		size_t processes;
+		uint64_t rssBytes;
+		uint64_t ioReadBytes;
+		uint64_t ioWriteBytes;
+		uint64_t fdCount;
+		uint64_t threads;
+		uint64_t voluntaryCtxSwitches;
+		uint64_t involuntaryCtxSwitches;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	/// /proc/[pid]/stat reader without heap allocation on the hot path:
+	/// path and content buffers are members and reused, content is read by
+	/// pread() and the fd is optionally cached for the pids sampled again,
+	/// numbers are parsed in place for the requested fields only.
+	/// Caching fd is meant for a bounded set of pids sampled repeatedly,
+	/// call release() for the pids no longer monitored.
+	/// Not thread safe, use one reader per thread or guard it.
+	//////////////////////////////////////////////////////////////////////////
+	class ProcStatReader
+	{
+	public:
+		explicit ProcStatReader(bool cacheFd = false) : m_cacheFd(cacheFd) {}
+		~ProcStatReader() { clear(); }
+		ProcStatReader(const ProcStatReader&) = delete;
+		ProcStatReader& operator=(const ProcStatReader&) = delete;
+
+		// Read /proc/[pid]/stat, return false if the process does not exist.
+		bool read(pid_t pid, unsigned int fields, ProcStat& stat)
+		{
+			if (pid <= 0) return false;
+			ssize_t len = readStat(pid);
+			if (len <= 0) return false;
+			return parse(m_buffer, (size_t)len, fields, stat);
+		}
+
+		// Close cached fd of one pid (e.g. the process exited).
+		void release(pid_t pid)
+		{
+			auto it = m_fds.find(pid);
+			if (it != m_fds.end())
+			{
+				::close(it->second);
+				m_fds.erase(it);
+			}
+		}
+
+		// Close all cached fds.
+		void clear()
+		{
+			for (const auto& fd : m_fds) ::close(fd.second);
+			m_fds.clear();
+		}
+
+		// Sum of RSS bytes of the process tree rooted at pid, the scan and
+		// the tree walk reuse member vectors, so no allocation after warm up.
+		uint64_t totalRss(pid_t pid)
+		{
+			if (!scanTree(pid, STAT_PPID | STAT_RSS)) return 0;
+			static const long pageSize = ::sysconf(_SC_PAGESIZE);
+			uint64_t total = 0;
+			for (const auto& e : m_tree) total += (uint64_t)e.rss * pageSize;
+			return total;
+		}
+
+		// Aggregate usage of the process tree rooted at pid, reads
+		// /proc/[pid]/io, /proc/[pid]/fd and /proc/[pid]/status for each
+		// process in the tree. /proc/[pid]/io is only readable by the owner
+		// or root, unreadable values are counted as zero.
+		bool treeUsage(pid_t pid, ProcTreeUsage& usage)
+		{
+			memset(&usage, 0, sizeof(usage));
+			if (!scanTree(pid, STAT_PPID | STAT_NUM_THREADS | STAT_RSS)) return false;
+			static const long pageSize = ::sysconf(_SC_PAGESIZE);
+			for (const auto& e : m_tree)
+			{
+				usage.processes++;
+				usage.rssBytes += (uint64_t)e.rss * pageSize;
+				usage.threads += (e.num_threads > 0) ? e.num_threads : 0;
+				usage.fdCount += countFds(e.pid);
+				snprintf(m_path, sizeof(m_path), "/proc/%d/io", (int)e.pid);
+				ssize_t len = readPath();
+				if (len > 0)
+				{
+					usage.ioReadBytes += fieldValue(m_buffer, "\nread_bytes:");
+					usage.ioWriteBytes += fieldValue(m_buffer, "\nwrite_bytes:");
+				}
+				snprintf(m_path, sizeof(m_path), "/proc/%d/status", (int)e.pid);
+				len = readPath();
+				if (len > 0)
+				{
+					usage.voluntaryCtxSwitches += fieldValue(m_buffer, "\nvoluntary_ctxt_switches:");
+					usage.involuntaryCtxSwitches += fieldValue(m_buffer, "\nnonvoluntary_ctxt_switches:");
+				}
+			}
+			return true;
+		}
+
+		// Iterate numeric entries of /proc, return the number of pids visited.
+		template<typename Func>
+		static size_t forEachPid(Func func)
+		{
+			DIR* dir = ::opendir("/proc");
+			if (dir == nullptr) return 0;
+			size_t count = 0;
+			struct dirent* entry;
+			while ((entry = ::readdir(dir)) != nullptr)
+			{
+				const char* name = entry->d_name;
+				if (*name < '0' || *name > '9') continue;
+				pid_t pid = 0;
+				for (; *name >= '0' && *name <= '9'; ++name) pid = pid * 10 + (*name - '0');
+				if (*name != '\0') continue;
+				func(pid);
+				++count;
+			}
+			::closedir(dir);
+			return count;
+		}
+
+		// Parse a /proc/[pid]/stat content.
+		// comm may contain spaces and parentheses, so it ends at the last ')'.
+		static bool parse(const char* buf, size_t len, unsigned int fields, ProcStat& stat)
+		{
+			const char* end = buf + len;
+			const char* p = buf;
+			stat.pid = (pid_t)parseNumber(p, end);
+
+			const char* commBegin = (const char*)memchr(buf, '(', len);
+			const char* commEnd = (const char*)memrchr(buf, ')', len);
+			if (commBegin == nullptr || commEnd == nullptr || commEnd < commBegin) return false;
+			if (fields & STAT_COMM)
+			{
+				size_t commLen = std::min((size_t)(commEnd - commBegin - 1), sizeof(stat.comm) - 1);
+				memcpy(stat.comm, commBegin + 1, commLen);
+				stat.comm[commLen] = '\0';
+			}
+
+			const int lastField = lastFieldIndex(fields);
+			p = commEnd + 1;
+			for (int field = 3; field <= lastField && p < end; ++field)
+			{
+				while (p < end && *p == ' ') ++p;
+				if (p >= end) return false;
+				switch (field)
+				{
+				case 3: stat.state = *p++; break;
+				case 4: stat.ppid = (pid_t)parseNumber(p, end); break;
+				case 5: stat.pgrp = (pid_t)parseNumber(p, end); break;
+				case 6: stat.session = (pid_t)parseNumber(p, end); break;
+				case 14: stat.utime = (unsigned long)parseNumber(p, end); break;
+				case 15: stat.stime = (unsigned long)parseNumber(p, end); break;
+				case 20: stat.num_threads = (long)parseNumber(p, end); break;
+				case 22: stat.starttime = (unsigned long long)parseNumber(p, end); break;
+				case 23: stat.vsize = (unsigned long)parseNumber(p, end); break;
+				case 24: stat.rss = (long)parseNumber(p, end); break;
+				default: while (p < end && *p != ' ') ++p; break;
+				}
+			}
+			return true;
+		}
+
+	private:
+		// Scan all processes and keep the tree rooted at pid in m_tree.
+		bool scanTree(pid_t pid, unsigned int fields)
+		{
+			m_tree.clear();
+			if (pid <= 0) return false;
+			m_entries.clear();
+			forEachPid([this, fields](pid_t p)
+				{
+					ProcStat stat;
+					if (read(p, fields, stat))
+					{
+						m_entries.push_back(stat);
+					}
+				});
+			auto byParent = [](const ProcStat& a, const ProcStat& b) { return a.ppid < b.ppid; };
+			std::sort(m_entries.begin(), m_entries.end(), byParent);
+
+			for (const auto& e : m_entries)
+			{
+				if (e.pid == pid)
+				{
+					m_tree.push_back(e);
+					break;
+				}
+			}
+			if (m_tree.empty()) return false;
+
+			m_frontier.clear();
+			m_frontier.push_back(pid);
+			while (!m_frontier.empty())
+			{
+				ProcStat key;
+				key.ppid = m_frontier.back();
+				m_frontier.pop_back();
+				auto range = std::equal_range(m_entries.begin(), m_entries.end(), key, byParent);
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					m_tree.push_back(*it);
+					m_frontier.push_back(it->pid);
+				}
+			}
+			return true;
+		}
+
+		static int lastFieldIndex(unsigned int fields)
+		{
+			if (fields & STAT_RSS) return 24;
+			if (fields & STAT_VSIZE) return 23;
+			if (fields & STAT_STARTTIME) return 22;
+			if (fields & STAT_NUM_THREADS) return 20;
+			if (fields & STAT_STIME) return 15;
+			if (fields & STAT_UTIME) return 14;
+			if (fields & STAT_SESSION) return 6;
+			if (fields & STAT_PGRP) return 5;
+			if (fields & STAT_PPID) return 4;
+			if (fields & STAT_STATE) return 3;
+			return 2;
+		}
+
+		// Value of a "key: value" line in a null terminated buffer.
+		static uint64_t fieldValue(const char* buf, const char* key)
+		{
+			const char* p = strstr(buf, key);
+			if (p == nullptr) return 0;
+			p += strlen(key);
+			while (*p == ' ' || *p == '\t') ++p;
+			uint64_t value = 0;
+			for (; *p >= '0' && *p <= '9'; ++p) value = value * 10 + (*p - '0');
+			return value;
+		}
+
+		static uint64_t countFds(pid_t pid)
+		{
+			char path[32];
+			snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+			DIR* dir = ::opendir(path);
+			if (dir == nullptr) return 0;
+			uint64_t count = 0;
+			struct dirent* entry;
+			while ((entry = ::readdir(dir)) != nullptr)
+			{
+				if (entry->d_name[0] != '.') ++count;
+			}
+			::closedir(dir);
+			return count;
+		}
+
+		// Read m_path into m_buffer (null terminated) without fd cache.
+		ssize_t readPath()
+		{
+			int fd = ::open(m_path, O_RDONLY | O_CLOEXEC);
+			if (fd < 0) return -1;
+			ssize_t len = ::pread(fd, m_buffer, sizeof(m_buffer) - 1, 0);
+			::close(fd);
+			m_buffer[len > 0 ? len : 0] = '\0';
+			return len;
+		}
+
+		static long long parseNumber(const char*& p, const char* end)
+		{
+			bool negative = false;
+			if (p < end && *p == '-')
+			{
+				negative = true;
+				++p;
+			}
+			unsigned long long value = 0;
+			for (; p < end && *p >= '0' && *p <= '9'; ++p) value = value * 10 + (*p - '0');
+			return negative ? -(long long)value : (long long)value;
+		}
+
+		ssize_t readStat(pid_t pid)
+		{
+			if (m_cacheFd)
+			{
+				auto it = m_fds.find(pid);
+				if (it != m_fds.end())
+				{
+					ssize_t len = ::pread(it->second, m_buffer, sizeof(m_buffer) - 1, 0);
+					if (len > 0) return len;
+					// process exited (ESRCH) or pid reused, reopen once
+					release(pid);
+				}
+			}
+			snprintf(m_path, sizeof(m_path), "/proc/%d/stat", (int)pid);
+			int fd = ::open(m_path, O_RDONLY | O_CLOEXEC);
+			if (fd < 0) return -1;
+			ssize_t len = ::pread(fd, m_buffer, sizeof(m_buffer) - 1, 0);
+			if (m_cacheFd && len > 0)
+			{
+				m_fds[pid] = fd;
+			}
+			else
+			{
+				::close(fd);
+			}
+			return len;
+		}
+
+	private:
+		const bool m_cacheFd;
+		std::unordered_map<pid_t, int> m_fds;
+		std::vector<ProcStat> m_entries;
+		std::vector<ProcStat> m_tree;
+		std::vector<pid_t> m_frontier;
+		char m_path[32];
+		char m_buffer[8192];
+	};
+}
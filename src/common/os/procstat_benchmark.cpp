@@ -0,0 +1,69 @@
+// Micro benchmark: os::ProcStatReader vs os::processes()
+// Build: cd src/common; make benchmark
+// Usage: ./procstat_benchmark [pid_count] (default 10000)
+// Both paths keep scanning /proc until pid_count pids are sampled.
+
+#include <chrono>
+#include <iostream>
+#include "linux.hpp"
+#include "procstat.hpp"
+
+int main(int argc, char* argv[])
+{
+	size_t target = (argc > 1) ? std::stoul(argv[1]) : 10000;
+
+	// current implementation
+	size_t legacyCount = 0;
+	uint64_t legacyRss = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (legacyCount < target)
+	{
+		auto processes = os::processes();
+		if (processes.empty()) break;
+		for (const auto& p : processes) legacyRss += p.rss;
+		legacyCount += processes.size();
+	}
+	auto legacyUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	// ProcStatReader without fd cache (full scan)
+	os::ProcStatReader reader;
+	os::ProcStat stat;
+	size_t scanCount = 0;
+	uint64_t scanRss = 0;
+	start = std::chrono::steady_clock::now();
+	while (scanCount < target)
+	{
+		auto visited = os::ProcStatReader::forEachPid([&](pid_t pid)
+			{
+				if (reader.read(pid, os::STAT_PPID | os::STAT_RSS, stat)) scanRss += stat.rss;
+			});
+		if (visited == 0) break;
+		scanCount += visited;
+	}
+	auto scanUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	// ProcStatReader with fd cache (repeated sampling of the same pids)
+	os::ProcStatReader cachedReader(true);
+	size_t cachedCount = 0;
+	uint64_t cachedRss = 0;
+	start = std::chrono::steady_clock::now();
+	while (cachedCount < target)
+	{
+		auto visited = os::ProcStatReader::forEachPid([&](pid_t pid)
+			{
+				if (cachedReader.read(pid, os::STAT_PPID | os::STAT_RSS, stat)) cachedRss += stat.rss;
+			});
+		if (visited == 0) break;
+		cachedCount += visited;
+	}
+	auto cachedUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "os::processes()            : " << legacyCount << " pids in " << legacyUs << " us, "
+		<< (legacyCount ? (double)legacyUs / legacyCount : 0) << " us/pid" << std::endl;
+	std::cout << "ProcStatReader             : " << scanCount << " pids in " << scanUs << " us, "
+		<< (scanCount ? (double)scanUs / scanCount : 0) << " us/pid" << std::endl;
+	std::cout << "ProcStatReader (fd cached) : " << cachedCount << " pids in " << cachedUs << " us, "
+		<< (cachedCount ? (double)cachedUs / cachedCount : 0) << " us/pid" << std::endl;
+	// keep results alive
+	return (legacyRss + scanRss + cachedRss) == 1 ? 1 : 0;
+}
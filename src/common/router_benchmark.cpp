@@ -0,0 +1,112 @@
+// Micro benchmark: RestRouter vs regex compiled per request (previous handleRest)
+// Build: cd src/common; make benchmark
+// Usage: ./router_benchmark [request_count] (default 100000)
+// Route list is the RestHandler GET/POST table, request paths cover static,
+// parametrized and not found routes.
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/regex.hpp>
+#include "RestRouter.h"
+
+int main(int argc, char* argv[])
+{
+	size_t target = (argc > 1) ? std::stoul(argv[1]) : 100000;
+
+	// route pattern in both syntax
+	const std::vector<std::pair<std::string, std::string>> routes = {
+		{ "/appmgr/login", "/appmgr/login" },
+		{ R"(/appmgr/auth/([^/\*]+))", "/appmgr/auth/{user}" },
+		{ R"(/appmgr/app/([^/\*]+))", "/appmgr/app/{name}" },
+		{ R"(/appmgr/app/([^/\*]+)/output)", "/appmgr/app/{name}/output" },
+		{ "/appmgr/applications", "/appmgr/applications" },
+		{ "/appmgr/resources", "/appmgr/resources" },
+		{ R"(/appmgr/app/([^/\*]+)/enable)", "/appmgr/app/{name}/enable" },
+		{ R"(/appmgr/app/([^/\*]+)/disable)", "/appmgr/app/{name}/disable" },
+		{ "/appmgr/app/run", "/appmgr/app/run" },
+		{ R"(/appmgr/app/([^/\*]+)/run/output)", "/appmgr/app/{name}/run/output" },
+		{ "/appmgr/app/syncrun", "/appmgr/app/syncrun" },
+		{ "/appmgr/file/download", "/appmgr/file/download" },
+		{ "/appmgr/file/upload", "/appmgr/file/upload" },
+		{ "/appmgr/labels", "/appmgr/labels" },
+		{ R"(/appmgr/label/([^/\*]+))", "/appmgr/label/{label}" },
+		{ "/appmgr/config", "/appmgr/config" },
+		{ R"(/appmgr/user/([^/\*]+)/passwd)", "/appmgr/user/{user}/passwd" },
+		{ R"(/appmgr/user/([^/\*]+)/lock)", "/appmgr/user/{user}/lock" },
+		{ R"(/appmgr/user/([^/\*]+)/unlock)", "/appmgr/user/{user}/unlock" },
+		{ R"(/appmgr/user/([^/\*]+))", "/appmgr/user/{user}" },
+		{ "/appmgr/users", "/appmgr/users" },
+		{ "/appmgr/roles", "/appmgr/roles" },
+		{ R"(/appmgr/role/([^/\*]+))", "/appmgr/role/{role}" },
+		{ "/appmgr/user/permissions", "/appmgr/user/permissions" },
+		{ "/appmgr/permissions", "/appmgr/permissions" },
+		{ R"(/appmgr/app/([^/\*]+)/health)", "/appmgr/app/{name}/health" },
+		{ "/appmgr/metrics", "/appmgr/metrics" },
+		{ R"(/appmgr/watch/([^/\*]+))", "/appmgr/watch/{type}" } };
+	const std::vector<std::string> paths = {
+		"/appmgr/applications",
+		"/appmgr/app/myapp",
+		"/appmgr/app/myapp/output",
+		"/appmgr/app/7f3c2a10-5b8e-11ea-8e2d-0242ac130003/run/output",
+		"/appmgr/user/permissions",
+		"/appmgr/app/myapp/health",
+		"/appmgr/metrics",
+		"/appmgr/not/exist/path" };
+
+	size_t hit = 0;
+	std::map<std::string, std::function<void()>> regexRoutes;
+	RestRouter<std::function<void()>> router;
+	for (const auto& route : routes)
+	{
+		regexRoutes[route.first] = [&hit]() { hit++; };
+		router.addRoute(route.second, [&hit]() { hit++; });
+	}
+
+	// previous implementation: walk the map and build regex for each entry
+	size_t regexCount = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (regexCount < target)
+	{
+		for (const auto& path : paths)
+		{
+			for (const auto& kvp : regexRoutes)
+			{
+				if (path == kvp.first || boost::regex_match(path, boost::regex(kvp.first)))
+				{
+					kvp.second();
+					break;
+				}
+			}
+			regexCount++;
+		}
+	}
+	auto regexUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	auto regexHit = hit;
+
+	// route table
+	hit = 0;
+	size_t routerCount = 0;
+	RestRouter<std::function<void()>>::PathParams params;
+	start = std::chrono::steady_clock::now();
+	while (routerCount < target)
+	{
+		for (const auto& path : paths)
+		{
+			auto handler = router.match(path, params);
+			if (handler) (*handler)();
+			routerCount++;
+		}
+	}
+	auto routerUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "routes: " << router.size() << std::endl;
+	std::cout << "regex per request : " << regexCount << " requests (" << regexHit << " matched) in " << regexUs << " us, "
+		<< (regexCount ? (double)regexUs * 1000 / regexCount : 0) << " ns/request" << std::endl;
+	std::cout << "RestRouter        : " << routerCount << " requests (" << hit << " matched) in " << routerUs << " us, "
+		<< (routerCount ? (double)routerUs * 1000 / routerCount : 0) << " ns/request" << std::endl;
+	return (regexHit * routerCount == hit * regexCount) ? 0 : 1;
+}
@@ -2,12 +2,15 @@
 #include "AppProcess.h"
 #include "../common/Utility.h"
 #include "../common/os/pstree.hpp"
+#include "../common/os/linux.hpp"
+#include "CpuAllocator.h"
 #include "LinuxCgroup.h"
 #include "ResourceLimitation.h"
 
 AppProcess::AppProcess(int cacheOutputLines)
 	:m_cacheOutputLines(cacheOutputLines), m_killTimerId(0), m_stdoutHandler(ACE_INVALID_HANDLE), m_uuid(Utility::createUUID())
 {
+	CPU_ZERO(&m_cpuMask);
 }
 
 
@@ -82,8 +85,12 @@ void AppProcess::setCgroup(std::shared_ptr<ResourceLimitation>& limit)
 	// https://blog.csdn.net/u011547375/article/details/9851455
 	if (limit != nullptr)
 	{
-		m_cgroup = std::make_unique<LinuxCgroup>(limit->m_memoryMb, limit->m_memoryVirtMb - limit->m_memoryMb, limit->m_cpuShares);
-		m_cgroup->setCgroup(limit->m_name, getpid(), ++(limit->m_index));
+		// cgroup is kept for the application, only changed limit is written
+		m_cgroup = LinuxCgroup::getCgroup(limit->m_name);
+		m_cgroup->setLimit(limit->m_memoryMb, limit->m_memoryVirtMb - limit->m_memoryMb, limit->m_cpuShares,
+			limit->m_cpuQuota, limit->m_ioLimits, os::formatCpuList(m_placedCpus), os::formatCpuList(m_placedMems));
+		m_cgroup->attach(getpid());
+		if (m_memoryEventHandler) m_cgroup->registerMemoryEvent(limit->m_memoryHighMb * 1024LL * 1024LL, m_memoryEventHandler);
 	}
 }
 
@@ -207,6 +214,12 @@ int AppProcess::spawnProcess(std::string cmd, std::string user, std::string work
 		env = Utility::stringReplace(env, ":/opt/appmanager/lib64", "");
 		option.setenv("LD_LIBRARY_PATH", "%s", env.c_str());
 	}
+	// resolve CPU pinning, affinity is applied in child() before exec
+	CPU_ZERO(&m_cpuMask);
+	if (CpuAllocator::instance()->place(limit, m_placedCpus, m_placedMems))
+	{
+		for (auto cpu : m_placedCpus) CPU_SET(cpu, &m_cpuMask);
+	}
 	if (this->spawn(option) >= 0)
 	{
 		pid = this->getpid();
@@ -222,6 +235,15 @@ int AppProcess::spawnProcess(std::string cmd, std::string user, std::string work
 	return pid;
 }
 
+void AppProcess::child(pid_t parent)
+{
+	// only async-signal-safe calls here, the mask is prepared before fork
+	if (CPU_COUNT(&m_cpuMask) > 0)
+	{
+		sched_setaffinity(0, sizeof(m_cpuMask), &m_cpuMask);
+	}
+}
+
 std::string AppProcess::getOutputMsg()
 {
 	return std::string();
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <map>
+#include <set>
 #include <string>
+#include <sched.h>
 #include <ace/Process.h>
 #include "TimerHandler.h"
 
@@ -21,6 +24,8 @@ public:
 	virtual pid_t getpid(void) const;
 	virtual void killgroup(int timerId = 0);
 	virtual void setCgroup(std::shared_ptr<ResourceLimitation>& limit);
+	// callback for cgroup memory event (OOM / memory_high), set before spawn
+	void setMemoryEventHandler(const std::function<void(const std::string&)>& handler) { m_memoryEventHandler = handler; }
 	const std::string getuuid() const;
 	void regKillTimer(size_t timeoutSec, const std::string from);
 	virtual std::string containerId() { return std::string(); };
@@ -37,12 +42,22 @@ public:
 	virtual bool complete() { return true; }
 
 protected:
+	// run in child process before exec, apply CPU affinity
+	virtual void child(pid_t parent) override;
+
 	const int m_cacheOutputLines;
 	std::shared_ptr<int> m_returnCode;
 
 private:
-	std::unique_ptr<LinuxCgroup> m_cgroup;
+	std::shared_ptr<LinuxCgroup> m_cgroup;
 	int m_killTimerId;
 	ACE_HANDLE m_stdoutHandler;
 	std::string m_uuid;
+
+	// CPU pinning placement
+	std::set<int> m_placedCpus;
+	std::set<int> m_placedMems;
+	cpu_set_t m_cpuMask;
+
+	std::function<void(const std::string&)> m_memoryEventHandler;
 };
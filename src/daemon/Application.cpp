@@ -1,24 +1,32 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <atomic>
 
 #include "Application.h"
 #include "AppProcess.h"
 #include "Configuration.h"
+#include "CpuAllocator.h"
 #include "DailyLimitation.h"
 #include "DockerProcess.h"
+#include "EventBus.h"
+#include "LinuxCgroup.h"
 #include "MonitoredProcess.h"
 #include "PrometheusRest.h"
 #include "ResourceCollection.h"
 #include "ResourceLimitation.h"
 #include "../common/TimeZoneHelper.h"
 #include "../common/Utility.h"
+#include "../common/os/procstat.hpp"
 #include "../prom_exporter/counter.h"
 #include "../prom_exporter/gauge.h"
 
+// object replaced by update get a new one, address may be reused
+static std::atomic<unsigned long long> appViewVersionSeq(0);
+
 Application::Application()
 	:m_status(STATUS::ENABLED), m_endTimerId(0), m_health(true), m_appId(Utility::createUUID())
-	, m_version(0), m_cacheOutputLines(0), m_process(new AppProcess()), m_pid(ACE_INVALID_PID)
+	, m_viewVersion(++appViewVersionSeq), m_version(0), m_cacheOutputLines(0), m_process(new AppProcess()), m_pid(ACE_INVALID_PID), m_priority(0), m_spawnDelayed(false), m_metricsInterval(0)
 	, m_metricStartCount(nullptr), m_metricMemory(nullptr)
 {
 	const static char fname[] = "Application::Application() ";
@@ -54,6 +62,8 @@ bool Application::operator==(const std::shared_ptr<Application>& app)
 		this->m_dockerImage == app->m_dockerImage &&
 		this->m_version == app->m_version &&
 		this->m_cacheOutputLines == app->m_cacheOutputLines &&
+		this->m_metricsInterval == app->m_metricsInterval &&
+		this->m_priority == app->m_priority &&
 		this->m_healthCheckCmd == app->m_healthCheckCmd &&
 		this->m_posixTimeZone == app->m_posixTimeZone &&
 		this->m_startTime == app->m_startTime &&
@@ -123,6 +133,9 @@ void Application::FromJson(std::shared_ptr<Application>& app, const web::json::v
 	}
 	app->m_cacheOutputLines = std::min(GET_JSON_INT_VALUE(jobj, JSON_KEY_APP_cache_lines), MAX_APP_CACHED_LINES);
 	app->m_dockerImage = GET_JSON_STR_VALUE(jobj, JSON_KEY_APP_docker_image);
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_APP_metrics_interval, app->m_metricsInterval);
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_APP_priority, app->m_priority);
+	if (app->m_metricsInterval < 0) throw std::invalid_argument("metrics_interval should not be negative");
 	if (HAS_JSON_FIELD(jobj, JSON_KEY_APP_pid)) app->attach(GET_JSON_INT_VALUE(jobj, JSON_KEY_APP_pid));
 	if (HAS_JSON_FIELD(jobj, JSON_KEY_APP_version)) SET_JSON_INT_VALUE(jobj, JSON_KEY_APP_version, app->m_version);
 	if (app->m_dockerImage.length() == 0 && app->m_commandLine.length() == 0) throw std::invalid_argument("no command line provide");
@@ -160,6 +173,7 @@ void Application::refreshPid()
 	// Try to get return code.
 	if (m_process != nullptr)
 	{
+		bool exited = false;
 		if (m_process->running())
 		{
 			m_pid = m_process->getpid();
@@ -170,16 +184,54 @@ void Application::refreshPid()
 			{
 				m_return = std::make_shared<int>(m_process->return_value());
 				m_pid = ACE_INVALID_PID;
+				m_exitReason = m_pendingExitReason;
+				m_pendingExitReason.clear();
+				exited = true;
 			}
 		}
 		else if (m_pid > 0)
 		{
 			m_return = std::make_shared<int>(m_process->return_value());
 			m_pid = ACE_INVALID_PID;
+			m_exitReason = m_pendingExitReason;
+			m_pendingExitReason.clear();
+			exited = true;
+		}
+		if (exited)
+		{
+			auto data = web::json::value::object();
+			data[JSON_KEY_EVENT_exit_code] = web::json::value::number(*m_return);
+			if (m_exitReason.length()) data[JSON_KEY_EVENT_exit_reason] = web::json::value::string(m_exitReason);
+			EventBus::instance()->publish(EVENT_TYPE_app_exited, m_name, data);
 		}
 		checkAndUpdateHealth();
 	}
 	if (m_metricMemory) m_metricMemory->metric().Set(ResourceCollection::instance()->getRssMemory(m_pid));
+	if (m_metricsInterval > 0) collectProcMetrics();
+}
+
+void Application::collectProcMetrics()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto now = std::chrono::system_clock::now();
+	if (m_pid > 0 && now - m_lastMetricsTime < std::chrono::seconds(m_metricsInterval)) return;
+	m_lastMetricsTime = now;
+
+	m_procUsage = nullptr;
+	if (m_pid > 0)
+	{
+		if (m_procReader == nullptr) m_procReader.reset(new os::ProcStatReader());
+		auto usage = std::make_shared<os::ProcTreeUsage>();
+		if (m_procReader->treeUsage(m_pid, *usage)) m_procUsage = usage;
+	}
+
+	const bool valid = (m_procUsage != nullptr);
+	if (m_metricIoRead) m_metricIoRead->metric().Set(valid ? m_procUsage->ioReadBytes : 0);
+	if (m_metricIoWrite) m_metricIoWrite->metric().Set(valid ? m_procUsage->ioWriteBytes : 0);
+	if (m_metricFds) m_metricFds->metric().Set(valid ? m_procUsage->fdCount : 0);
+	if (m_metricThreads) m_metricThreads->metric().Set(valid ? m_procUsage->threads : 0);
+	if (m_metricCtxVoluntary) m_metricCtxVoluntary->metric().Set(valid ? m_procUsage->voluntaryCtxSwitches : 0);
+	if (m_metricCtxInvoluntary) m_metricCtxInvoluntary->metric().Set(valid ? m_procUsage->involuntaryCtxSwitches : 0);
 }
 
 bool Application::attach(int pid)
@@ -201,13 +253,18 @@ void Application::invoke()
 		std::lock_guard<std::recursive_mutex> guard(m_mutex);
 		if (this->avialable())
 		{
-			if (!m_process->running())
+			if (!m_process->running() && !this->spawnPermit())
+			{
+				LOG_DBG << fname << "Application <" << m_name << "> start delayed by host pressure.";
+			}
+			else if (!m_process->running())
 			{
 				LOG_INF << fname << "Starting application <" << m_name << ">.";
 				m_process = allocProcess(m_cacheOutputLines, m_dockerImage, m_name);
 				m_procStartTime = std::chrono::system_clock::now();
 				m_pid = m_process->spawnProcess(m_commandLine, m_user, m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
 				if (m_metricStartCount) m_metricStartCount->metric().Increment();
+				if (m_pid > 0) publishStarted();
 			}
 		}
 		else if (m_process->running())
@@ -234,8 +291,11 @@ void Application::disable()
 		m_status = STATUS::DISABLED;
 		m_return = nullptr;
 		LOG_INF << fname << "Application <" << m_name << "> disabled.";
+		EventBus::instance()->publish(EVENT_TYPE_app_disabled, m_name);
 	}
 	if (m_process != nullptr) m_process->killgroup();
+	// placed again when enabled
+	CpuAllocator::instance()->release(m_name);
 	if (m_endTimerId) this->cancleTimer(m_endTimerId);
 }
 
@@ -247,6 +307,7 @@ void Application::enable()
 	if (m_status == STATUS::DISABLED)
 	{
 		m_status = STATUS::ENABLED;
+		EventBus::instance()->publish(EVENT_TYPE_app_enabled, m_name);
 		invokeNow(0);
 		LOG_INF << fname << "Application <" << m_name << "> started.";
 		handleEndTimer();
@@ -257,65 +318,6 @@ void Application::enable()
 	}
 }
 
-std::string Application::runAsyncrize(int timeoutSeconds)
-{
-	const static char fname[] = "Application::runSyncrize() ";
-	LOG_DBG << fname << " Entered.";
-
-	m_process = allocProcess(m_cacheOutputLines, m_dockerImage, m_name);
-	return runApp(timeoutSeconds);
-}
-
-std::string Application::runSyncrize(int timeoutSeconds, void* asyncHttpRequest)
-{
-	const static char fname[] = "Application::runAsyncrize() ";
-	LOG_DBG << fname << " Entered.";
-
-	std::lock_guard<std::recursive_mutex> guard(m_mutex);
-	if (m_cacheOutputLines <= 0)
-	{
-		LOG_ERR << fname << " m_cacheOutputLines is zero, force set to default value for MonitoredProcess";
-		m_cacheOutputLines = MAX_APP_CACHED_LINES;
-	}
-	m_process = allocProcess(m_cacheOutputLines, m_dockerImage, m_name);
-	auto monitProc = std::dynamic_pointer_cast<MonitoredProcess>(m_process);
-	assert(monitProc != nullptr);
-	monitProc->setAsyncHttpRequest(asyncHttpRequest);
-
-	return runApp(timeoutSeconds);
-}
-
-std::string Application::runApp(int timeoutSeconds)
-{
-	const static char fname[] = "Application::runApp() ";
-	LOG_DBG << fname << " Entered.";
-
-	std::lock_guard<std::recursive_mutex> guard(m_mutex);
-	if (m_dockerImage.length())
-	{
-		throw std::invalid_argument("Docker application does not support this API");
-	}
-	assert(m_status != STATUS::ENABLED);
-
-	LOG_INF << fname << "Running application <" << m_name << ">.";
-
-	m_procStartTime = std::chrono::system_clock::now();
-	m_pid = m_process->spawnProcess(m_commandLine, m_user, m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
-
-	if (m_metricStartCount) m_metricStartCount->metric().Increment();
-
-	if (m_pid > 0)
-	{
-		if (timeoutSeconds > 0) m_process->regKillTimer(timeoutSeconds, __FUNCTION__);
-	}
-	else
-	{
-		throw std::invalid_argument("Start process failed");
-	}
-
-	return m_process->getuuid();
-}
-
 void Application::handleEndTimer()
 {
 	const static char fname[] = "Application::handleEndTimer() ";
@@ -342,29 +344,6 @@ void Application::handleEndTimer()
 	}
 }
 
-std::string Application::getAsyncRunOutput(const std::string& processUuid, int& exitCode, bool& finished)
-{
-	const static char fname[] = "Application::getAsyncRunOutput() ";
-	finished = false;
-	if (m_process != nullptr && m_process->getuuid() == processUuid)
-	{
-		auto output = m_process->fetchOutputMsg();
-		if (output.length() == 0 && !m_process->running() && m_process->complete())
-		{
-			exitCode = m_process->return_value();
-			finished = true;
-			LOG_DBG << fname << "process:" << processUuid << " finished with exit code: " << exitCode;
-			return std::string();
-		}
-
-		return std::move(output);
-	}
-	else
-	{
-		throw std::invalid_argument("No corresponding process running or the given process uuid is wrong");
-	}
-}
-
 void Application::checkAndUpdateHealth()
 {
 	if (m_healthCheckCmd.empty())
@@ -383,6 +362,25 @@ void Application::checkAndUpdateHealth()
 	}
 }
 
+void Application::setHealth(bool health)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (m_health != health)
+	{
+		m_health = health;
+		auto data = web::json::value::object();
+		data[JSON_KEY_EVENT_healthy] = web::json::value::boolean(health);
+		EventBus::instance()->publish(EVENT_TYPE_app_health, m_name, data);
+	}
+}
+
+void Application::publishStarted()
+{
+	auto data = web::json::value::object();
+	data[JSON_KEY_EVENT_pid] = web::json::value::number(m_pid);
+	EventBus::instance()->publish(EVENT_TYPE_app_started, m_name, data);
+}
+
 pid_t Application::getpid() const
 {
 	return m_pid;
@@ -409,7 +407,9 @@ void Application::initMetrics(std::shared_ptr<PrometheusRest> prom)
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	// clean
 	m_metricStartCount = nullptr;
+	m_metricOomCount = nullptr;
 	m_metricMemory = nullptr;
+	m_metricIoRead = m_metricIoWrite = m_metricFds = m_metricThreads = m_metricCtxVoluntary = m_metricCtxInvoluntary = nullptr;
 	// update
 	if (prom)
 	{
@@ -418,10 +418,31 @@ void Application::initMetrics(std::shared_ptr<PrometheusRest> prom)
 			PROM_METRIC_NAME_appmgr_prom_process_start_count, PROM_METRIC_HELP_appmgr_prom_process_start_count,
 			{ {"application", getName()}, {"id", m_appId} }
 		);
+		m_metricOomCount = prom->createPromCounter(
+			PROM_METRIC_NAME_appmgr_prom_process_oom_count, PROM_METRIC_HELP_appmgr_prom_process_oom_count,
+			{ {"application", getName()}, {"id", m_appId} }
+		);
 		m_metricMemory = prom->createPromGauge(
 			PROM_METRIC_NAME_appmgr_prom_process_memory_gauge, PROM_METRIC_HELP_appmgr_prom_process_memory_gauge,
 			{ {"application", getName()}, {"id", m_appId} }
 		);
+		// process tree metrics only for the app enabled sampling
+		if (m_metricsInterval > 0)
+		{
+			const std::map<std::string, std::string> labels = { {"application", getName()}, {"id", m_appId} };
+			m_metricIoRead = prom->createPromGauge(
+				PROM_METRIC_NAME_appmgr_prom_process_io_read_bytes_gauge, PROM_METRIC_HELP_appmgr_prom_process_io_read_bytes_gauge, labels);
+			m_metricIoWrite = prom->createPromGauge(
+				PROM_METRIC_NAME_appmgr_prom_process_io_write_bytes_gauge, PROM_METRIC_HELP_appmgr_prom_process_io_write_bytes_gauge, labels);
+			m_metricFds = prom->createPromGauge(
+				PROM_METRIC_NAME_appmgr_prom_process_fd_gauge, PROM_METRIC_HELP_appmgr_prom_process_fd_gauge, labels);
+			m_metricThreads = prom->createPromGauge(
+				PROM_METRIC_NAME_appmgr_prom_process_threads_gauge, PROM_METRIC_HELP_appmgr_prom_process_threads_gauge, labels);
+			m_metricCtxVoluntary = prom->createPromGauge(
+				PROM_METRIC_NAME_appmgr_prom_process_ctx_switches_voluntary_gauge, PROM_METRIC_HELP_appmgr_prom_process_ctx_switches_voluntary_gauge, labels);
+			m_metricCtxInvoluntary = prom->createPromGauge(
+				PROM_METRIC_NAME_appmgr_prom_process_ctx_switches_involuntary_gauge, PROM_METRIC_HELP_appmgr_prom_process_ctx_switches_involuntary_gauge, labels);
+		}
 	}
 }
 
@@ -462,8 +483,18 @@ web::json::value Application::AsJson(bool returnRuntimeInfo)
 		if (m_pid > 0) result[JSON_KEY_APP_pid] = web::json::value::number(m_pid);
 		if (m_return != nullptr) result[JSON_KEY_APP_return] = web::json::value::number(*m_return);
 		if (m_pid > 0) result[JSON_KEY_APP_memory] = web::json::value::number(ResourceCollection::instance()->getRssMemory(m_pid));
+		if (m_pid > 0 && m_procUsage != nullptr)
+		{
+			result[JSON_KEY_APP_io_read_bytes] = web::json::value::number(m_procUsage->ioReadBytes);
+			result[JSON_KEY_APP_io_write_bytes] = web::json::value::number(m_procUsage->ioWriteBytes);
+			result[JSON_KEY_APP_fd_count] = web::json::value::number(m_procUsage->fdCount);
+			result[JSON_KEY_APP_threads] = web::json::value::number(m_procUsage->threads);
+			result[JSON_KEY_APP_ctx_switches_voluntary] = web::json::value::number(m_procUsage->voluntaryCtxSwitches);
+			result[JSON_KEY_APP_ctx_switches_involuntary] = web::json::value::number(m_procUsage->involuntaryCtxSwitches);
+		}
 		if (std::chrono::time_point_cast<std::chrono::hours>(m_procStartTime).time_since_epoch().count() > 24) // avoid print 1970-01-01 08:00:00
 			result[JSON_KEY_APP_last_start] = web::json::value::string(Utility::convertTime2Str(m_procStartTime));
+		if (m_exitReason.length()) result[JSON_KEY_APP_last_exit_reason] = web::json::value::string(GET_STRING_T(m_exitReason));
 		if (!m_process->containerId().empty())
 		{
 			result[JSON_KEY_APP_container_id] = web::json::value::string(GET_STRING_T(m_process->containerId()));
@@ -478,6 +509,11 @@ web::json::value Application::AsJson(bool returnRuntimeInfo)
 	if (m_resourceLimit != nullptr)
 	{
 		result[JSON_KEY_APP_resource_limit] = m_resourceLimit->AsJson();
+		if (returnRuntimeInfo)
+		{
+			auto placement = CpuAllocator::instance()->getPlacement(m_name);
+			if (!placement.is_null()) result[JSON_KEY_APP_resource_limit][JSON_KEY_RESOURCE_LIMITATION_placement] = placement;
+		}
 	}
 	if (m_envMap.size())
 	{
@@ -491,6 +527,8 @@ web::json::value Application::AsJson(bool returnRuntimeInfo)
 	if (m_posixTimeZone.length()) result[JSON_KEY_APP_posix_timezone] = web::json::value::string(m_posixTimeZone);
 	if (m_cacheOutputLines) result[JSON_KEY_APP_cache_lines] = web::json::value::number(m_cacheOutputLines);
 	if (m_dockerImage.length()) result[JSON_KEY_APP_docker_image] = web::json::value::string(m_dockerImage);
+	if (m_priority) result[JSON_KEY_APP_priority] = web::json::value::number(m_priority);
+	if (m_metricsInterval) result[JSON_KEY_APP_metrics_interval] = web::json::value::number(m_metricsInterval);
 	if (m_version) result[JSON_KEY_APP_version] = web::json::value::number(m_version);
 
 	if (m_startTime.time_since_epoch().count()) result[JSON_KEY_SHORT_APP_start_time] = web::json::value::string(Utility::convertTime2Str(m_startTime));
@@ -499,6 +537,24 @@ web::json::value Application::AsJson(bool returnRuntimeInfo)
 	return result;
 }
 
+std::size_t Application::getViewFingerprint()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	std::size_t seed = std::hash<unsigned long long>()(m_viewVersion);
+	auto combine = [&seed](std::size_t value) { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+	combine(static_cast<std::size_t>(m_status));
+	combine(m_pid);
+	combine(m_return != nullptr ? static_cast<std::size_t>(*m_return) + 1 : 0);
+	combine(m_health);
+	combine(m_version);
+	combine(std::hash<std::string>()(m_exitReason));
+	combine(m_procStartTime.time_since_epoch().count());
+	combine(m_lastMetricsTime.time_since_epoch().count());
+	// memory is read from /proc when render, refresh it with process refresh interval
+	if (m_pid > 0) combine(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / DEFAULT_RESOURCE_PROCESS_INTERVAL);
+	return seed;
+}
+
 void Application::dump()
 {
 	const static char fname[] = "Application::dump() ";
@@ -516,6 +572,8 @@ void Application::dump()
 	LOG_DBG << fname << "m_endTime:" << Utility::convertTime2Str(m_endTime);
 	LOG_DBG << fname << "m_cacheOutputLines:" << m_cacheOutputLines;
 	LOG_DBG << fname << "m_dockerImage:" << m_dockerImage;
+	LOG_DBG << fname << "m_metricsInterval:" << m_metricsInterval;
+	LOG_DBG << fname << "m_priority:" << m_priority;
 	LOG_DBG << fname << "m_version:" << m_version;
 	if (m_dailyLimit != nullptr) m_dailyLimit->dump();
 	if (m_resourceLimit != nullptr) m_resourceLimit->dump();
@@ -545,6 +603,13 @@ std::shared_ptr<AppProcess> Application::allocProcess(int cacheOutputLines, std:
 		{
 			process.reset(new AppProcess(cacheOutputLines));
 		}
+		// weak reference: the handler is held by the process cgroup of this app
+		std::weak_ptr<Application> weakApp = std::dynamic_pointer_cast<Application>(this->shared_from_this());
+		process->setMemoryEventHandler([weakApp](const std::string& event)
+			{
+				auto app = weakApp.lock();
+				if (app) app->onMemoryEvent(event);
+			});
 	}
 	return std::move(process);
 }
@@ -580,20 +645,65 @@ bool Application::avialable()
 	return (this->isEnabled() && this->isInDailyTimeRange());
 }
 
+bool Application::spawnPermit()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (ResourceCollection::instance()->spawnPermit(m_priority))
+	{
+		m_spawnDelayed = false;
+		return true;
+	}
+	if (!m_spawnDelayed) ResourceCollection::instance()->countSpawnDelayed();
+	m_spawnDelayed = true;
+	return false;
+}
+
 void Application::destroy()
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	this->disable();
 	this->m_status = STATUS::NOTAVIALABLE;
+	CpuAllocator::instance()->release(m_name);
+	LinuxCgroup::removeCgroup(m_name);
 	if (m_commandLineFini.length())
 	{
 		this->registerTimer(0, 0, std::bind(&Application::onFinishEvent, this, std::placeholders::_1), __FUNCTION__);
 	}
 }
 
-void Application::onSuicideEvent(int timerId)
+void Application::onMemoryEvent(const std::string& event)
+{
+	const static char fname[] = "Application::onMemoryEvent() ";
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (event == CGROUP_MEMORY_EVENT_OOM)
+	{
+		LOG_WAR << fname << "Application <" << m_name << "> triggered OOM killer.";
+		m_pendingExitReason = event;
+		if (m_metricOomCount) m_metricOomCount->metric().Increment();
+	}
+	else if (event == CGROUP_MEMORY_EVENT_HIGH)
+	{
+		LOG_WAR << fname << "Application <" << m_name << "> memory usage exceeded memory_high_mb.";
+		if (m_resourceLimit == nullptr || m_resourceLimit->m_memoryHighAction != MEMORY_HIGH_ACTION_RESTART) return;
+		m_pendingExitReason = event;
+		if (m_process != nullptr) m_process->killgroup();
+	}
+	// restart without waiting for schedule loop, leave 100ms for the kernel to finish the kill
+	auto self = std::dynamic_pointer_cast<Application>(this->shared_from_this());
+	this->registerTimer(100, 0, [self](int timerId) { self->onMemoryRestartEvent(timerId); }, __FUNCTION__);
+}
+
+void Application::onMemoryRestartEvent(int timerId)
 {
-	Configuration::instance()->removeApp(m_name);
+	// reap the killed process first, then invoke to start
+	refreshPid();
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		// OOM killer selected a child process, the main process exit is not caused by OOM
+		if (m_pendingExitReason == CGROUP_MEMORY_EVENT_OOM && m_process != nullptr && m_process->running()) m_pendingExitReason.clear();
+	}
+	this->invoke();
 }
 
 void Application::onFinishEvent(int timerId)
@@ -615,6 +725,7 @@ void Application::onEndEvent(int timerId)
 
 	this->disable();
 	this->m_status = STATUS::NOTAVIALABLE;
+	CpuAllocator::instance()->release(m_name);
 
 	LOG_DBG << fname << "Application <" << m_name << "> is end finished";
 }
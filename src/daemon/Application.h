@@ -14,6 +14,11 @@ class PrometheusRest;
 class AppProcess;
 class DailyLimitation;
 class ResourceLimitation;
+namespace os
+{
+	class ProcStatReader;
+	struct ProcTreeUsage;
+};
 //////////////////////////////////////////////////////////////////////////
 /// An Application is used to define and manage a process job.
 //////////////////////////////////////////////////////////////////////////
@@ -24,7 +29,7 @@ public:
 	{
 		DISABLED,
 		ENABLED,
-		NOTAVIALABLE,	// used for temp app from RestHandler::apiRunParseApp and destroyed app
+		NOTAVIALABLE,	// used for destroyed app
 		INITIALIZING,
 		UNINITIALIZING
 	};
@@ -40,6 +45,8 @@ public:
 	
 	static void FromJson(std::shared_ptr<Application>& app, const web::json::value& obj) noexcept(false);
 	virtual web::json::value AsJson(bool returnRuntimeInfo);
+	// hash of runtime fields in AsJson(true), used to detect view change
+	virtual std::size_t getViewFingerprint();
 	virtual void dump();
 
 	// Invoke by scheduler
@@ -47,16 +54,14 @@ public:
 	virtual void disable();
 	virtual void enable();
 	void destroy();
-	void onSuicideEvent(int timerId = 0);
 	void onFinishEvent(int timerId = 0);
 	void onEndEvent(int timerId = 0);
-
-	std::string runAsyncrize(int timeoutSeconds) noexcept(false);
-	std::string runSyncrize(int timeoutSeconds, void* asyncHttpRequest) noexcept(false);
-	std::string getAsyncRunOutput(const std::string& processUuid, int& exitCode, bool& finished) noexcept(false);
+	// cgroup memory notification from reactor
+	void onMemoryEvent(const std::string& event);
+	void onMemoryRestartEvent(int timerId = 0);
 
 	// health: 0-health, 1-unhealth
-	void setHealth(bool health) { m_health = health; }
+	void setHealth(bool health);
 	const std::string& getHealthCheck() { return m_healthCheckCmd; }
 	int getHealth() { return 1 - m_health; }
 	pid_t getpid() const;
@@ -70,16 +75,23 @@ public:
 	const std::string getMetadata() const { return m_metadata; }
 	const std::string getInitCmd() const { return m_commandLineInit; }
 	bool isCloudApp() const;
+	int getPriority() const { return m_priority; }
+	const std::string getUser() const { return m_user; }
+	STATUS getStatus() const { return m_status; }
+	bool isDockerApp() const { return !m_dockerImage.empty(); }
 
 protected:
 	// Invoke immediately
 	virtual void invokeNow(int timerId);
 	virtual void refreshPid();
+	void collectProcMetrics();
 	std::shared_ptr<AppProcess> allocProcess(int cacheOutputLines, std::string dockerImage, std::string appName);
 	bool isInDailyTimeRange();
 	virtual void checkAndUpdateHealth();
-	std::string runApp(int timeoutSeconds) noexcept(false);
+	void publishStarted();
 	void handleEndTimer();
+	// host pressure gate of a start, a postponed start is counted once until it is started
+	bool spawnPermit();
 
 protected:
 	STATUS m_status;
@@ -101,6 +113,8 @@ protected:
 	bool m_health;
 	std::string m_healthCheckCmd;
 	const std::string m_appId;
+	// unique for each application object, seed of view fingerprint
+	const unsigned long long m_viewVersion;
 	unsigned int m_version;
 	int m_cacheOutputLines;
 	std::shared_ptr<AppProcess> m_process;
@@ -110,8 +124,27 @@ protected:
 	std::map<std::string, std::string> m_envMap;
 	std::string m_dockerImage;
 	std::chrono::system_clock::time_point m_procStartTime;
+	// exit reason of last instance from cgroup event (oom / memory_high)
+	std::string m_exitReason;
+	std::string m_pendingExitReason;
+	// higher priority starts first and is not delayed by host pressure when reach Pressure.CriticalPriority
+	int m_priority;
+	// a start is postponed by host pressure and not yet started
+	bool m_spawnDelayed;
+	// process tree io/fd/thread/context switch sampling, 0 is disabled
+	int m_metricsInterval;
+	std::chrono::system_clock::time_point m_lastMetricsTime;
+	std::unique_ptr<os::ProcStatReader> m_procReader;
+	std::shared_ptr<os::ProcTreeUsage> m_procUsage;
 
 	// Prometheus
 	std::shared_ptr<CounterPtr> m_metricStartCount;
+	std::shared_ptr<CounterPtr> m_metricOomCount;
 	std::shared_ptr<GaugePtr> m_metricMemory;
+	std::shared_ptr<GaugePtr> m_metricIoRead;
+	std::shared_ptr<GaugePtr> m_metricIoWrite;
+	std::shared_ptr<GaugePtr> m_metricFds;
+	std::shared_ptr<GaugePtr> m_metricThreads;
+	std::shared_ptr<GaugePtr> m_metricCtxVoluntary;
+	std::shared_ptr<GaugePtr> m_metricCtxInvoluntary;
 };
@@ -1,6 +1,7 @@
 #include "ApplicationInitialize.h"
 #include "AppProcess.h"
 #include "Configuration.h"
+#include "ResourceCollection.h"
 #include "../common/Utility.h"
 
 ApplicationInitialize::ApplicationInitialize()
@@ -86,7 +87,12 @@ void ApplicationInitialize::invoke()
 	LOG_DBG << fname << "Entered.";
 
 	refreshPid();
-	if (!m_executed)
+	if (!m_executed && !this->spawnPermit())
+	{
+		// retried by the next schedule
+		LOG_DBG << fname << "Initializing for application <" << m_name << "> delayed by host pressure.";
+	}
+	else if (!m_executed)
 	{
 		std::lock_guard<std::recursive_mutex> guard(m_mutex);
 		m_executed = true;
@@ -96,6 +102,7 @@ void ApplicationInitialize::invoke()
 			m_process = allocProcess(m_cacheOutputLines, "", m_name);
 			m_procStartTime = std::chrono::system_clock::now();
 			m_pid = m_process->spawnProcess(m_commandLine, m_user, m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+			if (m_pid > 0) publishStarted();
 		}
 		else
 		{
@@ -1,6 +1,7 @@
 #include "ApplicationShortRun.h"
 #include "AppProcess.h"
 #include "Configuration.h"
+#include "ResourceCollection.h"
 #include "../common/Utility.h"
 #include "../common/TimeZoneHelper.h"
 
@@ -81,6 +82,12 @@ void ApplicationShortRun::invoke()
 			LOG_INF << fname << "Application <" << m_name << "> was not in daily start time";
 			m_process->killgroup();
 		}
+		// 2. retry the start delayed by host pressure, dropped out of daily start time
+		if (m_spawnDelayed)
+		{
+			if (this->avialable()) invokeNow(0);
+			else m_spawnDelayed = false;
+		}
 	}
 	// Only refresh Pid for short running
 	refreshPid();
@@ -88,6 +95,8 @@ void ApplicationShortRun::invoke()
 
 void ApplicationShortRun::invokeNow(int timerId)
 {
+	const static char fname[] = "ApplicationShortRun::invokeNow() ";
+
 	// Check app existance
 	if (timerId > 0 && !this->isEnabled())
 	{
@@ -96,6 +105,12 @@ void ApplicationShortRun::invokeNow(int timerId)
 	}
 	if (!isWorkingState()) return;
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	// a start delayed by host pressure keep its launch time and is retried by the next refresh
+	if (this->avialable() && !this->spawnPermit())
+	{
+		LOG_DBG << fname << "Application <" << m_name << "> start delayed by host pressure.";
+		return;
+	}
 	// clean old process
 	if (m_process->running())
 	{
@@ -119,6 +134,7 @@ void ApplicationShortRun::invokeNow(int timerId)
 		m_process = allocProcess(m_cacheOutputLines, m_dockerImage, m_name);
 		m_procStartTime = std::chrono::system_clock::now();
 		m_pid = m_process->spawnProcess(m_commandLine, m_user, m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+		if (m_pid > 0) publishStarted();
 		m_nextLaunchTime = std::make_unique<std::chrono::system_clock::time_point>(std::chrono::system_clock::now() + std::chrono::seconds(this->getStartInterval()));
 	}
 }
@@ -139,6 +155,14 @@ web::json::value ApplicationShortRun::AsJson(bool returnRuntimeInfo)
 	return result;
 }
 
+std::size_t ApplicationShortRun::getViewFingerprint()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto seed = Application::getViewFingerprint();
+	if (m_nextLaunchTime != nullptr) seed ^= m_nextLaunchTime->time_since_epoch().count() + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	return seed;
+}
+
 void ApplicationShortRun::enable()
 {
 	const static char fname[] = "ApplicationShortRun::enable() ";
@@ -17,6 +17,7 @@ public:
 
 	static void FromJson(std::shared_ptr<ApplicationShortRun>& app, const web::json::value& jobj) noexcept(false);
 	virtual web::json::value AsJson(bool returnRuntimeInfo) override;
+	virtual std::size_t getViewFingerprint() override;
 	virtual void dump() override;
 
 	virtual void invoke() override;
@@ -98,6 +98,7 @@ void ApplicationUnInitia::invoke()
 			m_process = allocProcess(m_cacheOutputLines, "", m_name);
 			m_procStartTime = std::chrono::system_clock::now();
 			m_pid = m_process->spawnProcess(m_commandLine, m_user, m_workdir, m_envMap, m_resourceLimit, m_stdoutFile);
+			if (m_pid > 0) publishStarted();
 		}
 		else
 		{
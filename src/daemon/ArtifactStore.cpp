@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <openssl/sha.h>
+#include "ArtifactStore.h"
+#include "../common/Utility.h"
+#include "../common/os/chown.hpp"
+#include "../common/os/filemap.hpp"
+#include "../common/os/linux.hpp"
+
+ArtifactStore::ArtifactStore(const std::string& storeDir)
+	:m_storeDir(storeDir), m_loaded(false)
+{
+}
+
+ArtifactStore::~ArtifactStore()
+{
+}
+
+std::shared_ptr<ArtifactStore>& ArtifactStore::instance()
+{
+	static auto singleton = std::make_shared<ArtifactStore>(Utility::getSelfDir() + "/" + DEFAULT_ARTIFACT_STORE_DIR);
+	return singleton;
+}
+
+bool ArtifactStore::isValidHash(const std::string& hash)
+{
+	// hex SHA-256
+	return hash.length() == 64 && std::all_of(hash.begin(), hash.end(), [](char c) { return std::isdigit(c) || (c >= 'a' && c <= 'f'); });
+}
+
+std::string ArtifactStore::objectPath(const std::string& hash) const
+{
+	return m_storeDir + "/" + hash;
+}
+
+bool ArtifactStore::has(const std::string& hash, uint64_t& size)
+{
+	const static char fname[] = "ArtifactStore::has() ";
+
+	if (!isValidHash(hash)) throw std::invalid_argument("invalid sha-256 hash");
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	load();
+	auto iter = m_artifacts.find(hash);
+	if (iter == m_artifacts.end()) return false;
+
+	// drop the object changed outside the store
+	struct stat st;
+	auto path = objectPath(hash);
+	if (::stat(path.c_str(), &st) != 0 || (uint64_t)st.st_size != iter->second.m_size || st.st_ino != iter->second.m_inode ||
+		(long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec != iter->second.m_mtimeNs)
+	{
+		LOG_WAR << fname << "Artifact <" << hash << "> was modified, removed from store";
+		::unlink(path.c_str());
+		m_artifacts.erase(iter);
+		return false;
+	}
+	size = iter->second.m_size;
+	return true;
+}
+
+void ArtifactStore::add(const std::string& filePath, const std::string& hash)
+{
+	const static char fname[] = "ArtifactStore::add() ";
+
+	uint64_t size = 0;
+	if (has(hash, size)) return;
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	// own inode, the uploaded file can be written in place later
+	auto path = objectPath(hash);
+	auto tmpFile = path + ".tmp";
+	try
+	{
+		copyFile(filePath, tmpFile);
+		// the source is a live path, it can be written after it was verified
+		if (contentHash(tmpFile) != hash) throw std::invalid_argument("content changed after verified");
+	}
+	catch (const std::exception& e)
+	{
+		::unlink(tmpFile.c_str());
+		LOG_WAR << fname << "Failed to keep <" << filePath << "> in store :" << e.what();
+		return;
+	}
+	struct stat st;
+	if (::stat(filePath.c_str(), &st) == 0) os::fileChmod(tmpFile, st.st_mode & 07777);
+	if (::rename(tmpFile.c_str(), path.c_str()) != 0)
+	{
+		LOG_WAR << fname << "Failed to keep <" << filePath << "> in store :" << std::strerror(errno);
+		::unlink(tmpFile.c_str());
+		return;
+	}
+	if (::stat(path.c_str(), &st) == 0)
+	{
+		m_artifacts[hash] = Artifact{ (uint64_t)st.st_size, st.st_ino, (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec, (long long)std::time(nullptr) };
+		LOG_INF << fname << "Artifact <" << hash << "> added from <" << filePath << ">";
+	}
+	evict();
+}
+
+std::string ArtifactStore::deploy(const std::string& hash, const std::string& filePath, int fileMode, const std::string& fileUser)
+{
+	const static char fname[] = "ArtifactStore::deploy() ";
+
+	if (filePath.empty() || filePath.back() == '/') throw std::invalid_argument("invalid file path");
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	uint64_t size = 0;
+	if (!has(hash, size)) throw std::invalid_argument(std::string("no such artifact <") + hash + ">");
+
+	struct stat objectStat;
+	auto path = objectPath(hash);
+	if (::stat(path.c_str(), &objectStat) != 0) throw std::invalid_argument(std::string("failed to stat artifact :") + std::strerror(errno));
+	unsigned int uid = 0, gid = 0;
+	if (fileUser.length() && !Utility::getUid(fileUser, uid, gid)) throw std::invalid_argument(std::string("no such user <") + fileUser + ">");
+
+	auto pos = filePath.find_last_of('/');
+	auto tmpFile = (pos == std::string::npos) ? ("." + filePath) : (filePath.substr(0, pos + 1) + "." + filePath.substr(pos + 1));
+	tmpFile += ".appmgr-deploy";
+	::unlink(tmpFile.c_str());
+	// reflink share extents copy-on-write, the target is never linked to the store object
+	std::string method;
+	try
+	{
+		method = copyFile(path, tmpFile) ? "reflink" : "copy";
+	}
+	catch (...)
+	{
+		::unlink(tmpFile.c_str());
+		throw;
+	}
+	os::fileChmod(tmpFile, (fileMode & 07777) ? (fileMode & 07777) : (objectStat.st_mode & 07777));
+	if (fileUser.length()) os::chown(tmpFile, fileUser);
+	if (::rename(tmpFile.c_str(), filePath.c_str()) != 0)
+	{
+		auto error = std::string("failed to rename file :") + std::strerror(errno);
+		::unlink(tmpFile.c_str());
+		throw std::invalid_argument(error);
+	}
+	m_artifacts[hash].m_lastUsed = std::time(nullptr);
+	LOG_INF << fname << "Artifact <" << hash << "> deployed to <" << filePath << "> by " << method;
+	return method;
+}
+
+void ArtifactStore::load()
+{
+	const static char fname[] = "ArtifactStore::load() ";
+
+	if (m_loaded) return;
+	m_loaded = true;
+	if (!Utility::isDirExist(m_storeDir) && !Utility::createDirectory(m_storeDir, 0700))
+	{
+		LOG_ERR << fname << "Failed to create store dir <" << m_storeDir << ">";
+		return;
+	}
+	auto dir = ::opendir(m_storeDir.c_str());
+	if (dir == nullptr) return;
+	while (auto entry = ::readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..") continue;
+		auto path = objectPath(name);
+		struct stat st;
+		if (!isValidHash(name) || ::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+		{
+			// unfinished copy
+			::unlink(path.c_str());
+			continue;
+		}
+		m_artifacts[name] = Artifact{ (uint64_t)st.st_size, st.st_ino, (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec, (long long)st.st_mtim.tv_sec };
+	}
+	::closedir(dir);
+	LOG_INF << fname << "Artifact store <" << m_storeDir << "> loaded with <" << m_artifacts.size() << "> artifacts";
+}
+
+void ArtifactStore::evict()
+{
+	const static char fname[] = "ArtifactStore::evict() ";
+
+	uint64_t total = 0;
+	for (const auto& artifact : m_artifacts) total += artifact.second.m_size;
+	if (total <= DEFAULT_ARTIFACT_STORE_MAX_SIZE) return;
+
+	// least recently used first
+	std::vector<std::pair<long long, std::string>> candidates;
+	for (const auto& artifact : m_artifacts)
+	{
+		candidates.push_back(std::make_pair(artifact.second.m_lastUsed, artifact.first));
+	}
+	std::sort(candidates.begin(), candidates.end());
+	for (const auto& candidate : candidates)
+	{
+		if (total <= DEFAULT_ARTIFACT_STORE_MAX_SIZE) break;
+		total -= m_artifacts[candidate.second].m_size;
+		m_artifacts.erase(candidate.second);
+		::unlink(objectPath(candidate.second).c_str());
+		LOG_DBG << fname << "Artifact <" << candidate.second << "> evicted";
+	}
+}
+
+std::string ArtifactStore::contentHash(const std::string& path)
+{
+	os::FileReader reader(path);
+	if (!reader.valid()) throw std::invalid_argument(std::string("failed to open <") + path + ">");
+	SHA256_CTX ctx;
+	SHA256_Init(&ctx);
+	std::vector<unsigned char> chunk(DEFAULT_FILE_STREAM_CHUNK_SIZE);
+	for (size_t offset = 0; offset < reader.size();)
+	{
+		auto bytes = reader.read(offset, chunk.data(), std::min(chunk.size(), reader.size() - offset));
+		if (bytes <= 0) throw std::invalid_argument(std::string("failed to read <") + path + ">");
+		SHA256_Update(&ctx, chunk.data(), bytes);
+		offset += bytes;
+	}
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256_Final(hash, &ctx);
+	return Utility::hexEncode(hash, sizeof(hash));
+}
+
+bool ArtifactStore::copyFile(const std::string& src, const std::string& dst)
+{
+	int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+	if (in < 0) throw std::invalid_argument(std::string("failed to open <") + src + "> :" + std::strerror(errno));
+	int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (out < 0)
+	{
+		::close(in);
+		throw std::invalid_argument(std::string("failed to create <") + dst + "> :" + std::strerror(errno));
+	}
+	bool reflinked = false;
+	std::string error;
+#ifdef FICLONE
+	// share extents on btrfs / xfs
+	reflinked = (::ioctl(out, FICLONE, in) == 0);
+#endif
+	if (!reflinked)
+	{
+		struct stat st;
+		off_t offset = 0;
+		if (::fstat(in, &st) != 0) error = std::strerror(errno);
+		while (error.empty() && offset < st.st_size)
+		{
+			auto ret = ::sendfile(out, in, &offset, st.st_size - offset);
+			if (ret < 0 && errno != EINTR) error = std::strerror(errno);
+			else if (ret == 0) error = "file truncated while copying";
+		}
+	}
+	if (error.empty() && ::fsync(out) != 0) error = std::strerror(errno);
+	::close(in);
+	::close(out);
+	if (error.length()) throw std::invalid_argument(std::string("failed to copy <") + src + "> :" + error);
+	return reflinked;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+//////////////////////////////////////////////////////////////////////////
+/// Content addressed artifact store
+/// Files are kept once by SHA-256 (hex) under <appmgr dir>/artifacts and
+/// reflinked (or copied) into target paths, so a client can ask whether the
+/// content already exist and skip the transfer. A target never share the
+/// inode with the store object, writing a target can not change the store.
+//////////////////////////////////////////////////////////////////////////
+class ArtifactStore
+{
+public:
+	struct Artifact
+	{
+		uint64_t m_size;
+		ino_t m_inode;
+		long long m_mtimeNs;
+		// seconds since epoch of add or last deploy, evicted first when oldest
+		long long m_lastUsed;
+	};
+
+	explicit ArtifactStore(const std::string& storeDir);
+	virtual ~ArtifactStore();
+	static std::shared_ptr<ArtifactStore>& instance();
+
+	// Check whether the content exist and the store object was not modified
+	bool has(const std::string& hash, uint64_t& size);
+	// Keep a reflink or copy of a verified file in store, the copy is hashed again before kept
+	void add(const std::string& filePath, const std::string& hash);
+	// Place the content to target path, return how it was done: reflink or copy
+	std::string deploy(const std::string& hash, const std::string& filePath, int fileMode, const std::string& fileUser);
+
+	static bool isValidHash(const std::string& hash);
+
+private:
+	std::string objectPath(const std::string& hash) const;
+	void load();
+	void evict();
+	// reflink or copy src to dst, return true when reflinked
+	static bool copyFile(const std::string& src, const std::string& dst);
+	// hex SHA-256 of a file
+	static std::string contentHash(const std::string& path);
+
+	const std::string m_storeDir;
+	std::map<std::string, Artifact> m_artifacts;
+	bool m_loaded;
+	std::recursive_mutex m_mutex;
+};
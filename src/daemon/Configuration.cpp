@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <set>
 #include <ace/Signal.h>
 #include <boost/algorithm/string_regex.hpp>
@@ -8,26 +10,39 @@
 #include "ApplicationPeriodRun.h"
 #include "Configuration.h"
 #include "ConsulConnection.h"
+#include "CpuAllocator.h"
+#include "EventBus.h"
 #include "Label.h"
 #include "ResourceCollection.h"
 #include "PrometheusRest.h"
+#include "RateLimiter.h"
 #include "RestHandler.h"
+#include "RunRegistry.h"
+#include "ShellWorkerPool.h"
+#include "TokenCache.h"
 #include "User.h"
 
+#include "../common/JsonWriter.h"
 #include "../common/Utility.h"
 
 // from main.cpp
 extern std::set<std::shared_ptr<RestHandler>> m_restList;
 
+// keep increasing when the Configuration object is replaced by reload
+static std::atomic<unsigned long long> viewVersionSeq(0);
+
 std::shared_ptr<Configuration> Configuration::m_instance = nullptr;
 Configuration::Configuration()
-	:m_scheduleInterval(DEFAULT_SCHEDULE_INTERVAL)
+	:m_scheduleInterval(DEFAULT_SCHEDULE_INTERVAL), m_transactionDepth(0), m_persistPending(false), m_configVersion(++viewVersionSeq), m_appsVersion(++viewVersionSeq), m_appsFingerprint(0)
 {
 	m_jsonFilePath = Utility::getSelfFullPath() + ".json";
 	m_label = std::make_unique<Label>();
 	m_security = std::make_shared<JsonSecurity>();
 	m_rest = std::make_shared<JsonRest>();
 	m_consul = std::make_shared<JsonConsul>();
+	m_pressure = std::make_shared<JsonPressure>();
+	m_rateLimit = std::make_shared<JsonRateLimit>();
+	m_runPool = std::make_shared<JsonRunPool>();
 	LOG_INF << "Configuration file <" << m_jsonFilePath << ">";
 }
 
@@ -99,6 +114,21 @@ std::shared_ptr<Configuration> Configuration::FromJson(const std::string& str)
 	{
 		config->m_consul = JsonConsul::FromJson(jsonValue.at(JSON_KEY_CONSULE));
 	}
+	// Pressure
+	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_Pressure))
+	{
+		config->m_pressure = JsonPressure::FromJson(jsonValue.at(JSON_KEY_Pressure));
+	}
+	// RateLimit
+	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_RateLimit))
+	{
+		config->m_rateLimit = JsonRateLimit::FromJson(jsonValue.at(JSON_KEY_RateLimit));
+	}
+	// RunPool
+	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_RunPool))
+	{
+		config->m_runPool = JsonRunPool::FromJson(jsonValue.at(JSON_KEY_RunPool));
+	}
 
 	// Applications
 	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_Applications))
@@ -178,6 +208,15 @@ web::json::value Configuration::AsJson(bool returnRuntimeInfo)
 	// Consul
 	result[JSON_KEY_CONSULE] = m_consul->AsJson();
 
+	// Pressure
+	result[JSON_KEY_Pressure] = m_pressure->AsJson();
+
+	// RateLimit
+	result[JSON_KEY_RateLimit] = m_rateLimit->AsJson();
+
+	// RunPool
+	result[JSON_KEY_RunPool] = m_runPool->AsJson();
+
 	return result;
 }
 
@@ -187,6 +226,23 @@ std::vector<std::shared_ptr<Application>> Configuration::getApps() const
 	return m_apps;
 }
 
+unsigned long long Configuration::getAppsVersion()
+{
+	const auto apps = getApps();
+	std::size_t fingerprint = apps.size();
+	for (const auto& app : apps)
+	{
+		fingerprint ^= app->getViewFingerprint() + 0x9e3779b9 + (fingerprint << 6) + (fingerprint >> 2);
+	}
+	std::lock_guard<std::mutex> guard(m_appsVersionMutex);
+	if (fingerprint != m_appsFingerprint)
+	{
+		m_appsFingerprint = fingerprint;
+		m_appsVersion = ++viewVersionSeq;
+	}
+	return m_appsVersion;
+}
+
 void Configuration::addApp2Map(std::shared_ptr<Application> app)
 {
 	const static char fname[] = "Configuration::addApp2Map() ";
@@ -201,6 +257,13 @@ void Configuration::addApp2Map(std::shared_ptr<Application> app)
 		}
 	}
 	m_apps.push_back(app);
+	bumpAppsVersion();
+}
+
+void Configuration::bumpAppsVersion()
+{
+	std::lock_guard<std::mutex> guard(m_appsVersionMutex);
+	m_appsVersion = ++viewVersionSeq;
 }
 
 int Configuration::getScheduleInterval()
@@ -280,13 +343,30 @@ web::json::value Configuration::getApplicationJson(bool returnRuntimeInfo) const
 	return result;
 }
 
+std::vector<std::shared_ptr<Application>> Configuration::getApps(const AppQuery& query, size_t& total) const
+{
+	std::vector<std::shared_ptr<Application>> apps;
+	total = 0;
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	for (const auto& app : m_apps)
+	{
+		if (!query.match(app)) continue;
+		if (total++ < query.m_offset) continue;
+		if (query.m_limit && apps.size() >= query.m_limit) continue;
+		apps.push_back(app);
+	}
+	return apps;
+}
+
 void Configuration::disableApp(const std::string& appName)
 {
+	std::lock_guard<std::recursive_mutex> changeGuard(m_appsChangeMutex);
 	getApp(appName)->disable();
 	saveConfigToDisk();
 }
 void Configuration::enableApp(const std::string& appName)
 {
+	std::lock_guard<std::recursive_mutex> changeGuard(m_appsChangeMutex);
 	auto app = getApp(appName);
 	app->enable();
 	saveConfigToDisk();
@@ -322,6 +402,17 @@ bool Configuration::getRestEnabled() const
 	return m_rest->m_restEnabled;
 }
 
+std::string Configuration::getLocalSocketPath() const
+{
+	return m_rest->m_localSocket->m_path;
+}
+
+std::map<std::string, std::string> Configuration::getLocalSocketPeers() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_rest->m_localSocket->m_peers;
+}
+
 bool Configuration::getJwtEnabled() const
 {
 	return m_rest->m_restEnabled;
@@ -376,6 +467,24 @@ const std::shared_ptr<Configuration::JsonConsul> Configuration::getConsul() cons
 	return m_consul;
 }
 
+const std::shared_ptr<Configuration::JsonPressure> Configuration::getPressure() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_pressure;
+}
+
+const std::shared_ptr<Configuration::JsonRateLimit> Configuration::getRateLimit() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_rateLimit;
+}
+
+const std::shared_ptr<Configuration::JsonRunPool> Configuration::getRunPool() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_runPool;
+}
+
 const std::shared_ptr<Configuration::JsonSecurity> Configuration::getSecurity()
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
@@ -386,6 +495,9 @@ void Configuration::updateSecurity(std::shared_ptr<Configuration::JsonSecurity>
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	m_security = security;
+	m_configVersion = ++viewVersionSeq;
+	TokenCache::instance()->invalidate();
+	EventBus::instance()->publish(EVENT_TYPE_security_updated, "");
 }
 
 void Configuration::dump()
@@ -404,24 +516,38 @@ void Configuration::dump()
 std::shared_ptr<Application> Configuration::addApp(const web::json::value& jsonApp)
 {
 	auto app = parseApp(jsonApp);
-	bool update = false;
-	std::lock_guard<std::recursive_mutex> guard(m_mutex);
-	std::for_each(m_apps.begin(), m_apps.end(), [&app, &update](std::shared_ptr<Application>& mapApp)
+	std::lock_guard<std::recursive_mutex> changeGuard(m_appsChangeMutex);
+	std::shared_ptr<Application> replaced;
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		for (const auto& mapApp : m_apps)
 		{
-			if (mapApp->getName() == app->getName())
-			{
-				// Stop existing app and replace
-				mapApp->disable();
-				mapApp = app;
-				update = true;
-				return;
-			}
-		});
-
-	if (!update)
+			if (mapApp->getName() == app->getName()) replaced = mapApp;
+		}
+	}
+	const bool update = (replaced != nullptr);
+	if (update)
+	{
+		// Stop existing app before the new one is visible, the CPU placement is keyed by name
+		replaced->disable();
+		CpuAllocator::instance()->release(replaced->getName());
+	}
 	{
-		// Register app
-		addApp2Map(app);
+		// lock only the registry change, process control and event are done without it
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		std::for_each(m_apps.begin(), m_apps.end(), [&app, &replaced](std::shared_ptr<Application>& mapApp)
+			{
+				if (mapApp == replaced) mapApp = app;
+			});
+		if (!update)
+		{
+			// Register app
+			addApp2Map(app);
+		}
+		else
+		{
+			bumpAppsVersion();
+		}
 	}
 	// Write to disk
 	if (app->isWorkingState())
@@ -433,6 +559,7 @@ std::shared_ptr<Application> Configuration::addApp(const web::json::value& jsonA
 		saveConfigToDisk();
 	}
 	app->dump();
+	EventBus::instance()->publish(update ? EVENT_TYPE_app_updated : EVENT_TYPE_app_added, app->getName());
 	return std::move(app);
 }
 
@@ -442,30 +569,49 @@ void Configuration::removeApp(const std::string& appName)
 
 	LOG_DBG << fname << appName;
 
-	std::lock_guard<std::recursive_mutex> guard(m_mutex);
-	// Update in-memory app
-	for (auto iterA = m_apps.begin(); iterA != m_apps.end();)
+	std::lock_guard<std::recursive_mutex> changeGuard(m_appsChangeMutex);
+	std::vector<std::shared_ptr<Application>> removed;
 	{
-		if ((*iterA)->getName() == appName)
-		{
-			bool needPersist = (*iterA)->isWorkingState();
-			(*iterA)->destroy();
-			iterA = m_apps.erase(iterA);
-			// Write to disk
-			if (needPersist) saveConfigToDisk();
-			LOG_DBG << fname << "removed " << appName;
-		}
-		else
+		// Update in-memory app
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		for (auto iterA = m_apps.begin(); iterA != m_apps.end();)
 		{
-			iterA++;
+			if ((*iterA)->getName() == appName)
+			{
+				removed.push_back(*iterA);
+				iterA = m_apps.erase(iterA);
+				bumpAppsVersion();
+			}
+			else
+			{
+				iterA++;
+			}
 		}
 	}
+	for (const auto& app : removed)
+	{
+		bool needPersist = app->isWorkingState();
+		app->destroy();
+		// Write to disk
+		if (needPersist) saveConfigToDisk();
+		LOG_DBG << fname << "removed " << appName;
+		EventBus::instance()->publish(EVENT_TYPE_app_removed, appName);
+	}
 }
 
 void Configuration::saveConfigToDisk()
 {
 	const static char fname[] = "Configuration::saveConfigToDisk() ";
 
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		if (m_transactionDepth > 0)
+		{
+			m_persistPending = true;
+			return;
+		}
+	}
+	m_configVersion = ++viewVersionSeq;
 	auto content = GET_STD_STRING(this->AsJson(false).serialize());
 	if (content.length())
 	{
@@ -501,6 +647,7 @@ void Configuration::hotUpdate(const web::json::value& config)
 	bool consulUpdated = false;
 	{
 		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		m_configVersion = ++viewVersionSeq;
 		// not support update [Application] section
 		auto jsonValue = config;
 		if (HAS_JSON_FIELD(jsonValue, JSON_KEY_Applications)) jsonValue.erase(GET_STRING_T(JSON_KEY_Applications));
@@ -544,6 +691,12 @@ void Configuration::hotUpdate(const web::json::value& config)
 				if (HAS_JSON_FIELD(ssl, JSON_KEY_SSLCertificateKeyFile)) SET_COMPARE(this->m_rest->m_ssl->m_certKeyFile, newConfig->m_rest->m_ssl->m_certKeyFile);
 				if (HAS_JSON_FIELD(ssl, JSON_KEY_SSLEnabled)) SET_COMPARE(this->m_rest->m_ssl->m_sslEnabled, newConfig->m_rest->m_ssl->m_sslEnabled);
 			}
+			// Local socket path is used when start, peers are checked for each connection
+			if (HAS_JSON_FIELD(rest, JSON_KEY_LocalSocket))
+			{
+				auto localSocket = rest.at(JSON_KEY_LocalSocket);
+				if (HAS_JSON_FIELD(localSocket, JSON_KEY_LocalSocketPeers)) SET_COMPARE(this->m_rest->m_localSocket->m_peers, newConfig->m_rest->m_localSocket->m_peers);
+			}
 		}
 
 		// Security
@@ -555,6 +708,7 @@ void Configuration::hotUpdate(const web::json::value& config)
 
 			// Roles
 			if (HAS_JSON_FIELD(sec, JSON_KEY_Roles)) SET_COMPARE(this->m_security->m_roles, newConfig->m_security->m_roles);
+			TokenCache::instance()->invalidate();
 		}
 
 		// Labels
@@ -566,10 +720,36 @@ void Configuration::hotUpdate(const web::json::value& config)
 			SET_COMPARE(this->m_consul, newConfig->m_consul);
 			consulUpdated = true;
 		}
+
+		// Pressure
+		if (HAS_JSON_FIELD(jsonValue, JSON_KEY_Pressure)) SET_COMPARE(this->m_pressure, newConfig->m_pressure);
+
+		// RateLimit
+		if (HAS_JSON_FIELD(jsonValue, JSON_KEY_RateLimit))
+		{
+			SET_COMPARE(this->m_rateLimit, newConfig->m_rateLimit);
+			RateLimiter::instance()->setConfig(this->m_rateLimit);
+		}
+
+		// RunPool
+		if (HAS_JSON_FIELD(jsonValue, JSON_KEY_RunPool)) SET_COMPARE(this->m_runPool, newConfig->m_runPool);
+	}
+	auto sections = web::json::value::array();
+	if (config.is_object())
+	{
+		for (const auto& section : config.as_object())
+		{
+			if (section.first != JSON_KEY_Applications) sections[sections.size()] = web::json::value::string(section.first);
+		}
 	}
+	auto data = web::json::value::object();
+	data[JSON_KEY_EVENT_sections] = sections;
+	EventBus::instance()->publish(EVENT_TYPE_config_updated, "", data);
+
 	// do not hold Configuration lock to access timer, timer lock is higher level
 	if (consulUpdated) ConsulConnection::instance()->initTimer();
 	ResourceCollection::instance()->getHostName(true);
+	ResourceCollection::instance()->invalidateSnapshot();
 
 	this->dump();
 	ResourceCollection::instance()->dump();
@@ -586,6 +766,10 @@ void Configuration::registerPrometheus()
 	{
 		rest->initMetrics(PrometheusRest::instance());
 	}
+	ResourceCollection::instance()->initMetrics(PrometheusRest::instance());
+	RateLimiter::instance()->initMetrics(PrometheusRest::instance());
+	ShellWorkerPool::instance()->initMetrics(PrometheusRest::instance());
+	RunRegistry::instance()->initMetrics(PrometheusRest::instance());
 }
 
 std::shared_ptr<Application> Configuration::parseApp(const web::json::value& jsonApp)
@@ -682,6 +866,11 @@ std::shared_ptr<Configuration::JsonRest> Configuration::JsonRest::FromJson(const
 	{
 		rest->m_ssl = JsonSsl::FromJson(jsonValue.at(JSON_KEY_SSL));
 	}
+	// Local socket
+	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_LocalSocket))
+	{
+		rest->m_localSocket = JsonLocalSocket::FromJson(jsonValue.at(JSON_KEY_LocalSocket));
+	}
 	return rest;
 }
 
@@ -695,6 +884,8 @@ web::json::value Configuration::JsonRest::AsJson() const
 	result[JSON_KEY_RestListenAddress] = web::json::value::string(m_restListenAddress);
 	// SSL
 	result[JSON_KEY_SSL] = m_ssl->AsJson();
+	// Local socket
+	result[JSON_KEY_LocalSocket] = m_localSocket->AsJson();
 	return result;
 }
 
@@ -703,6 +894,7 @@ Configuration::JsonRest::JsonRest()
 	m_restListenPort(DEFAULT_REST_LISTEN_PORT), m_promListenPort(DEFAULT_PROM_LISTEN_PORT)
 {
 	m_ssl = std::make_shared<JsonSsl>();
+	m_localSocket = std::make_shared<JsonLocalSocket>();
 }
 
 std::shared_ptr<Configuration::JsonSsl> Configuration::JsonSsl::FromJson(const web::json::value& jsonValue)
@@ -736,6 +928,35 @@ Configuration::JsonSsl::JsonSsl()
 {
 }
 
+std::shared_ptr<Configuration::JsonLocalSocket> Configuration::JsonLocalSocket::FromJson(const web::json::value& jsonValue)
+{
+	auto localSocket = std::make_shared<JsonLocalSocket>();
+	localSocket->m_path = GET_JSON_STR_VALUE(jsonValue, JSON_KEY_LocalSocketPath);
+	if (HAS_JSON_FIELD(jsonValue, JSON_KEY_LocalSocketPeers))
+	{
+		for (const auto& peer : jsonValue.at(JSON_KEY_LocalSocketPeers).as_object())
+		{
+			if (!peer.second.is_string()) throw std::invalid_argument(std::string("LocalSocketPeers value should be user name : ") + GET_STD_STRING(peer.first));
+			localSocket->m_peers[GET_STD_STRING(peer.first)] = GET_STD_STRING(peer.second.as_string());
+		}
+	}
+	return localSocket;
+}
+
+web::json::value Configuration::JsonLocalSocket::AsJson() const
+{
+	auto result = web::json::value::object();
+	result[JSON_KEY_LocalSocketPath] = web::json::value::string(m_path);
+	auto peers = web::json::value::object();
+	for (const auto& peer : m_peers) peers[peer.first] = web::json::value::string(peer.second);
+	result[JSON_KEY_LocalSocketPeers] = peers;
+	return result;
+}
+
+Configuration::JsonLocalSocket::JsonLocalSocket()
+{
+}
+
 std::shared_ptr<Configuration::JsonSecurity> Configuration::JsonSecurity::FromJson(const web::json::value& jsonValue)
 {
 	auto security = std::make_shared<Configuration::JsonSecurity>();
@@ -761,6 +982,91 @@ web::json::value Configuration::JsonSecurity::AsJson(bool returnRuntimeInfo)
 	return result;
 }
 
+Configuration::Transaction::Transaction(const std::shared_ptr<Configuration>& config)
+	:m_config(config), m_changeLock(config->m_appsChangeMutex)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_config->m_mutex);
+	m_config->m_transactionDepth++;
+}
+
+Configuration::Transaction::~Transaction()
+{
+	const static char fname[] = "Configuration::Transaction::~Transaction() ";
+
+	bool persist = false;
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_config->m_mutex);
+		persist = (--m_config->m_transactionDepth == 0 && m_config->m_persistPending);
+		if (persist) m_config->m_persistPending = false;
+	}
+	if (persist)
+	{
+		try
+		{
+			m_config->saveConfigToDisk();
+		}
+		catch (const std::exception& e)
+		{
+			LOG_ERR << fname << "Failed to persist configuration :" << e.what();
+		}
+	}
+}
+
+Configuration::AppQuery::AppQuery()
+	:m_status(-1), m_docker(-1), m_health(-1), m_offset(0), m_limit(0)
+{
+}
+
+bool Configuration::AppQuery::match(const std::shared_ptr<Application>& app) const
+{
+	if (m_status >= 0 && static_cast<int>(app->getStatus()) != m_status) return false;
+	if (m_docker >= 0 && app->isDockerApp() != (m_docker == 1)) return false;
+	if (m_user.length() && app->getUser() != m_user) return false;
+	if (m_namePrefix.length() && app->getName().compare(0, m_namePrefix.length(), m_namePrefix) != 0) return false;
+	if (m_health >= 0 && app->getHealth() != m_health) return false;
+	return true;
+}
+
+bool Configuration::AppQuery::returnRuntimeInfo() const
+{
+	const static std::set<std::string> runtimeFields = {
+		JSON_KEY_APP_pid, JSON_KEY_APP_return, JSON_KEY_APP_memory,
+		JSON_KEY_APP_io_read_bytes, JSON_KEY_APP_io_write_bytes, JSON_KEY_APP_fd_count, JSON_KEY_APP_threads,
+		JSON_KEY_APP_ctx_switches_voluntary, JSON_KEY_APP_ctx_switches_involuntary,
+		JSON_KEY_APP_last_start, JSON_KEY_APP_last_exit_reason, JSON_KEY_APP_container_id, JSON_KEY_APP_health,
+		JSON_KEY_APP_resource_limit, JSON_KEY_SHORT_APP_next_start_time };
+	// runtime info (pstree memory walk) is only collected when a runtime field is requested
+	if (m_fields.empty()) return true;
+	for (const auto& field : m_fields)
+	{
+		if (runtimeFields.count(field)) return true;
+	}
+	return false;
+}
+
+void Configuration::AppQuery::write(JsonWriter& writer, const std::vector<std::shared_ptr<Application>>& apps) const
+{
+	const bool runtimeInfo = returnRuntimeInfo();
+	writer.startArray();
+	for (const auto& app : apps)
+	{
+		// only one application json exist at a time
+		auto json = app->AsJson(runtimeInfo);
+		if (m_fields.empty())
+		{
+			writer.value(json);
+			continue;
+		}
+		writer.startObject();
+		for (const auto& field : m_fields)
+		{
+			if (HAS_JSON_FIELD(json, field)) writer.key(field).value(json.at(GET_STRING_T(field)));
+		}
+		writer.endObject();
+	}
+	writer.endArray();
+}
+
 Configuration::JsonSecurity::JsonSecurity()
 	:m_jwtEnabled(true), m_encryptKey(false)
 {
@@ -814,3 +1120,149 @@ Configuration::JsonConsul::JsonConsul()
 	:m_isMaster(false), m_isNode(false), m_ttl(CONSUL_SESSION_DEFAULT_TTL), m_securitySync(false)
 {
 }
+
+Configuration::JsonPressure::JsonPressure()
+	:m_cpuThreshold(0), m_memoryThreshold(0), m_ioThreshold(0), m_criticalPriority(DEFAULT_PRESSURE_CRITICAL_PRIORITY)
+{
+}
+
+std::shared_ptr<Configuration::JsonPressure> Configuration::JsonPressure::FromJson(const web::json::value& jobj)
+{
+	auto pressure = std::make_shared<JsonPressure>();
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_PressureCpuThreshold)) pressure->m_cpuThreshold = jobj.at(JSON_KEY_PressureCpuThreshold).as_double();
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_PressureMemoryThreshold)) pressure->m_memoryThreshold = jobj.at(JSON_KEY_PressureMemoryThreshold).as_double();
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_PressureIoThreshold)) pressure->m_ioThreshold = jobj.at(JSON_KEY_PressureIoThreshold).as_double();
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_PressureCriticalPriority, pressure->m_criticalPriority);
+	if (pressure->m_cpuThreshold < 0 || pressure->m_cpuThreshold > 100 ||
+		pressure->m_memoryThreshold < 0 || pressure->m_memoryThreshold > 100 ||
+		pressure->m_ioThreshold < 0 || pressure->m_ioThreshold > 100)
+	{
+		throw std::invalid_argument("pressure threshold should between 0 and 100");
+	}
+	return pressure;
+}
+
+web::json::value Configuration::JsonPressure::AsJson() const
+{
+	auto result = web::json::value::object();
+	result[JSON_KEY_PressureCpuThreshold] = web::json::value::number(m_cpuThreshold);
+	result[JSON_KEY_PressureMemoryThreshold] = web::json::value::number(m_memoryThreshold);
+	result[JSON_KEY_PressureIoThreshold] = web::json::value::number(m_ioThreshold);
+	result[JSON_KEY_PressureCriticalPriority] = web::json::value::number(m_criticalPriority);
+	return result;
+}
+
+bool Configuration::JsonPressure::enabled() const
+{
+	return m_cpuThreshold > 0 || m_memoryThreshold > 0 || m_ioThreshold > 0;
+}
+
+Configuration::JsonRateLimit::Limit::Limit()
+	:m_requestsPerSecond(0), m_burst(0), m_concurrency(0)
+{
+}
+
+Configuration::JsonRateLimit::Limit Configuration::JsonRateLimit::Limit::FromJson(const web::json::value& jobj)
+{
+	Limit limit;
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_RateLimitRequestsPerSecond)) limit.m_requestsPerSecond = jobj.at(JSON_KEY_RateLimitRequestsPerSecond).as_double();
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_RateLimitBurst, limit.m_burst);
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_RateLimitConcurrency, limit.m_concurrency);
+	if (limit.m_requestsPerSecond < 0 || limit.m_burst < 0 || limit.m_concurrency < 0)
+	{
+		throw std::invalid_argument("rate limit should not be negative");
+	}
+	// burst default to one second of requests
+	if (limit.m_requestsPerSecond > 0 && limit.m_burst == 0) limit.m_burst = std::max(1, static_cast<int>(std::ceil(limit.m_requestsPerSecond)));
+	return limit;
+}
+
+web::json::value Configuration::JsonRateLimit::Limit::AsJson() const
+{
+	auto result = web::json::value::object();
+	result[JSON_KEY_RateLimitRequestsPerSecond] = web::json::value::number(m_requestsPerSecond);
+	result[JSON_KEY_RateLimitBurst] = web::json::value::number(m_burst);
+	result[JSON_KEY_RateLimitConcurrency] = web::json::value::number(m_concurrency);
+	return result;
+}
+
+Configuration::JsonRateLimit::JsonRateLimit()
+	:m_reservedThreads(DEFAULT_RATE_LIMIT_RESERVED_THREADS)
+{
+}
+
+std::shared_ptr<Configuration::JsonRateLimit> Configuration::JsonRateLimit::FromJson(const web::json::value& jobj)
+{
+	auto rateLimit = std::make_shared<JsonRateLimit>();
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_RateLimitReservedThreads, rateLimit->m_reservedThreads);
+	if (rateLimit->m_reservedThreads < 0) throw std::invalid_argument("ReservedThreads should not be negative");
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_RateLimitUser)) rateLimit->m_user = Limit::FromJson(jobj.at(JSON_KEY_RateLimitUser));
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_RateLimitRoutes))
+	{
+		for (const auto& route : jobj.at(JSON_KEY_RateLimitRoutes).as_object())
+		{
+			auto routeClass = GET_STD_STRING(route.first);
+			if (!RateLimiter::isRouteClass(routeClass)) throw std::invalid_argument(std::string("unknown route class <") + routeClass + ">");
+			rateLimit->m_routes[routeClass] = Limit::FromJson(route.second);
+		}
+	}
+	return rateLimit;
+}
+
+web::json::value Configuration::JsonRateLimit::AsJson() const
+{
+	auto result = web::json::value::object();
+	result[JSON_KEY_RateLimitReservedThreads] = web::json::value::number(m_reservedThreads);
+	result[JSON_KEY_RateLimitUser] = m_user.AsJson();
+	auto routes = web::json::value::object();
+	for (const auto& route : m_routes)
+	{
+		routes[route.first] = route.second.AsJson();
+	}
+	result[JSON_KEY_RateLimitRoutes] = routes;
+	return result;
+}
+
+Configuration::JsonRunPool::JsonRunPool()
+	:m_shell(DEFAULT_RUN_POOL_SHELL), m_maxWorkers(DEFAULT_RUN_POOL_MAX_WORKERS), m_minIdleWorkers(DEFAULT_RUN_POOL_MIN_IDLE_WORKERS), m_idleTimeout(DEFAULT_RUN_POOL_IDLE_TIMEOUT)
+{
+}
+
+std::shared_ptr<Configuration::JsonRunPool> Configuration::JsonRunPool::FromJson(const web::json::value& jobj)
+{
+	auto runPool = std::make_shared<JsonRunPool>();
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_RunPoolShell)) runPool->m_shell = GET_JSON_STR_VALUE(jobj, JSON_KEY_RunPoolShell);
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_RunPoolMaxWorkersPerUser, runPool->m_maxWorkers);
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_RunPoolMinIdleWorkers, runPool->m_minIdleWorkers);
+	SET_JSON_INT_VALUE(jobj, JSON_KEY_RunPoolIdleTimeoutSeconds, runPool->m_idleTimeout);
+	if (runPool->m_maxWorkers < 0 || runPool->m_minIdleWorkers < 0 || runPool->m_idleTimeout < 0)
+	{
+		throw std::invalid_argument("run pool parameter should not be negative");
+	}
+	if (runPool->m_minIdleWorkers > runPool->m_maxWorkers) runPool->m_minIdleWorkers = runPool->m_maxWorkers;
+	if (runPool->m_shell.empty() || runPool->m_shell[0] != '/') throw std::invalid_argument("run pool Shell should be an absolute path");
+	if (HAS_JSON_FIELD(jobj, JSON_KEY_RunPoolPreforkUsers))
+	{
+		for (const auto& user : jobj.at(JSON_KEY_RunPoolPreforkUsers).as_array())
+		{
+			runPool->m_preforkUsers.insert(GET_STD_STRING(user.as_string()));
+		}
+	}
+	return runPool;
+}
+
+web::json::value Configuration::JsonRunPool::AsJson() const
+{
+	auto result = web::json::value::object();
+	result[JSON_KEY_RunPoolShell] = web::json::value::string(m_shell);
+	result[JSON_KEY_RunPoolMaxWorkersPerUser] = web::json::value::number(m_maxWorkers);
+	result[JSON_KEY_RunPoolMinIdleWorkers] = web::json::value::number(m_minIdleWorkers);
+	result[JSON_KEY_RunPoolIdleTimeoutSeconds] = web::json::value::number(m_idleTimeout);
+	auto users = web::json::value::array();
+	for (const auto& user : m_preforkUsers)
+	{
+		users[users.size()] = web::json::value::string(user);
+	}
+	result[JSON_KEY_RunPoolPreforkUsers] = users;
+	return result;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <string>
 #include <memory>
 #include <vector>
@@ -13,6 +15,7 @@ class Users;
 class User;
 class Label;
 class Application;
+class JsonWriter;
 
 //////////////////////////////////////////////////////////////////////////
 /// All the operation functions to access appmg.json
@@ -27,6 +30,15 @@ class Configuration
 		std::string m_certKeyFile;
 		JsonSsl();
 	};
+	struct JsonLocalSocket {
+		static std::shared_ptr<JsonLocalSocket> FromJson(const web::json::value& jobj);
+		web::json::value AsJson() const;
+		// empty to disable the listener
+		std::string m_path;
+		// OS user name or '@' + group name -> appmgr user
+		std::map<std::string, std::string> m_peers;
+		JsonLocalSocket();
+	};
 	struct JsonRest {
 		static std::shared_ptr<JsonRest> FromJson(const web::json::value& jobj);
 		web::json::value AsJson() const;
@@ -37,6 +49,7 @@ class Configuration
 		int m_promListenPort;
 		std::string m_restListenAddress;
 		std::shared_ptr<JsonSsl> m_ssl;
+		std::shared_ptr<JsonLocalSocket> m_localSocket;
 		JsonRest();
 	};
 	struct JsonConsul {
@@ -56,6 +69,19 @@ class Configuration
 		bool m_securitySync;
 		std::string m_consulDockerImg;
 	};
+	struct JsonPressure {
+		JsonPressure();
+		static std::shared_ptr<JsonPressure> FromJson(const web::json::value& jobj);
+		web::json::value AsJson() const;
+		bool enabled() const;
+
+		// PSI 'some avg10' percentage, 0 means not check
+		double m_cpuThreshold;
+		double m_memoryThreshold;
+		double m_ioThreshold;
+		// application priority equal or higher than this will not be delayed
+		int m_criticalPriority;
+	};
 public:
 	struct JsonSecurity {
 		static std::shared_ptr<JsonSecurity> FromJson(const web::json::value& jobj);
@@ -66,6 +92,69 @@ public:
 		std::shared_ptr<Roles> m_roles;
 		JsonSecurity();
 	};
+	// REST admission control, 0 means no limit
+	struct JsonRateLimit {
+		struct Limit {
+			Limit();
+			static Limit FromJson(const web::json::value& jobj);
+			web::json::value AsJson() const;
+			double m_requestsPerSecond;
+			int m_burst;
+			int m_concurrency;
+		};
+		JsonRateLimit();
+		static std::shared_ptr<JsonRateLimit> FromJson(const web::json::value& jobj);
+		web::json::value AsJson() const;
+
+		// pool threads only health and metrics requests can use
+		int m_reservedThreads;
+		// each user (JWT user, or remote address without JWT)
+		Limit m_user;
+		// route class (run, file, read, write) -> limit shared by all users
+		std::map<std::string, Limit> m_routes;
+	};
+	// Pre-forked shell workers for ad-hoc run, see ShellWorkerPool
+	struct JsonRunPool {
+		JsonRunPool();
+		static std::shared_ptr<JsonRunPool> FromJson(const web::json::value& jobj);
+		web::json::value AsJson() const;
+
+		std::string m_shell;
+		// 0 disable the pool
+		int m_maxWorkers;
+		// idle workers kept for prefork users
+		int m_minIdleWorkers;
+		int m_idleTimeout;
+		std::set<std::string> m_preforkUsers;
+	};
+	// Application list query, filters are checked before runtime info is collected
+	struct AppQuery {
+		AppQuery();
+		bool match(const std::shared_ptr<Application>& app) const;
+		bool returnRuntimeInfo() const;
+		// write applications json array with field projection
+		void write(JsonWriter& writer, const std::vector<std::shared_ptr<Application>>& apps) const;
+
+		std::string m_namePrefix;
+		std::string m_user;
+		int m_status;	// Application::STATUS, -1 for any
+		int m_docker;	// 1: docker app only, 0: no docker app, -1: any
+		int m_health;	// 0: health, 1: unhealth, -1: any
+		size_t m_offset;
+		size_t m_limit;	// 0 for no limit
+		std::set<std::string> m_fields;	// field projection, empty for all fields
+	};
+	// Group application changes: other changes wait until the transaction end,
+	// the configuration file is written once when the last transaction end,
+	// readers only lock the registry by each change
+	class Transaction {
+	public:
+		explicit Transaction(const std::shared_ptr<Configuration>& config);
+		~Transaction();
+	private:
+		const std::shared_ptr<Configuration> m_config;
+		std::unique_lock<std::recursive_mutex> m_changeLock;
+	};
 	Configuration();
 	virtual ~Configuration();
 
@@ -81,6 +170,8 @@ public:
 	void registerPrometheus();
 
 	std::vector<std::shared_ptr<Application>> getApps() const;
+	// applications matched by query, total is the number before offset and limit
+	std::vector<std::shared_ptr<Application>> getApps(const AppQuery& query, size_t& total) const;
 	std::shared_ptr<Application> addApp(const web::json::value& jsonApp);
 	void removeApp(const std::string& appName);
 	std::shared_ptr<Application> parseApp(const web::json::value& jsonApp);
@@ -98,6 +189,9 @@ public:
 	void enableApp(const std::string& appName);
 
 	std::shared_ptr<Label> getLabel() { return m_label; }
+	// Version of views, increased when the content changed, used as ETag
+	unsigned long long getConfigVersion() const { return m_configVersion; }
+	unsigned long long getAppsVersion();
 
 	const std::string getLogLevel() const;
 	bool getSslEnabled() const;
@@ -105,6 +199,8 @@ public:
 	std::string getSSLCertificateFile() const;
 	std::string getSSLCertificateKeyFile() const;
 	bool getRestEnabled() const;
+	std::string getLocalSocketPath() const;
+	std::map<std::string, std::string> getLocalSocketPeers() const;
 	bool getJwtEnabled() const;
 	const size_t getThreadPoolSize() const;
 	const std::string getDescription() const { return m_hostDescription; }
@@ -115,6 +211,9 @@ public:
 	const std::shared_ptr<Users> getUsers();
 	const std::shared_ptr<Roles> getRoles();
 	const std::shared_ptr<Configuration::JsonConsul> getConsul() const;
+	const std::shared_ptr<Configuration::JsonPressure> getPressure() const;
+	const std::shared_ptr<Configuration::JsonRateLimit> getRateLimit() const;
+	const std::shared_ptr<Configuration::JsonRunPool> getRunPool() const;
 	const std::shared_ptr<Configuration::JsonSecurity> getSecurity();
 	void updateSecurity(std::shared_ptr<Configuration::JsonSecurity> security);
 
@@ -122,6 +221,8 @@ public:
 
 private:
 		void addApp2Map(std::shared_ptr<Application> app);
+		// application added, replaced or removed
+		void bumpAppsVersion();
 
 private:
 	std::vector<std::shared_ptr<Application>> m_apps;
@@ -130,13 +231,27 @@ private:
 	std::shared_ptr<JsonRest> m_rest;
 	std::shared_ptr<JsonSecurity> m_security;
 	std::shared_ptr<JsonConsul> m_consul;
+	std::shared_ptr<JsonPressure> m_pressure;
+	std::shared_ptr<JsonRateLimit> m_rateLimit;
+	std::shared_ptr<JsonRunPool> m_runPool;
 	
 	std::string m_logLevel;
 
 	mutable std::recursive_mutex m_mutex;
+	// serialize application add/remove/enable/disable, held by Transaction
+	std::recursive_mutex m_appsChangeMutex;
 	std::string m_jsonFilePath;
 
 	std::shared_ptr<Label> m_label;
 
+	// saveConfigToDisk is deferred while transaction is open
+	int m_transactionDepth;
+	bool m_persistPending;
+
+	std::atomic<unsigned long long> m_configVersion;
+	unsigned long long m_appsVersion;
+	std::size_t m_appsFingerprint;
+	std::mutex m_appsVersionMutex;
+
 	static std::shared_ptr<Configuration> m_instance;
 };
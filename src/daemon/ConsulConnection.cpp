@@ -6,6 +6,7 @@
 #include "Application.h"
 #include "Configuration.h"
 #include "ConsulConnection.h"
+#include "EventBus.h"
 #include "ResourceCollection.h"
 #include "User.h"
 
@@ -341,6 +342,9 @@ void ConsulConnection::watchTopology()
 	const static char fname[] = "ConsulConnection::watchTopology() ";
 
 	auto currentAllApps = Configuration::instance()->getApps();
+	auto added = web::json::value::array();
+	auto updated = web::json::value::array();
+	auto removed = web::json::value::array();
 	std::shared_ptr<ConsulTopology> newTopology;
 	auto topology = retrieveTopology(MY_HOST_NAME);
 	auto hostTopologyIt = topology.find(MY_HOST_NAME);
@@ -367,6 +371,7 @@ void ConsulConnection::watchTopology()
 					{
 						Configuration::instance()->addApp(topologyAppObj->AsJson(false));
 						LOG_INF << fname << " Consul application <" << topologyAppObj->getName() << "> updated";
+						updated[updated.size()] = web::json::value::string(appName);
 
 						registerService(appName, consulTask->m_consulServicePort);
 					}
@@ -376,6 +381,7 @@ void ConsulConnection::watchTopology()
 					// New add app
 					Configuration::instance()->addApp(topologyAppObj->AsJson(false));
 					LOG_INF << fname << " Consul application <" << topologyAppObj->getName() << "> added";
+					added[added.size()] = web::json::value::string(appName);
 
 					registerService(appName, consulTask->m_consulServicePort);
 				}
@@ -391,6 +397,7 @@ void ConsulConnection::watchTopology()
 					// Remove no used topology
 					Configuration::instance()->removeApp(currentApp->getName());
 					LOG_INF << fname << " Consul application <" << currentApp->getName() << "> removed";
+					removed[removed.size()] = web::json::value::string(currentApp->getName());
 					deregisterService(currentApp->getName());
 				}
 			}
@@ -406,10 +413,19 @@ void ConsulConnection::watchTopology()
 				// Remove no used topology
 				Configuration::instance()->removeApp(currentApp->getName());
 				LOG_INF << fname << " Consul application <" << currentApp->getName() << "> removed";
+				removed[removed.size()] = web::json::value::string(currentApp->getName());
 				deregisterService(currentApp->getName());
 			}
 		}
 	}
+	if (added.size() || updated.size() || removed.size())
+	{
+		auto data = web::json::value::object();
+		data[JSON_KEY_EVENT_added] = added;
+		data[JSON_KEY_EVENT_updated] = updated;
+		data[JSON_KEY_EVENT_removed] = removed;
+		EventBus::instance()->publish(EVENT_TYPE_consul_topology, "", data);
+	}
 }
 
 bool ConsulConnection::eletionLeader()
@@ -423,6 +439,7 @@ bool ConsulConnection::eletionLeader()
 	auto body = web::json::value::string(MY_HOST_NAME);
 	auto timestamp = std::to_string(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
 	auto resp = requestHttp(web::http::methods::PUT, path, { {"acquire", sessionId}, {"flags", timestamp} }, {}, &body);
+	const bool leader = m_leader;
 	if (resp.status_code() == web::http::status_codes::OK)
 	{
 		auto result = resp.extract_utf8string(true).get();
@@ -432,6 +449,12 @@ bool ConsulConnection::eletionLeader()
 	{
 		m_leader = false;
 	}
+	if (leader != m_leader)
+	{
+		auto data = web::json::value::object();
+		data[JSON_KEY_EVENT_leader] = web::json::value::boolean(m_leader);
+		EventBus::instance()->publish(EVENT_TYPE_consul_leader, "", data);
+	}
 	return m_leader;
 }
 
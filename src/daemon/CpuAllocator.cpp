@@ -0,0 +1,196 @@
+#include "CpuAllocator.h"
+#include "ResourceLimitation.h"
+#include "../common/Utility.h"
+#include "../common/os/linux.hpp"
+
+CpuAllocator::CpuAllocator()
+	:m_numa(false), m_topologyRetrieved(false)
+{
+}
+
+CpuAllocator::~CpuAllocator()
+{
+}
+
+std::shared_ptr<CpuAllocator>& CpuAllocator::instance()
+{
+	static auto singleton = std::make_shared<CpuAllocator>();
+	return singleton;
+}
+
+void CpuAllocator::retrieveTopology()
+{
+	const static char fname[] = "CpuAllocator::retrieveTopology() ";
+
+	if (m_topologyRetrieved) return;
+	m_topologyRetrieved = true;
+
+	auto cpus = os::cpus();
+	m_nodeCpus = os::numaNodes();
+	m_numa = !m_nodeCpus.empty();
+	if (!m_numa)
+	{
+		// NUMA not exposed, use socket as placement domain
+		for (const auto& cpu : cpus) m_nodeCpus[cpu.socket].insert(cpu.id);
+	}
+	for (const auto& node : m_nodeCpus)
+	{
+		for (auto cpu : node.second) m_cpuNode[cpu] = node.first;
+	}
+	for (const auto& cpu : cpus)
+	{
+		m_cpuCore[cpu.id] = ((long long)cpu.socket << 32) + cpu.core;
+	}
+	LOG_INF << fname << "NUMA:" << m_numa << " domains:" << m_nodeCpus.size() << " cpus:" << m_cpuNode.size();
+}
+
+std::set<int> CpuAllocator::allocatedCpus(const std::string& exceptApp) const
+{
+	std::set<int> result;
+	for (const auto& placement : m_placements)
+	{
+		if (placement.first == exceptApp) continue;
+		result.insert(placement.second.cpus.begin(), placement.second.cpus.end());
+	}
+	return result;
+}
+
+bool CpuAllocator::place(const std::shared_ptr<ResourceLimitation>& limit, std::set<int>& cpus, std::set<int>& mems)
+{
+	const static char fname[] = "CpuAllocator::place() ";
+
+	cpus.clear();
+	mems.clear();
+	if (limit == nullptr) return false;
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	const auto& appName = limit->m_name;
+	const auto request = limit->m_cpuSet + "/" + std::to_string(limit->m_cpuCores) + "/" + limit->m_memNodes;
+	auto iter = m_placements.find(appName);
+	if (iter != m_placements.end())
+	{
+		if (iter->second.request == request)
+		{
+			cpus = iter->second.cpus;
+			mems = iter->second.mems;
+			return true;
+		}
+		m_placements.erase(iter);
+	}
+	m_conflicts.erase(appName);
+	if (limit->m_cpuSet.empty() && limit->m_cpuCores <= 0 && limit->m_memNodes.empty()) return false;
+
+	retrieveTopology();
+	Placement placement;
+	placement.request = request;
+	if (limit->m_cpuSet.length())
+	{
+		std::set<int> requested;
+		os::parseCpuList(limit->m_cpuSet, requested);
+		auto allocated = allocatedCpus(appName);
+		std::set<int> conflicts;
+		for (auto cpu : requested)
+		{
+			if (m_cpuNode.count(cpu) == 0)
+			{
+				LOG_WAR << fname << "Application <" << appName << "> request CPU <" << cpu << "> not exist on this host, ignored";
+				continue;
+			}
+			if (allocated.count(cpu)) conflicts.insert(cpu);
+			placement.cpus.insert(cpu);
+		}
+		if (conflicts.size())
+		{
+			// placement is exclusive, run without pinning and report in runtime info
+			m_conflicts[appName] = std::string("CPU <") + os::formatCpuList(conflicts) + "> reserved by other application";
+			LOG_ERR << fname << "Application <" << appName << "> cpu_set rejected: " << m_conflicts[appName];
+			return false;
+		}
+	}
+	else if (limit->m_cpuCores > 0)
+	{
+		// best fit: the domain with least free cpus that still satisfy the request
+		auto allocated = allocatedCpus(appName);
+		int selectedNode = -1;
+		std::vector<int> selectedFree;
+		for (const auto& node : m_nodeCpus)
+		{
+			std::vector<int> freeCpus;
+			for (auto cpu : node.second)
+			{
+				if (allocated.count(cpu) == 0) freeCpus.push_back(cpu);
+			}
+			if (freeCpus.size() >= (size_t)limit->m_cpuCores && (selectedNode < 0 || freeCpus.size() < selectedFree.size()))
+			{
+				selectedNode = node.first;
+				selectedFree = freeCpus;
+			}
+		}
+		if (selectedNode < 0)
+		{
+			LOG_WAR << fname << "No NUMA node have <" << limit->m_cpuCores << "> free CPUs for application <" << appName << ">, run without CPU pinning";
+			return false;
+		}
+		// take one hardware thread per physical core first, then the siblings
+		std::set<long long> usedCores;
+		for (auto cpu : selectedFree)
+		{
+			if (placement.cpus.size() >= (size_t)limit->m_cpuCores) break;
+			if (usedCores.insert(m_cpuCore[cpu]).second) placement.cpus.insert(cpu);
+		}
+		for (auto cpu : selectedFree)
+		{
+			if (placement.cpus.size() >= (size_t)limit->m_cpuCores) break;
+			placement.cpus.insert(cpu);
+		}
+	}
+
+	if (limit->m_memNodes.length())
+	{
+		os::parseCpuList(limit->m_memNodes, placement.mems);
+	}
+	else if (m_numa)
+	{
+		// memory follow the cpus
+		for (auto cpu : placement.cpus) placement.mems.insert(m_cpuNode[cpu]);
+	}
+	if (placement.cpus.empty() && placement.mems.empty()) return false;
+
+	LOG_INF << fname << "Application <" << appName << "> placed on CPU <" << os::formatCpuList(placement.cpus)
+		<< "> memory node <" << os::formatCpuList(placement.mems) << ">";
+	cpus = placement.cpus;
+	mems = placement.mems;
+	m_placements[appName] = std::move(placement);
+	return true;
+}
+
+void CpuAllocator::release(const std::string& appName)
+{
+	const static char fname[] = "CpuAllocator::release() ";
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_conflicts.erase(appName);
+	if (m_placements.erase(appName))
+	{
+		LOG_DBG << fname << "Released placement for application <" << appName << ">";
+	}
+}
+
+web::json::value CpuAllocator::getPlacement(const std::string& appName)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto conflict = m_conflicts.find(appName);
+	if (conflict != m_conflicts.end())
+	{
+		web::json::value result = web::json::value::object();
+		result[JSON_KEY_RESOURCE_LIMITATION_placement_conflict] = web::json::value::string(conflict->second);
+		return result;
+	}
+	auto iter = m_placements.find(appName);
+	if (iter == m_placements.end()) return web::json::value::null();
+
+	web::json::value result = web::json::value::object();
+	result[JSON_KEY_RESOURCE_LIMITATION_placement_cpus] = web::json::value::string(GET_STRING_T(os::formatCpuList(iter->second.cpus)));
+	result[JSON_KEY_RESOURCE_LIMITATION_placement_mems] = web::json::value::string(GET_STRING_T(os::formatCpuList(iter->second.mems)));
+	return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cpprest/json.h>
+
+class ResourceLimitation;
+
+//////////////////////////////////////////////////////////////////////////
+/// Assign CPU and memory nodes for applications with CPU pinning request
+/// Automatic placement keeps all cores of one application on one NUMA node
+/// (socket if NUMA is not exposed) and never oversubscribes a CPU, explicit
+/// cpu_set is reserved as requested and rejected if it overlap another one.
+//////////////////////////////////////////////////////////////////////////
+class CpuAllocator
+{
+public:
+	CpuAllocator();
+	virtual ~CpuAllocator();
+	static std::shared_ptr<CpuAllocator>& instance();
+
+	// Resolve placement for the application of limit, the same request keep
+	// the same placement. Return false if no pinning should be applied.
+	bool place(const std::shared_ptr<ResourceLimitation>& limit, std::set<int>& cpus, std::set<int>& mems);
+	void release(const std::string& appName);
+	// placement json for application runtime info, null if not pinned,
+	// conflict message when the explicit cpu_set was rejected
+	web::json::value getPlacement(const std::string& appName);
+
+private:
+	void retrieveTopology();
+	std::set<int> allocatedCpus(const std::string& exceptApp) const;
+
+	struct Placement
+	{
+		std::string request;
+		std::set<int> cpus;
+		std::set<int> mems;
+	};
+
+	// node id -> cpu ids
+	std::map<int, std::set<int>> m_nodeCpus;
+	// cpu id -> node id
+	std::map<int, int> m_cpuNode;
+	// cpu id -> physical core key, used to spread on different cores first
+	std::map<int, long long> m_cpuCore;
+	bool m_numa;
+	bool m_topologyRetrieved;
+
+	std::map<std::string, Placement> m_placements;
+	// app name -> rejected cpu_set reason
+	std::map<std::string, std::string> m_conflicts;
+	std::recursive_mutex m_mutex;
+};
@@ -3,6 +3,8 @@
 #include "DockerProcess.h"
 #include "../common/Utility.h"
 #include "../common/os/pstree.hpp"
+#include "../common/os/linux.hpp"
+#include "CpuAllocator.h"
 #include "LinuxCgroup.h"
 #include "MonitoredProcess.h"
 #include "ResourceLimitation.h"
@@ -131,6 +133,23 @@ int DockerProcess::syncSpawnProcess(std::string cmd, std::string user, std::stri
 		{
 			dockerCommand.append(" --cpu-shares ").append(std::to_string(limit->m_cpuShares));
 		}
+		if (limit->m_cpuQuota > 0)
+		{
+			dockerCommand.append(" --cpus ").append(std::to_string(limit->m_cpuQuota));
+		}
+		for (const auto& io : limit->m_ioLimits)
+		{
+			if (io.m_readBps) dockerCommand.append(" --device-read-bps ").append(io.m_device).append(":").append(std::to_string(io.m_readBps));
+			if (io.m_writeBps) dockerCommand.append(" --device-write-bps ").append(io.m_device).append(":").append(std::to_string(io.m_writeBps));
+			if (io.m_readIops) dockerCommand.append(" --device-read-iops ").append(io.m_device).append(":").append(std::to_string(io.m_readIops));
+			if (io.m_writeIops) dockerCommand.append(" --device-write-iops ").append(io.m_device).append(":").append(std::to_string(io.m_writeIops));
+		}
+		std::set<int> cpus, mems;
+		if (CpuAllocator::instance()->place(limit, cpus, mems))
+		{
+			if (cpus.size()) dockerCommand.append(" --cpuset-cpus ").append(os::formatCpuList(cpus));
+			if (mems.size()) dockerCommand.append(" --cpuset-mems ").append(os::formatCpuList(mems));
+		}
 	}
 	dockerCommand += " " + m_dockerImage;
 	dockerCommand += " " + cmd;
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include "EventBus.h"
+#include "../common/Utility.h"
+
+namespace
+{
+	const char* EVENT_TYPES[] = {
+		EVENT_TYPE_app_added, EVENT_TYPE_app_updated, EVENT_TYPE_app_removed, EVENT_TYPE_app_enabled, EVENT_TYPE_app_disabled,
+		EVENT_TYPE_app_started, EVENT_TYPE_app_exited, EVENT_TYPE_app_health, EVENT_TYPE_config_updated, EVENT_TYPE_security_updated,
+		EVENT_TYPE_consul_leader, EVENT_TYPE_consul_topology
+	};
+}
+
+bool EventBus::Filter::match(const std::string& type, const std::string& app) const
+{
+	return (m_types.empty() || m_types.count(type)) && (m_apps.empty() || m_apps.count(app));
+}
+
+EventBus::EventBus()
+	:m_seq(0), m_dispatch(false), m_running(true)
+{
+	m_dispatchThread = std::make_unique<std::thread>(&EventBus::dispatchLoop, this);
+}
+
+EventBus::~EventBus()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_running = false;
+	}
+	m_cond.notify_all();
+	if (m_dispatchThread && m_dispatchThread->joinable()) m_dispatchThread->join();
+	for (auto& subscriber : m_subscribers) subscriber->m_buffer.close(std::ios_base::out).wait();
+}
+
+std::shared_ptr<EventBus>& EventBus::instance()
+{
+	static auto singleton = std::make_shared<EventBus>();
+	return singleton;
+}
+
+bool EventBus::isEventType(const std::string& type)
+{
+	return std::find(std::begin(EVENT_TYPES), std::end(EVENT_TYPES), type) != std::end(EVENT_TYPES);
+}
+
+void EventBus::publish(const std::string& type, const std::string& app, const web::json::value& data)
+{
+	auto event = std::make_shared<Event>();
+	event->m_type = type;
+	event->m_app = app;
+	auto json = web::json::value::object();
+	json[JSON_KEY_EVENT_type] = web::json::value::string(type);
+	if (app.length()) json[JSON_KEY_EVENT_app] = web::json::value::string(app);
+	json[JSON_KEY_EVENT_time] = web::json::value::string(Utility::convertTime2Str(std::chrono::system_clock::now()));
+	json[JSON_KEY_EVENT_data] = data;
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		event->m_seq = ++m_seq;
+		json[JSON_KEY_EVENT_id] = web::json::value::number(static_cast<uint64_t>(event->m_seq));
+		// serialized once for all subscribers
+		event->m_json = GET_STD_STRING(json.serialize());
+		m_events.push_back(event);
+		if (m_events.size() > DEFAULT_EVENT_LOG_SIZE) m_events.pop_front();
+		m_dispatch = true;
+	}
+	m_cond.notify_one();
+}
+
+concurrency::streams::istream EventBus::subscribe(const Filter& filter, bool sse, long long since, int timeoutSeconds)
+{
+	const static char fname[] = "EventBus::subscribe() ";
+
+	auto subscriber = std::make_shared<Subscriber>();
+	subscriber->m_filter = filter;
+	subscriber->m_sse = sse;
+	subscriber->m_lost = false;
+	const auto now = std::chrono::steady_clock::now();
+	subscriber->m_expire = now + std::chrono::seconds(timeoutSeconds);
+	subscriber->m_lastWrite = now;
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_subscribers.size() >= MAX_EVENT_SUBSCRIBERS) throw std::invalid_argument("too many event subscribers");
+		const auto oldest = m_events.empty() ? m_seq + 1 : m_events.front()->m_seq;
+		if (since < 0)
+		{
+			subscriber->m_lastSeq = m_seq;
+		}
+		else if (static_cast<unsigned long long>(since) > m_seq || static_cast<unsigned long long>(since) + 1 < oldest)
+		{
+			// sequence from a previous daemon process or already dropped from the log
+			subscriber->m_lost = true;
+			subscriber->m_lastSeq = oldest - 1;
+		}
+		else
+		{
+			subscriber->m_lastSeq = since;
+		}
+		m_subscribers.push_back(subscriber);
+		m_dispatch = true;
+		LOG_DBG << fname << "subscriber <" << m_subscribers.size() << "> from sequence <" << subscriber->m_lastSeq << ">";
+	}
+	m_cond.notify_one();
+	return subscriber->m_buffer.create_istream();
+}
+
+void EventBus::dispatchLoop()
+{
+	const static char fname[] = "EventBus::dispatchLoop() ";
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_running)
+	{
+		m_cond.wait_for(lock, std::chrono::seconds(1), [this]() { return !m_running || m_dispatch; });
+		if (!m_running) break;
+		m_dispatch = false;
+		const auto now = std::chrono::steady_clock::now();
+		for (auto iter = m_subscribers.begin(); iter != m_subscribers.end();)
+		{
+			bool keep = false;
+			try
+			{
+				keep = deliver(**iter, now);
+			}
+			catch (const std::exception& e)
+			{
+				LOG_WAR << fname << "deliver failed: " << e.what();
+			}
+			if (keep)
+			{
+				++iter;
+			}
+			else
+			{
+				(*iter)->m_buffer.close(std::ios_base::out).wait();
+				iter = m_subscribers.erase(iter);
+			}
+		}
+	}
+}
+
+bool EventBus::deliver(Subscriber& subscriber, const std::chrono::steady_clock::time_point& now)
+{
+	const static char fname[] = "EventBus::deliver() ";
+
+	if (now >= subscriber.m_expire) return false;
+	// body is not read by a slow or gone client
+	if (subscriber.m_buffer.in_avail() > MAX_EVENT_STREAM_PENDING_BYTES)
+	{
+		LOG_WAR << fname << "close subscriber not reading the stream";
+		return false;
+	}
+
+	const auto written = subscriber.m_lastWrite;
+	if (subscriber.m_lost)
+	{
+		subscriber.m_lost = false;
+		auto json = web::json::value::object();
+		json[JSON_KEY_EVENT_type] = web::json::value::string(EVENT_TYPE_events_lost);
+		json[JSON_KEY_EVENT_data] = web::json::value::object();
+		json[JSON_KEY_EVENT_data][JSON_KEY_EVENT_resume_from] = web::json::value::number(static_cast<uint64_t>(subscriber.m_lastSeq));
+		const auto data = GET_STD_STRING(json.serialize());
+		write(subscriber, subscriber.m_sse ? (std::string("event: ") + EVENT_TYPE_events_lost + "\ndata: " + data + "\n\n") : (data + "\n"));
+		subscriber.m_lastWrite = now;
+	}
+	if (!m_events.empty() && subscriber.m_lastSeq < m_seq)
+	{
+		// sequence is continuous in the log
+		const auto first = m_events.front()->m_seq;
+		const auto start = subscriber.m_lastSeq < first ? 0 : subscriber.m_lastSeq + 1 - first;
+		for (auto index = start; index < m_events.size(); index++)
+		{
+			const auto& event = m_events[index];
+			if (subscriber.m_filter.match(event->m_type, event->m_app))
+			{
+				if (subscriber.m_sse)
+				{
+					write(subscriber, std::string("id: ") + std::to_string(event->m_seq) + "\nevent: " + event->m_type + "\ndata: " + event->m_json + "\n\n");
+				}
+				else
+				{
+					write(subscriber, event->m_json + "\n");
+				}
+				subscriber.m_lastWrite = now;
+			}
+			subscriber.m_lastSeq = event->m_seq;
+		}
+	}
+	// keep proxies from closing an idle stream
+	if (written == subscriber.m_lastWrite && now - written >= std::chrono::seconds(DEFAULT_EVENT_HEARTBEAT_SECONDS))
+	{
+		write(subscriber, subscriber.m_sse ? ": heartbeat\n\n" : "\n");
+		subscriber.m_lastWrite = now;
+	}
+	return true;
+}
+
+void EventBus::write(Subscriber& subscriber, const std::string& data)
+{
+	subscriber.m_buffer.putn_nocopy(reinterpret_cast<const uint8_t*>(data.data()), data.length()).wait();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <cpprest/json.h>
+#include <cpprest/producerconsumerstream.h>
+
+#define EVENT_TYPE_app_added "app_added"
+#define EVENT_TYPE_app_updated "app_updated"
+#define EVENT_TYPE_app_removed "app_removed"
+#define EVENT_TYPE_app_enabled "app_enabled"
+#define EVENT_TYPE_app_disabled "app_disabled"
+#define EVENT_TYPE_app_started "app_started"
+#define EVENT_TYPE_app_exited "app_exited"
+#define EVENT_TYPE_app_health "app_health"
+#define EVENT_TYPE_config_updated "config_updated"
+#define EVENT_TYPE_security_updated "security_updated"
+#define EVENT_TYPE_consul_leader "consul_leader"
+#define EVENT_TYPE_consul_topology "consul_topology"
+// sent to a subscriber resumed from a sequence no longer in the log
+#define EVENT_TYPE_events_lost "events_lost"
+
+//////////////////////////////////////////////////////////////////////////
+/// In-process bus of application state change events
+/// Published events get a sequence number and are kept in a bounded log,
+/// a subscriber resume from any sequence still in the log. Subscribers are
+/// fed by one dispatch thread through the response body stream, so the
+/// publisher never wait a client and a stream does not hold a REST thread.
+//////////////////////////////////////////////////////////////////////////
+class EventBus
+{
+public:
+	// empty set match all
+	struct Filter
+	{
+		std::set<std::string> m_apps;
+		std::set<std::string> m_types;
+		bool match(const std::string& type, const std::string& app) const;
+	};
+
+	EventBus();
+	virtual ~EventBus();
+	static std::shared_ptr<EventBus>& instance();
+	static bool isEventType(const std::string& type);
+
+	void publish(const std::string& type, const std::string& app, const web::json::value& data = web::json::value::object());
+	// Stream of events after sequence since (negative for new events only) in SSE or NDJSON,
+	// closed after timeoutSeconds or when the client stop reading
+	concurrency::streams::istream subscribe(const Filter& filter, bool sse, long long since, int timeoutSeconds);
+
+private:
+	struct Event
+	{
+		unsigned long long m_seq;
+		std::string m_type;
+		std::string m_app;
+		std::string m_json;
+	};
+	struct Subscriber
+	{
+		Filter m_filter;
+		bool m_sse;
+		bool m_lost;
+		unsigned long long m_lastSeq;
+		std::chrono::steady_clock::time_point m_expire;
+		std::chrono::steady_clock::time_point m_lastWrite;
+		concurrency::streams::producer_consumer_buffer<uint8_t> m_buffer;
+	};
+	void dispatchLoop();
+	// Write pending events, false when the subscriber should be closed
+	bool deliver(Subscriber& subscriber, const std::chrono::steady_clock::time_point& now);
+	static void write(Subscriber& subscriber, const std::string& data);
+
+	std::deque<std::shared_ptr<Event>> m_events;
+	std::list<std::shared_ptr<Subscriber>> m_subscribers;
+	unsigned long long m_seq;
+	bool m_dispatch;
+	std::atomic<bool> m_running;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::unique_ptr<std::thread> m_dispatchThread;
+};
@@ -2,7 +2,11 @@
 #include "../common/Utility.h"
 #include "ResourceCollection.h"
 
+// shared by all Label objects, version keep increase when hot-update replace the object
+static std::atomic<unsigned long long> labelVersionSeq(0);
+
 Label::Label()
+	:m_version(++labelVersionSeq)
 {
 }
 
@@ -47,12 +51,14 @@ void Label::addLabel(const std::string& name, const std::string& value)
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	m_labels[name] = value;
+	m_version = ++labelVersionSeq;
 }
 
 void Label::delLabel(const std::string& name)
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	if (m_labels.count(name)) m_labels.erase(name);
+	m_version = ++labelVersionSeq;
 }
 
 bool Label::match(const std::shared_ptr<Label>& label) const
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <map>
 #include <memory>
@@ -23,9 +24,12 @@ public:
 	void delLabel(const std::string& name);
 
 	bool match(const std::shared_ptr<Label>& label) const;
+	// increase on each change, also for a new Label object
+	unsigned long long getVersion() const { return m_version; }
 
 private:
 	std::map<std::string, std::string> m_labels;
+	std::atomic<unsigned long long> m_version;
 	mutable std::recursive_mutex m_mutex;
 
 };
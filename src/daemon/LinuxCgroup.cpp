@@ -1,86 +1,422 @@
 #include "LinuxCgroup.h"
 #include <cstring>
+#include <fcntl.h>
 #include <mntent.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <ace/Event_Handler.h>
+#include <ace/Reactor.h>
 #include "../common/Utility.h"
+#include "../common/os/linux.hpp"
+
+//////////////////////////////////////////////////////////////////////////
+/// Event callback shared by the cgroup and its reactor handlers, the handler
+/// may still be dispatched after the cgroup is destroyed on another thread
+//////////////////////////////////////////////////////////////////////////
+struct CgroupEventSink
+{
+	void notify(const std::string& event)
+	{
+		std::function<void(const std::string&)> handler;
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			handler = m_handler;
+		}
+		if (handler) handler(event);
+	}
+	void reset(const std::function<void(const std::string&)>& handler)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_handler = handler;
+	}
+
+private:
+	std::function<void(const std::string&)> m_handler;
+	std::mutex m_mutex;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// cgroup v1 notification eventfd watched by reactor
+//////////////////////////////////////////////////////////////////////////
+class CgroupEventHandler : public ACE_Event_Handler
+{
+public:
+	CgroupEventHandler(const std::string& event, int eventFd, int controlFd, const std::string& usageFile, long long threshold,
+		const std::shared_ptr<CgroupEventSink>& sink)
+		:m_event(event), m_eventFd(eventFd), m_controlFd(controlFd), m_usageFile(usageFile), m_threshold(threshold), m_sink(sink)
+	{
+	}
+	virtual ~CgroupEventHandler()
+	{
+		close(m_eventFd);
+		close(m_controlFd);
+	}
+	virtual ACE_HANDLE get_handle() const override { return m_eventFd; }
+	virtual int handle_input(ACE_HANDLE fd) override
+	{
+		uint64_t count = 0;
+		if (read(m_eventFd, &count, sizeof(count)) != sizeof(count)) return 0;
+		// threshold event is notified for both directions, only report the rising one
+		if (m_threshold > 0)
+		{
+			auto usage = Utility::stdStringTrim(Utility::readFileCpp(m_usageFile));
+			if (!Utility::isNumber(usage) || std::stoll(usage) < m_threshold) return 0;
+		}
+		m_sink->notify(m_event);
+		return 0;
+	}
+	virtual int handle_close(ACE_HANDLE handle, ACE_Reactor_Mask mask) override
+	{
+		delete this;
+		return 0;
+	}
+
+private:
+	const std::string m_event;
+	const int m_eventFd;
+	const int m_controlFd;
+	const std::string m_usageFile;
+	const long long m_threshold;
+	const std::shared_ptr<CgroupEventSink> m_sink;
+};
 
 
 std::string LinuxCgroup::cgroupMemRootName;
 std::string LinuxCgroup::cgroupCpuRootName;
+std::string LinuxCgroup::cgroupCpusetRootName;
+std::string LinuxCgroup::cgroupBlkioRootName;
+bool LinuxCgroup::swapLimitSupport = true;
+const long long LinuxCgroup::cpuCfsPeriodUs = 100000;
 const std::string LinuxCgroup::cgroupBaseDir = "/appmanager";
-LinuxCgroup::LinuxCgroup(long long memLimitBytes, long long memSwapBytes, long long cpuShares)
-	:m_memLimitMb(memLimitBytes), m_memSwapMb(memSwapBytes), m_cpuShares(cpuShares), m_pid(0), cgroupEnabled(false)
+std::map<std::string, std::shared_ptr<LinuxCgroup>> LinuxCgroup::cgroups;
+std::mutex LinuxCgroup::cgroupsMutex;
+
+LinuxCgroup::LinuxCgroup(const std::string& appName)
+	:m_appName(appName), m_memLimitMb(0), m_oomHandler(nullptr), m_highHandler(nullptr), m_highThreshold(0), m_eventSink(std::make_shared<CgroupEventSink>())
+{
+	if (cgroupMemRootName.length()) cgroupMemoryPath = cgroupMemRootName + "/" + appName;
+	if (cgroupCpuRootName.length()) cgroupCpuPath = cgroupCpuRootName + "/" + appName;
+	if (cgroupCpusetRootName.length()) cgroupCpusetPath = cgroupCpusetRootName + "/" + appName;
+	if (cgroupBlkioRootName.length()) cgroupBlkioPath = cgroupBlkioRootName + "/" + appName;
+}
+
+LinuxCgroup::~LinuxCgroup()
 {
-	const static char fname[] = "LinuxCgroup::LinuxCgroup() ";
+	// handler delete itself in handle_close, unregister before remove the cgroup,
+	// a handler already dispatched by reactor see an empty sink
+	m_eventSink->reset(nullptr);
+	unregisterEvent(m_oomHandler);
+	unregisterEvent(m_highHandler);
 
-	if (m_memLimitMb > 0 && m_memLimitMb < 4)
 	{
-		m_memLimitMb = 4;
-		LOG_WAR << fname << "memory_mb should not less than 4M";
+		// the same application registered again, the directories are reused
+		std::lock_guard<std::mutex> guard(cgroupsMutex);
+		if (cgroups.count(m_appName)) return;
 	}
-	// It is important to set the "memory.limit_in_bytes" before setting the "memory.memsw.limit_in_bytes"
-	if (m_memLimitMb == 0 && m_memSwapMb > 0)
+	if (cgroupMemoryPath.length() && Utility::isDirExist(cgroupMemoryPath))
 	{
-		m_memLimitMb = m_memSwapMb;
-		LOG_WAR << fname << "m_memLimitMb is setting to m_memSwapMb";
+		writeFile(cgroupMemoryPath + "/" + "memory.force_empty", 0);
+		Utility::removeDir(cgroupMemoryPath);
 	}
-	cgroupEnabled = (m_memLimitMb > 0 || m_memSwapMb > 0 || m_cpuShares > 0);
+	if (cgroupCpuPath.length()) Utility::removeDir(cgroupCpuPath);
+	if (cgroupCpusetPath.length()) Utility::removeDir(cgroupCpusetPath);
+	if (cgroupBlkioPath.length()) Utility::removeDir(cgroupBlkioPath);
+}
+
+std::shared_ptr<LinuxCgroup> LinuxCgroup::getCgroup(const std::string& appName)
+{
+	const static char fname[] = "LinuxCgroup::getCgroup() ";
 
+	std::lock_guard<std::mutex> guard(cgroupsMutex);
 	// Only need retrieve once for all
 	static bool retrieved = false;
-	static bool swapLimitSupport = true;
-	if (cgroupEnabled && !retrieved)
+	if (!retrieved)
 	{
 		retrieved = true;
 		retrieveCgroupHeirarchy();
 		// Check whether swap limit is enabled for OS, by default, Ubuntu does not enable swap limit
-		if (m_memSwapMb > 0 && !Utility::isFileExist(cgroupMemRootName + "/memory.memsw.limit_in_bytes"))
+		if (!Utility::isFileExist(cgroupMemRootName + "/memory.memsw.limit_in_bytes"))
 		{
 			LOG_WAR << fname << "Your kernel does not support swap limit capabilities or the cgroup is not mounted.";
 			swapLimitSupport = false;
 		}
-		cgroupMemRootName += cgroupBaseDir;
-		cgroupCpuRootName += cgroupBaseDir;
+		for (auto root : { &cgroupMemRootName, &cgroupCpuRootName, &cgroupCpusetRootName, &cgroupBlkioRootName })
+		{
+			if (root->empty()) continue;
+			*root += cgroupBaseDir;
+			// directories left by previous daemon run
+			cleanStaleCgroup(*root);
+		}
 	}
-	if (!swapLimitSupport) { m_memSwapMb = 0; }
+	auto& cgroup = cgroups[appName];
+	if (cgroup == nullptr) cgroup = std::make_shared<LinuxCgroup>(appName);
+	return cgroup;
 }
 
-LinuxCgroup::~LinuxCgroup()
+void LinuxCgroup::removeCgroup(const std::string& appName)
 {
-	if (cgroupEnabled)
+	std::shared_ptr<LinuxCgroup> removed;
 	{
-		std::string force_empty_file = cgroupMemoryPath + "/" + "memory.force_empty";
-		if (Utility::isDirExist(cgroupMemoryPath))
+		std::lock_guard<std::mutex> guard(cgroupsMutex);
+		auto iter = cgroups.find(appName);
+		if (iter == cgroups.end()) return;
+		removed = iter->second;
+		cgroups.erase(iter);
+	}
+	// directories are removed here if no process refer to it
+}
+
+void LinuxCgroup::cleanStaleCgroup(const std::string& root)
+{
+	const static char fname[] = "LinuxCgroup::cleanStaleCgroup() ";
+
+	// <root>/<app>/<index> for old layout, <root>/<app> for current layout,
+	// rmdir fails for cgroup still have process, keep them.
+	if (!Utility::isDirExist(root)) return;
+	size_t removed = 0;
+	for (const auto& app : os::ls(root))
+	{
+		auto appPath = root + "/" + app;
+		if (!Utility::isDirExist(appPath)) continue;
+		for (const auto& sub : os::ls(appPath))
 		{
-			writeFile(force_empty_file, 0);
+			auto subPath = appPath + "/" + sub;
+			if (Utility::isDirExist(subPath) && rmdir(subPath.c_str()) == 0) removed++;
 		}
+		if (rmdir(appPath.c_str()) == 0) removed++;
+	}
+	if (removed) LOG_INF << fname << "Removed <" << removed << "> stale cgroup directories from " << root;
+}
 
-		Utility::removeDir(cgroupMemoryPath);
-		Utility::removeDir(cgroupCpuPath);
+bool LinuxCgroup::prepareDir(const std::string& cgroupPath)
+{
+	if (cgroupPath.empty()) return false;
+	if (Utility::isDirExist(cgroupPath)) return true;
+	// directory (re)created, forget the written values
+	for (auto iter = m_values.begin(); iter != m_values.end();)
+	{
+		if (iter->second.file.find(cgroupPath + "/") == 0) iter = m_values.erase(iter);
+		else ++iter;
 	}
+	if (cgroupPath == cgroupCpusetPath)
+	{
+		initCpusetDir(cgroupPath);
+		return Utility::isDirExist(cgroupPath);
+	}
+	return Utility::createRecursiveDirectory(cgroupPath, 0711);
 }
 
-void LinuxCgroup::setCgroup(const std::string& appName, int pid, int index)
+void LinuxCgroup::setValue(const std::string& key, const std::string& file, const std::string& value, const std::string& resetValue)
 {
-	if (!cgroupEnabled) return;
+	m_desiredValues.insert(key);
+	auto iter = m_values.find(key);
+	if (iter != m_values.end() && iter->second.value == value) return;
+	if (writeFile(file, value))
+	{
+		m_values[key] = { file, value, resetValue };
+	}
+}
 
-	m_pid = pid;
-	cgroupMemoryPath = cgroupMemRootName + "/" + appName + "/" + std::to_string(index);
-	cgroupCpuPath = cgroupCpuRootName + "/" + appName + "/" + std::to_string(index);
+void LinuxCgroup::setLimit(long long memLimitMb, long long memSwapMb, long long cpuShares, double cpuQuota,
+	const std::list<DeviceIoLimit>& ioLimits, const std::string& cpusetCpus, const std::string& cpusetMems)
+{
+	const static char fname[] = "LinuxCgroup::setLimit() ";
 
-	if (m_memLimitMb > 0 && Utility::createRecursiveDirectory(cgroupMemoryPath, 0711))
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (memLimitMb > 0 && memLimitMb < 4)
 	{
-		this->setPhysicalMemory(cgroupMemoryPath, m_memLimitMb * 1024 * 1024);
+		memLimitMb = 4;
+		LOG_WAR << fname << "memory_mb should not less than 4M";
 	}
+	// It is important to set the "memory.limit_in_bytes" before setting the "memory.memsw.limit_in_bytes"
+	if (memLimitMb == 0 && memSwapMb > 0)
+	{
+		memLimitMb = memSwapMb;
+		LOG_WAR << fname << "m_memLimitMb is setting to m_memSwapMb";
+	}
+	if (!swapLimitSupport) memSwapMb = 0;
+	long long cpuQuotaUs = (long long)(cpuQuota * cpuCfsPeriodUs);
+	// kernel minimal cfs quota is 1ms
+	if (cpuQuotaUs > 0 && cpuQuotaUs < 1000)
+	{
+		cpuQuotaUs = 1000;
+		LOG_WAR << fname << "cpu_quota should not less than 0.01 CPU";
+	}
+
+	m_desiredValues.clear();
+	m_activePaths.clear();
+	m_memLimitMb = memLimitMb;
 
-	if (m_memSwapMb > 0 && Utility::createRecursiveDirectory(cgroupMemoryPath, 0711))
+	if (memLimitMb > 0 && prepareDir(cgroupMemoryPath))
 	{
-		this->setSwapMemory(cgroupMemoryPath, m_memSwapMb * 1024 * 1024);
+		m_activePaths.insert(cgroupMemoryPath);
+		auto limitFile = cgroupMemoryPath + "/" + "memory.limit_in_bytes";
+		auto swapFile = cgroupMemoryPath + "/" + "memory.memsw.limit_in_bytes";
+		const auto swapBytes = memSwapMb * 1024 * 1024;
+		// memsw limit can not less than memory limit, raise memsw first when it increase
+		auto swapIter = m_values.find(swapFile);
+		bool swapFirst = swapBytes > 0 && swapIter != m_values.end() && std::stoll(swapIter->second.value) < swapBytes;
+		if (swapFirst) setValue(swapFile, swapFile, std::to_string(swapBytes), "-1");
+		setValue(limitFile, limitFile, std::to_string(memLimitMb * 1024 * 1024), "-1");
+		if (swapBytes > 0 && !swapFirst) setValue(swapFile, swapFile, std::to_string(swapBytes), "-1");
 	}
 
-	if (m_cpuShares > 0 && Utility::createRecursiveDirectory(cgroupCpuPath, 0711))
+	if ((cpuShares > 0 || cpuQuotaUs > 0) && prepareDir(cgroupCpuPath))
 	{
-		this->setCpuShares(cgroupCpuPath, m_cpuShares);
+		m_activePaths.insert(cgroupCpuPath);
+		auto file = cgroupCpuPath + "/" + "cpu.shares";
+		if (cpuShares > 0) setValue(file, file, std::to_string(cpuShares), "1024");
+		if (cpuQuotaUs > 0)
+		{
+			file = cgroupCpuPath + "/" + "cpu.cfs_period_us";
+			setValue(file, file, std::to_string(cpuCfsPeriodUs), std::to_string(cpuCfsPeriodUs));
+			file = cgroupCpuPath + "/" + "cpu.cfs_quota_us";
+			setValue(file, file, std::to_string(cpuQuotaUs), "-1");
+		}
+	}
+
+	if (ioLimits.size() && cgroupBlkioPath.empty())
+	{
+		LOG_WAR << fname << "blkio cgroup is not mounted, io_limit is ignored for " << m_appName;
 	}
+	else if (ioLimits.size() && prepareDir(cgroupBlkioPath))
+	{
+		m_activePaths.insert(cgroupBlkioPath);
+		for (const auto& io : ioLimits)
+		{
+			// throttle file use block device number "major:minor value"
+			struct stat st;
+			if (stat(io.m_device.c_str(), &st) != 0 || !S_ISBLK(st.st_mode))
+			{
+				LOG_WAR << fname << "<" << io.m_device << "> is not a block device, io_limit ignored";
+				continue;
+			}
+			auto devNum = std::to_string(major(st.st_rdev)) + ":" + std::to_string(minor(st.st_rdev));
+			const std::map<std::string, long long> throttles = {
+				{ "blkio.throttle.read_bps_device", io.m_readBps },
+				{ "blkio.throttle.write_bps_device", io.m_writeBps },
+				{ "blkio.throttle.read_iops_device", io.m_readIops },
+				{ "blkio.throttle.write_iops_device", io.m_writeIops } };
+			for (const auto& throttle : throttles)
+			{
+				if (throttle.second <= 0) continue;
+				auto file = cgroupBlkioPath + "/" + throttle.first;
+				setValue(file + " " + devNum, file, devNum + " " + std::to_string(throttle.second), devNum + " 0");
+			}
+		}
+	}
+
+	// CPU affinity is already set before exec, cpuset cgroup is used to bind memory nodes
+	if (cpusetMems.length() && cgroupCpusetPath.empty())
+	{
+		LOG_WAR << fname << "cpuset cgroup is not mounted, memory node binding is ignored for " << m_appName;
+	}
+	else if (cpusetMems.length() && prepareDir(cgroupCpusetPath))
+	{
+		m_activePaths.insert(cgroupCpusetPath);
+		// empty cpus means inherit all cpus from parent
+		auto file = cgroupCpusetPath + "/" + "cpuset.cpus";
+		auto parentCpus = Utility::stdStringTrim(Utility::readFileCpp(cgroupCpusetRootName + "/" + "cpuset.cpus"));
+		setValue(file, file, cpusetCpus.length() ? cpusetCpus : parentCpus, parentCpus);
+		file = cgroupCpusetPath + "/" + "cpuset.mems";
+		auto parentMems = Utility::stdStringTrim(Utility::readFileCpp(cgroupCpusetRootName + "/" + "cpuset.mems"));
+		setValue(file, file, cpusetMems, parentMems);
+	}
+
+	// reset the value no longer configured, reverse order make memsw reset before memory limit
+	std::list<std::string> resetKeys;
+	for (auto iter = m_values.rbegin(); iter != m_values.rend(); ++iter)
+	{
+		if (m_desiredValues.count(iter->first) == 0)
+		{
+			writeFile(iter->second.file, iter->second.resetValue);
+			resetKeys.push_back(iter->first);
+		}
+	}
+	for (const auto& key : resetKeys) m_values.erase(key);
+}
+
+void LinuxCgroup::attach(int pid)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	// cgroup.procs move all threads of the process with one write
+	for (const auto& path : m_activePaths)
+	{
+		writeFile(path + "/" + "cgroup.procs", pid);
+	}
+}
+
+void LinuxCgroup::registerMemoryEvent(long long memHighBytes, const std::function<void(const std::string&)>& handler)
+{
+	m_eventSink->reset(handler);
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	// only the app with memory limit have its own memory cgroup
+	if (m_memLimitMb <= 0 || m_activePaths.count(cgroupMemoryPath) == 0)
+	{
+		unregisterEvent(m_oomHandler);
+		unregisterEvent(m_highHandler);
+		m_oomHandler = m_highHandler = nullptr;
+		m_highThreshold = 0;
+		return;
+	}
+
+	if (m_oomHandler == nullptr)
+	{
+		registerEvent(CGROUP_MEMORY_EVENT_OOM, cgroupMemoryPath + "/" + "memory.oom_control", 0);
+	}
+	if (memHighBytes != m_highThreshold)
+	{
+		unregisterEvent(m_highHandler);
+		m_highHandler = nullptr;
+		m_highThreshold = 0;
+		if (memHighBytes > 0 && registerEvent(CGROUP_MEMORY_EVENT_HIGH, cgroupMemoryPath + "/" + "memory.usage_in_bytes", memHighBytes))
+		{
+			m_highThreshold = memHighBytes;
+		}
+	}
+}
+
+bool LinuxCgroup::registerEvent(const std::string& event, const std::string& controlFile, long long threshold)
+{
+	const static char fname[] = "LinuxCgroup::registerEvent() ";
+
+	int eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (eventFd < 0)
+	{
+		LOG_ERR << fname << "eventfd failed with error :" << std::strerror(errno);
+		return false;
+	}
+	int controlFd = open(controlFile.c_str(), O_RDONLY | O_CLOEXEC);
+	if (controlFd < 0)
+	{
+		LOG_ERR << fname << "Failed open file <" << controlFile << ">, error :" << std::strerror(errno);
+		close(eventFd);
+		return false;
+	}
+	// "<event_fd> <control_fd> [args]"
+	std::string registration = std::to_string(eventFd) + " " + std::to_string(controlFd);
+	if (threshold > 0) registration.append(" ").append(std::to_string(threshold));
+	writeFile(cgroupMemoryPath + "/" + "cgroup.event_control", registration);
+
+	auto eventHandler = new CgroupEventHandler(event, eventFd, controlFd, cgroupMemoryPath + "/" + "memory.usage_in_bytes", threshold,
+		m_eventSink);
+	if (ACE_Reactor::instance()->register_handler(eventHandler, ACE_Event_Handler::READ_MASK) != 0)
+	{
+		LOG_ERR << fname << "Failed register <" << event << "> event for <" << cgroupMemoryPath << ">";
+		delete eventHandler;
+		return false;
+	}
+	if (threshold > 0) m_highHandler = eventHandler;
+	else m_oomHandler = eventHandler;
+	LOG_DBG << fname << "Registered <" << event << "> event for <" << cgroupMemoryPath << ">";
+	return true;
+}
+
+void LinuxCgroup::unregisterEvent(CgroupEventHandler* handler)
+{
+	if (handler) ACE_Reactor::instance()->remove_handler(handler, ACE_Event_Handler::READ_MASK);
 }
 
 void LinuxCgroup::retrieveCgroupHeirarchy()
@@ -127,47 +463,56 @@ void LinuxCgroup::retrieveCgroupHeirarchy()
 			cgroupCpuRootName = cgroupCpuRootName.c_str();
 			LOG_DBG << fname << "Get cpu hierarchy dir : " << cgroupCpuRootName;
 		}
-	}
-	if (fp)	fclose(fp);
-}
-
-void LinuxCgroup::setPhysicalMemory(const std::string& cgroupPath, long long memLimitBytes)
-{
-	std::string specifiedHeirarchy = cgroupPath + "/" + "memory.limit_in_bytes";
-	writeFile(specifiedHeirarchy, memLimitBytes);
 
-	std::string tasksHeirarchy = cgroupPath + "/" + "tasks";
-	writeFile(tasksHeirarchy, m_pid);
-}
-
-void LinuxCgroup::setSwapMemory(const std::string& cgroupPath, long long memSwapBytes)
-{
-	std::string specifiedHeirarchy = cgroupPath + "/" + "memory.memsw.limit_in_bytes";
-	writeFile(specifiedHeirarchy, memSwapBytes);
+		if (hasmntopt(&entObj, "blkio") && hasmntopt(&entObj, "rw"))
+		{
+			// cgroup on /sys/fs/cgroup/blkio type cgroup (rw,nosuid,nodev,noexec,relatime,blkio)
+			cgroupBlkioRootName = entObj.mnt_dir;
+			LOG_DBG << fname << "Get blkio hierarchy dir : " << cgroupBlkioRootName;
+		}
 
-	std::string tasksHeirarchy = cgroupPath + "/" + "tasks";
-	writeFile(tasksHeirarchy, m_pid);
+		if (hasmntopt(&entObj, "cpuset") && hasmntopt(&entObj, "rw"))
+		{
+			// cgroup on /sys/fs/cgroup/cpuset type cgroup (rw,nosuid,nodev,noexec,relatime,cpuset)
+			cgroupCpusetRootName = entObj.mnt_dir;
+			LOG_DBG << fname << "Get cpuset hierarchy dir : " << cgroupCpusetRootName;
+		}
+	}
+	if (fp)	fclose(fp);
 }
 
-void LinuxCgroup::setCpuShares(const std::string& cgroupPath, long long cpuShares)
+void LinuxCgroup::initCpusetDir(const std::string& cgroupPath)
 {
-	std::string specifiedHeirarchy = cgroupPath + "/" + "cpu.shares";
-	writeFile(specifiedHeirarchy, cpuShares);
-
-	std::string tasksHeirarchy = cgroupPath + "/" + "tasks";
-	writeFile(tasksHeirarchy, m_pid);
+	// cpuset v1 require cpuset.cpus and cpuset.mems set before attach task,
+	// a new directory is created empty, so copy from parent level by level
+	auto root = cgroupCpusetRootName.substr(0, cgroupCpusetRootName.length() - cgroupBaseDir.length());
+	auto parent = root;
+	for (const auto& dir : Utility::splitString(cgroupPath.substr(root.length()), "/"))
+	{
+		auto path = parent + "/" + dir;
+		if (!Utility::isDirExist(path))
+		{
+			Utility::createDirectory(path, 0711);
+			writeFile(path + "/" + "cpuset.cpus", Utility::stdStringTrim(Utility::readFileCpp(parent + "/" + "cpuset.cpus")));
+			writeFile(path + "/" + "cpuset.mems", Utility::stdStringTrim(Utility::readFileCpp(parent + "/" + "cpuset.mems")));
+		}
+		parent = path;
+	}
 }
 
-void LinuxCgroup::writeFile(const std::string& cgroupPath, long long value)
+bool LinuxCgroup::writeFile(const std::string& cgroupPath, const std::string& value)
 {
 	const static char fname[] = "LinuxCgroup::writeFile() ";
 
+	bool result = false;
 	FILE* fp = fopen(cgroupPath.c_str(), "w+");
 	if (fp)
 	{
-		if (fprintf(fp, "%lld", value))
+		// cgroup file report error on flush
+		if (fprintf(fp, "%s", value.c_str()) >= 0 && fflush(fp) == 0)
 		{
 			LOG_DBG << fname << "Write <" << value << "> to file <" << cgroupPath << "> success.";
+			result = true;
 		}
 		else
 		{
@@ -179,4 +524,10 @@ void LinuxCgroup::writeFile(const std::string& cgroupPath, long long value)
 	{
 		LOG_ERR << fname << "Failed open file <" << cgroupPath << ">, error :" << std::strerror(errno);
 	}
+	return result;
+}
+
+bool LinuxCgroup::writeFile(const std::string& cgroupPath, long long value)
+{
+	return writeFile(cgroupPath, std::to_string(value));
 }
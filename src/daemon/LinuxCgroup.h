@@ -1,35 +1,91 @@
 #pragma once
 
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include "ResourceLimitation.h"
+
+#define CGROUP_MEMORY_EVENT_OOM "oom"
+#define CGROUP_MEMORY_EVENT_HIGH "memory_high"
+
+class CgroupEventHandler;
+struct CgroupEventSink;
 
 //////////////////////////////////////////////////////////////////////////
 /// Linux Cgroup Management interface
+/// One long-lived cgroup for each application: directories are created
+/// once, limits are written only when changed and new process is moved
+/// in with one write for each hierarchy.
 //////////////////////////////////////////////////////////////////////////
 class LinuxCgroup
 {
 public:
-	explicit LinuxCgroup(long long memLimitBytes, long long memSwapBytes, long long cpuShares);
+	explicit LinuxCgroup(const std::string& appName);
 	virtual ~LinuxCgroup();
-	void setCgroup(const std::string& appName, int pid, int index);
 
-private:
-	void retrieveCgroupHeirarchy();
-	void setPhysicalMemory(const std::string& cgroupPath, long long memLimitBytes);
-	void setSwapMemory(const std::string& cgroupPath, long long memSwapBytes);
-	void setCpuShares(const std::string& cgroupPath, long long cpuShares);
-	void writeFile(const std::string& cgroupPath, long long value);
+	// Get or create the cgroup of an application
+	static std::shared_ptr<LinuxCgroup> getCgroup(const std::string& appName);
+	// Application removed, the directories are removed when the last process released it
+	static void removeCgroup(const std::string& appName);
+
+	// Write limits, the value already written is skipped
+	void setLimit(long long memLimitMb, long long memSwapMb, long long cpuShares, double cpuQuota,
+		const std::list<DeviceIoLimit>& ioLimits, const std::string& cpusetCpus, const std::string& cpusetMems);
+	// Move process to the cgroup
+	void attach(int pid);
+	// Register OOM and memory threshold notification (cgroup v1 eventfd) on reactor,
+	// handler is called from reactor thread with CGROUP_MEMORY_EVENT_XXX
+	void registerMemoryEvent(long long memHighBytes, const std::function<void(const std::string&)>& handler);
 
 private:
-	long long m_memLimitMb;
-	long long m_memSwapMb;
-	long long m_cpuShares;
+	static void retrieveCgroupHeirarchy();
+	static void cleanStaleCgroup(const std::string& root);
+	bool prepareDir(const std::string& cgroupPath);
+	void initCpusetDir(const std::string& cgroupPath);
+	void setValue(const std::string& key, const std::string& file, const std::string& value, const std::string& resetValue);
+	bool registerEvent(const std::string& event, const std::string& controlFile, long long threshold);
+	void unregisterEvent(CgroupEventHandler* handler);
+	bool writeFile(const std::string& cgroupPath, long long value);
+	bool writeFile(const std::string& cgroupPath, const std::string& value);
 
-	int m_pid;
+private:
+	const std::string m_appName;
 	std::string cgroupMemoryPath;
 	std::string cgroupCpuPath;
-	bool cgroupEnabled;
+	std::string cgroupCpusetPath;
+	std::string cgroupBlkioPath;
+	// directories with limit written, process is attached to them
+	std::set<std::string> m_activePaths;
+	// written value, used to skip unchanged value and reset the value no longer configured
+	struct CgroupValue
+	{
+		std::string file;
+		std::string value;
+		std::string resetValue;
+	};
+	// key: file (and device for blkio)
+	std::map<std::string, CgroupValue> m_values;
+	std::set<std::string> m_desiredValues;
+	long long m_memLimitMb;
+
+	CgroupEventHandler* m_oomHandler;
+	CgroupEventHandler* m_highHandler;
+	long long m_highThreshold;
+	// shared with the reactor handlers, not bound to this
+	std::shared_ptr<CgroupEventSink> m_eventSink;
+	std::recursive_mutex m_mutex;
 
 	static std::string cgroupMemRootName;
 	static std::string cgroupCpuRootName;
+	static std::string cgroupCpusetRootName;
+	static std::string cgroupBlkioRootName;
+	static bool swapLimitSupport;
+	static const long long cpuCfsPeriodUs;
 	static const std::string cgroupBaseDir;
+	static std::map<std::string, std::shared_ptr<LinuxCgroup>> cgroups;
+	static std::mutex cgroupsMutex;
 };
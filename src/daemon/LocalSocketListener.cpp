@@ -0,0 +1,296 @@
+#include <cerrno>
+#include <cstring>
+#include <grp.h>
+#include <pwd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+#include "LocalSocketListener.h"
+#include "Configuration.h"
+#include "RestHandler.h"
+#include "TokenCache.h"
+#include "User.h"
+#include "../common/UnixHttpConnection.h"
+#include "../common/Utility.h"
+
+namespace
+{
+	// The only use of cpprest internals here: http_listener complete a received
+	// request this way, a request built from the socket need the same for
+	// extract_xxx() and remote_address().
+	void completeReceivedRequest(web::http::http_request& request, size_t bodySize, const std::string& remote)
+	{
+		request._get_impl()->_complete(bodySize);
+		request._get_impl()->_set_remote_address(remote);
+	}
+}
+
+LocalSocketListener::LocalSocketListener(const std::string& socketPath, const std::shared_ptr<RestHandler>& restHandler)
+	:m_socketPath(socketPath), m_restHandler(restHandler), m_listenFd(-1), m_running(false), m_connections(0), m_serveSeq(0)
+{
+	const static char fname[] = "LocalSocketListener::LocalSocketListener() ";
+
+	struct sockaddr_un addr;
+	if (socketPath.length() >= sizeof(addr.sun_path)) throw std::invalid_argument(std::string("local socket path too long : ") + socketPath);
+	// remove socket left by previous process
+	struct stat st;
+	if (::lstat(socketPath.c_str(), &st) == 0)
+	{
+		if (!S_ISSOCK(st.st_mode)) throw std::invalid_argument(std::string("local socket path exist and is not a socket : ") + socketPath);
+		::unlink(socketPath.c_str());
+	}
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+	m_listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_listenFd < 0) throw std::invalid_argument(std::string("create local socket failed : ") + std::strerror(errno));
+	if (::bind(m_listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+		// any local user can connect, the peer credential decide the identity
+		::chmod(socketPath.c_str(), 0666) != 0 ||
+		::listen(m_listenFd, SOMAXCONN) != 0)
+	{
+		auto error = std::string("listen local socket <") + socketPath + "> failed : " + std::strerror(errno);
+		::close(m_listenFd);
+		throw std::invalid_argument(error);
+	}
+	m_running = true;
+	m_acceptThread = std::make_unique<std::thread>(&LocalSocketListener::acceptLoop, this);
+	LOG_INF << fname << "Listening for requests at:" << socketPath;
+}
+
+LocalSocketListener::~LocalSocketListener()
+{
+	m_running = false;
+	// wake up accept()
+	::shutdown(m_listenFd, SHUT_RDWR);
+	if (m_acceptThread && m_acceptThread->joinable()) m_acceptThread->join();
+	::close(m_listenFd);
+	::unlink(m_socketPath.c_str());
+
+	// wake up the serve threads blocked on read or write
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> guard(m_servingMutex);
+		for (auto& serving : m_serving)
+		{
+			::shutdown(serving.second.m_connection->fd(), SHUT_RDWR);
+			threads.push_back(std::move(serving.second.m_thread));
+		}
+		m_serving.clear();
+		m_finished.clear();
+	}
+	for (auto& thread : threads)
+	{
+		if (thread.joinable()) thread.join();
+	}
+}
+
+void LocalSocketListener::joinFinished()
+{
+	std::vector<std::thread> threads;
+	{
+		std::lock_guard<std::mutex> guard(m_servingMutex);
+		for (auto serveId : m_finished)
+		{
+			auto iter = m_serving.find(serveId);
+			if (iter == m_serving.end()) continue;
+			threads.push_back(std::move(iter->second.m_thread));
+			m_serving.erase(iter);
+		}
+		m_finished.clear();
+	}
+	for (auto& thread : threads)
+	{
+		if (thread.joinable()) thread.join();
+	}
+}
+
+void LocalSocketListener::acceptLoop()
+{
+	const static char fname[] = "LocalSocketListener::acceptLoop() ";
+
+	while (m_running)
+	{
+		int fd = ::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+		joinFinished();
+		if (fd < 0)
+		{
+			if (!m_running) break;
+			if (errno == EINTR) continue;
+			LOG_ERR << fname << "accept failed with error: " << std::strerror(errno);
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			continue;
+		}
+		if (m_connections >= MAX_LOCAL_SOCKET_CONNECTIONS)
+		{
+			LOG_WAR << fname << "too many local connections, reject new one";
+			::close(fd);
+			continue;
+		}
+		// idle keep-alive connection and peer not reading the response are closed after timeout
+		struct timeval timeout = { DEFAULT_LOCAL_SOCKET_IDLE_TIMEOUT, 0 };
+		::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		m_connections++;
+		std::lock_guard<std::mutex> guard(m_servingMutex);
+		const auto serveId = ++m_serveSeq;
+		auto& serving = m_serving[serveId];
+		serving.m_connection = std::make_shared<UnixHttpConnection>(fd);
+		// the socket is open to any local user, request is bounded before authentication
+		serving.m_connection->setLimits(MAX_LOCAL_SOCKET_HEADER_SIZE, MAX_LOCAL_SOCKET_BODY_SIZE);
+		serving.m_thread = std::thread(&LocalSocketListener::serve, this, serveId, serving.m_connection);
+	}
+}
+
+void LocalSocketListener::serve(unsigned long long serveId, std::shared_ptr<UnixHttpConnection> connection)
+{
+	const static char fname[] = "LocalSocketListener::serve() ";
+
+	try
+	{
+		struct ucred cred;
+		socklen_t length = sizeof(cred);
+		if (::getsockopt(connection->fd(), SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0)
+		{
+			throw std::invalid_argument(std::string("get peer credential failed : ") + std::strerror(errno));
+		}
+		const auto peerUser = mapPeer(cred.uid, cred.gid);
+		const auto remote = std::string("unix:") + std::to_string(cred.uid) + ":" + std::to_string(cred.pid);
+		LOG_DBG << fname << "peer <" << remote << "> mapped to user <" << peerUser << ">";
+
+		std::string startLine;
+		web::http::http_headers headers;
+		std::vector<unsigned char> body;
+		while (m_running)
+		{
+			try
+			{
+				if (!connection->readMessage(startLine, headers, body, false)) break;
+			}
+			catch (const UnixHttpConnection::TooLarge& e)
+			{
+				// rest of the message is not read, the connection can not be reused
+				LOG_WAR << fname << "peer <" << remote << "> " << e.what();
+				web::http::http_response response(web::http::status_codes::RequestEntityTooLarge);
+				response.set_body(std::string(e.what()));
+				response.headers()[web::http::header_names::connection] = "close";
+				connection->writeMessage(std::string("HTTP/1.1 ") + std::to_string(response.status_code()) + " Request Entity Too Large",
+					response.headers(), response.body());
+				break;
+			}
+			// GET /appmgr/applications HTTP/1.1
+			auto first = startLine.find(' ');
+			auto last = startLine.rfind(' ');
+			if (first == std::string::npos || last <= first) throw std::invalid_argument(std::string("invalid request line : ") + startLine);
+			const auto method = startLine.substr(0, first);
+
+			web::http::http_request request(method);
+			request.set_request_uri(web::uri(startLine.substr(first + 1, last - first - 1)));
+			const auto bodySize = body.size();
+			if (bodySize) request.set_body(std::move(body));
+			for (const auto& header : headers) request.headers()[header.first] = header.second;
+			completeReceivedRequest(request, bodySize, remote);
+			const bool keepAlive = !headers.has(web::http::header_names::connection) ||
+				Utility::stdStringTrim(GET_STD_STRING(headers.find(web::http::header_names::connection)->second)) != "close";
+
+			// peer credential replace the JWT token when client provide no token or login user
+			if (Configuration::instance()->getJwtEnabled() &&
+				!request.headers().has(HTTP_HEADER_JWT_Authorization) && !request.headers().has(HTTP_HEADER_JWT_username))
+			{
+				try
+				{
+					if (peerUser.empty()) throw std::invalid_argument(std::string("Local peer uid <") + std::to_string(cred.uid) + "> is not mapped by LocalSocketPeers");
+					request.headers().add(HTTP_HEADER_JWT_Authorization, std::string(HTTP_HEADER_JWT_BearerSpace) + peerToken(peerUser));
+				}
+				catch (const std::exception& e)
+				{
+					request.reply(web::http::status_codes::Unauthorized, std::string(e.what()));
+				}
+			}
+			// handler run on another thread, a streamed body (replyJsonStream) wait for
+			// the client to read, so the response is written as soon as it is replied
+			if (!request.get_response().is_done())
+			{
+				auto restHandler = m_restHandler;
+				pplx::create_task([restHandler, request]() { restHandler->dispatch(request); });
+			}
+
+			auto response = request.get_response().get();
+			if (!keepAlive) response.headers()[web::http::header_names::connection] = "close";
+			const auto status = response.status_code();
+			connection->writeMessage(std::string("HTTP/1.1 ") + std::to_string(status) + " " + GET_STD_STRING(response.reason_phrase()),
+				response.headers(), response.body(),
+				method != "HEAD" && status != web::http::status_codes::NoContent && status != web::http::status_codes::NotModified);
+			if (!keepAlive) break;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		LOG_WAR << fname << e.what();
+	}
+	catch (...)
+	{
+		LOG_WAR << fname << "unknown exception";
+	}
+	m_connections--;
+	std::lock_guard<std::mutex> guard(m_servingMutex);
+	m_finished.push_back(serveId);
+}
+
+std::string LocalSocketListener::mapPeer(uid_t uid, gid_t gid) const
+{
+	const auto peers = Configuration::instance()->getLocalSocketPeers();
+	if (peers.empty()) return std::string();
+
+	static auto bufsize = sysconf(_SC_GETPW_R_SIZE_MAX);
+	if (bufsize == -1) bufsize = 16384;
+	std::vector<char> buffer(bufsize);
+	struct passwd pwd;
+	struct passwd* pwdResult = nullptr;
+	if (::getpwuid_r(uid, &pwd, buffer.data(), buffer.size(), &pwdResult) != 0 || pwdResult == nullptr) return std::string();
+	const std::string osUser = pwd.pw_name;
+	auto iter = peers.find(osUser);
+	if (iter != peers.end()) return iter->second;
+
+	// '@group', primary and supplementary groups
+	int count = 64;
+	std::vector<gid_t> groups(count);
+	if (::getgrouplist(osUser.c_str(), gid, groups.data(), &count) < 0)
+	{
+		groups.resize(count);
+		if (::getgrouplist(osUser.c_str(), gid, groups.data(), &count) < 0) count = 0;
+	}
+	groups.resize(count);
+	for (auto group : groups)
+	{
+		struct group grp;
+		struct group* grpResult = nullptr;
+		if (::getgrgid_r(group, &grp, buffer.data(), buffer.size(), &grpResult) != 0 || grpResult == nullptr) continue;
+		iter = peers.find(std::string("@") + grp.gr_name);
+		if (iter != peers.end()) return iter->second;
+	}
+	return std::string();
+}
+
+std::string LocalSocketListener::peerToken(const std::string& user)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	const auto now = std::chrono::system_clock::now();
+	const auto generation = TokenCache::instance()->generation();
+	auto iter = m_tokens.find(user);
+	if (iter != m_tokens.end() && now < iter->second.m_refresh && iter->second.m_generation == generation)
+	{
+		return iter->second.m_token;
+	}
+	// getUserInfo throw for unknown user
+	auto userObj = Configuration::instance()->getUserInfo(user);
+	auto& peerToken = m_tokens[user];
+	peerToken.m_token = m_restHandler->createToken(user, userObj->getKey(), DEFAULT_LOCAL_SOCKET_TOKEN_SECONDS);
+	peerToken.m_refresh = now + std::chrono::seconds(DEFAULT_LOCAL_SOCKET_TOKEN_SECONDS / 2);
+	peerToken.m_generation = generation;
+	return peerToken.m_token;
+}
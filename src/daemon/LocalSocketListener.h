@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+#include <cpprest/http_msg.h>
+
+class RestHandler;
+class UnixHttpConnection;
+
+//////////////////////////////////////////////////////////////////////////
+/// REST listener on a Unix domain socket for local clients
+/// No TLS handshake, each connection is served by its own thread and the
+/// requests are dispatched to RestHandler directly, the response is written
+/// while the handler is still producing a streamed body. The peer is identified
+/// by SO_PEERCRED, a peer mapped by LocalSocketPeers and without a JWT token
+/// is authenticated as the mapped appmgr user.
+//////////////////////////////////////////////////////////////////////////
+class LocalSocketListener
+{
+public:
+	explicit LocalSocketListener(const std::string& socketPath, const std::shared_ptr<RestHandler>& restHandler);
+	virtual ~LocalSocketListener();
+
+private:
+	void acceptLoop();
+	void serve(unsigned long long serveId, std::shared_ptr<UnixHttpConnection> connection);
+	// join the serve threads already returned
+	void joinFinished();
+	// appmgr user mapped to the peer, empty if not mapped
+	std::string mapPeer(uid_t uid, gid_t gid) const;
+	// token of the mapped user, minted again when expiring or security changed
+	std::string peerToken(const std::string& user);
+
+	const std::string m_socketPath;
+	const std::shared_ptr<RestHandler> m_restHandler;
+	int m_listenFd;
+	std::atomic<bool> m_running;
+	std::atomic<int> m_connections;
+	std::unique_ptr<std::thread> m_acceptThread;
+	struct Serving
+	{
+		std::shared_ptr<UnixHttpConnection> m_connection;
+		std::thread m_thread;
+	};
+	// serve id -> connection thread, joined when finished or on destruction
+	std::map<unsigned long long, Serving> m_serving;
+	std::vector<unsigned long long> m_finished;
+	unsigned long long m_serveSeq;
+	std::mutex m_servingMutex;
+
+	struct PeerToken
+	{
+		std::string m_token;
+		std::chrono::system_clock::time_point m_refresh;
+		unsigned long long m_generation;
+	};
+	std::map<std::string, PeerToken> m_tokens;
+	std::mutex m_mutex;
+};
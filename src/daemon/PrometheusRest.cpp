@@ -1,6 +1,6 @@
-#include <boost/algorithm/string_regex.hpp>
 #include "PrometheusRest.h"
 #include "../prom_exporter/counter.h"
+#include "../prom_exporter/histogram.h"
 #include "../prom_exporter/registry.h"
 #include "ResourceCollection.h"
 #include "../common/Utility.h"
@@ -13,7 +13,6 @@ PrometheusRest::PrometheusRest(std::string ipaddress, int port)
 {
 	const static char fname[] = "PrometheusRest::PrometheusRest() ";
 	m_promRegistry = std::make_shared<prometheus::Registry>();
-	initMetrics();
 
 	if (port)
 	{
@@ -40,8 +39,10 @@ PrometheusRest::PrometheusRest(std::string ipaddress, int port)
 
 		bindRestMethod(web::http::methods::GET, "/metrics", std::bind(&PrometheusRest::apiMetrics, this, std::placeholders::_1));
 
-		this->open();
+		// metrics are only created when enabled
 		m_promEnabled = true;
+		initMetrics();
+		this->open();
 		LOG_INF << fname << "Listening for requests at:" << uri.to_string();
 	}
 	else
@@ -96,14 +97,13 @@ void PrometheusRest::handle_options(const HttpRequest& message)
 	message.reply(status_codes::OK);
 }
 
-void PrometheusRest::handleRest(const http_request& message, const std::map<std::string, std::function<void(const HttpRequest&)>>& restFunctions)
+void PrometheusRest::handleRest(const http_request& message, const RestFunctions& restFunctions)
 {
 	static char fname[] = "PrometheusRest::handle_rest() ";
 
-	std::function<void(const HttpRequest&)> stdFunction;
 	auto path = Utility::stringReplace(GET_STD_STRING(message.relative_uri().path()), "//", "/");
 
-	const auto request = std::move(HttpRequest(message));
+	auto request = std::move(HttpRequest(message));
 
 	if (path == "/" || path.empty())
 	{
@@ -111,25 +111,18 @@ void PrometheusRest::handleRest(const http_request& message, const std::map<std:
 		return;
 	}
 
-	bool findRest = false;
-	for (const auto& kvp : restFunctions)
-	{
-		if (path == kvp.first || boost::regex_match(path, boost::regex(kvp.first)))
-		{
-			findRest = true;
-			stdFunction = kvp.second;
-			break;
-		}
-	}
-	if (!findRest)
+	auto stdFunction = restFunctions.match(path, request.m_pathParams);
+	if (stdFunction == nullptr)
 	{
 		request.reply(status_codes::NotFound, "Path not found");
 		return;
 	}
+	// /metrics is the only route
+	if (m_scrapeMetrics) m_scrapeMetrics->track(request);
 
 	try
 	{
-		stdFunction(request);
+		(*stdFunction)(request);
 	}
 	catch (const std::exception& e)
 	{
@@ -149,15 +142,15 @@ void PrometheusRest::bindRestMethod(web::http::method method, std::string path,
 
 	LOG_DBG << fname << "bind " << GET_STD_STRING(method).c_str() << " " << path;
 
-	// bind to map
+	// compile to route table
 	if (method == web::http::methods::GET)
-		m_restGetFunctions[path] = func;
+		m_restGetFunctions.addRoute(path, func);
 	else if (method == web::http::methods::PUT)
-		m_restPutFunctions[path] = func;
+		m_restPutFunctions.addRoute(path, func);
 	else if (method == web::http::methods::POST)
-		m_restPstFunctions[path] = func;
+		m_restPstFunctions.addRoute(path, func);
 	else if (method == web::http::methods::DEL)
-		m_restDelFunctions[path] = func;
+		m_restDelFunctions.addRoute(path, func);
 	else
 		LOG_ERR << fname << GET_STD_STRING(method).c_str() << " not supported.";
 }
@@ -195,6 +188,7 @@ void PrometheusRest::initMetrics()
 		{}
 	);
 	if (m_promGauge) m_promGauge->metric().Set(1);
+	m_scrapeMetrics = std::make_shared<RouteMetrics>(*this, std::map<std::string, std::string>{ {"method", "GET"}, {"route", "/metrics"} });
 }
 
 
@@ -211,6 +205,12 @@ std::shared_ptr<GaugePtr> PrometheusRest::createPromGauge(const std::string& met
 	return std::make_shared<GaugePtr>(m_promRegistry, metricName, metricHelp, labels);
 }
 
+std::shared_ptr<HistogramPtr> PrometheusRest::createPromHistogram(const std::string& metricName, const std::string& metricHelp, const std::map<std::string, std::string>& labels, const std::vector<double>& buckets)
+{
+	if (!m_promEnabled) return nullptr;
+	return std::make_shared<HistogramPtr>(m_promRegistry, metricName, metricHelp, labels, buckets);
+}
+
 const std::string PrometheusRest::collectData()
 {
 	// leave a static text serializer here
@@ -287,3 +287,98 @@ prometheus::Gauge& GaugePtr::metric()
 {
 	return *m_metric;
 }
+
+HistogramPtr::HistogramPtr(std::shared_ptr<prometheus::Registry> retistry, const std::string& name, const std::string& help, std::map<std::string, std::string> label, const std::vector<double>& buckets)
+	:m_metric(nullptr), m_family(nullptr), m_promRegistry(retistry), m_name(name), m_help(help), m_label(label)
+{
+	const static char fname[] = "HistogramPtr::HistogramPtr() ";
+
+	std::map<std::string, std::string> commonLabels = { {"host", MY_HOST_NAME}, {"pid", std::to_string(ResourceCollection::instance()->getPid())} };
+	commonLabels.insert(label.begin(), label.end());
+
+	auto& family = prometheus::BuildHistogram()
+		.Name(m_name)
+		.Help(help)
+		.Register(*m_promRegistry);
+	m_family = &family;
+	m_metric = &((family.Add(commonLabels, buckets)));
+
+	LOG_DBG << fname << "metric " << m_name << " added";
+}
+
+HistogramPtr::~HistogramPtr()
+{
+	const static char fname[] = "HistogramPtr::~HistogramPtr() ";
+	m_family->Remove(m_metric);
+	LOG_DBG << fname << "metric " << m_name << " removed";
+}
+
+prometheus::Histogram& HistogramPtr::metric()
+{
+	return *m_metric;
+}
+
+RouteMetrics::RouteMetrics(PrometheusRest& prom, const std::map<std::string, std::string>& labels)
+{
+	// seconds, from a cached GET to a slow sync run
+	static const std::vector<double> buckets = { 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30 };
+
+	m_latency = prom.createPromHistogram(
+		PROM_METRIC_NAME_appmgr_http_request_latency_seconds, PROM_METRIC_HELP_appmgr_http_request_latency_seconds,
+		labels, buckets
+	);
+	auto errorLabels = labels;
+	errorLabels["code"] = "4xx";
+	m_clientError = prom.createPromCounter(
+		PROM_METRIC_NAME_appmgr_http_request_error_count, PROM_METRIC_HELP_appmgr_http_request_error_count,
+		errorLabels
+	);
+	errorLabels["code"] = "5xx";
+	m_serverError = prom.createPromCounter(
+		PROM_METRIC_NAME_appmgr_http_request_error_count, PROM_METRIC_HELP_appmgr_http_request_error_count,
+		errorLabels
+	);
+	m_inflight = prom.createPromGauge(
+		PROM_METRIC_NAME_appmgr_http_request_inflight_gauge, PROM_METRIC_HELP_appmgr_http_request_inflight_gauge,
+		labels
+	);
+}
+
+RouteMetrics::~RouteMetrics()
+{
+}
+
+void RouteMetrics::track(const web::http::http_request& message)
+{
+	if (m_inflight) m_inflight->metric().Increment();
+	const auto start = std::chrono::steady_clock::now();
+	// get_response() complete when the handler (or any later thread) reply
+	std::weak_ptr<RouteMetrics> weakSelf = shared_from_this();
+	message.get_response().then([weakSelf, start](pplx::task<web::http::http_response> task)
+		{
+			web::http::status_code status = status_codes::InternalError;
+			try
+			{
+				status = task.get().status_code();
+			}
+			catch (...)
+			{
+			}
+			auto self = weakSelf.lock();
+			if (self) self->complete(start, status);
+		});
+}
+
+void RouteMetrics::complete(const std::chrono::steady_clock::time_point& start, web::http::status_code status)
+{
+	if (m_inflight) m_inflight->metric().Decrement();
+	if (m_latency) m_latency->metric().Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	if (status >= 500)
+	{
+		if (m_serverError) m_serverError->metric().Increment();
+	}
+	else if (status >= 400)
+	{
+		if (m_clientError) m_clientError->metric().Increment();
+	}
+}
@@ -1,16 +1,20 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
+#include <vector>
 #include <assert.h>
 #include <functional>
 #include <cpprest/http_listener.h> // HTTP server 
 #include "../common/HttpRequest.h"
+#include "../common/RestRouter.h"
 #include "../prom_exporter/family.h"
 
 namespace prometheus
 {
 	class Counter;
 	class Gauge;
+	class Histogram;
 	class Registry;
 };
 
@@ -66,6 +70,50 @@ private:
 	
 };
 
+class HistogramPtr
+{
+public:
+	explicit HistogramPtr(std::shared_ptr<prometheus::Registry> retistry,
+		const std::string& name, const std::string& help,
+		std::map<std::string, std::string> label, const std::vector<double>& buckets);
+
+	virtual ~HistogramPtr();
+
+	prometheus::Histogram& metric();
+
+private:
+	prometheus::Histogram* m_metric;
+	prometheus::Family<prometheus::Histogram>* m_family;
+	std::shared_ptr<prometheus::Registry> m_promRegistry;
+	const std::string m_name;
+	const std::string m_help;
+	const std::map<std::string, std::string> m_label;
+};
+
+class PrometheusRest;
+//////////////////////////////////////////////////////////////////////////
+/// Latency histogram, error counter and in-flight gauge of one REST route,
+/// labeled with the route pattern to keep label cardinality bounded
+//////////////////////////////////////////////////////////////////////////
+class RouteMetrics : public std::enable_shared_from_this<RouteMetrics>
+{
+public:
+	explicit RouteMetrics(PrometheusRest& prom, const std::map<std::string, std::string>& labels);
+	virtual ~RouteMetrics();
+
+	// Observe a request from now until its reply is sent, the metrics are
+	// skipped if replaced by a later initMetrics() before the reply
+	void track(const web::http::http_request& message);
+
+private:
+	void complete(const std::chrono::steady_clock::time_point& start, web::http::status_code status);
+
+	std::shared_ptr<HistogramPtr> m_latency;
+	std::shared_ptr<CounterPtr> m_clientError;
+	std::shared_ptr<CounterPtr> m_serverError;
+	std::shared_ptr<GaugePtr> m_inflight;
+};
+
 //////////////////////////////////////////////////////////////////////////
 /// Prometheus Exporter REST service
 //////////////////////////////////////////////////////////////////////////
@@ -77,6 +125,7 @@ public:
 
 	std::shared_ptr<CounterPtr> createPromCounter(const std::string& metricName, const std::string& metricHelp, const std::map<std::string, std::string>& labels) noexcept(false);
 	std::shared_ptr<GaugePtr> createPromGauge(const std::string& metricName, const std::string& metricHelp, const std::map<std::string, std::string>& labels) noexcept(false);
+	std::shared_ptr<HistogramPtr> createPromHistogram(const std::string& metricName, const std::string& metricHelp, const std::map<std::string, std::string>& labels, const std::vector<double>& buckets) noexcept(false);
 	const std::string collectData();
 
 protected:
@@ -85,7 +134,8 @@ protected:
 	void initMetrics();
 
 private:
-	void handleRest(const http_request& message, const std::map<std::string, std::function<void(const HttpRequest&)>>& restFunctions);
+	typedef RestRouter<std::function<void(const HttpRequest&)>> RestFunctions;
+	void handleRest(const http_request& message, const RestFunctions& restFunctions);
 	void bindRestMethod(web::http::method method, std::string path, std::function< void(const HttpRequest&)> func);
 	void handle_get(const HttpRequest& message);
 	void handle_put(const HttpRequest& message);
@@ -99,10 +149,10 @@ private:
 private:
 	std::unique_ptr<web::http::experimental::listener::http_listener> m_listener;
 	// API functions
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restGetFunctions;
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restPutFunctions;
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restPstFunctions;
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restDelFunctions;
+	RestFunctions m_restGetFunctions;
+	RestFunctions m_restPutFunctions;
+	RestFunctions m_restPstFunctions;
+	RestFunctions m_restDelFunctions;
 	bool m_promEnabled;
 	std::recursive_mutex m_mutex;
 
@@ -110,6 +160,7 @@ private:
 	std::shared_ptr<prometheus::Registry> m_promRegistry;
 	std::shared_ptr<CounterPtr> m_scrapeCounter;
 	std::shared_ptr<GaugePtr> m_promGauge;
+	std::shared_ptr<RouteMetrics> m_scrapeMetrics;
 	static std::shared_ptr<PrometheusRest> m_instance;
 public:
 	static std::shared_ptr<PrometheusRest> instance() { return m_instance; }
@@ -128,5 +179,65 @@ public:
 #define PROM_METRIC_NAME_appmgr_prom_process_start_count "appmgr_prom_process_start_count"
 #define PROM_METRIC_HELP_appmgr_prom_process_start_count "application process spawn count"
 // Application process memory usage
+#define PROM_METRIC_NAME_appmgr_prom_process_oom_count "appmgr_prom_process_oom_count"
+#define PROM_METRIC_HELP_appmgr_prom_process_oom_count "application process OOM killed count"
+
 #define PROM_METRIC_NAME_appmgr_prom_process_memory_gauge "appmgr_prom_process_memory_gauge"
 #define PROM_METRIC_HELP_appmgr_prom_process_memory_gauge "application process memory bytes"
+
+#define PROM_METRIC_NAME_appmgr_host_pressure_gauge "appmgr_host_pressure_gauge"
+#define PROM_METRIC_HELP_appmgr_host_pressure_gauge "host pressure stall percentage (PSI avg10)"
+
+#define PROM_METRIC_NAME_appmgr_spawn_delayed_count "appmgr_spawn_delayed_count"
+#define PROM_METRIC_HELP_appmgr_spawn_delayed_count "application start delayed by host pressure count"
+
+#define PROM_METRIC_NAME_appmgr_prom_process_io_read_bytes_gauge "appmgr_prom_process_io_read_bytes_gauge"
+#define PROM_METRIC_HELP_appmgr_prom_process_io_read_bytes_gauge "application process tree storage read bytes"
+
+#define PROM_METRIC_NAME_appmgr_prom_process_io_write_bytes_gauge "appmgr_prom_process_io_write_bytes_gauge"
+#define PROM_METRIC_HELP_appmgr_prom_process_io_write_bytes_gauge "application process tree storage write bytes"
+
+#define PROM_METRIC_NAME_appmgr_prom_process_fd_gauge "appmgr_prom_process_fd_gauge"
+#define PROM_METRIC_HELP_appmgr_prom_process_fd_gauge "application process tree open file descriptors"
+
+#define PROM_METRIC_NAME_appmgr_prom_process_threads_gauge "appmgr_prom_process_threads_gauge"
+#define PROM_METRIC_HELP_appmgr_prom_process_threads_gauge "application process tree threads"
+
+#define PROM_METRIC_NAME_appmgr_prom_process_ctx_switches_voluntary_gauge "appmgr_prom_process_ctx_switches_voluntary_gauge"
+#define PROM_METRIC_HELP_appmgr_prom_process_ctx_switches_voluntary_gauge "application process tree voluntary context switches"
+
+#define PROM_METRIC_NAME_appmgr_prom_process_ctx_switches_involuntary_gauge "appmgr_prom_process_ctx_switches_involuntary_gauge"
+#define PROM_METRIC_HELP_appmgr_prom_process_ctx_switches_involuntary_gauge "application process tree involuntary context switches"
+
+#define PROM_METRIC_NAME_appmgr_http_rejected_count "appmgr_http_rejected_count"
+#define PROM_METRIC_HELP_appmgr_http_rejected_count "http request rejected by rate limit or concurrency cap"
+
+#define PROM_METRIC_NAME_appmgr_http_class_inflight_gauge "appmgr_http_class_inflight_gauge"
+#define PROM_METRIC_HELP_appmgr_http_class_inflight_gauge "http request being handled by route class"
+
+#define PROM_METRIC_NAME_appmgr_http_limited_users_gauge "appmgr_http_limited_users_gauge"
+#define PROM_METRIC_HELP_appmgr_http_limited_users_gauge "users tracked by http rate limiter"
+
+#define PROM_METRIC_NAME_appmgr_http_request_latency_seconds "appmgr_http_request_latency_seconds"
+#define PROM_METRIC_HELP_appmgr_http_request_latency_seconds "http request latency from receipt to reply by route"
+
+#define PROM_METRIC_NAME_appmgr_http_request_error_count "appmgr_http_request_error_count"
+#define PROM_METRIC_HELP_appmgr_http_request_error_count "http request replied with 4xx or 5xx by route"
+
+#define PROM_METRIC_NAME_appmgr_http_request_inflight_gauge "appmgr_http_request_inflight_gauge"
+#define PROM_METRIC_HELP_appmgr_http_request_inflight_gauge "http request waiting for reply by route"
+
+#define PROM_METRIC_NAME_appmgr_run_pool_worker_gauge "appmgr_run_pool_worker_gauge"
+#define PROM_METRIC_HELP_appmgr_run_pool_worker_gauge "pre-forked shell workers by state"
+
+#define PROM_METRIC_NAME_appmgr_run_pool_pending_gauge "appmgr_run_pool_pending_gauge"
+#define PROM_METRIC_HELP_appmgr_run_pool_pending_gauge "run requests waiting for a shell worker"
+
+#define PROM_METRIC_NAME_appmgr_run_pool_run_count "appmgr_run_pool_run_count"
+#define PROM_METRIC_HELP_appmgr_run_pool_run_count "run requests executed by shell workers"
+
+#define PROM_METRIC_NAME_appmgr_run_record_gauge "appmgr_run_record_gauge"
+#define PROM_METRIC_HELP_appmgr_run_record_gauge "ad-hoc run records kept for output"
+
+#define PROM_METRIC_NAME_appmgr_run_count "appmgr_run_count"
+#define PROM_METRIC_HELP_appmgr_run_count "ad-hoc run processes started"
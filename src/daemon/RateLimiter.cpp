@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cmath>
+#include "RateLimiter.h"
+#include "PrometheusRest.h"
+#include "../common/Utility.h"
+#include "../prom_exporter/counter.h"
+#include "../prom_exporter/gauge.h"
+
+namespace
+{
+	const char* REJECT_NAMES[] = { "user_rate", "user_concurrency", "route_rate", "route_concurrency", "capacity" };
+	const char* ROUTE_CLASS_NAMES[] = { "health", "run", "file", "read", "write" };
+}
+
+RateLimiter::Bucket::Bucket()
+	:m_tokens(0), m_started(false)
+{
+}
+
+bool RateLimiter::Bucket::take(const Configuration::JsonRateLimit::Limit& limit, const TimePoint& now, int& retryAfter)
+{
+	if (limit.m_requestsPerSecond <= 0) return true;
+	if (!m_started)
+	{
+		m_tokens = limit.m_burst;
+		m_started = true;
+	}
+	else
+	{
+		auto elapsed = std::chrono::duration<double>(now - m_last).count();
+		m_tokens = std::min<double>(limit.m_burst, m_tokens + elapsed * limit.m_requestsPerSecond);
+	}
+	m_last = now;
+	if (m_tokens >= 1)
+	{
+		m_tokens -= 1;
+		return true;
+	}
+	retryAfter = std::max(1, static_cast<int>(std::ceil((1 - m_tokens) / limit.m_requestsPerSecond)));
+	return false;
+}
+
+RateLimiter::UserState::UserState()
+	:m_inflight(0)
+{
+}
+
+RateLimiter::Ticket::Ticket(const std::shared_ptr<RateLimiter>& limiter, const std::string& user, RouteClass routeClass)
+	:m_limiter(limiter), m_user(user), m_routeClass(routeClass)
+{
+}
+
+RateLimiter::Ticket::~Ticket()
+{
+	m_limiter->release(m_user, m_routeClass);
+}
+
+RateLimiter::RateLimiter()
+	:m_config(std::make_shared<Configuration::JsonRateLimit>()), m_threadPoolSize(0), m_inflight(0)
+{
+	std::fill(std::begin(m_routeInflight), std::end(m_routeInflight), 0);
+}
+
+RateLimiter::~RateLimiter()
+{
+}
+
+std::shared_ptr<RateLimiter>& RateLimiter::instance()
+{
+	static auto singleton = std::make_shared<RateLimiter>();
+	return singleton;
+}
+
+void RateLimiter::setConfig(const std::shared_ptr<const Configuration::JsonRateLimit>& config)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	m_config = config ? config : std::make_shared<Configuration::JsonRateLimit>();
+	// start from full buckets with new limits
+	for (auto& bucket : m_routeBuckets) bucket = Bucket();
+	for (auto& user : m_users) user.second.m_bucket = Bucket();
+}
+
+void RateLimiter::setThreadPoolSize(size_t threadPoolSize)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	m_threadPoolSize = threadPoolSize;
+}
+
+void RateLimiter::initMetrics(std::shared_ptr<PrometheusRest> prom)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	// clean
+	for (auto& counters : m_rejectCounters)
+	{
+		for (auto& counter : counters) counter = nullptr;
+	}
+	for (auto& gauge : m_inflightGauges) gauge = nullptr;
+	m_usersGauge = nullptr;
+	// update
+	if (prom)
+	{
+		for (int routeClass = 0; routeClass < static_cast<int>(RouteClass::count); routeClass++)
+		{
+			m_inflightGauges[routeClass] = prom->createPromGauge(
+				PROM_METRIC_NAME_appmgr_http_class_inflight_gauge, PROM_METRIC_HELP_appmgr_http_class_inflight_gauge,
+				{ {"class", ROUTE_CLASS_NAMES[routeClass]} }
+			);
+			// health is never rejected
+			if (routeClass == static_cast<int>(RouteClass::health)) continue;
+			for (int reason = 0; reason < static_cast<int>(Reject::count); reason++)
+			{
+				m_rejectCounters[routeClass][reason] = prom->createPromCounter(
+					PROM_METRIC_NAME_appmgr_http_rejected_count, PROM_METRIC_HELP_appmgr_http_rejected_count,
+					{ {"class", ROUTE_CLASS_NAMES[routeClass]}, {"reason", REJECT_NAMES[reason]} }
+				);
+			}
+		}
+		m_usersGauge = prom->createPromGauge(
+			PROM_METRIC_NAME_appmgr_http_limited_users_gauge, PROM_METRIC_HELP_appmgr_http_limited_users_gauge,
+			{}
+		);
+	}
+	updateGauges();
+}
+
+RateLimiter::RouteClass RateLimiter::classify(const web::http::method& method, const std::string& path)
+{
+	if (path == "/appmgr/metrics" || (Utility::startWith(path, "/appmgr/app/") && Utility::endWith(path, "/health")))
+	{
+		return RouteClass::health;
+	}
+	if (path == "/appmgr/app/run" || path == "/appmgr/app/syncrun" || (Utility::startWith(path, "/appmgr/app/") && Utility::endWith(path, "/output")))
+	{
+		return RouteClass::run;
+	}
+	if (Utility::startWith(path, "/appmgr/file/"))
+	{
+		return RouteClass::file;
+	}
+	return (method == web::http::methods::GET) ? RouteClass::read : RouteClass::write;
+}
+
+const char* RateLimiter::routeClassName(RouteClass routeClass)
+{
+	return ROUTE_CLASS_NAMES[static_cast<int>(routeClass)];
+}
+
+bool RateLimiter::isRouteClass(const std::string& name)
+{
+	return std::find(std::begin(ROUTE_CLASS_NAMES) + 1, std::end(ROUTE_CLASS_NAMES), name) != std::end(ROUTE_CLASS_NAMES);
+}
+
+std::shared_ptr<RateLimiter::Ticket> RateLimiter::admit(const std::string& user, RouteClass routeClass, int& retryAfter)
+{
+	const auto now = std::chrono::steady_clock::now();
+	const int index = static_cast<int>(routeClass);
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	if (routeClass != RouteClass::health)
+	{
+		static const Configuration::JsonRateLimit::Limit noLimit;
+		const auto routeIter = m_config->m_routes.find(routeClassName(routeClass));
+		const auto& routeLimit = (routeIter != m_config->m_routes.end()) ? routeIter->second : noLimit;
+		const auto& userLimit = m_config->m_user;
+		// user state is only kept when user limit is set
+		UserState unlimitedUser;
+		const bool trackUser = (userLimit.m_concurrency > 0 || userLimit.m_requestsPerSecond > 0);
+		auto& userState = trackUser ? m_users[user] : unlimitedUser;
+		userState.m_lastSeen = now;
+		retryAfter = 1;
+
+		// keep reserved threads for health and metrics
+		const int capacity = static_cast<int>(m_threadPoolSize) - m_config->m_reservedThreads;
+		if (m_config->m_reservedThreads > 0 && capacity > 0 && m_inflight >= capacity)
+		{
+			reject(routeClass, Reject::capacity);
+			return nullptr;
+		}
+		if (userLimit.m_concurrency > 0 && userState.m_inflight >= userLimit.m_concurrency)
+		{
+			reject(routeClass, Reject::user_concurrency);
+			return nullptr;
+		}
+		if (routeLimit.m_concurrency > 0 && m_routeInflight[index] >= routeLimit.m_concurrency)
+		{
+			reject(routeClass, Reject::route_concurrency);
+			return nullptr;
+		}
+		// user bucket first, a flooding user does not drain the shared route bucket
+		if (!userState.m_bucket.take(userLimit, now, retryAfter))
+		{
+			reject(routeClass, Reject::user_rate);
+			return nullptr;
+		}
+		if (!m_routeBuckets[index].take(routeLimit, now, retryAfter))
+		{
+			reject(routeClass, Reject::route_rate);
+			return nullptr;
+		}
+		userState.m_inflight++;
+		m_inflight++;
+		if (m_users.size() > MAX_RATE_LIMIT_TRACKED_USERS && now - m_lastClean > std::chrono::seconds(10)) cleanIdleUsers(now);
+	}
+	m_routeInflight[index]++;
+	updateGauges();
+	return std::make_shared<Ticket>(instance(), user, routeClass);
+}
+
+void RateLimiter::release(const std::string& user, RouteClass routeClass)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	m_routeInflight[static_cast<int>(routeClass)]--;
+	if (routeClass != RouteClass::health)
+	{
+		m_inflight--;
+		auto iter = m_users.find(user);
+		if (iter != m_users.end() && iter->second.m_inflight > 0) iter->second.m_inflight--;
+	}
+	updateGauges();
+}
+
+void RateLimiter::reject(RouteClass routeClass, Reject reason)
+{
+	auto& counter = m_rejectCounters[static_cast<int>(routeClass)][static_cast<int>(reason)];
+	if (counter) counter->metric().Increment();
+}
+
+void RateLimiter::updateGauges()
+{
+	for (int routeClass = 0; routeClass < static_cast<int>(RouteClass::count); routeClass++)
+	{
+		if (m_inflightGauges[routeClass]) m_inflightGauges[routeClass]->metric().Set(m_routeInflight[routeClass]);
+	}
+	if (m_usersGauge) m_usersGauge->metric().Set(m_users.size());
+}
+
+void RateLimiter::cleanIdleUsers(const TimePoint& now)
+{
+	const static char fname[] = "RateLimiter::cleanIdleUsers() ";
+
+	m_lastClean = now;
+	auto before = m_users.size();
+	for (auto iter = m_users.begin(); iter != m_users.end();)
+	{
+		// bucket of an idle minute is full again for any sane limit
+		if (iter->second.m_inflight == 0 && now - iter->second.m_lastSeen > std::chrono::minutes(1))
+		{
+			iter = m_users.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	LOG_DBG << fname << "Removed <" << (before - m_users.size()) << "> idle users";
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cpprest/http_msg.h>
+#include "Configuration.h"
+
+class CounterPtr;
+class GaugePtr;
+class PrometheusRest;
+
+//////////////////////////////////////////////////////////////////////////
+/// REST admission control
+/// Token bucket rate limit and concurrency cap for each user and each route
+/// class, checked before the REST handler run on the shared cpprest thread
+/// pool. Health and metrics requests are never limited and ReservedThreads
+/// pool threads are kept for them.
+//////////////////////////////////////////////////////////////////////////
+class RateLimiter
+{
+public:
+	enum class RouteClass
+	{
+		health,
+		run,
+		file,
+		read,
+		write,
+		count
+	};
+	enum class Reject
+	{
+		user_rate,
+		user_concurrency,
+		route_rate,
+		route_concurrency,
+		capacity,
+		count
+	};
+
+	// Held while the handler run, concurrency slots are released when destroyed
+	class Ticket
+	{
+	public:
+		Ticket(const std::shared_ptr<RateLimiter>& limiter, const std::string& user, RouteClass routeClass);
+		~Ticket();
+	private:
+		const std::shared_ptr<RateLimiter> m_limiter;
+		const std::string m_user;
+		const RouteClass m_routeClass;
+	};
+
+	RateLimiter();
+	virtual ~RateLimiter();
+	static std::shared_ptr<RateLimiter>& instance();
+
+	void setConfig(const std::shared_ptr<const Configuration::JsonRateLimit>& config);
+	void setThreadPoolSize(size_t threadPoolSize);
+	void initMetrics(std::shared_ptr<PrometheusRest> prom);
+
+	static RouteClass classify(const web::http::method& method, const std::string& path);
+	static const char* routeClassName(RouteClass routeClass);
+	static bool isRouteClass(const std::string& name);
+
+	// nullptr when rejected, retryAfter is the seconds client should wait
+	std::shared_ptr<Ticket> admit(const std::string& user, RouteClass routeClass, int& retryAfter);
+
+private:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	struct Bucket
+	{
+		Bucket();
+		// take one token, or set retryAfter
+		bool take(const Configuration::JsonRateLimit::Limit& limit, const TimePoint& now, int& retryAfter);
+		double m_tokens;
+		TimePoint m_last;
+		bool m_started;
+	};
+	struct UserState
+	{
+		UserState();
+		Bucket m_bucket;
+		int m_inflight;
+		TimePoint m_lastSeen;
+	};
+
+	void release(const std::string& user, RouteClass routeClass);
+	void reject(RouteClass routeClass, Reject reason);
+	void updateGauges();
+	void cleanIdleUsers(const TimePoint& now);
+
+	std::shared_ptr<const Configuration::JsonRateLimit> m_config;
+	size_t m_threadPoolSize;
+	std::unordered_map<std::string, UserState> m_users;
+	Bucket m_routeBuckets[static_cast<int>(RouteClass::count)];
+	int m_routeInflight[static_cast<int>(RouteClass::count)];
+	// requests not in health class
+	int m_inflight;
+	TimePoint m_lastClean;
+	std::mutex m_mutex;
+
+	std::shared_ptr<CounterPtr> m_rejectCounters[static_cast<int>(RouteClass::count)][static_cast<int>(Reject::count)];
+	std::shared_ptr<GaugePtr> m_inflightGauges[static_cast<int>(RouteClass::count)];
+	std::shared_ptr<GaugePtr> m_usersGauge;
+};
@@ -2,26 +2,60 @@
 #include <ace/OS.h>
 #include "ResourceCollection.h"
 #include "../common/Utility.h"
+#include "../common/PerfLog.h"
 #include "../common/os/net.hpp"
 #include "../common/os/pstree.hpp"
 #include "Configuration.h"
+#include "PrometheusRest.h"
+#include "../prom_exporter/counter.h"
+#include "../prom_exporter/gauge.h"
 
 
 ResourceCollection::ResourceCollection()
-	: m_appmgrStartTime(std::chrono::system_clock::now())
+	: m_appmgrStartTime(std::chrono::system_clock::now()), m_snapshotVersion(0),
+	m_underPressure(false), m_criticalPriority(DEFAULT_PRESSURE_CRITICAL_PRIORITY), m_spawnBudget(DEFAULT_PRESSURE_SPAWN_BUDGET),
+	m_fastTimerId(0), m_processTimerId(0), m_slowTimerId(0)
 {
 }
 
 ResourceCollection::~ResourceCollection()
 {
+	this->cancleTimer(m_fastTimerId);
+	this->cancleTimer(m_processTimerId);
+	this->cancleTimer(m_slowTimerId);
 }
 
-std::unique_ptr<ResourceCollection>& ResourceCollection::instance()
+std::shared_ptr<ResourceCollection>& ResourceCollection::instance()
 {
-	static auto singleton = std::make_unique<ResourceCollection>();
+	static auto singleton = std::make_shared<ResourceCollection>();
 	return singleton;
 }
 
+void ResourceCollection::initTimer()
+{
+	this->cancleTimer(m_fastTimerId);
+	this->cancleTimer(m_processTimerId);
+	this->cancleTimer(m_slowTimerId);
+	m_fastTimerId = this->registerTimer(
+		1000L * DEFAULT_RESOURCE_FAST_INTERVAL,
+		DEFAULT_RESOURCE_FAST_INTERVAL,
+		std::bind(&ResourceCollection::fastRefreshTimer, this, std::placeholders::_1),
+		__FUNCTION__
+	);
+	m_processTimerId = this->registerTimer(
+		1000L * DEFAULT_RESOURCE_FAST_INTERVAL,
+		DEFAULT_RESOURCE_PROCESS_INTERVAL,
+		std::bind(&ResourceCollection::processRefreshTimer, this, std::placeholders::_1),
+		__FUNCTION__
+	);
+	m_slowTimerId = this->registerTimer(
+		1000L * DEFAULT_RESOURCE_SLOW_INTERVAL,
+		DEFAULT_RESOURCE_SLOW_INTERVAL,
+		std::bind(&ResourceCollection::slowRefreshTimer, this, std::placeholders::_1),
+		__FUNCTION__
+	);
+}
+
 std::string ResourceCollection::getHostName(bool refresh)
 {
 	static std::string hostname;
@@ -36,15 +70,23 @@ std::string ResourceCollection::getHostName(bool refresh)
 
 const HostResource& ResourceCollection::getHostResource()
 {
-	static auto cpus = os::cpus();
-	auto nets = net::links();
-	auto mem = os::memory();
+	refreshCpu();
+	refreshNet();
+	refreshFs();
+	refreshMemory();
+	refreshLoad();
+	refreshPressure();
+	refreshAppMemory();
 
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_resources;
+}
 
-	m_resources.m_ipaddress.clear();
+void ResourceCollection::refreshCpu()
+{
+	// CPU topology does not change during process lifetime
+	static auto cpus = os::cpus();
 
-	// CPU
 	std::set<int> sockets;
 	std::set<int> processers;
 	for (auto c : cpus)
@@ -52,24 +94,17 @@ const HostResource& ResourceCollection::getHostResource()
 		sockets.insert(c.socket);
 		processers.insert(c.id);
 	}
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	m_resources.m_cores = cpus.size();
 	m_resources.m_sockets = sockets.size();
 	m_resources.m_processors = processers.size();
+}
 
-	// Memory
-	if (mem != nullptr)
-	{
-		m_resources.m_total_bytes = mem->total_bytes;
-		m_resources.m_totalSwap_bytes = mem->totalSwap_bytes;
-		m_resources.m_free_bytes = mem->free_bytes;
-		m_resources.m_freeSwap_bytes = mem->freeSwap_bytes;
-	}
-	else
-	{
-		m_resources.m_total_bytes = m_resources.m_totalSwap_bytes = m_resources.m_free_bytes = m_resources.m_freeSwap_bytes = 0;
-	}
-
-	// Net
+bool ResourceCollection::refreshNet()
+{
+	std::list<HostNetInterface> ipaddress;
+	auto nets = net::links();
 	for (auto net : nets)
 	{
 		// do not need show lo
@@ -79,11 +114,247 @@ const HostResource& ResourceCollection::getHostResource()
 			inet.address = net.address;
 			inet.ipv4 = net.ipv4;
 			inet.name = net.name;
-			m_resources.m_ipaddress.push_back(inet);
+			ipaddress.push_back(inet);
 		}
 	}
 
-	return m_resources;
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (m_resources.m_ipaddress == ipaddress) return false;
+	m_resources.m_ipaddress = std::move(ipaddress);
+	return true;
+}
+
+bool ResourceCollection::refreshFs()
+{
+	std::list<HostFileSystem> fsList;
+	auto mountPoints = os::getMoundPoints();
+	for (const auto& pair : mountPoints)
+	{
+		auto usage = os::df(pair.first);
+		if (usage != nullptr)
+		{
+			HostFileSystem fs;
+			fs.size = usage->size;
+			fs.used = usage->used;
+			fs.usage = usage->usage;
+			fs.device = pair.second;
+			fs.mountPoint = pair.first;
+			fsList.push_back(fs);
+		}
+	}
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (m_resources.m_fs == fsList) return false;
+	m_resources.m_fs = std::move(fsList);
+	return true;
+}
+
+bool ResourceCollection::refreshMemory()
+{
+	auto mem = os::memory();
+	uint64_t total = 0, totalSwap = 0, free = 0, freeSwap = 0;
+	if (mem != nullptr)
+	{
+		total = mem->total_bytes;
+		totalSwap = mem->totalSwap_bytes;
+		free = mem->free_bytes;
+		freeSwap = mem->freeSwap_bytes;
+	}
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (m_resources.m_total_bytes == total && m_resources.m_totalSwap_bytes == totalSwap &&
+		m_resources.m_free_bytes == free && m_resources.m_freeSwap_bytes == freeSwap)
+	{
+		return false;
+	}
+	m_resources.m_total_bytes = total;
+	m_resources.m_totalSwap_bytes = totalSwap;
+	m_resources.m_free_bytes = free;
+	m_resources.m_freeSwap_bytes = freeSwap;
+	return true;
+}
+
+bool ResourceCollection::refreshLoad()
+{
+	auto load = os::loadavg();
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (load == nullptr)
+	{
+		bool changed = m_resources.m_load_valid;
+		m_resources.m_load_valid = false;
+		return changed;
+	}
+	if (m_resources.m_load_valid &&
+		m_resources.m_load_one == load->one &&
+		m_resources.m_load_five == load->five &&
+		m_resources.m_load_fifteen == load->fifteen)
+	{
+		return false;
+	}
+	m_resources.m_load_valid = true;
+	m_resources.m_load_one = load->one;
+	m_resources.m_load_five = load->five;
+	m_resources.m_load_fifteen = load->fifteen;
+	return true;
+}
+
+bool ResourceCollection::refreshAppMemory()
+{
+	// full process tree scan, the most expensive one
+	auto bytes = getRssMemory(getPid());
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	bool valid = (bytes > 0);
+	if (valid == m_resources.m_app_mem_valid && bytes == m_resources.m_app_mem_bytes) return false;
+	m_resources.m_app_mem_valid = valid;
+	m_resources.m_app_mem_bytes = bytes;
+	return true;
+}
+
+bool ResourceCollection::refreshPressure()
+{
+	auto read = [](const std::string& resource, HostPressure& target)
+	{
+		HostPressure value;
+		auto psi = os::pressure(resource);
+		if (psi != nullptr)
+		{
+			value.valid = true;
+			value.someAvg10 = psi->someAvg10;
+			value.someAvg60 = psi->someAvg60;
+			value.someAvg300 = psi->someAvg300;
+			value.fullAvg10 = psi->fullAvg10;
+			value.fullAvg60 = psi->fullAvg60;
+			value.fullAvg300 = psi->fullAvg300;
+		}
+		target = value;
+	};
+	HostPressure cpu, mem, io;
+	read("cpu", cpu);
+	read("memory", mem);
+	read("io", io);
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (m_resources.m_cpu_pressure == cpu && m_resources.m_mem_pressure == mem && m_resources.m_io_pressure == io) return false;
+	m_resources.m_cpu_pressure = cpu;
+	m_resources.m_mem_pressure = mem;
+	m_resources.m_io_pressure = io;
+	return true;
+}
+
+void ResourceCollection::evaluatePressure()
+{
+	const static char fname[] = "ResourceCollection::evaluatePressure() ";
+
+	// do not hold resource lock to access Configuration
+	auto config = Configuration::instance();
+	auto threshold = (config != nullptr) ? config->getPressure() : nullptr;
+
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	bool pressure = false;
+	if (threshold != nullptr && threshold->enabled())
+	{
+		auto exceed = [](const HostPressure& psi, double limit) { return psi.valid && limit > 0 && psi.someAvg10 >= limit; };
+		pressure = exceed(m_resources.m_cpu_pressure, threshold->m_cpuThreshold) ||
+			exceed(m_resources.m_mem_pressure, threshold->m_memoryThreshold) ||
+			exceed(m_resources.m_io_pressure, threshold->m_ioThreshold);
+		m_criticalPriority = threshold->m_criticalPriority;
+	}
+	if (pressure != m_underPressure)
+	{
+		LOG_WAR << fname << "host pressure " << (pressure ? "exceed" : "below") << " threshold, cpu <" << m_resources.m_cpu_pressure.someAvg10
+			<< "> memory <" << m_resources.m_mem_pressure.someAvg10 << "> io <" << m_resources.m_io_pressure.someAvg10 << ">";
+	}
+	m_underPressure = pressure;
+	m_spawnBudget = DEFAULT_PRESSURE_SPAWN_BUDGET;
+
+	auto setGauge = [this](const std::string& key, double value)
+	{
+		auto it = m_metricPressure.find(key);
+		if (it != m_metricPressure.end() && it->second) it->second->metric().Set(value);
+	};
+	setGauge("cpu_some", m_resources.m_cpu_pressure.someAvg10);
+	setGauge("cpu_full", m_resources.m_cpu_pressure.fullAvg10);
+	setGauge("memory_some", m_resources.m_mem_pressure.someAvg10);
+	setGauge("memory_full", m_resources.m_mem_pressure.fullAvg10);
+	setGauge("io_some", m_resources.m_io_pressure.someAvg10);
+	setGauge("io_full", m_resources.m_io_pressure.fullAvg10);
+}
+
+bool ResourceCollection::spawnPermit(int priority)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (!m_underPressure || priority >= m_criticalPriority) return true;
+	if (m_spawnBudget > 0)
+	{
+		--m_spawnBudget;
+		return true;
+	}
+	return false;
+}
+
+void ResourceCollection::countSpawnDelayed()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (m_metricSpawnDelayed) m_metricSpawnDelayed->metric().Increment();
+}
+
+bool ResourceCollection::underPressure()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_underPressure;
+}
+
+void ResourceCollection::initMetrics(std::shared_ptr<PrometheusRest> prom)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	// clean
+	m_metricPressure.clear();
+	m_metricSpawnDelayed = nullptr;
+	// update
+	if (prom)
+	{
+		for (auto resource : { "cpu", "memory", "io" })
+		{
+			for (auto kind : { "some", "full" })
+			{
+				m_metricPressure[std::string(resource) + "_" + kind] = prom->createPromGauge(
+					PROM_METRIC_NAME_appmgr_host_pressure_gauge, PROM_METRIC_HELP_appmgr_host_pressure_gauge,
+					{ {"resource", resource}, {"kind", kind} }
+				);
+			}
+		}
+		m_metricSpawnDelayed = prom->createPromCounter(
+			PROM_METRIC_NAME_appmgr_spawn_delayed_count, PROM_METRIC_HELP_appmgr_spawn_delayed_count,
+			{}
+		);
+	}
+}
+
+void ResourceCollection::fastRefreshTimer(int timerId)
+{
+	bool changed = refreshMemory();
+	changed = refreshLoad() || changed;
+	changed = refreshPressure() || changed;
+	evaluatePressure();
+	if (changed) buildSnapshot();
+}
+
+void ResourceCollection::processRefreshTimer(int timerId)
+{
+	const static char fname[] = "ResourceCollection::processRefreshTimer() ";
+	PerfLog perf(fname);
+	if (refreshAppMemory()) buildSnapshot();
+}
+
+void ResourceCollection::slowRefreshTimer(int timerId)
+{
+	const static char fname[] = "ResourceCollection::slowRefreshTimer() ";
+	PerfLog perf(fname);
+	bool changed = refreshNet();
+	changed = refreshFs() || changed;
+	if (changed) buildSnapshot();
 }
 
 const pid_t ResourceCollection::getPid()
@@ -97,16 +368,16 @@ uint64_t ResourceCollection::getRssMemory(pid_t pid)
 	const static char fname[] = "ResourceCollection::getRssMemory() ";
 	if (pid > 0)
 	{
-		auto tree = os::pstree(pid);
-		if (nullptr != tree)
+		uint64_t rss = 0;
 		{
-			return tree->totalRSS();
+			std::lock_guard<std::mutex> guard(m_procMutex);
+			rss = m_procReader.totalRss(pid);
 		}
-		else
+		if (rss == 0)
 		{
 			LOG_WAR << fname << " Failed to find process: " << pid;
-			return 0;
 		}
+		return rss;
 	}
 	return 0;
 }
@@ -129,20 +400,22 @@ void ResourceCollection::dump()
 	LOG_DBG << fname << "m_free_bytes:" << m_resources.m_free_bytes;
 	LOG_DBG << fname << "m_totalSwap_bytes:" << m_resources.m_totalSwap_bytes;
 	LOG_DBG << fname << "m_freeSwap_bytes:" << m_resources.m_freeSwap_bytes;
-
+	LOG_DBG << fname << "snapshot version:" << m_snapshotVersion;
 }
 
-web::json::value ResourceCollection::AsJson()
+void ResourceCollection::buildSnapshot()
 {
-	const static char fname[] = "ResourceCollection::AsJson() ";
-	LOG_DBG << fname << "Entered";
+	const static char fname[] = "ResourceCollection::buildSnapshot() ";
+
+	// do not hold resource lock to access Configuration
+	auto config = Configuration::instance();
+	auto description = (config != nullptr) ? config->getDescription() : std::string();
 
-	this->getHostResource();
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 
 	web::json::value result = web::json::value::object();
 	result[GET_STRING_T("host_name")] = web::json::value::string(GET_STRING_T(getHostName()));
-	result[GET_STRING_T("host_description")] = web::json::value::string(Configuration::instance()->getDescription());
+	result[GET_STRING_T("host_description")] = web::json::value::string(description);
 	auto arr = web::json::value::array(m_resources.m_ipaddress.size());
 	int idx = 0;
 	std::for_each(m_resources.m_ipaddress.begin(), m_resources.m_ipaddress.end(), [&arr, &idx](const  HostNetInterface& pair)
@@ -161,59 +434,124 @@ web::json::value ResourceCollection::AsJson()
 	result[GET_STRING_T("mem_free_bytes")] = web::json::value::number(m_resources.m_free_bytes);
 	result[GET_STRING_T("mem_totalSwap_bytes")] = web::json::value::number(m_resources.m_totalSwap_bytes);
 	result[GET_STRING_T("mem_freeSwap_bytes")] = web::json::value::number(m_resources.m_freeSwap_bytes);
-	auto allAppMem = os::pstree();
-	if (nullptr != allAppMem)
+	if (m_resources.m_app_mem_valid)
 	{
-		result[GET_STRING_T("mem_applications")] = web::json::value::number(allAppMem->totalRSS());
+		result[GET_STRING_T("mem_applications")] = web::json::value::number(m_resources.m_app_mem_bytes);
 	}
 	// Load
-	auto load = os::loadavg();
-	if (load != nullptr)
+	if (m_resources.m_load_valid)
 	{
 		web::json::value sysLoad = web::json::value::object();
-		sysLoad["1min"] = web::json::value::number(load->one);
-		sysLoad["5min"] = web::json::value::number(load->five);
-		sysLoad["15min"] = web::json::value::number(load->fifteen);
+		sysLoad["1min"] = web::json::value::number(m_resources.m_load_one);
+		sysLoad["5min"] = web::json::value::number(m_resources.m_load_five);
+		sysLoad["15min"] = web::json::value::number(m_resources.m_load_fifteen);
 		result[GET_STRING_T("load")] = sysLoad;
 	}
+	// PSI
+	if (m_resources.m_cpu_pressure.valid || m_resources.m_mem_pressure.valid || m_resources.m_io_pressure.valid)
+	{
+		auto psiJson = [](const HostPressure& psi)
+		{
+			web::json::value result = web::json::value::object();
+			result["some_avg10"] = web::json::value::number(psi.someAvg10);
+			result["some_avg60"] = web::json::value::number(psi.someAvg60);
+			result["some_avg300"] = web::json::value::number(psi.someAvg300);
+			result["full_avg10"] = web::json::value::number(psi.fullAvg10);
+			result["full_avg60"] = web::json::value::number(psi.fullAvg60);
+			result["full_avg300"] = web::json::value::number(psi.fullAvg300);
+			return result;
+		};
+		web::json::value pressure = web::json::value::object();
+		if (m_resources.m_cpu_pressure.valid) pressure["cpu"] = psiJson(m_resources.m_cpu_pressure);
+		if (m_resources.m_mem_pressure.valid) pressure["memory"] = psiJson(m_resources.m_mem_pressure);
+		if (m_resources.m_io_pressure.valid) pressure["io"] = psiJson(m_resources.m_io_pressure);
+		pressure["throttling"] = web::json::value::boolean(m_underPressure);
+		result[GET_STRING_T("pressure")] = pressure;
+	}
 	// FS
-	auto mountPoints = os::getMoundPoints();
-	auto fsArr = web::json::value::array(mountPoints.size());
+	auto fsArr = web::json::value::array(m_resources.m_fs.size());
 	idx = 0;
-	std::for_each(mountPoints.begin(), mountPoints.end(), [&fsArr, &idx](const std::pair<std::string, std::string>& pair)
+	std::for_each(m_resources.m_fs.begin(), m_resources.m_fs.end(), [&fsArr, &idx](const HostFileSystem& usage)
 		{
-			auto usage = os::df(pair.first);
-			if (usage != nullptr)
-			{
-				web::json::value fs = web::json::value::object();
-				fs["size"] = web::json::value::number(usage->size);
-				fs["used"] = web::json::value::number(usage->used);
-				fs["usage"] = web::json::value::number(usage->usage);
-				fs["device"] = web::json::value::string(pair.second);
-				fs["mount_point"] = web::json::value::string(pair.first);
-				fsArr[idx++] = fs;
-			}
+			web::json::value fs = web::json::value::object();
+			fs["size"] = web::json::value::number(usage.size);
+			fs["used"] = web::json::value::number(usage.used);
+			fs["usage"] = web::json::value::number(usage.usage);
+			fs["device"] = web::json::value::string(usage.device);
+			fs["mount_point"] = web::json::value::string(usage.mountPoint);
+			fsArr[idx++] = fs;
 		});
 
 	result[GET_STRING_T("fs")] = fsArr;
-	result[GET_STRING_T("systime")] = web::json::value::string(Utility::convertTime2Str(std::chrono::system_clock::now()));
+	// systime is filled when the snapshot is served
 	result[GET_STRING_T("appmgr_start_time")] = web::json::value::string(Utility::convertTime2Str(m_appmgrStartTime));
 	result[GET_STRING_T("pid")] = web::json::value::number(getPid());
-	LOG_DBG << fname << "Exit";
-	return std::move(result);
+
+	web::json::value consul = web::json::value::object();
+	consul[GET_STRING_T("cpu_cores")] = web::json::value::number(m_resources.m_cores);
+	consul[GET_STRING_T("mem_total_bytes")] = web::json::value::number(m_resources.m_total_bytes);
+
+	m_snapshotStr = std::make_shared<const std::string>(Utility::prettyJson(GET_STD_STRING(result.serialize())));
+	m_snapshot = std::move(result);
+	m_consulSnapshot = std::move(consul);
+	++m_snapshotVersion;
+	LOG_DBG << fname << "snapshot version <" << m_snapshotVersion << "> built";
 }
 
-web::json::value ResourceCollection::getConsulJson()
+void ResourceCollection::ensureSnapshot()
 {
-	static auto cpus = os::cpus();
-	auto mem = os::memory();
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		if (m_snapshotVersion > 0) return;
+	}
+	// timer not started yet, collect all
+	getHostResource();
+	buildSnapshot();
+}
 
-	web::json::value result = web::json::value::object();
-	result[GET_STRING_T("cpu_cores")] = web::json::value::number(cpus.size());
-	result[GET_STRING_T("mem_total_bytes")] = web::json::value::number(mem->total_bytes);
-	//result[GET_STRING_T("mem_free_bytes")] = web::json::value::number(mem->free_bytes);
-	//result[GET_STRING_T("mem_totalSwap_bytes")] = web::json::value::number(mem->totalSwap_bytes);
-	//result[GET_STRING_T("mem_freeSwap_bytes")] = web::json::value::number(mem->freeSwap_bytes);
+void ResourceCollection::invalidateSnapshot()
+{
+	buildSnapshot();
+}
 
-	return std::move(result);
+web::json::value ResourceCollection::AsJson()
+{
+	ensureSnapshot();
+	web::json::value result;
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		result = m_snapshot;
+	}
+	result[GET_STRING_T("systime")] = web::json::value::string(Utility::convertTime2Str(std::chrono::system_clock::now()));
+	return result;
+}
+
+std::string ResourceCollection::getSnapshotString()
+{
+	ensureSnapshot();
+	std::shared_ptr<const std::string> snapshot;
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		snapshot = m_snapshotStr;
+	}
+	// append systime as the last member of the pretty json object: "...\n}"
+	auto end = snapshot->find_last_not_of('\n', snapshot->rfind('}') - 1);
+	std::string result;
+	result.reserve(snapshot->length() + 64);
+	result.append(*snapshot, 0, end + 1);
+	result.append(",\n\t\"systime\": \"").append(Utility::convertTime2Str(std::chrono::system_clock::now())).append("\"\n}");
+	return result;
+}
+
+uint64_t ResourceCollection::getSnapshotVersion()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_snapshotVersion;
+}
+
+web::json::value ResourceCollection::getConsulJson()
+{
+	ensureSnapshot();
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_consulSnapshot;
 }
@@ -4,22 +4,62 @@
 #include <memory>
 #include <string>
 #include <list>
+#include <map>
 #include <unistd.h>
 #include <chrono>
 #include <cpprest/json.h>
+#include "TimerHandler.h"
+#include "../common/os/procstat.hpp"
+
+class CounterPtr;
+class GaugePtr;
+class PrometheusRest;
 
 struct HostNetInterface
 {
+	bool operator==(const HostNetInterface& other) const { return name == other.name && ipv4 == other.ipv4 && address == other.address; }
 	std::string name;
 	bool ipv4;
 	std::string address;
 };
+
+struct HostFileSystem
+{
+	bool operator==(const HostFileSystem& other) const
+	{
+		return size == other.size && used == other.used && usage == other.usage && device == other.device && mountPoint == other.mountPoint;
+	}
+	uint64_t size;
+	uint64_t used;
+	double usage;
+	std::string device;
+	std::string mountPoint;
+};
+
+struct HostPressure
+{
+	HostPressure() :valid(false), someAvg10(0), someAvg60(0), someAvg300(0), fullAvg10(0), fullAvg60(0), fullAvg300(0) {}
+	bool operator==(const HostPressure& other) const
+	{
+		return valid == other.valid && someAvg10 == other.someAvg10 && someAvg60 == other.someAvg60 && someAvg300 == other.someAvg300 &&
+			fullAvg10 == other.fullAvg10 && fullAvg60 == other.fullAvg60 && fullAvg300 == other.fullAvg300;
+	}
+	bool valid;
+	double someAvg10;
+	double someAvg60;
+	double someAvg300;
+	double fullAvg10;
+	double fullAvg60;
+	double fullAvg300;
+};
+
 //////////////////////////////////////////////////////////////////////////
 /// Host resource attribute
 //////////////////////////////////////////////////////////////////////////
 struct HostResource
 {
-	HostResource() :m_cores(0), m_sockets(0), m_processors(0), m_total_bytes(0), m_free_bytes(0), m_totalSwap_bytes(0), m_freeSwap_bytes(0) {}
+	HostResource() :m_cores(0), m_sockets(0), m_processors(0), m_total_bytes(0), m_free_bytes(0), m_totalSwap_bytes(0), m_freeSwap_bytes(0),
+		m_load_valid(false), m_load_one(0), m_load_five(0), m_load_fifteen(0), m_app_mem_valid(false), m_app_mem_bytes(0) {}
 
 	// CPU
 	size_t m_cores;
@@ -30,24 +70,47 @@ struct HostResource
 	uint64_t m_free_bytes;
 	uint64_t m_totalSwap_bytes;
 	uint64_t m_freeSwap_bytes;
-	// TODO: disk
-
+	// LOAD
+	bool m_load_valid;
+	double m_load_one;
+	double m_load_five;
+	double m_load_fifteen;
+	// PSI
+	HostPressure m_cpu_pressure;
+	HostPressure m_mem_pressure;
+	HostPressure m_io_pressure;
+	// Process tree
+	bool m_app_mem_valid;
+	uint64_t m_app_mem_bytes;
+	// DISK
+	std::list<HostFileSystem> m_fs;
 	// NET
 	std::list<HostNetInterface> m_ipaddress;
 };
 
 //////////////////////////////////////////////////////////////////////////
-// Collect host and application resource usage metrics
+/// Collect host and application resource usage metrics
+/// Each resource class is refreshed by timer with its own cadence:
+///   CPU topology : once
+///   NET / FS     : slow
+///   Process tree : medium
+///   MEM / LOAD / PSI : fast
+/// A prebuilt JSON snapshot is rebuilt only when something changed,
+/// REST and Consul read the snapshot without touching /proc.
 //////////////////////////////////////////////////////////////////////////
-class ResourceCollection
+class ResourceCollection :public TimerHandler
 {
 public:
 	ResourceCollection();
 	virtual ~ResourceCollection();
 	// Internal Singleton.
-	static std::unique_ptr<ResourceCollection>& instance();
+	static std::shared_ptr<ResourceCollection>& instance();
+
+	// start background refresh timers
+	void initTimer();
 
 	std::string getHostName(bool refresh = false);
+	// refresh all resource classes immediately and return the model
 	const HostResource& getHostResource();
 	const pid_t getPid();
 
@@ -56,10 +119,62 @@ public:
 	void dump();
 
 	web::json::value AsJson();
+	// pretty serialized snapshot with current systime for REST reply
+	std::string getSnapshotString();
+	uint64_t getSnapshotVersion();
 	web::json::value getConsulJson();
+	// rebuild snapshot for none-resource attributes change (host name, description)
+	void invalidateSnapshot();
+
+	void initMetrics(std::shared_ptr<PrometheusRest> prom);
+	// Spawn throttling by host pressure (PSI), return false if a start with
+	// this priority should be delayed to the next schedule
+	bool spawnPermit(int priority);
+	// count one postponed start, not each retry of it
+	void countSpawnDelayed();
+	bool underPressure();
+
+private:
+	// each refresh function return true if the data changed
+	void refreshCpu();
+	bool refreshNet();
+	bool refreshFs();
+	bool refreshMemory();
+	bool refreshLoad();
+	bool refreshAppMemory();
+	bool refreshPressure();
+	void evaluatePressure();
+
+	void fastRefreshTimer(int timerId = 0);
+	void processRefreshTimer(int timerId = 0);
+	void slowRefreshTimer(int timerId = 0);
+
+	void buildSnapshot();
+	void ensureSnapshot();
 
 private:
 	HostResource m_resources;
-	std::recursive_mutex m_mutex;
 	const std::chrono::system_clock::time_point m_appmgrStartTime;
+
+	uint64_t m_snapshotVersion;
+	web::json::value m_snapshot;
+	std::shared_ptr<const std::string> m_snapshotStr;
+	web::json::value m_consulSnapshot;
+
+	// reused /proc parser for process tree scan
+	os::ProcStatReader m_procReader;
+	std::mutex m_procMutex;
+
+	// pressure throttle
+	bool m_underPressure;
+	int m_criticalPriority;
+	int m_spawnBudget;
+
+	// Prometheus
+	std::map<std::string, std::shared_ptr<GaugePtr>> m_metricPressure;
+	std::shared_ptr<CounterPtr> m_metricSpawnDelayed;
+
+	int m_fastTimerId;
+	int m_processTimerId;
+	int m_slowTimerId;
 };
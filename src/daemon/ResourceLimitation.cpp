@@ -1,8 +1,9 @@
 #include "ResourceLimitation.h"
 #include "../common/Utility.h"
+#include "../common/os/linux.hpp"
 
 ResourceLimitation::ResourceLimitation()
-	:m_memoryMb(0), m_memoryVirtMb(0), m_cpuShares(0), m_index(0)
+	:m_memoryMb(0), m_memoryVirtMb(0), m_cpuShares(0), m_memoryHighMb(0), m_cpuQuota(0), m_cpuCores(0)
 {
 }
 
@@ -17,6 +18,13 @@ bool ResourceLimitation::operator==(const std::shared_ptr<ResourceLimitation>& o
 	return (m_cpuShares == obj->m_cpuShares &&
 		m_memoryMb == obj->m_memoryMb &&
 		m_memoryVirtMb == obj->m_memoryVirtMb &&
+		m_memoryHighMb == obj->m_memoryHighMb &&
+		m_memoryHighAction == obj->m_memoryHighAction &&
+		m_cpuQuota == obj->m_cpuQuota &&
+		m_ioLimits == obj->m_ioLimits &&
+		m_cpuSet == obj->m_cpuSet &&
+		m_cpuCores == obj->m_cpuCores &&
+		m_memNodes == obj->m_memNodes &&
 		m_name == obj->m_name);
 }
 
@@ -27,6 +35,17 @@ void ResourceLimitation::dump()
 	LOG_DBG << fname << "m_memoryMb:" << m_memoryMb;
 	LOG_DBG << fname << "m_memoryVirtMb:" << m_memoryVirtMb;
 	LOG_DBG << fname << "m_cpuShares:" << m_cpuShares;
+	LOG_DBG << fname << "m_memoryHighMb:" << m_memoryHighMb;
+	LOG_DBG << fname << "m_memoryHighAction:" << m_memoryHighAction;
+	LOG_DBG << fname << "m_cpuQuota:" << m_cpuQuota;
+	for (const auto& io : m_ioLimits)
+	{
+		LOG_DBG << fname << "io_limit:" << io.m_device << " read_bps:" << io.m_readBps << " write_bps:" << io.m_writeBps
+			<< " read_iops:" << io.m_readIops << " write_iops:" << io.m_writeIops;
+	}
+	LOG_DBG << fname << "m_cpuSet:" << m_cpuSet;
+	LOG_DBG << fname << "m_cpuCores:" << m_cpuCores;
+	LOG_DBG << fname << "m_memNodes:" << m_memNodes;
 }
 
 web::json::value ResourceLimitation::AsJson()
@@ -36,6 +55,19 @@ web::json::value ResourceLimitation::AsJson()
 	result[JSON_KEY_RESOURCE_LIMITATION_memory_mb] = web::json::value::number(m_memoryMb);
 	result[JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb] = web::json::value::number(m_memoryVirtMb);
 	result[JSON_KEY_RESOURCE_LIMITATION_cpu_shares] = web::json::value::number(m_cpuShares);
+	if (m_memoryHighMb > 0) result[JSON_KEY_RESOURCE_LIMITATION_memory_high_mb] = web::json::value::number(m_memoryHighMb);
+	if (m_memoryHighAction.length()) result[JSON_KEY_RESOURCE_LIMITATION_memory_high_action] = web::json::value::string(GET_STRING_T(m_memoryHighAction));
+	if (m_cpuQuota > 0) result[JSON_KEY_RESOURCE_LIMITATION_cpu_quota] = web::json::value::number(m_cpuQuota);
+	if (m_ioLimits.size())
+	{
+		auto ioLimits = web::json::value::array(m_ioLimits.size());
+		size_t index = 0;
+		for (const auto& io : m_ioLimits) ioLimits[index++] = io.AsJson();
+		result[JSON_KEY_RESOURCE_LIMITATION_io_limit] = ioLimits;
+	}
+	if (m_cpuSet.length()) result[JSON_KEY_RESOURCE_LIMITATION_cpu_set] = web::json::value::string(GET_STRING_T(m_cpuSet));
+	if (m_cpuCores > 0) result[JSON_KEY_RESOURCE_LIMITATION_cpu_cores] = web::json::value::number(m_cpuCores);
+	if (m_memNodes.length()) result[JSON_KEY_RESOURCE_LIMITATION_mem_nodes] = web::json::value::string(GET_STRING_T(m_memNodes));
 	return result;
 }
 
@@ -48,7 +80,87 @@ std::shared_ptr<ResourceLimitation> ResourceLimitation::FromJson(const web::json
 		result->m_memoryMb = GET_JSON_INT_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_memory_mb);
 		result->m_memoryVirtMb = GET_JSON_INT_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_memory_virt_mb);
 		result->m_cpuShares = GET_JSON_INT_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_cpu_shares);
+		result->m_memoryHighMb = GET_JSON_INT_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_memory_high_mb);
+		result->m_memoryHighAction = GET_JSON_STR_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_memory_high_action);
+		if (result->m_memoryHighMb < 0 || (result->m_memoryHighMb > 0 && result->m_memoryHighMb >= result->m_memoryMb))
+		{
+			throw std::invalid_argument("memory_high_mb should be less than memory_mb");
+		}
+		if (result->m_memoryHighAction.length() &&
+			result->m_memoryHighAction != MEMORY_HIGH_ACTION_NOTIFY && result->m_memoryHighAction != MEMORY_HIGH_ACTION_RESTART)
+		{
+			throw std::invalid_argument("memory_high_action should be notify or restart");
+		}
+		if (HAS_JSON_FIELD(jobj, JSON_KEY_RESOURCE_LIMITATION_cpu_quota)) result->m_cpuQuota = jobj.at(JSON_KEY_RESOURCE_LIMITATION_cpu_quota).as_double();
+		if (result->m_cpuQuota < 0)
+		{
+			throw std::invalid_argument("cpu_quota should not less than 0");
+		}
+		if (HAS_JSON_FIELD(jobj, JSON_KEY_RESOURCE_LIMITATION_io_limit))
+		{
+			for (const auto& io : jobj.at(JSON_KEY_RESOURCE_LIMITATION_io_limit).as_array())
+			{
+				result->m_ioLimits.push_back(DeviceIoLimit::FromJson(io));
+			}
+		}
+		result->m_cpuSet = GET_JSON_STR_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_cpu_set);
+		result->m_cpuCores = GET_JSON_INT_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_cpu_cores);
+		result->m_memNodes = GET_JSON_STR_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_mem_nodes);
+		std::set<int> ids;
+		if (!os::parseCpuList(result->m_cpuSet, ids))
+		{
+			throw std::invalid_argument("invalid cpu_set format");
+		}
+		if (!os::parseCpuList(result->m_memNodes, ids))
+		{
+			throw std::invalid_argument("invalid mem_nodes format");
+		}
+		if (result->m_cpuCores < 0)
+		{
+			throw std::invalid_argument("cpu_cores should not less than 0");
+		}
+		if (result->m_cpuCores > 0 && result->m_cpuSet.length())
+		{
+			throw std::invalid_argument("cpu_set and cpu_cores can not be set at the same time");
+		}
 		result->m_name = appName;
 	}
 	return result;
 }
+
+bool DeviceIoLimit::operator==(const DeviceIoLimit& other) const
+{
+	return m_device == other.m_device && m_readBps == other.m_readBps && m_writeBps == other.m_writeBps &&
+		m_readIops == other.m_readIops && m_writeIops == other.m_writeIops;
+}
+
+web::json::value DeviceIoLimit::AsJson() const
+{
+	web::json::value result = web::json::value::object();
+
+	result[JSON_KEY_RESOURCE_LIMITATION_io_device] = web::json::value::string(GET_STRING_T(m_device));
+	if (m_readBps) result[JSON_KEY_RESOURCE_LIMITATION_io_read_bps] = web::json::value::number(m_readBps);
+	if (m_writeBps) result[JSON_KEY_RESOURCE_LIMITATION_io_write_bps] = web::json::value::number(m_writeBps);
+	if (m_readIops) result[JSON_KEY_RESOURCE_LIMITATION_io_read_iops] = web::json::value::number(m_readIops);
+	if (m_writeIops) result[JSON_KEY_RESOURCE_LIMITATION_io_write_iops] = web::json::value::number(m_writeIops);
+	return result;
+}
+
+DeviceIoLimit DeviceIoLimit::FromJson(const web::json::value& jobj)
+{
+	DeviceIoLimit result;
+	result.m_device = GET_JSON_STR_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_io_device);
+	result.m_readBps = GET_JSON_NUMBER_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_io_read_bps);
+	result.m_writeBps = GET_JSON_NUMBER_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_io_write_bps);
+	result.m_readIops = GET_JSON_NUMBER_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_io_read_iops);
+	result.m_writeIops = GET_JSON_NUMBER_VALUE(jobj, JSON_KEY_RESOURCE_LIMITATION_io_write_iops);
+	if (result.m_device.empty())
+	{
+		throw std::invalid_argument("io_limit device should not be empty");
+	}
+	if (result.m_readBps < 0 || result.m_writeBps < 0 || result.m_readIops < 0 || result.m_writeIops < 0)
+	{
+		throw std::invalid_argument("io_limit value should not less than 0");
+	}
+	return result;
+}
@@ -2,6 +2,28 @@
 
 #include <cpprest/json.h>
 #include <string>
+#include <list>
+
+#define MEMORY_HIGH_ACTION_NOTIFY "notify"
+#define MEMORY_HIGH_ACTION_RESTART "restart"
+
+//////////////////////////////////////////////////////////////////////////
+/// Block device IO throttle, 0 means no limit
+//////////////////////////////////////////////////////////////////////////
+struct DeviceIoLimit
+{
+	DeviceIoLimit() :m_readBps(0), m_writeBps(0), m_readIops(0), m_writeIops(0) {}
+	bool operator==(const DeviceIoLimit& other) const;
+
+	web::json::value AsJson() const;
+	static DeviceIoLimit FromJson(const web::json::value& jobj) noexcept(false);
+
+	std::string m_device;
+	long long m_readBps;
+	long long m_writeBps;
+	long long m_readIops;
+	long long m_writeIops;
+};
 
 //////////////////////////////////////////////////////////////////////////
 /// Define the application resource usage limitation
@@ -20,8 +42,18 @@ public:
 	int m_memoryMb;
 	int m_memoryVirtMb;
 	int m_cpuShares;
+	// memory usage threshold for early notification, "notify" or "restart" when crossed
+	int m_memoryHighMb;
+	std::string m_memoryHighAction;
+	// CPU hard limit in number of CPUs (e.g. 1.5), 0 means no limit
+	double m_cpuQuota;
+	std::list<DeviceIoLimit> m_ioLimits;
+	// CPU pinning: explicit cpu list ("0-3,8") or number of cores placed
+	// automatically on one NUMA node, memory nodes follow the cpus if not set
+	std::string m_cpuSet;
+	int m_cpuCores;
+	std::string m_memNodes;
 
 	// runtime info
 	std::string m_name;
-	int m_index;
 };
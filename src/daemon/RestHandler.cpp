@@ -1,27 +1,42 @@
+#include <algorithm>
 #include <atomic>
 #include <chrono>
-#include <boost/algorithm/string_regex.hpp>
+#include <cstdio>
+#include <limits>
+#include <thread>
+#include <cpprest/containerstream.h>
 #include <cpprest/filestream.h>
+#include <cpprest/producerconsumerstream.h>
+#include <openssl/sha.h>
 #include <cpprest/http_listener.h> // HTTP server 
 #include <cpprest/http_client.h>
 
 #include "Application.h"
 #include "Configuration.h"
 #include "ConsulConnection.h"
+#include "EventBus.h"
 #include "RestHandler.h"
+#include "RunRegistry.h"
+#include "ShellWorkerPool.h"
 #include "PrometheusRest.h"
+#include "RateLimiter.h"
 #include "ResourceCollection.h"
 #include "User.h"
 #include "Label.h"
+#include "UploadManager.h"
+#include "ArtifactStore.h"
 
 #include "../common/Utility.h"
 #include "../prom_exporter/counter.h"
 #include "../prom_exporter/gauge.h"
 #include "../common/HttpRequest.h"
+#include "../common/DeltaSync.h"
+#include "../common/JsonWriter.h"
 #include "../common/Utility.h"
 #include "../common/jwt-cpp/jwt.h"
 #include "../common/os/linux.hpp"
 #include "../common/os/chown.hpp"
+#include "../common/os/filemap.hpp"
 #include "../common/HttpRequest.h"
 #include "../prom_exporter/text_serializer.h"
 
@@ -97,34 +112,38 @@ RestHandler::RestHandler(const std::string& ipaddress, int port)
 	// http://127.0.0.1:6060/login
 	bindRestMethod(web::http::methods::POST, "/appmgr/login", std::bind(&RestHandler::apiLogin, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/auth/admin
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/auth/([^/\*]+))", std::bind(&RestHandler::apiAuth, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/auth/{user}", std::bind(&RestHandler::apiAuth, this, std::placeholders::_1));
 
 
 	// 2. View Application
 	// http://127.0.0.1:6060/app/app-name
-	bindRestMethod(web::http::methods::GET, R"(/appmgr/app/([^/\*]+))", std::bind(&RestHandler::apiGetApp, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::GET, "/appmgr/app/{name}", std::bind(&RestHandler::apiGetApp, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app/app-name/output
-	bindRestMethod(web::http::methods::GET, R"(/appmgr/app/([^/\*]+)/output)", std::bind(&RestHandler::apiGetAppOutput, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::GET, "/appmgr/app/{name}/output", std::bind(&RestHandler::apiGetAppOutput, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app-manager/applications
 	bindRestMethod(web::http::methods::GET, "/appmgr/applications", std::bind(&RestHandler::apiGetApps, this, std::placeholders::_1));
+	// http://127.0.0.1:6060/appmgr/events?app=web&type=app_exited&since=100
+	bindRestMethod(web::http::methods::GET, "/appmgr/events", std::bind(&RestHandler::apiGetEvents, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app-manager/resources
 	bindRestMethod(web::http::methods::GET, "/appmgr/resources", std::bind(&RestHandler::apiGetResources, this, std::placeholders::_1));
 
 	// 3. Manage Application
 	// http://127.0.0.1:6060/app/app-name
-	bindRestMethod(web::http::methods::PUT, R"(/appmgr/app/([^/\*]+))", std::bind(&RestHandler::apiRegApp, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::PUT, "/appmgr/app/{name}", std::bind(&RestHandler::apiRegApp, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app/appname/enable
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/app/([^/\*]+)/enable)", std::bind(&RestHandler::apiEnableApp, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/app/{name}/enable", std::bind(&RestHandler::apiEnableApp, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app/appname/disable
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/app/([^/\*]+)/disable)", std::bind(&RestHandler::apiDisableApp, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/app/{name}/disable", std::bind(&RestHandler::apiDisableApp, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app/appname
-	bindRestMethod(web::http::methods::DEL, R"(/appmgr/app/([^/\*]+))", std::bind(&RestHandler::apiDeleteApp, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::DEL, "/appmgr/app/{name}", std::bind(&RestHandler::apiDeleteApp, this, std::placeholders::_1));
+	// http://127.0.0.1:6060/apps/batch
+	bindRestMethod(web::http::methods::POST, "/appmgr/apps/batch", std::bind(&RestHandler::apiBatchApps, this, std::placeholders::_1));
 
 	// 4. Operate Application
 	// http://127.0.0.1:6060/app/run?timeout=5
 	bindRestMethod(web::http::methods::POST, "/appmgr/app/run", std::bind(&RestHandler::apiRunAsync, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app/app-name/run/output?process_uuid=uuidabc
-	bindRestMethod(web::http::methods::GET, R"(/appmgr/app/([^/\*]+)/run/output)", std::bind(&RestHandler::apiRunAsyncOut, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::GET, "/appmgr/app/{name}/run/output", std::bind(&RestHandler::apiRunAsyncOut, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/app/syncrun?timeout=5
 	bindRestMethod(web::http::methods::POST, "/appmgr/app/syncrun", std::bind(&RestHandler::apiRunSync, this, std::placeholders::_1));
 
@@ -133,38 +152,51 @@ RestHandler::RestHandler(const std::string& ipaddress, int port)
 	bindRestMethod(web::http::methods::GET, "/appmgr/file/download", std::bind(&RestHandler::apiFileDownload, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/upload
 	bindRestMethod(web::http::methods::POST, "/appmgr/file/upload", std::bind(&RestHandler::apiFileUpload, this, std::placeholders::_1));
+	// http://127.0.0.1:6060/upload/session
+	bindRestMethod(web::http::methods::POST, "/appmgr/file/upload/session", std::bind(&RestHandler::apiUploadSessionOpen, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::GET, "/appmgr/file/upload/session/{id}", std::bind(&RestHandler::apiUploadSessionGet, this, std::placeholders::_1));
+	// http://127.0.0.1:6060/upload/session/id?offset=0
+	bindRestMethod(web::http::methods::PUT, "/appmgr/file/upload/session/{id}", std::bind(&RestHandler::apiUploadSessionChunk, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/file/upload/session/{id}/commit", std::bind(&RestHandler::apiUploadSessionCommit, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::DEL, "/appmgr/file/upload/session/{id}", std::bind(&RestHandler::apiUploadSessionAbort, this, std::placeholders::_1));
+	// http://127.0.0.1:6060/appmgr/file/artifact/sha256hex
+	bindRestMethod(web::http::methods::GET, "/appmgr/file/artifact/{hash}", std::bind(&RestHandler::apiArtifactView, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/file/artifact/{hash}/deploy", std::bind(&RestHandler::apiArtifactDeploy, this, std::placeholders::_1));
+	// http://127.0.0.1:6060/appmgr/file/delta
+	bindRestMethod(web::http::methods::GET, "/appmgr/file/delta/signature", std::bind(&RestHandler::apiFileDeltaSignature, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/file/delta", std::bind(&RestHandler::apiFileDelta, this, std::placeholders::_1));
 
 	// 6. Label Management
 	// http://127.0.0.1:6060/labels
 	bindRestMethod(web::http::methods::GET, "/appmgr/labels", std::bind(&RestHandler::apiGetLabels, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/label/abc?value=123
-	bindRestMethod(web::http::methods::PUT, R"(/appmgr/label/([^/\*]+))", std::bind(&RestHandler::apiAddLabel, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::PUT, "/appmgr/label/{label}", std::bind(&RestHandler::apiAddLabel, this, std::placeholders::_1));
 	// http://127.0.0.1:6060/label/abc
-	bindRestMethod(web::http::methods::DEL, R"(/appmgr/label/([^/\*]+))", std::bind(&RestHandler::apiDeleteLabel, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::DEL, "/appmgr/label/{label}", std::bind(&RestHandler::apiDeleteLabel, this, std::placeholders::_1));
 
 	// 7. Log level
 	bindRestMethod(web::http::methods::GET, "/appmgr/config", std::bind(&RestHandler::apiGetBasicConfig, this, std::placeholders::_1));
 	bindRestMethod(web::http::methods::POST, "/appmgr/config", std::bind(&RestHandler::apiSetBasicConfig, this, std::placeholders::_1));
 
 	// 8. Security
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/user/([^/\*]+)/passwd)", std::bind(&RestHandler::apiUserChangePwd, this, std::placeholders::_1));
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/user/([^/\*]+)/lock)", std::bind(&RestHandler::apiUserLock, this, std::placeholders::_1));
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/user/([^/\*]+)/unlock)", std::bind(&RestHandler::apiUserUnlock, this, std::placeholders::_1));
-	bindRestMethod(web::http::methods::PUT, R"(/appmgr/user/([^/\*]+))", std::bind(&RestHandler::apiUserAdd, this, std::placeholders::_1));
-	bindRestMethod(web::http::methods::DEL, R"(/appmgr/user/([^/\*]+))", std::bind(&RestHandler::apiUserDel, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/user/{user}/passwd", std::bind(&RestHandler::apiUserChangePwd, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/user/{user}/lock", std::bind(&RestHandler::apiUserLock, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/user/{user}/unlock", std::bind(&RestHandler::apiUserUnlock, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::PUT, "/appmgr/user/{user}", std::bind(&RestHandler::apiUserAdd, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::DEL, "/appmgr/user/{user}", std::bind(&RestHandler::apiUserDel, this, std::placeholders::_1));
 	bindRestMethod(web::http::methods::GET, "/appmgr/users", std::bind(&RestHandler::apiUserList, this, std::placeholders::_1));
 	bindRestMethod(web::http::methods::GET, "/appmgr/roles", std::bind(&RestHandler::apiRoleView, this, std::placeholders::_1));
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/role/([^/\*]+))", std::bind(&RestHandler::apiRoleUpdate, this, std::placeholders::_1));
-	bindRestMethod(web::http::methods::DEL, R"(/appmgr/role/([^/\*]+))", std::bind(&RestHandler::apiRoleDelete, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/role/{role}", std::bind(&RestHandler::apiRoleUpdate, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::DEL, "/appmgr/role/{role}", std::bind(&RestHandler::apiRoleDelete, this, std::placeholders::_1));
 	bindRestMethod(web::http::methods::GET, "/appmgr/user/permissions", std::bind(&RestHandler::apiGetUserPermissions, this, std::placeholders::_1));
 	bindRestMethod(web::http::methods::GET, "/appmgr/permissions", std::bind(&RestHandler::apiListPermissions, this, std::placeholders::_1));
 
 	// 9. metrics
-	bindRestMethod(web::http::methods::GET, R"(/appmgr/app/([^/\*]+)/health)", std::bind(&RestHandler::apiHealth, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::GET, "/appmgr/app/{name}/health", std::bind(&RestHandler::apiHealth, this, std::placeholders::_1));
 	bindRestMethod(web::http::methods::GET, "/appmgr/metrics", std::bind(&RestHandler::apiMetrics, this, std::placeholders::_1));
 
 	// 10. consul
-	bindRestMethod(web::http::methods::POST, R"(/appmgr/watch/([^/\*]+))", std::bind(&RestHandler::apiPostWatch, this, std::placeholders::_1));
+	bindRestMethod(web::http::methods::POST, "/appmgr/watch/{type}", std::bind(&RestHandler::apiPostWatch, this, std::placeholders::_1));
 
 	this->open();
 
@@ -231,14 +263,24 @@ void RestHandler::handle_options(const HttpRequest& message)
 	message.reply(status_codes::OK);
 }
 
-void RestHandler::handleRest(const http_request& message, const std::map<std::string, std::function<void(const HttpRequest&)>>& restFunctions)
+void RestHandler::dispatch(const http_request& message)
+{
+	const auto& method = message.method();
+	if (method == methods::GET) handle_get(message);
+	else if (method == methods::PUT) handle_put(message);
+	else if (method == methods::POST) handle_post(message);
+	else if (method == methods::DEL) handle_delete(message);
+	else if (method == methods::OPTIONS) handle_options(message);
+	else message.reply(status_codes::MethodNotAllowed);
+}
+
+void RestHandler::handleRest(const http_request& message, const RestFunctions& restFunctions)
 {
 	static char fname[] = "RestHandler::handle_rest() ";
 
-	std::function<void(const HttpRequest&)> stdFunction;
 	auto path = Utility::stringReplace(GET_STD_STRING(message.relative_uri().path()), "//", "/");
 
-	const auto request = std::move(HttpRequest(message));
+	auto request = std::move(HttpRequest(message));
 
 	if (path == "/" || path.empty())
 	{
@@ -246,26 +288,38 @@ void RestHandler::handleRest(const http_request& message, const std::map<std::st
 		return;
 	}
 
-	bool findRest = false;
-	for (const auto& kvp : restFunctions)
+	auto stdFunction = restFunctions.match(path, request.m_pathParams);
+	if (stdFunction == nullptr)
 	{
-		if (path == kvp.first || boost::regex_match(path, boost::regex(kvp.first)))
-		{
-			findRest = true;
-			stdFunction = kvp.second;
-			break;
-		}
+		request.reply(status_codes::NotFound, "Path not found");
+		return;
 	}
-	if (!findRest)
+	for (auto& param : request.m_pathParams)
 	{
-		request.reply(status_codes::NotFound, "Path not found");
+		param.second = GET_STD_STRING(http::uri::decode(param.second));
+	}
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		auto metrics = m_routeMetrics.find(stdFunction->m_name);
+		if (metrics != m_routeMetrics.end()) metrics->second->track(request);
+	}
+
+	// admission control before the handler occupy a pool thread
+	int retryAfter = 1;
+	auto ticket = RateLimiter::instance()->admit(rateLimitUser(request), RateLimiter::classify(request.method(), path), retryAfter);
+	if (ticket == nullptr)
+	{
+		http_response response(HTTP_STATUS_TOO_MANY_REQUESTS);
+		response.headers().add(HTTP_HEADER_KEY_Retry_After, std::to_string(retryAfter));
+		response.set_body("Too many requests");
+		request.reply(response);
 		return;
 	}
 
 	try
 	{
 		// LOG_DBG << fname << "rest " << path;
-		stdFunction(request);
+		stdFunction->m_handler(request);
 	}
 	catch (const std::exception& e)
 	{
@@ -285,17 +339,22 @@ void RestHandler::bindRestMethod(web::http::method method, std::string path, std
 
 	LOG_DBG << fname << "bind " << GET_STD_STRING(method).c_str() << " " << path;
 
-	// bind to map
+	const RestRoute route{ GET_STD_STRING(method) + " " + path, func };
+	// compile to route table
 	if (method == web::http::methods::GET)
-		m_restGetFunctions[path] = func;
+		m_restGetFunctions.addRoute(path, route);
 	else if (method == web::http::methods::PUT)
-		m_restPutFunctions[path] = func;
+		m_restPutFunctions.addRoute(path, route);
 	else if (method == web::http::methods::POST)
-		m_restPstFunctions[path] = func;
+		m_restPstFunctions.addRoute(path, route);
 	else if (method == web::http::methods::DEL)
-		m_restDelFunctions[path] = func;
+		m_restDelFunctions.addRoute(path, route);
 	else
+	{
 		LOG_ERR << fname << GET_STD_STRING(method).c_str() << " not supported.";
+		return;
+	}
+	m_routes.push_back(std::make_pair(GET_STD_STRING(method), path));
 }
 
 void RestHandler::handle_error(pplx::task<void>& t)
@@ -316,11 +375,36 @@ void RestHandler::handle_error(pplx::task<void>& t)
 	}
 }
 
+std::string RestHandler::rateLimitUser(const HttpRequest& message)
+{
+	try
+	{
+		auto verified = getVerifiedToken(message);
+		if (verified) return verified->m_user;
+	}
+	catch (...)
+	{
+		// login request or invalid token, handler reply the error
+	}
+	return std::string("remote:") + GET_STD_STRING(message.remote_address());
+}
+
 std::string RestHandler::verifyToken(const HttpRequest& message)
 {
-	if (!Configuration::instance()->getJwtEnabled()) return "";
+	auto verified = getVerifiedToken(message);
+	return verified ? verified->m_user : "";
+}
+
+std::shared_ptr<const TokenCache::VerifiedToken> RestHandler::getVerifiedToken(const HttpRequest& message)
+{
+	if (!Configuration::instance()->getJwtEnabled()) return nullptr;
 
 	auto token = getTokenStr(message);
+	auto cached = TokenCache::instance()->get(token);
+	if (cached) return cached;
+
+	// read before verify, security change during verify drop this result
+	auto generation = TokenCache::instance()->generation();
 	auto decoded_token = jwt::decode(token);
 	if (decoded_token.has_payload_claim(HTTP_HEADER_JWT_name))
 	{
@@ -339,7 +423,16 @@ std::string RestHandler::verifyToken(const HttpRequest& message)
 			.with_claim(HTTP_HEADER_JWT_name, userName);
 		verifier.verify(decoded_token);
 
-		return std::move(userName.as_string());
+		auto verified = std::make_shared<TokenCache::VerifiedToken>();
+		verified->m_user = userName.as_string();
+		verified->m_permissions = userObj->getPermissionSet();
+		// token without exp is not cached
+		if (decoded_token.has_expires_at())
+		{
+			verified->m_expire = decoded_token.get_expires_at();
+			TokenCache::instance()->put(token, verified, generation);
+		}
+		return verified;
 	}
 	else
 	{
@@ -363,14 +456,43 @@ std::string RestHandler::getTokenUser(const HttpRequest& message)
 	}
 }
 
+bool RestHandler::permissionCheck(const HttpRequest& message, Permission permission)
+{
+	const static char fname[] = "RestHandler::permissionCheck() ";
+
+	auto verified = getVerifiedToken(message);
+	if (verified && verified->m_user.length())
+	{
+		// check user role permission
+		if (verified->m_permissions.test(static_cast<size_t>(permission)))
+		{
+			LOG_DBG << fname << "authentication success for remote: " << message.remote_address() << " with user : " << verified->m_user << " and permission : " << Role::permissionName(permission);
+			return true;
+		}
+		else
+		{
+			LOG_WAR << fname << "No such permission " << Role::permissionName(permission) << " for user " << verified->m_user;
+			throw std::invalid_argument(std::string("No such permission <") + Role::permissionName(permission) + "> for user <" + verified->m_user + ">");
+		}
+	}
+	else
+	{
+		// JWT not enabled
+		return true;
+	}
+}
+
 bool RestHandler::permissionCheck(const HttpRequest& message, const std::string& permission)
 {
 	const static char fname[] = "RestHandler::permissionCheck() ";
 
+	Permission perm;
+	if (Role::toPermission(permission, perm)) return permissionCheck(message, perm);
+
+	// permission not defined by PERMISSION_KEY_XXX, check role permission names
 	auto userName = verifyToken(message);
-	if (permission.length() && userName.length() && Configuration::instance()->getJwtEnabled())
+	if (permission.length() && userName.length())
 	{
-		// check user role permission
 		if (Configuration::instance()->getUserPermissions(userName).count(permission))
 		{
 			LOG_DBG << fname << "authentication success for remote: " << message.remote_address() << " with user : " << userName << " and permission : " << permission;
@@ -427,6 +549,63 @@ std::string RestHandler::createToken(const std::string& uname, const std::string
 	return std::move(token);
 }
 
+void RestHandler::replyCachedView(const HttpRequest& message, CachedView& view, const std::string& version, const std::function<std::string()>& render)
+{
+	// versions restart from 1 with process, add process start time to avoid match ETag from previous process
+	static const auto instanceId = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+	const auto etag = std::string("\"") + instanceId + "-" + version + "\"";
+
+	if (message.headers().has(HTTP_HEADER_KEY_If_None_Match) && GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_If_None_Match)->second) == etag)
+	{
+		http_response response(status_codes::NotModified);
+		response.headers().add(HTTP_HEADER_KEY_ETag, etag);
+		message.reply(response);
+		return;
+	}
+
+	http_response response(status_codes::OK);
+	{
+		std::lock_guard<std::mutex> guard(view.m_mutex);
+		if (view.m_etag != etag)
+		{
+			view.m_body = render();
+			view.m_etag = etag;
+		}
+		response.set_body(view.m_body, "application/json");
+	}
+	response.headers().add(HTTP_HEADER_KEY_ETag, etag);
+	message.reply(response);
+}
+
+void RestHandler::replyJsonStream(const HttpRequest& message, http_response& response, const std::function<void(JsonWriter&)>& write)
+{
+	const static char fname[] = "RestHandler::replyJsonStream() ";
+
+	// no content length, body is sent with chunked transfer while written
+	concurrency::streams::producer_consumer_buffer<uint8_t> buffer;
+	response.set_body(buffer.create_istream(), "application/json");
+	message.reply(response);
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(DEFAULT_JSON_STREAM_TIMEOUT);
+	JsonWriter writer(false, DEFAULT_JSON_STREAM_CHUNK_SIZE, [&buffer, &deadline](std::string& data)
+		{
+			writeStream(buffer, reinterpret_cast<const uint8_t*>(data.data()), data.length(),
+				DEFAULT_JSON_STREAM_PENDING_CHUNKS * DEFAULT_JSON_STREAM_CHUNK_SIZE, DEFAULT_JSON_STREAM_MIN_RATE, deadline);
+			data.clear();
+		});
+	try
+	{
+		write(writer);
+		writer.flush();
+	}
+	catch (const std::exception& e)
+	{
+		// response already started, the client get a truncated body
+		LOG_WAR << fname << "stream " << message.relative_uri().path() << " failed :" << e.what();
+	}
+	buffer.close(std::ios_base::out).wait();
+}
+
 int RestHandler::getHttpQueryValue(const HttpRequest& message, const std::string& key, int defaultValue, int min, int max) const
 {
 	const static char fname[] = "RestHandler::getQueryValue() ";
@@ -444,12 +623,8 @@ int RestHandler::getHttpQueryValue(const HttpRequest& message, const std::string
 
 void RestHandler::apiEnableApp(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_app_control);
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-
-	// /app/$app-name/enable
-	std::string appName = path.substr(strlen("/appmgr/app/"));
-	appName = appName.substr(0, appName.find_last_of('/'));
+	permissionCheck(message, Permission::app_control);
+	const auto& appName = message.getPathParam("name");
 
 	Configuration::instance()->enableApp(appName);
 	message.reply(status_codes::OK, std::string("Enable <") + appName + "> success.");
@@ -457,12 +632,8 @@ void RestHandler::apiEnableApp(const HttpRequest& message)
 
 void RestHandler::apiDisableApp(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_app_control);
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-
-	// /appmgr/app/$app-name/disable
-	std::string appName = path.substr(strlen("/appmgr/app/"));
-	appName = appName.substr(0, appName.find_last_of('/'));
+	permissionCheck(message, Permission::app_control);
+	const auto& appName = message.getPathParam("name");
 
 	Configuration::instance()->disableApp(appName);
 	message.reply(status_codes::OK, std::string("Disable <") + appName + "> success.");
@@ -470,10 +641,8 @@ void RestHandler::apiDisableApp(const HttpRequest& message)
 
 void RestHandler::apiDeleteApp(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_app_delete);
-	auto path = GET_STD_STRING(message.relative_uri().path());
-
-	std::string appName = path.substr(strlen("/appmgr/app/"));
+	permissionCheck(message, Permission::app_delete);
+	const auto& appName = message.getPathParam("name");
 	if (Configuration::instance()->isSystemInternalApp(appName)) throw std::invalid_argument("not allowed for internal and cluster application");
 	Configuration::instance()->removeApp(appName);
 	auto msg = std::string("application <") + appName + "> removed.";
@@ -483,7 +652,7 @@ void RestHandler::apiDeleteApp(const HttpRequest& message)
 void RestHandler::apiFileDownload(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiFileDownload() ";
-	permissionCheck(message, PERMISSION_KEY_file_download);
+	permissionCheck(message, Permission::file_download);
 	if (!message.headers().has(U(HTTP_HEADER_KEY_file_path)))
 	{
 		message.reply(status_codes::BadRequest, "file_path header not found");
@@ -495,41 +664,172 @@ void RestHandler::apiFileDownload(const HttpRequest& message)
 		message.reply(status_codes::NotAcceptable, "file not found");
 		return;
 	}
+	// file is read from the opened descriptor until the response is sent
+	auto reader = std::make_shared<os::FileReader>(file);
+	if (!reader->valid())
+	{
+		message.reply(status_codes::NotAcceptable, "file can not be read");
+		return;
+	}
+	const auto size = reader->size();
+	const auto etag = std::string("\"") + reader->version() + "\"";
+
+	// single range request, resume when If-Range still match the file version
+	size_t start = 0, length = size;
+	bool partial = false;
+	if (message.headers().has(HTTP_HEADER_KEY_Range) &&
+		(!message.headers().has(HTTP_HEADER_KEY_If_Range) || GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_If_Range)->second) == etag))
+	{
+		const auto range = GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_Range)->second);
+		if (!parseRange(range, size, start, length))
+		{
+			http_response resp(status_codes::RangeNotSatisfiable);
+			resp.headers().add(HTTP_HEADER_KEY_Content_Range, std::string("bytes */") + std::to_string(size));
+			resp.set_body("requested range not satisfiable");
+			message.reply(resp);
+			return;
+		}
+		partial = (start != 0 || length != size);
+	}
 
-	LOG_DBG << fname << "Downloading file <" << file << ">";
+	LOG_DBG << fname << "Downloading file <" << file << "> range <" << start << "-" << (start + length) << "/" << size << ">";
 
-	concurrency::streams::fstream::open_istream(file, std::ios::in | std::ios::binary).then([=](concurrency::streams::istream fileStream)
+	web::http::http_response resp(partial ? status_codes::PartialContent : status_codes::OK);
+	concurrency::streams::producer_consumer_buffer<uint8_t> buffer;
+	resp.set_body(buffer.create_istream(), length);
+	resp.headers().add(HTTP_HEADER_KEY_Accept_Ranges, "bytes");
+	resp.headers().add(HTTP_HEADER_KEY_ETag, etag);
+	if (partial)
+	{
+		resp.headers().add(HTTP_HEADER_KEY_Content_Range, std::string("bytes ") + std::to_string(start) + "-" + std::to_string(start + length - 1) + "/" + std::to_string(size));
+	}
+	// Digest is the full representation digest, not sent for a partial response
+	if (!partial && message.headers().has(HTTP_HEADER_KEY_Want_Digest) &&
+		Utility::stdStringTrim(GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_Want_Digest)->second)).find("sha-256") != std::string::npos)
+	{
+		const auto digest = contentDigest(*reader);
+		if (digest.length()) resp.headers().add(HTTP_HEADER_KEY_Digest, std::string("sha-256=") + digest);
+	}
+	resp.headers().add(HTTP_HEADER_KEY_file_mode, os::fileStat(file));
+	resp.headers().add(HTTP_HEADER_KEY_file_user, os::fileUser(file));
+	message.reply(resp).then([this](pplx::task<void> t) { this->handle_error(t); });
+
+	// pread the range into the body, a file truncated during the send end the body early.
+	// cpprest own the socket, so this is not zero-copy: each chunk is pread into a vector
+	// and copied again into the producer_consumer_buffer
+	pplx::create_task([reader, buffer, file, start, length]() mutable
 		{
-			// Get the content length, which is used to set the
-			// Content-Length property
-			fileStream.seek(0, std::ios::end);
-			auto length = static_cast<size_t>(fileStream.tell());
-			fileStream.seek(0, std::ios::beg);
-
-			web::http::http_response resp(status_codes::OK);
-			resp.set_body(fileStream, length);
-			resp.headers().add(HTTP_HEADER_KEY_file_mode, os::fileStat(file));
-			resp.headers().add(HTTP_HEADER_KEY_file_user, os::fileUser(file));
-			message.reply(resp).then([this](pplx::task<void> t) { this->handle_error(t); });
-		}).then([=](pplx::task<void> t)
+			const static char fname[] = "RestHandler::apiFileDownload() ";
+
+			std::vector<uint8_t> chunk(std::min<size_t>(length, DEFAULT_FILE_STREAM_CHUNK_SIZE));
+			size_t offset = start;
+			const size_t end = start + length;
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(DEFAULT_FILE_STREAM_TIMEOUT);
+			try
 			{
-				try
+				while (offset < end)
 				{
-					t.get();
+					auto bytes = reader->read(offset, chunk.data(), std::min(chunk.size(), end - offset));
+					if (bytes <= 0) throw std::runtime_error(bytes < 0 ? std::strerror(errno) : "file truncated");
+					writeStream(buffer, chunk.data(), bytes, DEFAULT_FILE_STREAM_PENDING_CHUNKS * DEFAULT_FILE_STREAM_CHUNK_SIZE, DEFAULT_FILE_STREAM_MIN_RATE, deadline);
+					offset += bytes;
 				}
-				catch (...)
-				{
-					// opening the file (open_istream) failed.
-					// Reply with an error.
-					message.reply(status_codes::InternalError).then([this](pplx::task<void> t) { this->handle_error(t); });
-				}
-			});
+			}
+			catch (const std::exception& e)
+			{
+				LOG_WAR << fname << "Download file <" << file << "> stopped at <" << offset << "/" << end << "> :" << e.what();
+			}
+			buffer.close(std::ios_base::out).wait();
+		});
+}
+
+void RestHandler::writeStream(concurrency::streams::producer_consumer_buffer<uint8_t>& buffer, const uint8_t* data, size_t length,
+	size_t maxPending, size_t minRate, std::chrono::steady_clock::time_point& deadline)
+{
+	// back pressure: producer_consumer_buffer does not notify when the client read,
+	// so the pending size is polled with a growing interval instead of a fixed spin
+	auto interval = std::chrono::milliseconds(1);
+	while (buffer.in_avail() > maxPending)
+	{
+		if (std::chrono::steady_clock::now() > deadline) throw std::runtime_error("client read timeout");
+		std::this_thread::sleep_for(interval);
+		interval = std::min(interval * 2, std::chrono::milliseconds(50));
+	}
+	buffer.putn_nocopy(data, length).wait();
+	// not reset by each chunk, a client slower than minRate over the transfer time out
+	deadline += std::chrono::milliseconds(static_cast<long long>(length) * 1000 / minRate);
+}
+
+bool RestHandler::parseRange(const std::string& range, size_t size, size_t& start, size_t& length)
+{
+	// bytes=first-last, bytes=first-, bytes=-suffix
+	const std::string unit = "bytes=";
+	if (range.compare(0, unit.length(), unit) != 0) return false;
+	auto spec = Utility::stdStringTrim(range.substr(unit.length()));
+	auto dash = spec.find('-');
+	if (dash == std::string::npos || spec.find(',') != std::string::npos) return false;
+	auto first = spec.substr(0, dash);
+	auto last = spec.substr(dash + 1);
+	if ((first.length() && !Utility::isNumber(first)) || (last.length() && !Utility::isNumber(last))) return false;
+	if (first.empty())
+	{
+		if (last.empty()) return false;
+		auto suffix = std::min<unsigned long long>(std::stoull(last), size);
+		if (suffix == 0) return false;
+		start = size - suffix;
+		length = suffix;
+		return true;
+	}
+	auto begin = std::stoull(first);
+	if (begin >= size) return false;
+	auto end = last.empty() ? size - 1 : std::min<unsigned long long>(std::stoull(last), size - 1);
+	if (end < begin) return false;
+	start = begin;
+	length = end - begin + 1;
+	return true;
+}
+
+std::string RestHandler::contentDigest(const os::FileReader& reader)
+{
+	const static char fname[] = "RestHandler::contentDigest() ";
+
+	// full file digest is cached by file version, repeated download does not hash again
+	const auto version = reader.version();
+	{
+		std::lock_guard<std::mutex> guard(m_digestMutex);
+		auto iter = m_digestCache.find(version);
+		if (iter != m_digestCache.end()) return iter->second;
+	}
+	SHA256_CTX ctx;
+	SHA256_Init(&ctx);
+	std::vector<uint8_t> chunk(DEFAULT_FILE_STREAM_CHUNK_SIZE);
+	for (size_t offset = 0; offset < reader.size();)
+	{
+		auto bytes = reader.read(offset, chunk.data(), std::min(chunk.size(), reader.size() - offset));
+		if (bytes <= 0)
+		{
+			// changed while hashing, no digest rather than a wrong one
+			LOG_WAR << fname << "File changed while calculating digest, version <" << version << ">";
+			return std::string();
+		}
+		SHA256_Update(&ctx, chunk.data(), bytes);
+		offset += bytes;
+	}
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256_Final(hash, &ctx);
+	auto digest = Utility::encode64(std::string(reinterpret_cast<const char*>(hash), sizeof(hash)));
+	{
+		std::lock_guard<std::mutex> guard(m_digestMutex);
+		if (m_digestCache.size() >= MAX_DIGEST_CACHE_SIZE) m_digestCache.clear();
+		m_digestCache[version] = digest;
+	}
+	return digest;
 }
 
 void RestHandler::apiFileUpload(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiFileUpload() ";
-	permissionCheck(message, PERMISSION_KEY_file_upload);
+	permissionCheck(message, Permission::file_upload);
 	if (!message.headers().has(U(HTTP_HEADER_KEY_file_path)))
 	{
 		message.reply(status_codes::BadRequest, "file_path header not found");
@@ -575,19 +875,205 @@ void RestHandler::apiFileUpload(const HttpRequest& message)
 				});
 }
 
+void RestHandler::apiUploadSessionOpen(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	if (!message.headers().has(U(HTTP_HEADER_KEY_file_path)) || !message.headers().has(U(HTTP_HEADER_KEY_file_size)))
+	{
+		throw std::invalid_argument("file_path and file_size header are required");
+	}
+	auto file = GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_file_path))->second);
+	auto size = GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_file_size))->second);
+	if (!Utility::isNumber(size)) throw std::invalid_argument("invalid file_size");
+	int mode = message.headers().has(HTTP_HEADER_KEY_file_mode) ? std::stoi(message.headers().find(HTTP_HEADER_KEY_file_mode)->second) : 0;
+	auto user = message.headers().has(HTTP_HEADER_KEY_file_user) ? GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_file_user)->second) : std::string();
+
+	auto session = UploadManager::instance()->open(file, std::stoull(size), mode, user);
+	std::lock_guard<std::mutex> guard(session->m_mutex);
+	message.reply(status_codes::OK, session->AsJson());
+}
+
+void RestHandler::apiUploadSessionGet(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	auto session = UploadManager::instance()->get(message.getPathParam("id"));
+	std::lock_guard<std::mutex> guard(session->m_mutex);
+	message.reply(status_codes::OK, session->AsJson());
+}
+
+void RestHandler::apiUploadSessionChunk(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	auto session = UploadManager::instance()->get(message.getPathParam("id"));
+	auto querymap = web::uri::split_query(web::http::uri::decode(message.relative_uri().query()));
+	auto offset = querymap.find(U(HTTP_QUERY_KEY_offset));
+	if (offset == querymap.end() || !Utility::isNumber(GET_STD_STRING(offset->second)))
+	{
+		throw std::invalid_argument("offset query is required");
+	}
+	auto data = readBody(message, MAX_UPLOAD_CHUNK_SIZE);
+	UploadManager::instance()->write(session, std::stoull(GET_STD_STRING(offset->second)), data);
+	message.reply(status_codes::OK);
+}
+
+std::vector<unsigned char> RestHandler::readBody(const HttpRequest& message, size_t maxSize)
+{
+	const auto error = std::string("request body size should not exceed ") + std::to_string(maxSize);
+	if (message.headers().content_length() > maxSize) throw std::invalid_argument(error);
+
+	concurrency::streams::container_buffer<std::vector<unsigned char>> buffer;
+	auto body = message.body();
+	size_t total = 0;
+	while (true)
+	{
+		// read one byte over the limit at most
+		auto bytes = body.read(buffer, std::min<size_t>(DEFAULT_FILE_STREAM_CHUNK_SIZE, maxSize + 1 - total)).get();
+		if (bytes == 0) break;
+		total += bytes;
+		if (total > maxSize) throw std::invalid_argument(error);
+	}
+	return std::move(buffer.collection());
+}
+
+void RestHandler::apiUploadSessionCommit(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	if (!message.headers().has(HTTP_HEADER_KEY_Digest)) throw std::invalid_argument("Digest header is required");
+	auto session = UploadManager::instance()->get(message.getPathParam("id"));
+	// Digest: sha-256=base64
+	const std::string prefix = "sha-256=";
+	auto value = Utility::stdStringTrim(GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_Digest)->second));
+	if (value.compare(0, prefix.length(), prefix) != 0) throw std::invalid_argument("only sha-256 digest is supported");
+	auto digest = value.substr(prefix.length());
+	UploadManager::instance()->commit(session, digest);
+	message.reply(status_codes::OK, "Success");
+}
+
+void RestHandler::apiUploadSessionAbort(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	auto session = UploadManager::instance()->get(message.getPathParam("id"));
+	UploadManager::instance()->abort(session);
+	message.reply(status_codes::OK);
+}
+
+void RestHandler::apiArtifactView(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	auto hash = message.getPathParam("hash");
+	uint64_t size = 0;
+	if (!ArtifactStore::instance()->has(hash, size))
+	{
+		message.reply(status_codes::NotFound, "Artifact not found");
+		return;
+	}
+	web::json::value result = web::json::value::object();
+	result[JSON_KEY_ARTIFACT_hash] = web::json::value::string(hash);
+	result[JSON_KEY_ARTIFACT_size] = web::json::value::number(size);
+	message.reply(status_codes::OK, result);
+}
+
+void RestHandler::apiArtifactDeploy(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	if (!message.headers().has(U(HTTP_HEADER_KEY_file_path)))
+	{
+		throw std::invalid_argument("header file_path is required");
+	}
+	auto hash = message.getPathParam("hash");
+	uint64_t size = 0;
+	if (!ArtifactStore::instance()->has(hash, size))
+	{
+		// client should upload the content
+		message.reply(status_codes::NotFound, "Artifact not found");
+		return;
+	}
+	auto file = GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_file_path))->second);
+	int mode = message.headers().has(HTTP_HEADER_KEY_file_mode) ? std::stoi(message.headers().find(HTTP_HEADER_KEY_file_mode)->second) : 0;
+	auto user = message.headers().has(HTTP_HEADER_KEY_file_user) ? GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_file_user)->second) : std::string();
+
+	web::json::value result = web::json::value::object();
+	result[JSON_KEY_ARTIFACT_hash] = web::json::value::string(hash);
+	result[JSON_KEY_ARTIFACT_file_path] = web::json::value::string(file);
+	result[JSON_KEY_ARTIFACT_method] = web::json::value::string(ArtifactStore::instance()->deploy(hash, file, mode, user));
+	message.reply(status_codes::OK, result);
+}
+
+void RestHandler::apiFileDeltaSignature(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_download);
+	if (!message.headers().has(U(HTTP_HEADER_KEY_file_path)))
+	{
+		throw std::invalid_argument("header file_path is required");
+	}
+	auto file = GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_file_path))->second);
+	// live file may be truncated while read, pread instead of mapping it
+	os::FileReader base(file);
+	if (!base.valid())
+	{
+		// nothing to diff against, client upload the full content
+		message.reply(status_codes::NotFound, "File not found");
+		return;
+	}
+	const auto blockSize = DeltaSync::blockSize(base.size());
+	const auto signatures = DeltaSync::signatures([&base](uint64_t offset, unsigned char* buffer, size_t length) -> size_t
+		{
+			auto bytes = base.read(offset, buffer, length);
+			if (bytes < 0) throw std::invalid_argument(std::string("failed to read file :") + std::strerror(errno));
+			return bytes;
+		}, base.size(), blockSize);
+
+	JsonWriter writer(false);
+	writer.startObject();
+	writer.key(JSON_KEY_DELTA_file_size).value(static_cast<long long>(base.size()));
+	writer.key(JSON_KEY_DELTA_block_size).value(static_cast<long long>(blockSize));
+	// [weak, "strong hex"]
+	writer.key(JSON_KEY_DELTA_blocks).startArray();
+	char strong[32] = { 0 };
+	for (const auto& signature : signatures)
+	{
+		std::snprintf(strong, sizeof(strong), "%016llx", static_cast<unsigned long long>(signature.m_strong));
+		writer.startArray().value(static_cast<long long>(signature.m_weak)).value(strong).endArray();
+	}
+	writer.endArray();
+	writer.endObject();
+	message.reply(status_codes::OK, std::move(writer.str()), "application/json");
+}
+
+void RestHandler::apiFileDelta(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::file_upload);
+	if (!message.headers().has(U(HTTP_HEADER_KEY_file_path)) || !message.headers().has(U(HTTP_HEADER_KEY_block_size)) || !message.headers().has(U(HTTP_HEADER_KEY_Digest)))
+	{
+		throw std::invalid_argument("file_path, block_size and Digest header are required");
+	}
+	auto file = GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_file_path))->second);
+	auto blockSize = GET_STD_STRING(message.headers().find(U(HTTP_HEADER_KEY_block_size))->second);
+	if (!Utility::isNumber(blockSize)) throw std::invalid_argument("invalid block_size");
+	int mode = message.headers().has(HTTP_HEADER_KEY_file_mode) ? std::stoi(message.headers().find(HTTP_HEADER_KEY_file_mode)->second) : 0;
+	auto user = message.headers().has(HTTP_HEADER_KEY_file_user) ? GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_file_user)->second) : std::string();
+	// Digest: sha-256=base64
+	const std::string prefix = "sha-256=";
+	auto digest = Utility::stdStringTrim(GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_Digest)->second));
+	if (digest.compare(0, prefix.length(), prefix) != 0) throw std::invalid_argument("only sha-256 digest is supported");
+
+	auto delta = readBody(message, MAX_FILE_DELTA_SIZE);
+	UploadManager::instance()->applyDelta(file, std::stoul(blockSize), delta, mode, user, digest.substr(prefix.length()));
+	message.reply(status_codes::OK, "Success");
+}
+
 void RestHandler::apiGetLabels(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_label_view);
-	message.reply(status_codes::OK, Configuration::instance()->getLabel()->AsJson());
+	permissionCheck(message, Permission::label_view);
+	auto label = Configuration::instance()->getLabel();
+	replyCachedView(message, m_labelsView, std::to_string(label->getVersion()), [&label]() { return GET_STD_STRING(label->AsJson().serialize()); });
 }
 
 void RestHandler::apiAddLabel(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_label_set);
+	permissionCheck(message, Permission::label_set);
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	auto vec = Utility::splitString(path, "/");
-	auto labelKey = vec[vec.size() - 1];
+	const auto& labelKey = message.getPathParam("label");
 	auto querymap = web::uri::split_query(web::http::uri::decode(message.relative_uri().query()));
 	if (querymap.find(U(HTTP_QUERY_KEY_label_value)) != querymap.end())
 	{
@@ -606,11 +1092,9 @@ void RestHandler::apiAddLabel(const HttpRequest& message)
 
 void RestHandler::apiDeleteLabel(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_label_delete);
+	permissionCheck(message, Permission::label_delete);
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	auto vec = Utility::splitString(path, "/");
-	auto labelKey = vec[vec.size() - 1];
+	const auto& labelKey = message.getPathParam("label");
 
 	Configuration::instance()->getLabel()->delLabel(labelKey);
 	Configuration::instance()->saveConfigToDisk();
@@ -633,18 +1117,23 @@ void RestHandler::apiGetUserPermissions(const HttpRequest& message)
 
 void RestHandler::apiGetBasicConfig(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_config_view);
-
-	auto config = Configuration::instance()->AsJson(false);
-	if (HAS_JSON_FIELD(config, JSON_KEY_Security) && HAS_JSON_FIELD(config.at(JSON_KEY_Security), JSON_KEY_JWT_Users))
-		config.at(JSON_KEY_Security).erase(JSON_KEY_JWT_Users);
+	permissionCheck(message, Permission::config_view);
 
-	message.reply(status_codes::OK, config);
+	auto configuration = Configuration::instance();
+	const auto version = std::to_string(configuration->getConfigVersion()) + "." +
+		std::to_string(configuration->getLabel()->getVersion()) + "." + std::to_string(configuration->getAppsVersion());
+	replyCachedView(message, m_configView, version, [&configuration]()
+		{
+			auto config = configuration->AsJson(false);
+			if (HAS_JSON_FIELD(config, JSON_KEY_Security) && HAS_JSON_FIELD(config.at(JSON_KEY_Security), JSON_KEY_JWT_Users))
+				config.at(JSON_KEY_Security).erase(JSON_KEY_JWT_Users);
+			return GET_STD_STRING(config.serialize());
+		});
 }
 
 void RestHandler::apiSetBasicConfig(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_config_set);
+	permissionCheck(message, Permission::config_set);
 
 	auto json = message.extract_json().get();
 	// do not allow users update from host-update API
@@ -662,15 +1151,9 @@ void RestHandler::apiUserChangePwd(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiUserChangePwd() ";
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	permissionCheck(message, PERMISSION_KEY_change_passwd);
+	permissionCheck(message, Permission::change_passwd);
 
-	auto vec = Utility::splitString(path, "/");
-	if (vec.size() != 4)
-	{
-		throw std::invalid_argument("failed to get user name from path");
-	}
-	auto pathUserName = vec[2];
+	const auto& pathUserName = message.getPathParam("user");
 	auto tokenUserName = getTokenUser(message);
 	if (!message.headers().has(HTTP_HEADER_JWT_new_password))
 	{
@@ -695,7 +1178,7 @@ void RestHandler::apiUserChangePwd(const HttpRequest& message)
 	Configuration::instance()->saveConfigToDisk();
 	ConsulConnection::instance()->saveSecurity();
 
-	LOG_INF << fname << "User <" << uname << "> changed password";
+	LOG_INF << fname << "User <" << pathUserName << "> changed password";
 	message.reply(status_codes::OK, "password changed success");
 }
 
@@ -703,15 +1186,9 @@ void RestHandler::apiUserLock(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiUserLock() ";
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	permissionCheck(message, PERMISSION_KEY_lock_user);
+	permissionCheck(message, Permission::lock_user);
 
-	auto vec = Utility::splitString(path, "/");
-	if (vec.size() != 4)
-	{
-		throw std::invalid_argument("failed to get user name from path");
-	}
-	auto pathUserName = vec[2];
+	const auto& pathUserName = message.getPathParam("user");
 	auto tokenUserName = getTokenUser(message);
 
 	if (pathUserName == JWT_ADMIN_NAME)
@@ -728,7 +1205,7 @@ void RestHandler::apiUserLock(const HttpRequest& message)
 	Configuration::instance()->saveConfigToDisk();
 	ConsulConnection::instance()->saveSecurity();
 
-	LOG_INF << fname << "User <" << uname << "> locked by " << tokenUserName;
+	LOG_INF << fname << "User <" << pathUserName << "> locked by " << tokenUserName;
 	message.reply(status_codes::OK);
 }
 
@@ -736,15 +1213,9 @@ void RestHandler::apiUserUnlock(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiUserUnlock() ";
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	permissionCheck(message, PERMISSION_KEY_lock_user);
+	permissionCheck(message, Permission::lock_user);
 
-	auto vec = Utility::splitString(path, "/");
-	if (vec.size() != 4)
-	{
-		throw std::invalid_argument("failed to get user name from path");
-	}
-	auto pathUserName = vec[2];
+	const auto& pathUserName = message.getPathParam("user");
 	auto tokenUserName = getTokenUser(message);
 	//if (tokenUserName != JWT_ADMIN_NAME)
 	//{
@@ -756,7 +1227,7 @@ void RestHandler::apiUserUnlock(const HttpRequest& message)
 	Configuration::instance()->saveConfigToDisk();
 	ConsulConnection::instance()->saveSecurity();
 
-	LOG_INF << fname << "User <" << uname << "> unlocked by " << tokenUserName;
+	LOG_INF << fname << "User <" << pathUserName << "> unlocked by " << tokenUserName;
 	message.reply(status_codes::OK);
 }
 
@@ -764,15 +1235,9 @@ void RestHandler::apiUserAdd(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiUserAdd() ";
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	permissionCheck(message, PERMISSION_KEY_add_user);
+	permissionCheck(message, Permission::add_user);
 
-	auto vec = Utility::splitString(path, "/");
-	if (vec.size() != 3)
-	{
-		throw std::invalid_argument("failed to get user name from path");
-	}
-	auto pathUserName = vec[2];
+	const auto& pathUserName = message.getPathParam("user");
 	auto tokenUserName = getTokenUser(message);
 
 	auto user = Configuration::instance()->getUsers()->addUser(pathUserName, message.extract_json(true).get(), Configuration::instance()->getRoles());
@@ -790,15 +1255,9 @@ void RestHandler::apiUserDel(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiUserDel() ";
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	permissionCheck(message, PERMISSION_KEY_delete_user);
+	permissionCheck(message, Permission::delete_user);
 
-	auto vec = Utility::splitString(path, "/");
-	if (vec.size() != 3)
-	{
-		throw std::invalid_argument("failed to get user name from path");
-	}
-	auto pathUserName = vec[2];
+	const auto& pathUserName = message.getPathParam("user");
 	auto tokenUserName = getTokenUser(message);
 
 	Configuration::instance()->getUsers()->delUser(pathUserName);
@@ -812,7 +1271,7 @@ void RestHandler::apiUserDel(const HttpRequest& message)
 
 void RestHandler::apiUserList(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_get_users);
+	permissionCheck(message, Permission::get_users);
 
 	auto users = Configuration::instance()->getUsers()->AsJson();
 	for (auto& user : users.as_object())
@@ -825,7 +1284,7 @@ void RestHandler::apiUserList(const HttpRequest& message)
 
 void RestHandler::apiRoleView(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_role_view);
+	permissionCheck(message, Permission::role_view);
 
 	message.reply(status_codes::OK, Configuration::instance()->getRoles()->AsJson());
 }
@@ -834,15 +1293,9 @@ void RestHandler::apiRoleUpdate(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiRoleUpdate() ";
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	permissionCheck(message, PERMISSION_KEY_role_update);
+	permissionCheck(message, Permission::role_update);
 
-	auto vec = Utility::splitString(path, "/");
-	if (vec.size() != 3)
-	{
-		throw std::invalid_argument("failed to get role name from path");
-	}
-	auto pathRoleName = vec[2];
+	const auto& pathRoleName = message.getPathParam("role");
 	auto tokenUserName = getTokenUser(message);
 
 	//if (tokenUserName == JWT_ADMIN_NAME)
@@ -863,15 +1316,9 @@ void RestHandler::apiRoleDelete(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiRoleDelete() ";
 
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	permissionCheck(message, PERMISSION_KEY_role_delete);
+	permissionCheck(message, Permission::role_delete);
 
-	auto vec = Utility::splitString(path, "/");
-	if (vec.size() != 3)
-	{
-		throw std::invalid_argument("failed to get role name from path");
-	}
-	auto pathRoleName = vec[2];
+	const auto& pathRoleName = message.getPathParam("role");
 	auto tokenUserName = getTokenUser(message);
 
 	//if (tokenUserName == JWT_ADMIN_NAME)
@@ -890,7 +1337,7 @@ void RestHandler::apiRoleDelete(const HttpRequest& message)
 
 void RestHandler::apiListPermissions(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_permission_list);
+	permissionCheck(message, Permission::permission_list);
 
 	auto permissions = Configuration::instance()->getAllPermissions();
 	auto json = web::json::value::array(permissions.size());
@@ -904,11 +1351,7 @@ void RestHandler::apiListPermissions(const HttpRequest& message)
 
 void RestHandler::apiHealth(const HttpRequest& message)
 {
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	// /appmgr/app/$app-name/health
-	std::string appName = path.substr(strlen("/appmgr/app/"));
-	appName = appName.substr(0, appName.find_last_of('/'));
-	auto health = Configuration::instance()->getApp(appName)->getHealth();
+	auto health = Configuration::instance()->getApp(message.getPathParam("name"))->getHealth();
 	http::status_code status = status_codes::OK;
 	if (health != 0) status = status_codes::NotAcceptable;
 	message.reply(status, std::to_string(health));
@@ -921,9 +1364,8 @@ void RestHandler::apiMetrics(const HttpRequest& message)
 
 void RestHandler::apiPostWatch(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_consul_watch);
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	std::string type = path.substr(strlen("/appmgr/watch/"));
+	permissionCheck(message, Permission::consul_watch);
+	const auto& type = message.getPathParam("type");
 	if (type == "security")
 	{
 		message.reply(status_codes::OK, "success");
@@ -1030,63 +1472,83 @@ void RestHandler::apiAuth(const HttpRequest& message)
 
 void RestHandler::apiGetApp(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_view_app);
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-	std::string app = path.substr(strlen("/appmgr/app/"));
-	message.reply(status_codes::OK, Utility::prettyJson(GET_STD_STRING(Configuration::instance()->getApp(app)->AsJson(true).serialize())));
+	permissionCheck(message, Permission::view_app);
+	const auto& app = message.getPathParam("name");
+	JsonWriter writer(true);
+	writer.value(Configuration::instance()->getApp(app)->AsJson(true));
+	message.reply(status_codes::OK, std::move(writer.str()), "application/json");
 }
 
-std::shared_ptr<Application> RestHandler::apiRunParseApp(const HttpRequest& message)
+bool RestHandler::apiRunPermit(const HttpRequest& message, const web::json::value& jsonApp)
 {
-	auto jsonApp = const_cast<HttpRequest*>(&message)->extract_json(true).get();
-	// force specify a UUID app name
-	auto appName = Utility::createUUID();
-	jsonApp[JSON_KEY_APP_name] = web::json::value::string(appName);
-	jsonApp[JSON_KEY_APP_status] = web::json::value::number(static_cast<int>(Application::STATUS::NOTAVIALABLE));
-	jsonApp[JSON_KEY_APP_cache_lines] = web::json::value::number(MAX_APP_CACHED_LINES);
-	return Configuration::instance()->addApp(jsonApp);
+	// priority is never taken from the request body, a run of a defined application use its priority
+	int priority = 0;
+	const auto name = GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_name);
+	auto config = Configuration::instance();
+	if (name.length() && config->isAppExist(name)) priority = config->getApp(name)->getPriority();
+	if (ResourceCollection::instance()->spawnPermit(priority)) return true;
+	// each refused run is one postponed start, the client decide to retry
+	ResourceCollection::instance()->countSpawnDelayed();
+	http_response response(HTTP_STATUS_TOO_MANY_REQUESTS);
+	response.headers().add(HTTP_HEADER_KEY_Retry_After, std::to_string(DEFAULT_RESOURCE_FAST_INTERVAL));
+	response.set_body("Run delayed by host pressure");
+	message.reply(response);
+	return false;
 }
 
 void RestHandler::apiRunAsync(const HttpRequest& message)
 {
-	const static char fname[] = "RestHandler::apiAsyncRun() ";
-	permissionCheck(message, PERMISSION_KEY_run_app_async);
+	permissionCheck(message, Permission::run_app_async);
 
 	int retention = getHttpQueryValue(message, HTTP_QUERY_KEY_retention, DEFAULT_RUN_APP_RETENTION_DURATION, 1, 60 * 60 * 24);
 	int timeout = getHttpQueryValue(message, HTTP_QUERY_KEY_timeout, DEFAULT_RUN_APP_TIMEOUT_SECONDS, 1, 60 * 60 * 24);
-	auto appObj = apiRunParseApp(message);
-
-	auto processUuid = appObj->runAsyncrize(timeout);
+	auto jsonApp = const_cast<HttpRequest*>(&message)->extract_json(true).get();
+	if (!apiRunPermit(message, jsonApp)) return;
+	std::string processUuid;
+	if (getHttpQueryValue(message, HTTP_QUERY_KEY_pool, false, 0, 0) && ShellWorkerPool::instance()->accept(jsonApp))
+	{
+		processUuid = ShellWorkerPool::instance()->submit(jsonApp, timeout, retention, nullptr)->m_uuid;
+	}
+	else
+	{
+		processUuid = RunRegistry::instance()->run(jsonApp, timeout, retention, nullptr);
+	}
+	// run is not an application, the process uuid is used as app name for output query
 	auto result = web::json::value::object();
-	result[JSON_KEY_APP_name] = web::json::value::string(appObj->getName());
+	result[JSON_KEY_APP_name] = web::json::value::string(processUuid);
 	result[HTTP_QUERY_KEY_process_uuid] = web::json::value::string(processUuid);
 	message.reply(status_codes::OK, result);
-
-	// clean reference from timer
-	appObj->registerTimer(1000L * (timeout + retention), 0, std::bind(&Application::onSuicideEvent, appObj, std::placeholders::_1), fname);
 }
 
 void RestHandler::apiRunSync(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_run_app_sync);
+	permissionCheck(message, Permission::run_app_sync);
 
 	int timeout = getHttpQueryValue(message, HTTP_QUERY_KEY_timeout, DEFAULT_RUN_APP_TIMEOUT_SECONDS, 1, 60 * 60 * 24);
-	auto appObj = apiRunParseApp(message);
+	auto jsonApp = const_cast<HttpRequest*>(&message)->extract_json(true).get();
+	if (!apiRunPermit(message, jsonApp)) return;
+	if (getHttpQueryValue(message, HTTP_QUERY_KEY_pool, false, 0, 0) && ShellWorkerPool::instance()->accept(jsonApp))
+	{
+		// replied from the worker reader thread
+		auto asyncRequest = std::make_shared<HttpRequest>(message);
+		ShellWorkerPool::instance()->submit(jsonApp, timeout, 0, [asyncRequest](const std::string& output, int exitCode)
+			{
+				web::http::http_response resp(status_codes::OK);
+				resp.set_body(output);
+				resp.headers().add(HTTP_HEADER_KEY_exit_code, exitCode);
+				asyncRequest->reply(resp).get();
+			});
+		return;
+	}
 
 	// Use async reply here
-	HttpRequest* asyncRequest = new HttpRequestWithAppRef(message, appObj);
-	appObj->runSyncrize(timeout, asyncRequest);
+	RunRegistry::instance()->run(jsonApp, timeout, DEFAULT_RUN_APP_RETENTION_DURATION, new HttpRequest(message));
 }
 
 void RestHandler::apiRunAsyncOut(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiAsyncRunOut() ";
-	permissionCheck(message, PERMISSION_KEY_run_app_async_output);
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-
-	// /appmgr/app/$app-name/run?timeout=5
-	std::string app = path.substr(strlen("/appmgr/app/"));
-	app = app.substr(0, app.find_first_of('/'));
+	permissionCheck(message, Permission::run_app_async_output);
 
 	auto querymap = web::uri::split_query(web::http::uri::decode(message.relative_uri().query()));
 	if (querymap.find(U(HTTP_QUERY_KEY_process_uuid)) != querymap.end())
@@ -1095,16 +1557,18 @@ void RestHandler::apiRunAsyncOut(const HttpRequest& message)
 
 		int exitCode = 0;
 		bool finished = false;
-		auto appObj = Configuration::instance()->getApp(app);
-		std::string body = appObj->getAsyncRunOutput(uuid, exitCode, finished);
+		std::string body;
+		if (!ShellWorkerPool::instance()->fetchOutput(uuid, body, exitCode, finished) &&
+			!RunRegistry::instance()->fetchOutput(uuid, body, exitCode, finished))
+		{
+			throw std::invalid_argument("No corresponding process running or the given process uuid is wrong");
+		}
 		web::http::http_response resp(status_codes::OK);
 		resp.set_body(body);
 		if (finished)
 		{
 			resp.set_status_code(status_codes::Created);
 			resp.headers().add(HTTP_HEADER_KEY_exit_code, exitCode);
-			// remove temp app immediately
-			if (!appObj->isWorkingState()) Configuration::instance()->removeApp(app);
 		}
 
 		LOG_DBG << fname << "Use process uuid :" << uuid << " exit_code:" << exitCode;
@@ -1121,12 +1585,8 @@ void RestHandler::apiGetAppOutput(const HttpRequest& message)
 {
 	const static char fname[] = "RestHandler::apiGetAppOutput() ";
 
-	permissionCheck(message, PERMISSION_KEY_view_app_output);
-	auto path = GET_STD_STRING(http::uri::decode(message.relative_uri().path()));
-
-	// /app/$app-name/output
-	std::string app = path.substr(strlen("/appmgr/app/"));
-	app = app.substr(0, app.find_first_of('/'));
+	permissionCheck(message, Permission::view_app_output);
+	const auto& app = message.getPathParam("name");
 	bool keepHis = getHttpQueryValue(message, HTTP_QUERY_KEY_keep_history, false, 0, 0);
 	auto output = Configuration::instance()->getApp(app)->getOutput(keepHis);
 	LOG_DBG << fname;// << output;
@@ -1135,20 +1595,129 @@ void RestHandler::apiGetAppOutput(const HttpRequest& message)
 
 void RestHandler::apiGetApps(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_view_all_app);
-	message.reply(status_codes::OK, Configuration::instance()->getApplicationJson(true));
+	permissionCheck(message, Permission::view_all_app);
+	auto configuration = Configuration::instance();
+	auto querymap = web::uri::split_query(web::http::uri::decode(message.relative_uri().query()));
+	if (querymap.empty())
+	{
+		const auto version = std::to_string(configuration->getAppsVersion());
+		replyCachedView(message, m_appsView, version, [&configuration]()
+			{
+				// write to string without build the json array
+				Configuration::AppQuery all;
+				size_t total = 0;
+				JsonWriter writer(false);
+				all.write(writer, configuration->getApps(all, total));
+				return std::move(writer.str());
+			});
+		return;
+	}
+
+	auto intQuery = [&querymap](const std::string& key, int min, int max) -> int
+	{
+		auto iter = querymap.find(U(key));
+		if (iter == querymap.end()) return -1;
+		auto value = Utility::isNumber(GET_STD_STRING(iter->second)) ? std::stoi(GET_STD_STRING(iter->second)) : -1;
+		if (value < min || value > max) throw std::invalid_argument(std::string("invalid query value for <") + key + ">");
+		return value;
+	};
+	Configuration::AppQuery query;
+	query.m_status = intQuery(HTTP_QUERY_KEY_status, static_cast<int>(Application::STATUS::DISABLED), static_cast<int>(Application::STATUS::UNINITIALIZING));
+	query.m_docker = intQuery(HTTP_QUERY_KEY_docker, 0, 1);
+	query.m_health = intQuery(HTTP_QUERY_KEY_health, 0, 1);
+	query.m_offset = std::max(intQuery(HTTP_QUERY_KEY_offset, 0, std::numeric_limits<int>::max()), 0);
+	query.m_limit = std::max(intQuery(HTTP_QUERY_KEY_limit, 0, std::numeric_limits<int>::max()), 0);
+	if (querymap.count(U(HTTP_QUERY_KEY_user))) query.m_user = GET_STD_STRING(querymap.find(U(HTTP_QUERY_KEY_user))->second);
+	if (querymap.count(U(HTTP_QUERY_KEY_name_prefix))) query.m_namePrefix = GET_STD_STRING(querymap.find(U(HTTP_QUERY_KEY_name_prefix))->second);
+	if (querymap.count(U(HTTP_QUERY_KEY_fields)))
+	{
+		for (const auto& field : Utility::splitString(GET_STD_STRING(querymap.find(U(HTTP_QUERY_KEY_fields))->second), ","))
+		{
+			auto name = Utility::stdStringTrim(field);
+			if (name.length()) query.m_fields.insert(name);
+		}
+	}
+
+	size_t total = 0;
+	auto apps = configuration->getApps(query, total);
+	http_response response(status_codes::OK);
+	response.headers().add(HTTP_HEADER_KEY_total_count, total);
+	replyJsonStream(message, response, [&query, &apps](JsonWriter& writer) { query.write(writer, apps); });
+}
+
+void RestHandler::apiGetEvents(const HttpRequest& message)
+{
+	permissionCheck(message, Permission::view_all_app);
+	auto querymap = web::uri::split_query(web::http::uri::decode(message.relative_uri().query()));
+	auto listQuery = [&querymap](const std::string& key, std::set<std::string>& values)
+	{
+		auto iter = querymap.find(U(key));
+		if (iter == querymap.end()) return;
+		for (const auto& item : Utility::splitString(GET_STD_STRING(iter->second), ","))
+		{
+			auto value = Utility::stdStringTrim(item);
+			if (value.length()) values.insert(value);
+		}
+	};
+	EventBus::Filter filter;
+	listQuery(HTTP_QUERY_KEY_app, filter.m_apps);
+	listQuery(HTTP_QUERY_KEY_type, filter.m_types);
+	for (const auto& type : filter.m_types)
+	{
+		if (!EventBus::isEventType(type)) throw std::invalid_argument(std::string("invalid event type <") + type + ">");
+	}
+
+	// resume after the sequence, SSE client reconnect with Last-Event-ID
+	std::string since;
+	if (querymap.count(U(HTTP_QUERY_KEY_since))) since = GET_STD_STRING(querymap.find(U(HTTP_QUERY_KEY_since))->second);
+	else if (message.headers().has(HTTP_HEADER_KEY_Last_Event_ID)) since = GET_STD_STRING(message.headers().find(HTTP_HEADER_KEY_Last_Event_ID)->second);
+	since = Utility::stdStringTrim(since);
+	if (since.length() && !Utility::isNumber(since)) throw std::invalid_argument("invalid query value for <since>");
+	const long long sinceSeq = since.length() ? std::stoll(since) : -1;
+
+	int timeout = DEFAULT_EVENT_STREAM_TIMEOUT;
+	if (querymap.count(U(HTTP_QUERY_KEY_timeout)))
+	{
+		const auto value = GET_STD_STRING(querymap.find(U(HTTP_QUERY_KEY_timeout))->second);
+		timeout = Utility::isNumber(value) ? std::stoi(value) : 0;
+		if (timeout < 1 || timeout > MAX_EVENT_STREAM_TIMEOUT) throw std::invalid_argument("invalid query value for <timeout>");
+	}
+
+	// NDJSON unless SSE is asked by format or Accept
+	bool sse = message.headers().has(web::http::header_names::accept) &&
+		GET_STD_STRING(message.headers().find(web::http::header_names::accept)->second).find("text/event-stream") != std::string::npos;
+	if (querymap.count(U(HTTP_QUERY_KEY_format)))
+	{
+		const auto format = GET_STD_STRING(querymap.find(U(HTTP_QUERY_KEY_format))->second);
+		if (format != "sse" && format != "ndjson") throw std::invalid_argument("invalid query value for <format>, sse or ndjson");
+		sse = (format == "sse");
+	}
+
+	// no content length, events are sent with chunked transfer by the event dispatcher
+	http_response response(status_codes::OK);
+	response.set_body(EventBus::instance()->subscribe(filter, sse, sinceSeq, timeout), sse ? "text/event-stream" : "application/x-ndjson");
+	response.headers().add(web::http::header_names::cache_control, "no-cache");
+	message.reply(response);
 }
 
 void RestHandler::apiGetResources(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_view_host_resource);
-	message.reply(status_codes::OK, Utility::prettyJson(GET_STD_STRING(ResourceCollection::instance()->AsJson().serialize())));
+	permissionCheck(message, Permission::view_host_resource);
+	message.reply(status_codes::OK, ResourceCollection::instance()->getSnapshotString());
 }
 
 void RestHandler::apiRegApp(const HttpRequest& message)
 {
-	permissionCheck(message, PERMISSION_KEY_app_reg);
+	permissionCheck(message, Permission::app_reg);
 	auto jsonApp = message.extract_json(true).get();
+	auto app = registerApp(jsonApp);
+	JsonWriter writer(true);
+	writer.value(app->AsJson(false));
+	message.reply(status_codes::OK, std::move(writer.str()), "application/json");
+}
+
+std::shared_ptr<Application> RestHandler::registerApp(web::json::value& jsonApp)
+{
 	if (jsonApp.is_null())
 	{
 		throw std::invalid_argument("invalid json format");
@@ -1168,8 +1737,119 @@ void RestHandler::apiRegApp(const HttpRequest& message)
 	{
 		throw std::invalid_argument("not allowed for internal and cluster application");
 	}
-	auto app = Configuration::instance()->addApp(jsonApp);
-	message.reply(status_codes::OK, Utility::prettyJson(GET_STD_STRING(app->AsJson(false).serialize())));
+	return Configuration::instance()->addApp(jsonApp);
+}
+
+void RestHandler::apiBatchApps(const HttpRequest& message)
+{
+	const static char fname[] = "RestHandler::apiBatchApps() ";
+
+	auto body = message.extract_json(true).get();
+	if (!HAS_JSON_FIELD(body, JSON_KEY_BATCH_operations) || !body.at(JSON_KEY_BATCH_operations).is_array())
+	{
+		throw std::invalid_argument("operations array is required");
+	}
+	const auto& operations = body.at(JSON_KEY_BATCH_operations).as_array();
+	const bool rollback = GET_JSON_BOOL_VALUE(body, JSON_KEY_BATCH_rollback);
+	auto config = Configuration::instance();
+
+	auto results = web::json::value::array(operations.size());
+	// compensation of each applied operation, run in reverse order for rollback
+	std::vector<std::function<void()>> undoList;
+	bool failed = false;
+	bool rolledBack = false;
+	{
+		// other application changes wait until the batch end, rollback never overwrites them
+		Configuration::Transaction transaction(config);
+		size_t index = 0;
+		for (const auto& operation : operations)
+		{
+			auto& result = results[index++];
+			result = web::json::value::object();
+			const auto action = GET_JSON_STR_VALUE(operation, JSON_KEY_BATCH_action);
+			const auto jsonApp = HAS_JSON_FIELD(operation, JSON_KEY_BATCH_app) ? operation.at(JSON_KEY_BATCH_app) : web::json::value::null();
+			const auto appName = (action == JSON_KEY_BATCH_action_reg) ? GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_name) : GET_JSON_STR_VALUE(operation, JSON_KEY_APP_name);
+			result[JSON_KEY_BATCH_action] = web::json::value::string(action);
+			result[JSON_KEY_APP_name] = web::json::value::string(appName);
+			if (failed && rollback)
+			{
+				result[JSON_KEY_BATCH_status] = web::json::value::number(status_codes::PreconditionFailed);
+				result[JSON_KEY_BATCH_message] = web::json::value::string("skipped");
+				continue;
+			}
+			try
+			{
+				if (action == JSON_KEY_BATCH_action_reg)
+				{
+					permissionCheck(message, Permission::app_reg);
+					auto previous = config->isAppExist(appName) ? config->getApp(appName)->AsJson(false) : web::json::value::null();
+					auto regJson = jsonApp;
+					registerApp(regJson);
+					undoList.push_back([config, appName, previous]()
+						{
+							if (previous.is_null()) config->removeApp(appName);
+							else config->addApp(previous);
+						});
+				}
+				else if (action == JSON_KEY_BATCH_action_enable || action == JSON_KEY_BATCH_action_disable)
+				{
+					permissionCheck(message, Permission::app_control);
+					const bool enable = (action == JSON_KEY_BATCH_action_enable);
+					const bool wasEnabled = config->getApp(appName)->isEnabled();
+					if (enable) config->enableApp(appName);
+					else config->disableApp(appName);
+					undoList.push_back([config, appName, wasEnabled]()
+						{
+							if (wasEnabled) config->enableApp(appName);
+							else config->disableApp(appName);
+						});
+				}
+				else if (action == JSON_KEY_BATCH_action_delete)
+				{
+					permissionCheck(message, Permission::app_delete);
+					if (config->isSystemInternalApp(appName)) throw std::invalid_argument("not allowed for internal and cluster application");
+					auto previous = config->getApp(appName)->AsJson(false);
+					config->removeApp(appName);
+					undoList.push_back([config, previous]() { config->addApp(previous); });
+				}
+				else
+				{
+					throw std::invalid_argument(std::string("unsupported action <") + action + ">");
+				}
+				result[JSON_KEY_BATCH_status] = web::json::value::number(status_codes::OK);
+				result[JSON_KEY_BATCH_message] = web::json::value::string("success");
+			}
+			catch (const std::exception& e)
+			{
+				failed = true;
+				result[JSON_KEY_BATCH_status] = web::json::value::number(status_codes::BadRequest);
+				result[JSON_KEY_BATCH_message] = web::json::value::string(e.what());
+			}
+		}
+
+		if (failed && rollback)
+		{
+			LOG_WAR << fname << "Rollback <" << undoList.size() << "> applied operations";
+			for (auto undo = undoList.rbegin(); undo != undoList.rend(); ++undo)
+			{
+				try
+				{
+					(*undo)();
+				}
+				catch (const std::exception& e)
+				{
+					LOG_ERR << fname << "Rollback operation failed :" << e.what();
+				}
+			}
+			rolledBack = true;
+		}
+		// configuration is persisted once when transaction end
+	}
+
+	auto response = web::json::value::object();
+	response[JSON_KEY_BATCH_results] = results;
+	response[JSON_KEY_BATCH_rolled_back] = web::json::value::boolean(rolledBack);
+	message.reply(failed ? status_codes::BadRequest : status_codes::OK, response);
 }
 
 void RestHandler::initMetrics(std::shared_ptr<PrometheusRest> prom)
@@ -1181,6 +1861,7 @@ void RestHandler::initMetrics(std::shared_ptr<PrometheusRest> prom)
 	m_restPutCounter = nullptr;
 	m_restDelCounter = nullptr;
 	m_restPostCounter = nullptr;
+	m_routeMetrics.clear();
 
 	// update
 	if (prom)
@@ -1201,5 +1882,11 @@ void RestHandler::initMetrics(std::shared_ptr<PrometheusRest> prom)
 			PROM_METRIC_NAME_appmgr_http_request_count, PROM_METRIC_HELP_appmgr_http_request_count,
 			{ {"method", "POST"}, { "listen", m_listenAddress } }
 		);
+		// route pattern instead of raw path as label
+		for (const auto& route : m_routes)
+		{
+			m_routeMetrics[route.first + " " + route.second] = std::make_shared<RouteMetrics>(*prom,
+				std::map<std::string, std::string>{ {"method", route.first}, { "route", route.second }, { "listen", m_listenAddress } });
+		}
 	}
 }
@@ -1,14 +1,24 @@
 #pragma once
 
+#include <chrono>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <functional>
+#include <vector>
 #include <cpprest/http_listener.h> // HTTP server 
+#include <cpprest/producerconsumerstream.h>
 #include "../common/HttpRequest.h"
+#include "../common/RestRouter.h"
+#include "TokenCache.h"
 
 class CounterPtr;
 class PrometheusRest;
+class RouteMetrics;
 class Application;
 class HttpRequest;
+class JsonWriter;
+namespace os { class FileReader; }
 //////////////////////////////////////////////////////////////////////////
 /// REST service
 //////////////////////////////////////////////////////////////////////////
@@ -19,13 +29,23 @@ public:
 	virtual ~RestHandler();
 
 	void initMetrics(std::shared_ptr<PrometheusRest> prom);
+	// Handle a request not received by the cpprest listener (local socket)
+	void dispatch(const http_request& message);
+	std::string createToken(const std::string& uname, const std::string& passwd, int timeoutSeconds);
 
 protected:
 	void open();
 	void close();
 
 private:
-	void handleRest(const http_request& message, const std::map<std::string, std::function<void(const HttpRequest&)>>& restFunctions);
+	// handler and route name "METHOD /pattern" used as metrics key
+	struct RestRoute
+	{
+		std::string m_name;
+		std::function<void(const HttpRequest&)> m_handler;
+	};
+	typedef RestRouter<RestRoute> RestFunctions;
+	void handleRest(const http_request& message, const RestFunctions& restFunctions);
 	void bindRestMethod(web::http::method method, std::string path, std::function< void(const HttpRequest&)> func);
 	void handle_get(const HttpRequest& message);
 	void handle_put(const HttpRequest& message);
@@ -35,28 +55,66 @@ private:
 	void handle_error(pplx::task<void>& t);
 
 	std::string verifyToken(const HttpRequest& message);
+	// rate limit key: JWT user, or remote address when no valid token
+	std::string rateLimitUser(const HttpRequest& message);
+	std::shared_ptr<const TokenCache::VerifiedToken> getVerifiedToken(const HttpRequest& message);
 	std::string getTokenUser(const HttpRequest& message);
+	bool permissionCheck(const HttpRequest& message, Permission permission);
 	bool permissionCheck(const HttpRequest& message, const std::string& permission);
 	std::string getTokenStr(const HttpRequest& message);
-	std::string createToken(const std::string& uname, const std::string& passwd, int timeoutSeconds);
 	int getHttpQueryValue(const HttpRequest& message, const std::string& key, int defaultValue, int min, int max) const;
 
+	// Serialized GET view, rendered again only when the version changed
+	struct CachedView
+	{
+		std::string m_etag;
+		std::string m_body;
+		std::mutex m_mutex;
+	};
+	// Reply 304 if If-None-Match match the view version, otherwise reply the cached or rendered view
+	void replyCachedView(const HttpRequest& message, CachedView& view, const std::string& version, const std::function<std::string()>& render);
+	// Reply json written by write() with chunked transfer
+	void replyJsonStream(const HttpRequest& message, http_response& response, const std::function<void(JsonWriter&)>& write);
+
 	void apiLogin(const HttpRequest& message);
 	void apiAuth(const HttpRequest& message);
 	void apiGetApp(const HttpRequest& message);
-	std::shared_ptr<Application> apiRunParseApp(const HttpRequest& message);
+	// Host pressure admission for ad-hoc run, reply 429 and return false when delayed
+	bool apiRunPermit(const HttpRequest& message, const web::json::value& jsonApp);
 	void apiRunAsync(const HttpRequest& message);
 	void apiRunSync(const HttpRequest& message);
 	void apiRunAsyncOut(const HttpRequest& message);
 	void apiGetAppOutput(const HttpRequest& message);
 	void apiGetApps(const HttpRequest& message);
+	void apiGetEvents(const HttpRequest& message);
 	void apiGetResources(const HttpRequest& message);
 	void apiRegApp(const HttpRequest& message);
+	std::shared_ptr<Application> registerApp(web::json::value& jsonApp);
+	void apiBatchApps(const HttpRequest& message);
 	void apiEnableApp(const HttpRequest& message);
 	void apiDisableApp(const HttpRequest& message);
 	void apiDeleteApp(const HttpRequest& message);
 	void apiFileDownload(const HttpRequest& message);
+	// append to a streamed body, wait while more than maxPending bytes are not read by the client;
+	// deadline cover the whole transfer and is extended by the time to send the data at minRate
+	static void writeStream(concurrency::streams::producer_consumer_buffer<uint8_t>& buffer, const uint8_t* data, size_t length,
+		size_t maxPending, size_t minRate, std::chrono::steady_clock::time_point& deadline);
+	// parse single range "bytes=first-last", return false if not satisfiable
+	static bool parseRange(const std::string& range, size_t size, size_t& start, size_t& length);
+	// base64 SHA-256 of the whole file, empty if the file changed while read
+	std::string contentDigest(const os::FileReader& reader);
 	void apiFileUpload(const HttpRequest& message);
+	void apiUploadSessionOpen(const HttpRequest& message);
+	void apiUploadSessionGet(const HttpRequest& message);
+	void apiUploadSessionChunk(const HttpRequest& message);
+	// read request body, throw when it exceed maxSize (chunked request has no Content-Length)
+	static std::vector<unsigned char> readBody(const HttpRequest& message, size_t maxSize);
+	void apiUploadSessionCommit(const HttpRequest& message);
+	void apiUploadSessionAbort(const HttpRequest& message);
+	void apiArtifactView(const HttpRequest& message);
+	void apiArtifactDeploy(const HttpRequest& message);
+	void apiFileDeltaSignature(const HttpRequest& message);
+	void apiFileDelta(const HttpRequest& message);
 	void apiGetLabels(const HttpRequest& message);
 	void apiAddLabel(const HttpRequest& message);
 	void apiDeleteLabel(const HttpRequest& message);
@@ -80,18 +138,29 @@ private:
 private:
 	std::string m_listenAddress;
 	std::unique_ptr<web::http::experimental::listener::http_listener> m_listener;
-	// API functions
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restGetFunctions;
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restPutFunctions;
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restPstFunctions;
-	std::map<std::string, std::function<void(const HttpRequest&)>> m_restDelFunctions;
+	// API functions, routes are compiled in bindRestMethod
+	RestFunctions m_restGetFunctions;
+	RestFunctions m_restPutFunctions;
+	RestFunctions m_restPstFunctions;
+	RestFunctions m_restDelFunctions;
+	// method and pattern of bound routes
+	std::vector<std::pair<std::string, std::string>> m_routes;
 
 	std::recursive_mutex m_mutex;
 
+	CachedView m_appsView;
+	CachedView m_configView;
+	CachedView m_labelsView;
+
+	// file version -> full file digest
+	std::map<std::string, std::string> m_digestCache;
+	std::mutex m_digestMutex;
+
 	// prometheus
 	std::shared_ptr<CounterPtr> m_promScrapeCounter;
 	std::shared_ptr<CounterPtr> m_restGetCounter;
 	std::shared_ptr<CounterPtr> m_restPutCounter;
 	std::shared_ptr<CounterPtr> m_restDelCounter;
 	std::shared_ptr<CounterPtr> m_restPostCounter;
+	std::map<std::string, std::shared_ptr<RouteMetrics>> m_routeMetrics;
 };
@@ -1,6 +1,42 @@
+#include <unordered_map>
 #include "Role.h"
+#include "TokenCache.h"
 #include "../common/Utility.h"
 
+// index is Permission value
+static const char* const PERMISSION_NAMES[] = {
+	PERMISSION_KEY_view_app,
+	PERMISSION_KEY_view_app_output,
+	PERMISSION_KEY_view_all_app,
+	PERMISSION_KEY_view_host_resource,
+	PERMISSION_KEY_app_reg,
+	PERMISSION_KEY_app_control,
+	PERMISSION_KEY_app_delete,
+	PERMISSION_KEY_run_app_async,
+	PERMISSION_KEY_run_app_sync,
+	PERMISSION_KEY_run_app_async_output,
+	PERMISSION_KEY_file_download,
+	PERMISSION_KEY_file_upload,
+	PERMISSION_KEY_label_view,
+	PERMISSION_KEY_label_set,
+	PERMISSION_KEY_label_delete,
+	PERMISSION_KEY_loglevel,
+	PERMISSION_KEY_config_view,
+	PERMISSION_KEY_config_set,
+	PERMISSION_KEY_change_passwd,
+	PERMISSION_KEY_lock_user,
+	PERMISSION_KEY_unlock_user,
+	PERMISSION_KEY_add_user,
+	PERMISSION_KEY_delete_user,
+	PERMISSION_KEY_get_users,
+	PERMISSION_KEY_role_update,
+	PERMISSION_KEY_role_delete,
+	PERMISSION_KEY_role_view,
+	PERMISSION_KEY_permission_list,
+	PERMISSION_KEY_consul_watch,
+};
+static_assert(sizeof(PERMISSION_NAMES) / sizeof(PERMISSION_NAMES[0]) == static_cast<size_t>(Permission::count), "PERMISSION_NAMES should match Permission");
+
 //////////////////////////////////////////////////////////////////////
 /// Users
 //////////////////////////////////////////////////////////////////////
@@ -58,7 +94,9 @@ void Roles::addRole(const web::json::value& obj, std::string name)
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	for (auto role : roles->m_roles)
 	{
-		m_roles[role.first] = role.second;
+		// update existing role in place, users keep reference to it
+		if (m_roles.count(role.first)) m_roles[role.first]->update(role.second);
+		else m_roles[role.first] = role.second;
 		// remove role if have no permission
 		if (role.second->getPermissions().size() == 0)
 		{
@@ -66,6 +104,7 @@ void Roles::addRole(const web::json::value& obj, std::string name)
 		}
 		break;
 	}
+	TokenCache::instance()->invalidate();
 }
 
 void Roles::delRole(std::string name)
@@ -73,6 +112,7 @@ void Roles::delRole(std::string name)
 	getRole(name);
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	m_roles.erase(name);
+	TokenCache::instance()->invalidate();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -107,10 +147,32 @@ std::shared_ptr<Role> Role::FromJson(std::string roleName, web::json::value& obj
 	{
 		auto perm = permmisionJson.as_string();
 		if (perm.length()) role->m_permissions.insert(perm);
+		Permission permission;
+		if (toPermission(perm, permission)) role->m_permissionSet.set(static_cast<size_t>(permission));
 	}
 	return role;
 }
 
+bool Role::toPermission(const std::string& name, Permission& permission)
+{
+	static const std::unordered_map<std::string, Permission> permissions = []()
+	{
+		std::unordered_map<std::string, Permission> result;
+		for (size_t i = 0; i < static_cast<size_t>(Permission::count); i++) result[PERMISSION_NAMES[i]] = static_cast<Permission>(i);
+		return result;
+	}();
+	auto iter = permissions.find(name);
+	if (iter == permissions.end()) return false;
+	permission = iter->second;
+	return true;
+}
+
+const char* Role::permissionName(Permission permission)
+{
+	auto index = static_cast<size_t>(permission);
+	return index < static_cast<size_t>(Permission::count) ? PERMISSION_NAMES[index] : "";
+}
+
 bool Role::hasPermission(std::string permission)
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
@@ -123,7 +185,22 @@ const std::set<std::string> Role::getPermissions()
 	return m_permissions;
 }
 
+const PermissionSet Role::getPermissionSet()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_permissionSet;
+}
+
 const std::string Role::getName() const
 {
 	return m_name;
 }
+
+void Role::update(const std::shared_ptr<Role>& role)
+{
+	auto permissions = role->getPermissions();
+	auto permissionSet = role->getPermissionSet();
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_permissions = permissions;
+	m_permissionSet = permissionSet;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <bitset>
 #include <string>
 #include <map>
 #include <set>
@@ -7,6 +8,44 @@
 #include <mutex>
 #include <cpprest/json.h>
 
+//////////////////////////////////////////////////////////////////////////
+/// Permission defined by PERMISSION_KEY_XXX, used as bit index
+//////////////////////////////////////////////////////////////////////////
+enum class Permission : int
+{
+	view_app,
+	view_app_output,
+	view_all_app,
+	view_host_resource,
+	app_reg,
+	app_control,
+	app_delete,
+	run_app_async,
+	run_app_sync,
+	run_app_async_output,
+	file_download,
+	file_upload,
+	label_view,
+	label_set,
+	label_delete,
+	loglevel,
+	config_view,
+	config_set,
+	change_passwd,
+	lock_user,
+	unlock_user,
+	add_user,
+	delete_user,
+	get_users,
+	role_update,
+	role_delete,
+	role_view,
+	permission_list,
+	consul_watch,
+	count
+};
+typedef std::bitset<static_cast<size_t>(Permission::count)> PermissionSet;
+
 //////////////////////////////////////////////////////////////////////////
 /// Role
 //////////////////////////////////////////////////////////////////////////
@@ -16,6 +55,10 @@ public:
 	explicit Role(const std::string& name);
 	virtual ~Role();
 
+	// permission name <-> enum, return false for name not defined by PERMISSION_KEY_XXX
+	static bool toPermission(const std::string& name, Permission& permission);
+	static const char* permissionName(Permission permission);
+
 	// seriarize
 	web::json::value AsJson() const;
 	static std::shared_ptr<Role> FromJson(std::string roleName, web::json::value& obj) noexcept(false);
@@ -23,10 +66,15 @@ public:
 	// get infomation
 	bool hasPermission(std::string permission);
 	const std::set<std::string> getPermissions();
+	const PermissionSet getPermissionSet();
 	const std::string getName() const;
+	// take permissions from the role parsed from new json
+	void update(const std::shared_ptr<Role>& role);
 
 private:
 	std::set<std::string> m_permissions;
+	// resolved from m_permissions when loaded or updated
+	PermissionSet m_permissionSet;
 	std::string m_name;
 	mutable std::recursive_mutex m_mutex;
 };
@@ -0,0 +1,203 @@
+#include "RunRegistry.h"
+#include "CpuAllocator.h"
+#include "LinuxCgroup.h"
+#include "MonitoredProcess.h"
+#include "PrometheusRest.h"
+#include "ResourceLimitation.h"
+#include "../common/HttpRequest.h"
+#include "../common/Utility.h"
+#include "../prom_exporter/counter.h"
+#include "../prom_exporter/gauge.h"
+
+namespace
+{
+	const size_t NO_SLOT = static_cast<size_t>(-1);
+}
+
+RunRegistry::Record::Record()
+	:m_sync(false), m_limited(false), m_next(NO_SLOT)
+{
+}
+
+RunRegistry::RunRegistry()
+	:m_freeHead(NO_SLOT), m_used(0), m_timerId(0)
+{
+	m_slots.reserve(MAX_RUN_RECORDS);
+	m_index.reserve(MAX_RUN_RECORDS);
+}
+
+RunRegistry::~RunRegistry()
+{
+	this->cancleTimer(m_timerId);
+}
+
+std::shared_ptr<RunRegistry>& RunRegistry::instance()
+{
+	static auto singleton = std::make_shared<RunRegistry>();
+	return singleton;
+}
+
+void RunRegistry::initTimer()
+{
+	this->cancleTimer(m_timerId);
+	m_timerId = this->registerTimer(
+		1000L,
+		1,
+		std::bind(&RunRegistry::maintainTimer, this, std::placeholders::_1),
+		__FUNCTION__
+	);
+}
+
+void RunRegistry::initMetrics(std::shared_ptr<PrometheusRest> prom)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+	// clean
+	m_recordGauge = nullptr;
+	m_runCounter = nullptr;
+	// update
+	if (prom)
+	{
+		m_recordGauge = prom->createPromGauge(PROM_METRIC_NAME_appmgr_run_record_gauge, PROM_METRIC_HELP_appmgr_run_record_gauge, {});
+		m_runCounter = prom->createPromCounter(PROM_METRIC_NAME_appmgr_run_count, PROM_METRIC_HELP_appmgr_run_count, {});
+		m_recordGauge->metric().Set(m_used);
+	}
+}
+
+std::string RunRegistry::run(const web::json::value& jsonApp, int timeoutSeconds, int retentionSeconds, HttpRequest* syncRequest)
+{
+	const static char fname[] = "RunRegistry::run() ";
+
+	// request is replied by the process after spawn
+	std::unique_ptr<HttpRequest> request(syncRequest);
+	if (HAS_JSON_FIELD(jsonApp, JSON_KEY_APP_docker_image)) throw std::invalid_argument("Docker application does not support this API");
+	auto user = GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_user);
+	if (user.empty()) user = "root";
+	const auto command = GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_command);
+	if (command.empty()) throw std::invalid_argument("no command line provide");
+	if (command.length() >= MAX_COMMAND_LINE_LENGH) throw std::invalid_argument("command line lengh should less than 2048");
+	std::map<std::string, std::string> envMap;
+	if (HAS_JSON_FIELD(jsonApp, JSON_KEY_APP_env))
+	{
+		for (const auto& env : jsonApp.at(JSON_KEY_APP_env).as_object())
+		{
+			envMap[GET_STD_STRING(env.first)] = GET_STD_STRING(env.second.as_string());
+		}
+	}
+
+	auto process = std::make_shared<MonitoredProcess>(MAX_APP_CACHED_LINES);
+	const auto uuid = process->getuuid();
+	std::shared_ptr<ResourceLimitation> limit;
+	if (HAS_JSON_FIELD(jsonApp, JSON_KEY_APP_resource_limit))
+	{
+		limit = ResourceLimitation::FromJson(jsonApp.at(JSON_KEY_APP_resource_limit), uuid);
+	}
+
+	size_t slot = NO_SLOT;
+	{
+		// reserve the slot before fork, a full registry reject the run
+		std::lock_guard<std::mutex> guard(m_mutex);
+		slot = allocSlot();
+	}
+	if (request) process->setAsyncHttpRequest(request.release());
+	const auto pid = process->spawnProcess(command, user, GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_working_dir), envMap, limit, GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_stdout_file));
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (pid <= 0)
+	{
+		freeSlot(slot);
+		if (limit) CpuAllocator::instance()->release(uuid);
+		throw std::invalid_argument("Start process failed");
+	}
+	process->regKillTimer(timeoutSeconds, __FUNCTION__);
+
+	auto& record = m_slots[slot];
+	record.m_process = process;
+	record.m_sync = (syncRequest != nullptr);
+	record.m_limited = (limit != nullptr);
+	record.m_expire = std::chrono::steady_clock::now() + std::chrono::seconds(timeoutSeconds + retentionSeconds);
+	m_index[uuid] = slot;
+	if (m_runCounter) m_runCounter->metric().Increment();
+	LOG_DBG << fname << "run <" << uuid << "> started with pid <" << pid << "> in slot <" << slot << ">";
+	return uuid;
+}
+
+bool RunRegistry::fetchOutput(const std::string& uuid, std::string& output, int& exitCode, bool& finished)
+{
+	const static char fname[] = "RunRegistry::fetchOutput() ";
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	auto iter = m_index.find(uuid);
+	if (iter == m_index.end()) return false;
+	auto& process = m_slots[iter->second].m_process;
+	output = process->fetchOutputMsg();
+	finished = (output.empty() && !process->running() && process->complete());
+	if (finished)
+	{
+		exitCode = process->return_value();
+		LOG_DBG << fname << "run <" << uuid << "> finished with exit code <" << exitCode << ">";
+		// all output is fetched
+		freeSlot(iter->second);
+	}
+	return true;
+}
+
+size_t RunRegistry::allocSlot()
+{
+	size_t slot = m_freeHead;
+	if (slot != NO_SLOT)
+	{
+		m_freeHead = m_slots[slot].m_next;
+	}
+	else if (m_slots.size() < MAX_RUN_RECORDS)
+	{
+		slot = m_slots.size();
+		m_slots.emplace_back();
+	}
+	else
+	{
+		throw std::invalid_argument("too many runs in progress");
+	}
+	m_used++;
+	if (m_recordGauge) m_recordGauge->metric().Set(m_used);
+	return slot;
+}
+
+void RunRegistry::freeSlot(size_t slot)
+{
+	auto& record = m_slots[slot];
+	if (record.m_process)
+	{
+		const auto uuid = record.m_process->getuuid();
+		m_index.erase(uuid);
+		if (record.m_process->running()) record.m_process->killgroup();
+		if (record.m_limited)
+		{
+			CpuAllocator::instance()->release(uuid);
+			LinuxCgroup::removeCgroup(uuid);
+		}
+	}
+	record = Record();
+	record.m_next = m_freeHead;
+	m_freeHead = slot;
+	m_used--;
+	if (m_recordGauge) m_recordGauge->metric().Set(m_used);
+}
+
+void RunRegistry::maintainTimer(int timerId)
+{
+	const static char fname[] = "RunRegistry::maintainTimer() ";
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	const auto now = std::chrono::steady_clock::now();
+	for (size_t slot = 0; slot < m_slots.size(); slot++)
+	{
+		const auto& record = m_slots[slot];
+		if (!record.m_process) continue;
+		// sync run is released once replied, async run output is kept for retention
+		if ((record.m_sync && !record.m_process->running() && record.m_process->complete()) || now > record.m_expire)
+		{
+			LOG_DBG << fname << "release run <" << record.m_process->getuuid() << ">";
+			freeSlot(slot);
+		}
+	}
+}
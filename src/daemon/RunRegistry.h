@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cpprest/json.h>
+#include "TimerHandler.h"
+
+class CounterPtr;
+class GaugePtr;
+class HttpRequest;
+class MonitoredProcess;
+class PrometheusRest;
+
+//////////////////////////////////////////////////////////////////////////
+/// Ad-hoc run records
+/// A run from /appmgr/app/run and /appmgr/app/syncrun is kept as a small
+/// record of the process instead of a temporary Application. Records live
+/// in a fixed size slab reused through a free list and are found by process
+/// uuid, a record is dropped when its output is fetched, when a sync run is
+/// replied, or after timeout + retention.
+//////////////////////////////////////////////////////////////////////////
+class RunRegistry : public TimerHandler
+{
+public:
+	RunRegistry();
+	virtual ~RunRegistry();
+	static std::shared_ptr<RunRegistry>& instance();
+
+	void initTimer();
+	void initMetrics(std::shared_ptr<PrometheusRest> prom);
+
+	// Start the run, return the process uuid. Sync run is replied to
+	// syncRequest when the process exit, the request is owned by the process.
+	std::string run(const web::json::value& jsonApp, int timeoutSeconds, int retentionSeconds, HttpRequest* syncRequest);
+	// Async run output since last fetch, false if uuid is not a run record
+	bool fetchOutput(const std::string& uuid, std::string& output, int& exitCode, bool& finished);
+
+private:
+	struct Record
+	{
+		Record();
+		// null for a free slot
+		std::shared_ptr<MonitoredProcess> m_process;
+		std::chrono::steady_clock::time_point m_expire;
+		bool m_sync;
+		// cgroup and CPU placement are named by process uuid
+		bool m_limited;
+		// next free slot
+		size_t m_next;
+	};
+	// Following functions are called with m_mutex hold
+	size_t allocSlot();
+	void freeSlot(size_t slot);
+	void maintainTimer(int timerId = 0);
+
+	// slab reserved once, slots are reused so the index stay valid
+	std::vector<Record> m_slots;
+	size_t m_freeHead;
+	size_t m_used;
+	// process uuid -> slot
+	std::unordered_map<std::string, size_t> m_index;
+	std::mutex m_mutex;
+	int m_timerId;
+
+	std::shared_ptr<GaugePtr> m_recordGauge;
+	std::shared_ptr<CounterPtr> m_runCounter;
+};
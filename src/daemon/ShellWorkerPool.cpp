@@ -0,0 +1,532 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <sys/socket.h>
+#include <ace/Process.h>
+#include "ShellWorkerPool.h"
+#include "Configuration.h"
+#include "PrometheusRest.h"
+#include "ResourceCollection.h"
+#include "../common/Utility.h"
+#include "../prom_exporter/counter.h"
+#include "../prom_exporter/gauge.h"
+
+namespace
+{
+	// Read NUL separated run requests from stdin: boundary, working dir, env count, env items, command.
+	// Output of the command is followed by "<boundary> <exit code>\n".
+	// Job control put each run in its own process group, the group is killed when the
+	// command exit (background processes left by it) and when the worker get SIGTERM.
+	const char WORKER_SCRIPT[] =
+		"set -m\n"
+		"run=\n"
+		"trap 'kill -KILL -- \"-$run\" 2>/dev/null; exit 143' TERM\n"
+		"while IFS= read -r -d '' boundary && IFS= read -r -d '' dir && IFS= read -r -d '' count; do\n"
+		"  envs=()\n"
+		"  while [ \"$count\" -gt 0 ] && IFS= read -r -d '' item; do envs+=(\"$item\"); count=$((count - 1)); done\n"
+		"  IFS= read -r -d '' cmd || break\n"
+		"  (cd \"${dir:-.}\" && exec env \"${envs[@]}\" /bin/sh -c \"$cmd\") </dev/null 2>&1 &\n"
+		"  run=$!\n"
+		"  wait \"$run\"\n"
+		"  code=$?\n"
+		"  kill -KILL -- \"-$run\" 2>/dev/null\n"
+		"  run=\n"
+		"  printf '%s %d\\n' \"$boundary\" \"$code\"\n"
+		"done\n";
+
+	void checkField(const std::string& value, const std::string& name)
+	{
+		if (value.find('\0') != std::string::npos) throw std::invalid_argument(name + " should not contain NUL character");
+	}
+}
+
+ShellWorkerPool::Job::Job()
+	:m_timeout(DEFAULT_RUN_APP_TIMEOUT_SECONDS), m_retention(DEFAULT_RUN_APP_RETENTION_DURATION), m_exitCode(0), m_finished(false)
+{
+}
+
+ShellWorkerPool::Worker::Worker()
+	:m_fd(-1), m_closing(false)
+{
+}
+
+ShellWorkerPool::Worker::~Worker()
+{
+	if (m_fd >= 0) ::close(m_fd);
+}
+
+ShellWorkerPool::ShellWorkerPool()
+	:m_timerId(0)
+{
+}
+
+ShellWorkerPool::~ShellWorkerPool()
+{
+	this->cancleTimer(m_timerId);
+}
+
+std::shared_ptr<ShellWorkerPool>& ShellWorkerPool::instance()
+{
+	static auto singleton = std::make_shared<ShellWorkerPool>();
+	return singleton;
+}
+
+void ShellWorkerPool::initTimer()
+{
+	this->cancleTimer(m_timerId);
+	m_timerId = this->registerTimer(
+		1000L,
+		1,
+		std::bind(&ShellWorkerPool::maintainTimer, this, std::placeholders::_1),
+		__FUNCTION__
+	);
+}
+
+void ShellWorkerPool::initMetrics(std::shared_ptr<PrometheusRest> prom)
+{
+	std::lock_guard<std::mutex> guard(m_poolMutex);
+	// clean
+	m_idleGauge = m_busyGauge = m_pendingGauge = nullptr;
+	m_runCounter = nullptr;
+	// update
+	if (prom)
+	{
+		m_idleGauge = prom->createPromGauge(PROM_METRIC_NAME_appmgr_run_pool_worker_gauge, PROM_METRIC_HELP_appmgr_run_pool_worker_gauge, { {"state", "idle"} });
+		m_busyGauge = prom->createPromGauge(PROM_METRIC_NAME_appmgr_run_pool_worker_gauge, PROM_METRIC_HELP_appmgr_run_pool_worker_gauge, { {"state", "busy"} });
+		m_pendingGauge = prom->createPromGauge(PROM_METRIC_NAME_appmgr_run_pool_pending_gauge, PROM_METRIC_HELP_appmgr_run_pool_pending_gauge, {});
+		m_runCounter = prom->createPromCounter(PROM_METRIC_NAME_appmgr_run_pool_run_count, PROM_METRIC_HELP_appmgr_run_pool_run_count, {});
+	}
+	updateGauges();
+}
+
+bool ShellWorkerPool::accept(const web::json::value& jsonApp) const
+{
+	return Configuration::instance()->getRunPool()->m_maxWorkers > 0 &&
+		!HAS_JSON_FIELD(jsonApp, JSON_KEY_APP_docker_image) &&
+		!HAS_JSON_FIELD(jsonApp, JSON_KEY_APP_resource_limit) &&
+		!HAS_JSON_FIELD(jsonApp, JSON_KEY_APP_stdout_file);
+}
+
+std::shared_ptr<ShellWorkerPool::Job> ShellWorkerPool::submit(const web::json::value& jsonApp, int timeoutSeconds, int retentionSeconds, const std::function<void(const std::string&, int)>& onFinish)
+{
+	const static char fname[] = "ShellWorkerPool::submit() ";
+
+	auto job = std::make_shared<Job>();
+	job->m_uuid = Utility::createUUID();
+	job->m_user = Utility::stdStringTrim(GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_user));
+	if (job->m_user.empty()) job->m_user = "root";
+	job->m_command = GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_command);
+	job->m_workdir = GET_JSON_STR_VALUE(jsonApp, JSON_KEY_APP_working_dir);
+	if (job->m_command.empty()) throw std::invalid_argument("command is empty");
+	if (job->m_command.length() > MAX_COMMAND_LINE_LENGH) throw std::invalid_argument("command is too long");
+	checkField(job->m_command, "command");
+	checkField(job->m_workdir, "working_dir");
+	if (HAS_JSON_FIELD(jsonApp, JSON_KEY_APP_env))
+	{
+		for (const auto& env : jsonApp.at(JSON_KEY_APP_env).as_object())
+		{
+			const auto key = GET_STD_STRING(env.first);
+			// env(1) take '-' as option and '=' as the end of name
+			if (key.empty() || key[0] == '-' || key.find('=') != std::string::npos) throw std::invalid_argument(std::string("invalid env name <") + key + ">");
+			job->m_env[key] = GET_STD_STRING(env.second.as_string());
+			checkField(key + job->m_env[key], "env");
+		}
+	}
+	job->m_env[ENV_APP_MANAGER_LAUNCH_TIME] = Utility::formatTime(std::chrono::system_clock::now(), DATE_TIME_FORMAT);
+	job->m_timeout = timeoutSeconds;
+	job->m_retention = retentionSeconds;
+	job->m_onFinish = onFinish;
+
+	const auto config = Configuration::instance()->getRunPool();
+	{
+		std::lock_guard<std::mutex> guard(m_poolMutex);
+		// sync run is replied when finished, async run is kept for output query
+		if (!onFinish) m_jobs[job->m_uuid] = job;
+		auto& pool = m_pools[job->m_user];
+		for (const auto& worker : pool.m_workers)
+		{
+			if (!worker->m_job && !worker->m_closing && startJob(worker, job))
+			{
+				updateGauges();
+				return job;
+			}
+		}
+		if (pool.m_workers.size() >= static_cast<size_t>(config->m_maxWorkers))
+		{
+			if (pool.m_pending.size() >= MAX_RUN_POOL_PENDING)
+			{
+				m_jobs.erase(job->m_uuid);
+				throw std::invalid_argument(std::string("run pool of user <") + job->m_user + "> is busy");
+			}
+			pool.m_pending.push_back(job);
+			updateGauges();
+			LOG_DBG << fname << "run <" << job->m_uuid << "> queued";
+			return job;
+		}
+		// queued until the new worker is added
+		pool.m_pending.push_back(job);
+	}
+	// fork and exec is the slow path, do not hold the pool
+	try
+	{
+		addWorker(spawnWorker(job->m_user));
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> guard(m_poolMutex);
+		auto& pending = m_pools[job->m_user].m_pending;
+		pending.erase(std::remove(pending.begin(), pending.end(), job), pending.end());
+		m_jobs.erase(job->m_uuid);
+		throw;
+	}
+	return job;
+}
+
+bool ShellWorkerPool::fetchOutput(const std::string& uuid, std::string& output, int& exitCode, bool& finished)
+{
+	std::lock_guard<std::mutex> guard(m_poolMutex);
+	auto iter = m_jobs.find(uuid);
+	if (iter == m_jobs.end()) return false;
+	auto& job = iter->second;
+	output.clear();
+	output.swap(job->m_output);
+	finished = (output.empty() && job->m_finished);
+	exitCode = job->m_exitCode;
+	// all output is fetched
+	if (finished) m_jobs.erase(iter);
+	return true;
+}
+
+std::shared_ptr<ShellWorkerPool::Worker> ShellWorkerPool::spawnWorker(const std::string& user)
+{
+	const static char fname[] = "ShellWorkerPool::spawnWorker() ";
+
+	const auto shell = Configuration::instance()->getRunPool()->m_shell;
+	ACE_Process_Options option;
+	const char* argv[] = { shell.c_str(), "--noprofile", "--norc", "-c", WORKER_SCRIPT, "appmgr-shell-worker", nullptr };
+	option.command_line(argv);
+	if (user.length())
+	{
+		unsigned int gid, uid;
+		if (!Utility::getUid(user, uid, gid)) throw std::invalid_argument(std::string("user <") + user + "> does not exist");
+		option.seteuid(uid);
+		option.setruid(uid);
+		option.setegid(gid);
+		option.setrgid(gid);
+	}
+	option.setgroup(0);	// run timeout kill the process group
+	option.inherit_environment(true);
+	option.handle_inheritance(0);
+	// do not inherit LD_LIBRARY_PATH to child
+	static const std::string ldEnv = ::getenv("LD_LIBRARY_PATH") ? ::getenv("LD_LIBRARY_PATH") : "";
+	if (!ldEnv.empty())
+	{
+		std::string env = ldEnv;
+		env = Utility::stringReplace(env, "/opt/appmanager/lib64:", "");
+		env = Utility::stringReplace(env, ":/opt/appmanager/lib64", "");
+		option.setenv("LD_LIBRARY_PATH", "%s", env.c_str());
+	}
+
+	// socket instead of pipe, a write to an exited worker fail with EPIPE instead of SIGPIPE
+	int fds[2];
+	if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+	{
+		throw std::invalid_argument(std::string("create worker socket failed : ") + std::strerror(errno));
+	}
+	auto worker = std::make_shared<Worker>();
+	worker->m_user = user;
+	worker->m_fd = fds[0];
+	worker->m_process = std::make_unique<ACE_Process>();
+	ACE_HANDLE dummy = ACE_OS::open("/dev/null", O_RDWR);
+	option.release_handles();
+	option.set_handles(fds[1], fds[1], dummy);
+	auto pid = worker->m_process->spawn(option);
+	option.release_handles();
+	::close(fds[1]);
+	if (dummy != ACE_INVALID_HANDLE) ACE_OS::close(dummy);
+	if (pid <= 0) throw std::invalid_argument(std::string("start shell worker failed : ") + std::strerror(errno));
+	worker->m_idleSince = std::chrono::steady_clock::now();
+	LOG_INF << fname << "shell worker <" << pid << "> started for user <" << user << ">";
+	return worker;
+}
+
+void ShellWorkerPool::addWorker(const std::shared_ptr<Worker>& worker)
+{
+	std::lock_guard<std::mutex> guard(m_poolMutex);
+	auto& pool = m_pools[worker->m_user];
+	pool.m_workers.push_back(worker);
+	std::thread(&ShellWorkerPool::readLoop, this, worker).detach();
+	dispatchPending(pool, worker);
+	updateGauges();
+}
+
+void ShellWorkerPool::readLoop(std::shared_ptr<Worker> worker)
+{
+	const static char fname[] = "ShellWorkerPool::readLoop() ";
+
+	char buffer[16 * 1024];
+	while (true)
+	{
+		auto size = ::recv(worker->m_fd, buffer, sizeof(buffer), 0);
+		if (size < 0 && errno == EINTR) continue;
+		if (size <= 0) break;
+
+		std::shared_ptr<Job> finished;
+		int exitCode = 0;
+		{
+			std::lock_guard<std::mutex> guard(m_poolMutex);
+			if (!worker->m_job)
+			{
+				// a process escaped the run group, retire the worker before it write into another run
+				if (!worker->m_closing)
+				{
+					LOG_WAR << fname << "output after run finished, retire shell worker <" << worker->m_process->getpid() << ">";
+					closeWorker(*worker, SIGTERM);
+					updateGauges();
+				}
+				continue;
+			}
+			worker->m_pending.append(buffer, size);
+			if (consume(*worker, exitCode))
+			{
+				finished = worker->m_job;
+				worker->m_job = nullptr;
+				worker->m_idleSince = std::chrono::steady_clock::now();
+				if (!worker->m_closing) dispatchPending(m_pools[worker->m_user], worker);
+				updateGauges();
+			}
+		}
+		if (finished) finishJob(finished, exitCode);
+	}
+
+	// worker exited: closed by idle timeout, killed by run timeout or crashed
+	std::shared_ptr<Job> job;
+	{
+		std::lock_guard<std::mutex> guard(m_poolMutex);
+		job = worker->m_job;
+		worker->m_job = nullptr;
+		if (job) job->m_output.append(worker->m_pending);
+		auto& workers = m_pools[worker->m_user].m_workers;
+		workers.remove(worker);
+		updateGauges();
+	}
+	// let the worker kill the run group, kill its own group if it does not exit
+	ACE_OS::kill(worker->m_process->getpid(), SIGTERM);
+	if (worker->m_process->wait(ACE_Time_Value(DEFAULT_RUN_POOL_CLOSE_TIMEOUT)) == 0)
+	{
+		ACE_OS::kill(-worker->m_process->getpid(), SIGKILL);
+		worker->m_process->wait();
+	}
+	LOG_INF << fname << "shell worker <" << worker->m_process->getpid() << "> of user <" << worker->m_user << "> exited";
+	if (job) finishJob(job, -1);
+}
+
+void ShellWorkerPool::closeWorker(Worker& worker, int signal)
+{
+	worker.m_closing = true;
+	worker.m_closeTime = std::chrono::steady_clock::now();
+	// SIGTERM: the worker kill the run group and exit
+	// 0: EOF on stdin end the worker loop
+	if (signal) ACE_OS::kill(worker.m_process->getpid(), signal);
+	else ::shutdown(worker.m_fd, SHUT_WR);
+}
+
+bool ShellWorkerPool::consume(Worker& worker, int& exitCode)
+{
+	auto& job = *worker.m_job;
+	auto pos = worker.m_pending.find(worker.m_boundary);
+	const auto end = (pos == std::string::npos) ? std::string::npos : worker.m_pending.find('\n', pos);
+	bool done = false;
+	size_t outputSize = 0;
+	if (end != std::string::npos)
+	{
+		exitCode = std::atoi(worker.m_pending.c_str() + pos + worker.m_boundary.length());
+		outputSize = pos;
+		done = true;
+	}
+	else if (pos == std::string::npos && worker.m_pending.length() > worker.m_boundary.length())
+	{
+		// keep the tail which may be a partial boundary
+		outputSize = worker.m_pending.length() - worker.m_boundary.length();
+	}
+	job.m_output.append(worker.m_pending, 0, outputSize);
+	if (job.m_output.length() > MAX_RUN_POOL_OUTPUT_SIZE) job.m_output.erase(0, job.m_output.length() - MAX_RUN_POOL_OUTPUT_SIZE);
+	worker.m_pending.erase(0, done ? std::string::npos : outputSize);
+	return done;
+}
+
+void ShellWorkerPool::finishJob(const std::shared_ptr<Job>& job, int exitCode)
+{
+	const static char fname[] = "ShellWorkerPool::finishJob() ";
+
+	std::function<void(const std::string&, int)> onFinish;
+	std::string output;
+	{
+		std::lock_guard<std::mutex> guard(m_poolMutex);
+		job->m_finished = true;
+		job->m_exitCode = exitCode;
+		job->m_expire = std::chrono::steady_clock::now() + std::chrono::seconds(job->m_retention);
+		if (job->m_onFinish)
+		{
+			onFinish.swap(job->m_onFinish);
+			output.swap(job->m_output);
+		}
+	}
+	LOG_DBG << fname << "run <" << job->m_uuid << "> finished with exit code <" << exitCode << ">";
+	if (onFinish)
+	{
+		try
+		{
+			onFinish(output, exitCode);
+		}
+		catch (const std::exception& e)
+		{
+			LOG_ERR << fname << "reply failed, maybe the http connection broken: " << e.what();
+		}
+	}
+}
+
+bool ShellWorkerPool::startJob(const std::shared_ptr<Worker>& worker, const std::shared_ptr<Job>& job)
+{
+	const static char fname[] = "ShellWorkerPool::startJob() ";
+
+	worker->m_boundary = std::string("\x1e") + Utility::createUUID();
+	std::string request;
+	request.append(worker->m_boundary).append(1, '\0');
+	request.append(job->m_workdir).append(1, '\0');
+	request.append(std::to_string(job->m_env.size())).append(1, '\0');
+	for (const auto& env : job->m_env) request.append(env.first).append("=").append(env.second).append(1, '\0');
+	request.append(job->m_command).append(1, '\0');
+
+	const char* data = request.data();
+	size_t length = request.length();
+	while (length)
+	{
+		auto size = ::send(worker->m_fd, data, length, MSG_NOSIGNAL);
+		if (size < 0)
+		{
+			if (errno == EINTR) continue;
+			LOG_WAR << fname << "write to shell worker failed : " << std::strerror(errno);
+			closeWorker(*worker, SIGTERM);
+			return false;
+		}
+		data += size;
+		length -= size;
+	}
+	worker->m_job = job;
+	worker->m_pending.clear();
+	job->m_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(job->m_timeout);
+	if (m_runCounter) m_runCounter->metric().Increment();
+	LOG_DBG << fname << "run <" << job->m_uuid << "> started on worker <" << worker->m_process->getpid() << ">";
+	return true;
+}
+
+void ShellWorkerPool::dispatchPending(UserPool& pool, const std::shared_ptr<Worker>& worker)
+{
+	if (pool.m_pending.empty() || worker->m_job || worker->m_closing) return;
+	auto job = pool.m_pending.front();
+	pool.m_pending.pop_front();
+	// broken worker exit soon, keep the run for another one
+	if (!startJob(worker, job)) pool.m_pending.push_front(job);
+}
+
+void ShellWorkerPool::maintainTimer(int timerId)
+{
+	const static char fname[] = "ShellWorkerPool::maintainTimer() ";
+
+	const auto config = Configuration::instance()->getRunPool();
+	const auto now = std::chrono::steady_clock::now();
+	// queued runs are admitted by the REST handler, idle workers are not prepared under host pressure
+	const bool pressure = ResourceCollection::instance()->underPressure();
+	std::vector<std::string> spawnUsers;
+	{
+		std::lock_guard<std::mutex> guard(m_poolMutex);
+		for (const auto& user : config->m_preforkUsers) m_pools[user];
+		for (auto& poolIter : m_pools)
+		{
+			auto& pool = poolIter.second;
+			const int minIdle = (config->m_maxWorkers > 0 && config->m_preforkUsers.count(poolIter.first)) ? config->m_minIdleWorkers : 0;
+			int idle = 0;
+			int live = 0;
+			for (const auto& worker : pool.m_workers)
+			{
+				if (worker->m_closing)
+				{
+					// a process left with the socket keep the reader from EOF, stop reading and reap the worker
+					if (now - worker->m_closeTime > std::chrono::seconds(DEFAULT_RUN_POOL_CLOSE_TIMEOUT)) ::shutdown(worker->m_fd, SHUT_RDWR);
+					continue;
+				}
+				if (worker->m_job)
+				{
+					if (now > worker->m_job->m_deadline)
+					{
+						// the reader finish the run when the worker exit
+						LOG_WAR << fname << "run <" << worker->m_job->m_uuid << "> timeout, kill shell worker <" << worker->m_process->getpid() << ">";
+						closeWorker(*worker, SIGTERM);
+						continue;
+					}
+				}
+				else
+				{
+					dispatchPending(pool, worker);
+					if (!worker->m_job && !worker->m_closing)
+					{
+						if (idle >= minIdle && now - worker->m_idleSince > std::chrono::seconds(config->m_idleTimeout))
+						{
+							closeWorker(*worker, 0);
+							continue;
+						}
+						idle++;
+					}
+				}
+				live++;
+			}
+			// replace killed and closed workers for queued runs and keep idle ones ready
+			auto need = static_cast<int>(pool.m_pending.size()) + (pressure ? 0 : std::max(0, minIdle - idle));
+			need = std::min(need, config->m_maxWorkers - live);
+			for (int i = 0; i < need; i++) spawnUsers.push_back(poolIter.first);
+		}
+		for (auto iter = m_jobs.begin(); iter != m_jobs.end();)
+		{
+			if (iter->second->m_finished && now > iter->second->m_expire)
+			{
+				iter = m_jobs.erase(iter);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		updateGauges();
+	}
+	for (const auto& user : spawnUsers)
+	{
+		try
+		{
+			addWorker(spawnWorker(user));
+		}
+		catch (const std::exception& e)
+		{
+			LOG_WAR << fname << "spawn shell worker for user <" << user << "> failed: " << e.what();
+		}
+	}
+}
+
+void ShellWorkerPool::updateGauges()
+{
+	size_t idle = 0, busy = 0, pending = 0;
+	for (const auto& pool : m_pools)
+	{
+		for (const auto& worker : pool.second.m_workers)
+		{
+			if (worker->m_job) busy++;
+			else if (!worker->m_closing) idle++;
+		}
+		pending += pool.second.m_pending.size();
+	}
+	if (m_idleGauge) m_idleGauge->metric().Set(idle);
+	if (m_busyGauge) m_busyGauge->metric().Set(busy);
+	if (m_pendingGauge) m_pendingGauge->metric().Set(pending);
+}
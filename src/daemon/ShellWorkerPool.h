@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cpprest/json.h>
+#include "TimerHandler.h"
+
+class ACE_Process;
+class CounterPtr;
+class GaugePtr;
+class PrometheusRest;
+
+//////////////////////////////////////////////////////////////////////////
+/// Pre-forked shell workers for ad-hoc run
+/// Each OS user has a pool of long-lived shell processes already running as
+/// that user. A run is written to an idle worker over its stdin socket, the
+/// worker fork a /bin/sh -c for the command and stream the output back over
+/// the same socket followed by a per-run boundary and the exit code. Each run
+/// is a process group killed before the boundary, so nothing left by a run
+/// write into the next one. A run does not create an Application or fork the
+/// daemon, so the cost does not grow with the daemon size. Timeout kill the
+/// whole worker, it is replaced.
+//////////////////////////////////////////////////////////////////////////
+class ShellWorkerPool : public TimerHandler
+{
+public:
+	struct Job
+	{
+		Job();
+		std::string m_uuid;
+		std::string m_user;
+		std::string m_command;
+		std::string m_workdir;
+		std::map<std::string, std::string> m_env;
+		int m_timeout;
+		int m_retention;
+		std::chrono::steady_clock::time_point m_deadline;
+		// output kept after finished, async run only
+		std::chrono::steady_clock::time_point m_expire;
+		std::string m_output;
+		int m_exitCode;
+		bool m_finished;
+		// sync run reply, called once when finished
+		std::function<void(const std::string& output, int exitCode)> m_onFinish;
+	};
+
+	ShellWorkerPool();
+	virtual ~ShellWorkerPool();
+	static std::shared_ptr<ShellWorkerPool>& instance();
+
+	void initTimer();
+	void initMetrics(std::shared_ptr<PrometheusRest> prom);
+
+	// Run request the pool can serve: pool enabled and plain command without docker, resource limit or stdout file
+	bool accept(const web::json::value& jsonApp) const;
+	// Queue a run, the job uuid is the process uuid for output query
+	std::shared_ptr<Job> submit(const web::json::value& jsonApp, int timeoutSeconds, int retentionSeconds, const std::function<void(const std::string&, int)>& onFinish);
+	// Async run output since last fetch, false if uuid is not a pool run
+	bool fetchOutput(const std::string& uuid, std::string& output, int& exitCode, bool& finished);
+
+private:
+	struct Worker
+	{
+		Worker();
+		~Worker();
+		std::string m_user;
+		std::unique_ptr<ACE_Process> m_process;
+		// socket pair end, the worker use the other end as stdin and stdout
+		int m_fd;
+		// no new run, closed by idle timeout or killed by run timeout
+		bool m_closing;
+		std::chrono::steady_clock::time_point m_closeTime;
+		std::shared_ptr<Job> m_job;
+		std::string m_boundary;
+		// received output not yet moved to job, may contain a partial boundary
+		std::string m_pending;
+		std::chrono::steady_clock::time_point m_idleSince;
+	};
+	struct UserPool
+	{
+		std::list<std::shared_ptr<Worker>> m_workers;
+		std::deque<std::shared_ptr<Job>> m_pending;
+	};
+
+	std::shared_ptr<Worker> spawnWorker(const std::string& user);
+	// Add a spawned worker and start its reader thread
+	void addWorker(const std::shared_ptr<Worker>& worker);
+	void readLoop(std::shared_ptr<Worker> worker);
+	// Stop new run on the worker, the run is killed and the worker exit
+	void closeWorker(Worker& worker, int signal);
+	// Move received output to the job, true when the boundary and exit code are received
+	bool consume(Worker& worker, int& exitCode);
+	// Set result and reply sync run, called without m_poolMutex
+	void finishJob(const std::shared_ptr<Job>& job, int exitCode);
+	// Following functions are called with m_poolMutex hold
+	// Write job to an idle worker, false when the worker is broken
+	bool startJob(const std::shared_ptr<Worker>& worker, const std::shared_ptr<Job>& job);
+	// Start queued runs on the idle worker
+	void dispatchPending(UserPool& pool, const std::shared_ptr<Worker>& worker);
+	void maintainTimer(int timerId = 0);
+	void updateGauges();
+
+	// OS user -> workers and queued runs
+	std::map<std::string, UserPool> m_pools;
+	// job uuid -> async job kept for output fetch
+	std::unordered_map<std::string, std::shared_ptr<Job>> m_jobs;
+	std::mutex m_poolMutex;
+	int m_timerId;
+
+	std::shared_ptr<GaugePtr> m_idleGauge;
+	std::shared_ptr<GaugePtr> m_busyGauge;
+	std::shared_ptr<GaugePtr> m_pendingGauge;
+	std::shared_ptr<CounterPtr> m_runCounter;
+};
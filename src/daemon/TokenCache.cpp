@@ -0,0 +1,82 @@
+#include <openssl/sha.h>
+#include "TokenCache.h"
+#include "../common/Utility.h"
+
+TokenCache::TokenCache()
+	:m_generation(0)
+{
+}
+
+TokenCache::~TokenCache()
+{
+}
+
+std::shared_ptr<TokenCache>& TokenCache::instance()
+{
+	static auto singleton = std::make_shared<TokenCache>();
+	return singleton;
+}
+
+std::string TokenCache::digest(const std::string& token)
+{
+	unsigned char hash[SHA256_DIGEST_LENGTH];
+	SHA256((const unsigned char*)token.data(), token.length(), hash);
+	return std::string((const char*)hash, sizeof(hash));
+}
+
+std::shared_ptr<const TokenCache::VerifiedToken> TokenCache::get(const std::string& token)
+{
+	if (token.empty()) return nullptr;
+	const auto key = digest(token);
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	auto iter = m_index.find(key);
+	if (iter == m_index.end()) return nullptr;
+	if (iter->second->second->m_expire <= std::chrono::system_clock::now())
+	{
+		// expired token go through full verify and get rejected there
+		m_lru.erase(iter->second);
+		m_index.erase(iter);
+		return nullptr;
+	}
+	m_lru.splice(m_lru.begin(), m_lru, iter->second);
+	return iter->second->second;
+}
+
+void TokenCache::put(const std::string& token, const std::shared_ptr<const VerifiedToken>& verified, unsigned long long generation)
+{
+	if (token.empty() || verified == nullptr) return;
+	const auto key = digest(token);
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	if (generation != m_generation) return;
+	auto iter = m_index.find(key);
+	if (iter != m_index.end())
+	{
+		m_lru.erase(iter->second);
+		m_index.erase(iter);
+	}
+	m_lru.emplace_front(key, verified);
+	m_index[key] = m_lru.begin();
+	while (m_lru.size() > MAX_TOKEN_CACHE_SIZE)
+	{
+		m_index.erase(m_lru.back().first);
+		m_lru.pop_back();
+	}
+}
+
+unsigned long long TokenCache::generation() const
+{
+	return m_generation;
+}
+
+void TokenCache::invalidate()
+{
+	const static char fname[] = "TokenCache::invalidate() ";
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	m_generation++;
+	if (m_lru.size()) LOG_DBG << fname << "Dropped <" << m_lru.size() << "> verified tokens";
+	m_lru.clear();
+	m_index.clear();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Role.h"
+
+//////////////////////////////////////////////////////////////////////////
+/// Verified JWT token cache
+/// LRU cache keyed by SHA-256 of the token, an entry keep the user and the
+/// permissions resolved when the token was verified. All entries are dropped
+/// when users, roles, passwords or lock status change, an entry is never
+/// used after the token exp.
+//////////////////////////////////////////////////////////////////////////
+class TokenCache
+{
+public:
+	struct VerifiedToken
+	{
+		std::string m_user;
+		std::chrono::system_clock::time_point m_expire;
+		PermissionSet m_permissions;
+	};
+
+	TokenCache();
+	virtual ~TokenCache();
+	static std::shared_ptr<TokenCache>& instance();
+
+	// nullptr if not cached or expired
+	std::shared_ptr<const VerifiedToken> get(const std::string& token);
+	// generation is read before verify, entry verified with old security info is dropped
+	void put(const std::string& token, const std::shared_ptr<const VerifiedToken>& verified, unsigned long long generation);
+	unsigned long long generation() const;
+	// security info changed
+	void invalidate();
+
+private:
+	static std::string digest(const std::string& token);
+
+	typedef std::pair<std::string, std::shared_ptr<const VerifiedToken>> Entry;
+	// most recently used at front
+	std::list<Entry> m_lru;
+	std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+	std::atomic<unsigned long long> m_generation;
+	std::mutex m_mutex;
+};
@@ -0,0 +1,395 @@
+#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <openssl/sha.h>
+#include "UploadManager.h"
+#include "ArtifactStore.h"
+#include "../common/DeltaSync.h"
+#include "../common/Utility.h"
+#include "../common/os/chown.hpp"
+#include "../common/os/filemap.hpp"
+#include "../common/os/linux.hpp"
+
+UploadManager::Session::Session()
+	:m_fileSize(0), m_fileMode(0), m_lastActive(std::chrono::system_clock::now()), m_fd(-1), m_closed(false), m_writing(0)
+{
+}
+
+UploadManager::Session::~Session()
+{
+	if (m_fd >= 0) ::close(m_fd);
+}
+
+uint64_t UploadManager::Session::receivedBytes() const
+{
+	uint64_t total = 0;
+	for (const auto& range : m_received) total += range.second - range.first;
+	return total;
+}
+
+web::json::value UploadManager::Session::AsJson() const
+{
+	web::json::value result = web::json::value::object();
+	result[JSON_KEY_UPLOAD_session_id] = web::json::value::string(m_id);
+	result[JSON_KEY_UPLOAD_file_path] = web::json::value::string(m_filePath);
+	result[JSON_KEY_UPLOAD_file_size] = web::json::value::number(m_fileSize);
+	result[JSON_KEY_UPLOAD_file_mode] = web::json::value::number(m_fileMode);
+	result[JSON_KEY_UPLOAD_file_user] = web::json::value::string(m_fileUser);
+	result[JSON_KEY_UPLOAD_chunk_size] = web::json::value::number(DEFAULT_UPLOAD_CHUNK_SIZE);
+	result[JSON_KEY_UPLOAD_received_bytes] = web::json::value::number(receivedBytes());
+	auto received = web::json::value::array(m_received.size());
+	size_t index = 0;
+	for (const auto& range : m_received)
+	{
+		auto pair = web::json::value::array(2);
+		pair[0] = web::json::value::number(range.first);
+		pair[1] = web::json::value::number(range.second);
+		received[index++] = pair;
+	}
+	result[JSON_KEY_UPLOAD_received] = received;
+	return result;
+}
+
+UploadManager::UploadManager()
+{
+}
+
+UploadManager::~UploadManager()
+{
+}
+
+std::shared_ptr<UploadManager>& UploadManager::instance()
+{
+	static auto singleton = std::make_shared<UploadManager>();
+	return singleton;
+}
+
+std::string UploadManager::tempFilePath(const std::string& filePath)
+{
+	// same directory as target, rename is atomic
+	auto pos = filePath.find_last_of('/');
+	auto dir = (pos == std::string::npos) ? std::string() : filePath.substr(0, pos + 1);
+	auto name = (pos == std::string::npos) ? filePath : filePath.substr(pos + 1);
+	return dir + "." + name + ".appmgr-upload";
+}
+
+std::string UploadManager::progressFilePath(const std::string& filePath)
+{
+	return tempFilePath(filePath) + ".json";
+}
+
+std::shared_ptr<UploadManager::Session> UploadManager::open(const std::string& filePath, uint64_t fileSize, int fileMode, const std::string& fileUser)
+{
+	const static char fname[] = "UploadManager::open() ";
+
+	if (filePath.empty() || filePath.back() == '/') throw std::invalid_argument("invalid file path");
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	cleanExpired();
+
+	auto iter = m_fileSessions.find(filePath);
+	std::shared_ptr<Session> session = (iter != m_fileSessions.end()) ? m_sessions[iter->second] : loadProgress(filePath);
+	// the temp file is being renamed into place, it must not be removed or reused
+	if (session && session->m_closed) throw std::invalid_argument(std::string("upload of <") + filePath + "> is committing");
+	if (session && session->m_fileSize != fileSize)
+	{
+		LOG_INF << fname << "File <" << filePath << "> size changed, restart upload";
+		remove(session, true);
+		session.reset();
+	}
+	if (session == nullptr)
+	{
+		session = std::make_shared<Session>();
+		session->m_id = Utility::createUUID();
+		session->m_filePath = filePath;
+		session->m_fileSize = fileSize;
+	}
+	session->m_fileMode = fileMode;
+	session->m_fileUser = fileUser;
+	session->m_lastActive = std::chrono::system_clock::now();
+	if (session->m_fd < 0)
+	{
+		auto tmpFile = tempFilePath(filePath);
+		session->m_fd = ::open(tmpFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if (session->m_fd < 0 || ::ftruncate(session->m_fd, fileSize) != 0)
+		{
+			throw std::invalid_argument(std::string("failed to create file <") + tmpFile + "> :" + std::strerror(errno));
+		}
+	}
+	m_sessions[session->m_id] = session;
+	m_fileSessions[filePath] = session->m_id;
+	{
+		std::lock_guard<std::mutex> sessionGuard(session->m_mutex);
+		saveProgress(session);
+	}
+	LOG_DBG << fname << "Upload session <" << session->m_id << "> for <" << filePath << "> received <" << session->receivedBytes() << "/" << fileSize << ">";
+	return session;
+}
+
+std::shared_ptr<UploadManager::Session> UploadManager::get(const std::string& sessionId)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto iter = m_sessions.find(sessionId);
+	if (iter == m_sessions.end()) throw std::invalid_argument(std::string("no such upload session <") + sessionId + ">");
+	return iter->second;
+}
+
+void UploadManager::write(const std::shared_ptr<Session>& session, uint64_t offset, const std::vector<unsigned char>& data)
+{
+	if (offset + data.size() > session->m_fileSize) throw std::invalid_argument("chunk exceed file size");
+	{
+		std::lock_guard<std::mutex> guard(session->m_mutex);
+		if (session->m_closed) throw std::invalid_argument("upload session is closed");
+		session->m_writing++;
+	}
+	// chunks of one session are written in parallel with pwrite
+	size_t written = 0;
+	int error = 0;
+	while (written < data.size())
+	{
+		auto ret = ::pwrite(session->m_fd, data.data() + written, data.size() - written, offset + written);
+		if (ret < 0)
+		{
+			if (errno == EINTR) continue;
+			error = errno;
+			break;
+		}
+		written += ret;
+	}
+	// chunk must be on disk before the progress file claim it
+	if (error == 0 && ::fdatasync(session->m_fd) != 0) error = errno;
+
+	std::lock_guard<std::mutex> guard(session->m_mutex);
+	session->m_writing--;
+	session->m_idle.notify_all();
+	if (error) throw std::invalid_argument(std::string("failed to write chunk :") + std::strerror(error));
+	// merge [offset, end) into received ranges
+	auto start = offset;
+	auto end = offset + data.size();
+	auto iter = session->m_received.upper_bound(start);
+	if (iter != session->m_received.begin() && std::prev(iter)->second >= start) --iter;
+	while (iter != session->m_received.end() && iter->first <= end)
+	{
+		start = std::min(start, iter->first);
+		end = std::max(end, iter->second);
+		iter = session->m_received.erase(iter);
+	}
+	if (end > start) session->m_received[start] = end;
+	session->m_lastActive = std::chrono::system_clock::now();
+	saveProgress(session);
+}
+
+void UploadManager::commit(const std::shared_ptr<Session>& session, const std::string& sha256Base64)
+{
+	const static char fname[] = "UploadManager::commit() ";
+
+	if (sha256Base64.empty()) throw std::invalid_argument("sha-256 digest is required for commit");
+	{
+		// release the session lock before take the manager lock, open() lock them in the other order
+		std::unique_lock<std::mutex> lock(session->m_mutex);
+		if (session->m_closed) throw std::invalid_argument("upload session is closed");
+		if (session->receivedBytes() != session->m_fileSize)
+		{
+			throw std::invalid_argument(std::string("upload incomplete, received <") + std::to_string(session->receivedBytes()) + "/" + std::to_string(session->m_fileSize) + ">");
+		}
+		// no chunk is accepted from now on, wait the ones still writing
+		session->m_closed = true;
+		session->m_idle.wait(lock, [&session]() { return session->m_writing == 0; });
+		try
+		{
+			auto tmpFile = tempFilePath(session->m_filePath);
+			if (::fsync(session->m_fd) != 0)
+			{
+				throw std::invalid_argument(std::string("failed to sync file :") + std::strerror(errno));
+			}
+			unsigned char hash[SHA256_DIGEST_LENGTH];
+			hashFile(session->m_fd, session->m_fileSize, hash);
+			auto digest = Utility::encode64(std::string(reinterpret_cast<const char*>(hash), sizeof(hash)));
+			if (digest != sha256Base64)
+			{
+				// content is wrong, upload again from beginning
+				session->m_received.clear();
+				saveProgress(session);
+				throw std::invalid_argument(std::string("checksum mismatch, expect <") + sha256Base64 + "> actual <" + digest + ">");
+			}
+			if (session->m_fileMode) os::fileChmod(tmpFile, session->m_fileMode);
+			if (session->m_fileUser.length()) os::chown(tmpFile, session->m_fileUser);
+			// the path must still be the verified file, not one recreated by another session
+			struct stat pathStat, fdStat;
+			if (::stat(tmpFile.c_str(), &pathStat) != 0 || ::fstat(session->m_fd, &fdStat) != 0 ||
+				pathStat.st_dev != fdStat.st_dev || pathStat.st_ino != fdStat.st_ino)
+			{
+				throw std::invalid_argument(std::string("file <") + tmpFile + "> was replaced during upload");
+			}
+			if (::rename(tmpFile.c_str(), session->m_filePath.c_str()) != 0)
+			{
+				throw std::invalid_argument(std::string("failed to rename file :") + std::strerror(errno));
+			}
+			LOG_INF << fname << "File <" << session->m_filePath << "> uploaded, size <" << session->m_fileSize << ">";
+			// verified content can be deployed to other path without upload again
+			ArtifactStore::instance()->add(session->m_filePath, Utility::hexEncode(hash, sizeof(hash)));
+		}
+		catch (...)
+		{
+			session->m_closed = false;
+			throw;
+		}
+	}
+	std::lock_guard<std::recursive_mutex> managerGuard(m_mutex);
+	remove(session, false);
+}
+
+void UploadManager::abort(const std::shared_ptr<Session>& session)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	if (session->m_closed) throw std::invalid_argument("upload session is committing");
+	remove(session, true);
+}
+
+void UploadManager::applyDelta(const std::string& filePath, size_t blockSize, const std::vector<unsigned char>& delta, int fileMode, const std::string& fileUser, const std::string& sha256Base64)
+{
+	const static char fname[] = "UploadManager::applyDelta() ";
+
+	if (sha256Base64.empty()) throw std::invalid_argument("sha-256 digest is required for delta");
+	if (blockSize < DeltaSync::MIN_BLOCK_SIZE || blockSize > DeltaSync::MAX_BLOCK_SIZE) throw std::invalid_argument("invalid block_size");
+	// live file may be truncated while read, pread instead of mapping it
+	os::FileReader base(filePath);
+	if (!base.valid()) throw std::invalid_argument(std::string("file <") + filePath + "> can not be read");
+
+	// unique temp file, concurrent delta of the same target fail on digest instead of mixing content
+	auto tmpFile = tempFilePath(filePath) + "." + Utility::createUUID();
+	int fd = ::open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) throw std::invalid_argument(std::string("failed to create file <") + tmpFile + "> :" + std::strerror(errno));
+	SHA256_CTX sha;
+	SHA256_Init(&sha);
+	try
+	{
+		auto reader = [&base](uint64_t offset, unsigned char* buffer, size_t length) -> size_t
+		{
+			auto bytes = base.read(offset, buffer, length);
+			if (bytes < 0) throw std::invalid_argument(std::string("failed to read file :") + std::strerror(errno));
+			return bytes;
+		};
+		DeltaSync::apply(reader, base.size(), blockSize, delta.data(), delta.size(), [fd, &sha](const unsigned char* data, size_t length)
+			{
+				SHA256_Update(&sha, data, length);
+				size_t written = 0;
+				while (written < length)
+				{
+					auto ret = ::write(fd, data + written, length - written);
+					if (ret < 0)
+					{
+						if (errno == EINTR) continue;
+						throw std::invalid_argument(std::string("failed to write file :") + std::strerror(errno));
+					}
+					written += ret;
+				}
+			});
+		if (::fsync(fd) != 0) throw std::invalid_argument(std::string("failed to sync file :") + std::strerror(errno));
+		unsigned char hash[SHA256_DIGEST_LENGTH];
+		SHA256_Final(hash, &sha);
+		auto digest = Utility::encode64(std::string(reinterpret_cast<const char*>(hash), sizeof(hash)));
+		if (digest != sha256Base64)
+		{
+			// target changed after signature was read or delta is wrong, client upload the full content
+			throw std::invalid_argument(std::string("checksum mismatch, expect <") + sha256Base64 + "> actual <" + digest + ">");
+		}
+		::close(fd);
+		fd = -1;
+		if (fileMode) os::fileChmod(tmpFile, fileMode);
+		if (fileUser.length()) os::chown(tmpFile, fileUser);
+		if (::rename(tmpFile.c_str(), filePath.c_str()) != 0)
+		{
+			throw std::invalid_argument(std::string("failed to rename file :") + std::strerror(errno));
+		}
+		LOG_INF << fname << "File <" << filePath << "> rebuilt from delta of <" << delta.size() << "> bytes";
+		ArtifactStore::instance()->add(filePath, Utility::hexEncode(hash, sizeof(hash)));
+	}
+	catch (...)
+	{
+		if (fd >= 0) ::close(fd);
+		::unlink(tmpFile.c_str());
+		throw;
+	}
+}
+
+void UploadManager::remove(const std::shared_ptr<Session>& session, bool removeTempFile)
+{
+	m_sessions.erase(session->m_id);
+	auto iter = m_fileSessions.find(session->m_filePath);
+	if (iter != m_fileSessions.end() && iter->second == session->m_id) m_fileSessions.erase(iter);
+	if (removeTempFile) ::unlink(tempFilePath(session->m_filePath).c_str());
+	::unlink(progressFilePath(session->m_filePath).c_str());
+}
+
+void UploadManager::cleanExpired()
+{
+	const static char fname[] = "UploadManager::cleanExpired() ";
+
+	auto now = std::chrono::system_clock::now();
+	for (auto iter = m_sessions.begin(); iter != m_sessions.end();)
+	{
+		auto session = (iter++)->second;
+		if (!session->m_closed && now - session->m_lastActive > std::chrono::seconds(DEFAULT_UPLOAD_SESSION_TIMEOUT))
+		{
+			LOG_INF << fname << "Upload session <" << session->m_id << "> for <" << session->m_filePath << "> expired";
+			remove(session, true);
+		}
+	}
+}
+
+void UploadManager::hashFile(int fd, uint64_t size, unsigned char* hash)
+{
+	// pread the opened temp file, a mapping would SIGBUS if the file is truncated meanwhile
+	std::vector<unsigned char> buffer(DEFAULT_FILE_STREAM_CHUNK_SIZE);
+	SHA256_CTX sha;
+	SHA256_Init(&sha);
+	uint64_t offset = 0;
+	while (offset < size)
+	{
+		auto length = static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - offset));
+		auto bytes = ::pread(fd, buffer.data(), length, offset);
+		if (bytes < 0 && errno == EINTR) continue;
+		if (bytes < 0) throw std::invalid_argument(std::string("failed to read file :") + std::strerror(errno));
+		if (bytes == 0) throw std::invalid_argument("file truncated during upload");
+		SHA256_Update(&sha, buffer.data(), bytes);
+		offset += bytes;
+	}
+	SHA256_Final(hash, &sha);
+}
+
+void UploadManager::saveProgress(const std::shared_ptr<Session>& session)
+{
+	auto progressFile = progressFilePath(session->m_filePath);
+	std::ofstream ofs(progressFile, std::ios::trunc);
+	if (ofs.is_open()) ofs << session->AsJson().serialize();
+}
+
+std::shared_ptr<UploadManager::Session> UploadManager::loadProgress(const std::string& filePath)
+{
+	const static char fname[] = "UploadManager::loadProgress() ";
+
+	auto progressFile = progressFilePath(filePath);
+	if (!Utility::isFileExist(progressFile) || !Utility::isFileExist(tempFilePath(filePath))) return nullptr;
+	try
+	{
+		auto json = web::json::value::parse(Utility::readFileCpp(progressFile));
+		auto session = std::make_shared<Session>();
+		session->m_id = GET_JSON_STR_VALUE(json, JSON_KEY_UPLOAD_session_id);
+		if (session->m_id.empty()) session->m_id = Utility::createUUID();
+		session->m_filePath = filePath;
+		session->m_fileSize = GET_JSON_NUMBER_VALUE(json, JSON_KEY_UPLOAD_file_size);
+		for (const auto& range : json.at(JSON_KEY_UPLOAD_received).as_array())
+		{
+			session->m_received[range.at(0).as_number().to_uint64()] = range.at(1).as_number().to_uint64();
+		}
+		LOG_INF << fname << "Resume upload session <" << session->m_id << "> for <" << filePath << ">";
+		return session;
+	}
+	catch (const std::exception& e)
+	{
+		LOG_WAR << fname << "Discard upload progress <" << progressFile << "> :" << e.what();
+		::unlink(progressFile.c_str());
+		return nullptr;
+	}
+}
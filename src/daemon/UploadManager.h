@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cpprest/json.h>
+
+//////////////////////////////////////////////////////////////////////////
+/// Resumable upload sessions
+/// Chunks are written with pwrite to a hidden temp file next to the target
+/// in any order and in parallel, received ranges are recorded in a progress
+/// file so an interrupted upload (or daemon restart) resume from where it
+/// stopped. Commit close the session, verify size and SHA-256 then rename
+/// into place.
+//////////////////////////////////////////////////////////////////////////
+class UploadManager
+{
+public:
+	struct Session
+	{
+		std::string m_id;
+		std::string m_filePath;
+		uint64_t m_fileSize;
+		int m_fileMode;
+		std::string m_fileUser;
+		// received ranges: offset -> end (exclusive), merged
+		std::map<uint64_t, uint64_t> m_received;
+		std::chrono::system_clock::time_point m_lastActive;
+		int m_fd;
+		// set by commit, no chunk is accepted and the temp file is not removed after that
+		std::atomic<bool> m_closed;
+		// pwrite in progress, commit wait them before verify
+		int m_writing;
+		std::condition_variable m_idle;
+		std::mutex m_mutex;
+
+		Session();
+		~Session();
+		uint64_t receivedBytes() const;
+		web::json::value AsJson() const;
+	};
+
+	UploadManager();
+	virtual ~UploadManager();
+	static std::shared_ptr<UploadManager>& instance();
+
+	// Create or resume the session of a target file, resumed only when size match
+	std::shared_ptr<Session> open(const std::string& filePath, uint64_t fileSize, int fileMode, const std::string& fileUser);
+	std::shared_ptr<Session> get(const std::string& sessionId);
+	// Write one chunk at offset
+	void write(const std::shared_ptr<Session>& session, uint64_t offset, const std::vector<unsigned char>& data);
+	// Verify all bytes received and digest (base64 SHA-256, required) then rename into target path
+	void commit(const std::shared_ptr<Session>& session, const std::string& sha256Base64);
+	void abort(const std::shared_ptr<Session>& session);
+	// Rebuild the target from its current copy and a block delta (see DeltaSync), verify digest then rename into place
+	void applyDelta(const std::string& filePath, size_t blockSize, const std::vector<unsigned char>& delta, int fileMode, const std::string& fileUser, const std::string& sha256Base64);
+
+	static std::string tempFilePath(const std::string& filePath);
+	static std::string progressFilePath(const std::string& filePath);
+
+private:
+	static void hashFile(int fd, uint64_t size, unsigned char* hash);
+	void saveProgress(const std::shared_ptr<Session>& session);
+	std::shared_ptr<Session> loadProgress(const std::string& filePath);
+	void remove(const std::shared_ptr<Session>& session, bool removeTempFile);
+	void cleanExpired();
+
+	// session id -> session
+	std::map<std::string, std::shared_ptr<Session>> m_sessions;
+	// target file -> session id
+	std::map<std::string, std::string> m_fileSessions;
+	std::recursive_mutex m_mutex;
+};
@@ -1,4 +1,5 @@
 #include "User.h"
+#include "TokenCache.h"
 #include "../common/Utility.h"
 
 
@@ -86,6 +87,7 @@ std::shared_ptr<User> Users::addUser(const std::string userName, const web::json
 		// insert
 		m_users[userName] = user;
 	}
+	TokenCache::instance()->invalidate();
 	return user;
 }
 
@@ -94,6 +96,7 @@ void Users::delUser(std::string name)
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	getUser(name);
 	m_users.erase(name);
+	TokenCache::instance()->invalidate();
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -148,22 +151,26 @@ std::shared_ptr<User> User::FromJson(std::string userName, const web::json::valu
 void User::lock()
 {
 	this->m_locked = true;
+	TokenCache::instance()->invalidate();
 }
 
 void User::unlock()
 {
 	this->m_locked = false;
+	TokenCache::instance()->invalidate();
 }
 
 void User::updateRoles(std::set<std::shared_ptr<Role>> roles)
 {
 	this->m_roles = roles;
+	TokenCache::instance()->invalidate();
 }
 
 void User::updateKey(std::string passswd)
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
 	m_key = passswd;
+	TokenCache::instance()->invalidate();
 }
 
 bool User::locked() const
@@ -183,6 +190,14 @@ const std::set<std::shared_ptr<Role>> User::getRoles()
 	return m_roles;
 }
 
+const PermissionSet User::getPermissionSet()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	PermissionSet result;
+	for (const auto& role : m_roles) result |= role->getPermissionSet();
+	return result;
+}
+
 bool User::hasPermission(std::string permission)
 {
 	std::lock_guard<std::recursive_mutex> guard(m_mutex);
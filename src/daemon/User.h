@@ -30,6 +30,8 @@ public:
 	bool locked() const;
 	const std::string getKey();
 	const std::set<std::shared_ptr<Role>> getRoles();
+	// permissions of all roles
+	const PermissionSet getPermissionSet();
 	bool hasPermission(std::string permission);
 
 private:
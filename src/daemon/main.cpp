@@ -1,5 +1,6 @@
 #include <stdio.h>
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <chrono>
@@ -17,8 +18,12 @@
 #include "HealthCheckTask.h"
 #include "PersistManager.h"
 #include "PrometheusRest.h"
+#include "RateLimiter.h"
+#include "LocalSocketListener.h"
 #include "ResourceCollection.h"
 #include "RestHandler.h"
+#include "RunRegistry.h"
+#include "ShellWorkerPool.h"
 #include "TimerHandler.h"
 #include "../common/os/linux.hpp"
 #include "../common/Utility.h"
@@ -59,11 +64,14 @@ int main(int argc, char* argv[])
 
 		std::shared_ptr<RestHandler> httpServerIp4;
 		std::shared_ptr<RestHandler> httpServerIp6;
+		std::shared_ptr<LocalSocketListener> localSocketListener;
 		if (config->getRestEnabled())
 		{
 			// Thread pool: 6 threads
 			crossplat::threadpool::initialize_with_threads(config->getThreadPoolSize());
 			LOG_INF << fname << "initialize_with_threads:" << config->getThreadPoolSize();
+			RateLimiter::instance()->setThreadPoolSize(config->getThreadPoolSize());
+			RateLimiter::instance()->setConfig(config->getRateLimit());
 
 			// Init Prometheus Exporter
 			PrometheusRest::instance(std::make_shared<PrometheusRest>(config->getRestListenAddress(), config->getPromListenPort()));
@@ -94,6 +102,19 @@ int main(int argc, char* argv[])
 					LOG_ERR << fname << "unknown exception";
 				}
 			}
+
+			// Init local socket REST for local clients
+			if (!config->getLocalSocketPath().empty())
+			{
+				try
+				{
+					localSocketListener = std::make_shared<LocalSocketListener>(config->getLocalSocketPath(), httpServerIp4);
+				}
+				catch (const std::exception & e)
+				{
+					LOG_ERR << fname << e.what();
+				}
+			}
 		}
 
 		// HA attach process to App
@@ -130,6 +151,12 @@ int main(int argc, char* argv[])
 		ConsulConnection::instance()->initTimer();
 		// init health-check
 		HealthCheckTask::instance()->initTimer();
+		// init host resource refresh
+		ResourceCollection::instance()->initTimer();
+		// pre-fork shell workers for ad-hoc run
+		ShellWorkerPool::instance()->initTimer();
+		// release ad-hoc run records
+		RunRegistry::instance()->initTimer();
 
 		// monitor applications
 		while (true)
@@ -139,6 +166,11 @@ int main(int argc, char* argv[])
 
 			// monitor application
 			auto allApp = Configuration::instance()->getApps();
+			// higher priority first, starts may be delayed under host pressure
+			std::stable_sort(allApp.begin(), allApp.end(), [](const std::shared_ptr<Application>& a, const std::shared_ptr<Application>& b)
+				{
+					return a->getPriority() > b->getPriority();
+				});
 			for (const auto& app : allApp)
 			{
 				app->invoke();